@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Get the number of heap allocations made through `operator new` so far, in all threads.
+//
+// The counting `operator new` lives in its own translation unit: when GCC can inline it into
+// callers that free with `operator delete`, -Wmismatched-new-delete reports its `malloc()` as
+// paired with the wrong deallocation.
+uint64_t allocation_count() noexcept;
@@ -0,0 +1,250 @@
+#include <benchmark/benchmark.h>
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/mmap_file.hh"
+
+using namespace std::string_view_literals;
+using peregrine::StatusCode;
+using peregrine::internal::File;
+using peregrine::internal::MmapFile;
+
+namespace {
+
+constexpr int64_t KiB = 1024;
+constexpr int64_t MiB = 1024 * KiB;
+
+enum class Access { sequential, random };
+enum class Cache { warm, cold };
+
+// A data file shared by all benchmarks of the same size. Files are created on first use and
+// removed when the process exits.
+class DataFile {
+  std::string path;
+  File file;
+
+public:
+  explicit DataFile(int64_t size) : path(fmt::format("./peregrine_bench_{}.dat"sv, size)) {
+    File out;
+    if(out.open(path, O_CREAT | O_TRUNC | O_WRONLY) != StatusCode::ok) std::abort();
+    std::vector<char> chunk(MiB);
+    std::mt19937_64 rng(size);
+    for(auto& c : chunk) c = static_cast<char>(rng());
+    for(int64_t written = 0; written < size; written += MiB) {
+      const auto count = static_cast<size_t>(std::min<int64_t>(MiB, size - written));
+      if(!out.pwrite(chunk.data(), count, written).ok()) std::abort();
+    }
+    out.flush();
+    if(file.open(path) != StatusCode::ok) std::abort();
+  }
+
+  ~DataFile() {
+    file.close();
+    ::unlink(path.c_str());
+  }
+
+  const File& get() const noexcept { return file; }
+
+  // Drop the file from the page cache
+  void drop_cache() const noexcept { file.advise(0, 0, POSIX_FADV_DONTNEED); }
+
+  // Read the whole file once so it is cached
+  void warm_cache() const noexcept {
+    std::vector<char> buffer(MiB);
+    for(off_t offset = 0; file.pread(buffer.data(), buffer.size(), offset).value() > 0;)
+      offset += static_cast<off_t>(buffer.size());
+  }
+
+  static const DataFile& get(int64_t size) {
+    static std::mutex mutex;
+    static std::map<int64_t, std::unique_ptr<DataFile>> files;
+    std::lock_guard lock(mutex);
+    auto& entry = files[size];
+    if(!entry) entry = std::make_unique<DataFile>(size);
+    return *entry;
+  }
+}; // class DataFile
+
+// Block offsets in the order they are read by one pass over the file
+std::vector<off_t> block_offsets(int64_t file_size, int64_t block_size, Access access, int seed) {
+  std::vector<off_t> offsets;
+  for(int64_t offset = 0; offset + block_size <= file_size; offset += block_size)
+    offsets.push_back(static_cast<off_t>(offset));
+  if(access == Access::random) std::shuffle(offsets.begin(), offsets.end(), std::mt19937(seed));
+  return offsets;
+}
+
+// Warm the cache once before a warm run. Threads start timing together, after this returns.
+void warm_cache(benchmark::State& state, const DataFile& data, Cache cache) {
+  if(cache == Cache::warm && state.thread_index() == 0) data.warm_cache();
+}
+
+// Drop the cache before each pass of a cold run. With several threads only the first one drops
+// it, so passes of the other threads may find part of the file cached.
+void drop_cache(benchmark::State& state, const DataFile& data) {
+  if(state.thread_index() == 0) data.drop_cache();
+}
+
+void set_counters(benchmark::State& state, int64_t bytes_per_pass, size_t reads_per_pass) {
+  state.SetBytesProcessed(state.iterations() * bytes_per_pass);
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(reads_per_pass));
+}
+
+// Arguments: file size, block size
+template <Access access, Cache cache>
+void BM_pread(benchmark::State& state) {
+  const int64_t file_size  = state.range(0);
+  const int64_t block_size = state.range(1);
+  const auto& data         = DataFile::get(file_size);
+  const auto offsets = block_offsets(file_size, block_size, access, state.thread_index());
+  std::vector<char> buffer(static_cast<size_t>(block_size));
+
+  warm_cache(state, data, cache);
+  for(auto _ : state) {
+    if constexpr(cache == Cache::cold) {
+      state.PauseTiming();
+      drop_cache(state, data);
+      state.ResumeTiming();
+    }
+    for(off_t offset : offsets) {
+      auto result = data.get().pread(buffer.data(), buffer.size(), offset);
+      benchmark::DoNotOptimize(result);
+    }
+  }
+  set_counters(state, static_cast<int64_t>(offsets.size()) * block_size, offsets.size());
+}
+
+// Arguments: file size, block size
+template <Cache cache>
+void BM_read(benchmark::State& state) {
+  const int64_t file_size  = state.range(0);
+  const int64_t block_size = state.range(1);
+  const auto& data         = DataFile::get(file_size);
+
+  // read() moves the shared file offset, so use a private descriptor
+  auto file = data.get().dup().value();
+  std::vector<char> buffer(static_cast<size_t>(block_size));
+  size_t reads = 0;
+
+  warm_cache(state, data, cache);
+  for(auto _ : state) {
+    state.PauseTiming();
+    if constexpr(cache == Cache::cold) drop_cache(state, data);
+    file.seek(0, SEEK_SET);
+    state.ResumeTiming();
+
+    reads = 0;
+    while(file.read(buffer.data(), buffer.size()).value() > 0) ++reads;
+  }
+  set_counters(state, file_size, reads);
+}
+
+// Arguments: file size, block size. Each call gathers four consecutive blocks.
+template <Access access, Cache cache>
+void BM_preadv(benchmark::State& state) {
+  constexpr int iovcnt     = 4;
+  const int64_t file_size  = state.range(0);
+  const int64_t block_size = state.range(1);
+  const auto& data         = DataFile::get(file_size);
+  const auto offsets =
+      block_offsets(file_size, block_size * iovcnt, access, state.thread_index());
+
+  std::vector<char> buffer(static_cast<size_t>(block_size * iovcnt));
+  struct iovec iov[iovcnt];
+  for(int i = 0; i < iovcnt; ++i)
+    iov[i] = {buffer.data() + i * block_size, static_cast<size_t>(block_size)};
+
+  warm_cache(state, data, cache);
+  for(auto _ : state) {
+    if constexpr(cache == Cache::cold) {
+      state.PauseTiming();
+      drop_cache(state, data);
+      state.ResumeTiming();
+    }
+    for(off_t offset : offsets) {
+      auto result = data.get().preadv(iov, iovcnt, offset);
+      benchmark::DoNotOptimize(result);
+    }
+  }
+  set_counters(state, static_cast<int64_t>(offsets.size()) * block_size * iovcnt, offsets.size());
+}
+
+// Arguments: file size, block size. Copies each block out of a shared read-only mapping, so the
+// cost of page faults is included.
+template <Access access, Cache cache>
+void BM_mmap(benchmark::State& state) {
+  const int64_t file_size  = state.range(0);
+  const int64_t block_size = state.range(1);
+  const auto& data         = DataFile::get(file_size);
+  const auto offsets = block_offsets(file_size, block_size, access, state.thread_index());
+  std::vector<char> buffer(static_cast<size_t>(block_size));
+
+  auto file = data.get().dup().value();
+  MmapFile map;
+  if(map.map(file) != StatusCode::ok) {
+    state.SkipWithError("mmap failed");
+    return;
+  }
+  const auto* base = static_cast<const char*>(map.data());
+
+  warm_cache(state, data, cache);
+  for(auto _ : state) {
+    if constexpr(cache == Cache::cold) {
+      // Dropped pages must be faulted in again as well as read from the device
+      state.PauseTiming();
+      map.advise(MADV_DONTNEED);
+      drop_cache(state, data);
+      state.ResumeTiming();
+    }
+    for(off_t offset : offsets) {
+      std::memcpy(buffer.data(), base + offset, buffer.size());
+      benchmark::ClobberMemory();
+    }
+  }
+  set_counters(state, static_cast<int64_t>(offsets.size()) * block_size, offsets.size());
+}
+
+void file_args(benchmark::internal::Benchmark* bench) {
+  bench->ArgNames({"file_size", "block_size"});
+  for(int64_t file_size : {16 * MiB, 256 * MiB}) {
+    for(int64_t block_size : {4 * KiB, 64 * KiB, 1 * MiB}) bench->Args({file_size, block_size});
+  }
+  bench->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+void threaded_file_args(benchmark::internal::Benchmark* bench) {
+  file_args(bench);
+  bench->ThreadRange(1, 8);
+}
+
+} // namespace
+
+BENCHMARK(BM_read<Cache::warm>)->Apply(file_args);
+BENCHMARK(BM_read<Cache::cold>)->Apply(file_args);
+
+BENCHMARK(BM_pread<Access::sequential, Cache::warm>)->Apply(file_args);
+BENCHMARK(BM_pread<Access::sequential, Cache::cold>)->Apply(file_args);
+BENCHMARK(BM_pread<Access::random, Cache::warm>)->Apply(threaded_file_args);
+BENCHMARK(BM_pread<Access::random, Cache::cold>)->Apply(threaded_file_args);
+
+BENCHMARK(BM_preadv<Access::sequential, Cache::warm>)->Apply(file_args);
+BENCHMARK(BM_preadv<Access::random, Cache::warm>)->Apply(threaded_file_args);
+BENCHMARK(BM_preadv<Access::random, Cache::cold>)->Apply(threaded_file_args);
+
+BENCHMARK(BM_mmap<Access::sequential, Cache::warm>)->Apply(file_args);
+BENCHMARK(BM_mmap<Access::sequential, Cache::cold>)->Apply(file_args);
+BENCHMARK(BM_mmap<Access::random, Cache::warm>)->Apply(threaded_file_args);
+BENCHMARK(BM_mmap<Access::random, Cache::cold>)->Apply(threaded_file_args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "peregrine/internal/merge_iterator.hh"
+
+using peregrine::internal::MergeEntry;
+using peregrine::internal::MergeIterator;
+using peregrine::internal::MergeSource;
+using peregrine::internal::SpanSource;
+
+namespace {
+
+constexpr size_t total_entries = size_t{1} << 20;
+
+// `count` sorted runs sharing `total_entries` entries of 16-byte keys and 16-byte values. Keys
+// are drawn at random, so runs interleave and some keys have several versions. Each run's keys
+// are laid out in order in one buffer, like a batch read from a sorted file.
+class Runs {
+  std::string value = std::string(16, 'v');
+  std::vector<std::string> arenas;
+
+public:
+  std::vector<std::vector<MergeEntry>> runs;
+  int64_t bytes{0};
+
+  explicit Runs(size_t count) : arenas(count), runs(count) {
+    std::mt19937_64 rng(count);
+    std::vector<uint64_t> keys(total_entries);
+    for(auto& key : keys) key = rng();
+
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> versions(count);
+    for(uint64_t sequence = 1; sequence <= total_entries; ++sequence)
+      versions[sequence % count].emplace_back(keys[rng() % keys.size()], sequence);
+    for(size_t r = 0; r < count; ++r) {
+      auto& run = versions[r];
+      std::sort(run.begin(), run.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first < b.first : a.second > b.second;
+      });
+      for(const auto& [key, sequence] : run) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(key));
+        arenas[r].append(buf, 16);
+      }
+      for(size_t i = 0; i < run.size(); ++i) {
+        const std::string_view key(arenas[r].data() + 16 * i, 16);
+        runs[r].push_back({key, value, run[i].second, false});
+        bytes += static_cast<int64_t>(key.size() + value.size());
+      }
+    }
+  }
+}; // class Runs
+
+// Arguments: number of runs, whether duplicates are resolved
+void BM_merge(benchmark::State& state) {
+  const Runs data(static_cast<size_t>(state.range(0)));
+  MergeIterator::Options options;
+  options.resolve_duplicates = state.range(1) != 0;
+  std::vector<MergeEntry> batch(256);
+
+  for(auto _ : state) {
+    std::vector<std::unique_ptr<MergeSource>> sources;
+    for(const auto& run : data.runs)
+      sources.push_back(std::make_unique<SpanSource>(run.data(), run.size()));
+    MergeIterator merge(std::move(sources), options);
+    while(merge.next_batch(batch.data(), batch.size()).value() != 0)
+      benchmark::DoNotOptimize(batch.data());
+  }
+  state.SetBytesProcessed(state.iterations() * data.bytes);
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(total_entries));
+}
+
+} // namespace
+
+BENCHMARK(BM_merge)
+    ->ArgNames({"runs", "resolve"})
+    ->ArgsProduct({{2, 8, 16, 64}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
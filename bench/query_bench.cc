@@ -0,0 +1,337 @@
+// End-to-end query benchmark.
+//
+// Builds a synthetic sorted key/value index file with `File`, maps it with `MmapFile` and runs
+// point lookups from several threads, either closed loop (each thread issues the next query as
+// soon as the previous one finishes) or open loop (queries are issued on a fixed schedule and
+// latency is measured from the scheduled time, so queueing delay is not hidden). Reports
+// throughput, latency percentiles and heap allocations per query.
+//
+// Usage: peregrine_query_bench [--keys=N] [--dataset=sequential|uniform]
+//            [--access=uniform|zipf|sequential] [--zipf_theta=F] [--threads=N] [--seconds=F]
+//            [--mode=closed|open] [--rate=QPS] [--seed=N] [--path=FILE] [--json=FILE]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allocation_count.hh"
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/io_stats.hh"
+#include "peregrine/internal/mmap_file.hh"
+
+using namespace std::string_view_literals;
+using peregrine::StatusCode;
+using peregrine::internal::File;
+using peregrine::internal::IoHistogram;
+using peregrine::internal::MmapFile;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct Options {
+  uint64_t keys{10'000'000};
+  std::string dataset{"uniform"};
+  std::string access{"zipf"};
+  double zipf_theta{0.99};
+  unsigned threads{1};
+  double seconds{5.0};
+  std::string mode{"closed"};
+  double rate{100'000.0}; // Total queries per second in open loop mode
+  uint64_t seed{1};
+  std::string path{"./peregrine_query_bench.dat"};
+  std::string json;
+}; // struct Options
+
+struct Header {
+  uint64_t magic;
+  uint64_t count;
+}; // struct Header
+
+struct Record {
+  uint64_t key;
+  uint64_t value;
+}; // struct Record
+
+constexpr uint64_t file_magic = 0x7065726567726e31; // "peregrn1"
+
+uint64_t value_of(uint64_t key) noexcept { return key * 0x9e3779b97f4a7c15ull; }
+
+[[noreturn]] void usage(const char* arg) {
+  std::fprintf(stderr, "unknown argument: %s\n", arg);
+  std::exit(2);
+}
+
+Options parse(int argc, char** argv) {
+  Options options;
+  for(int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    auto eq              = arg.find('=');
+    if(arg.substr(0, 2) != "--"sv || eq == std::string_view::npos) usage(argv[i]);
+    const auto name  = arg.substr(2, eq - 2);
+    const auto value = std::string(arg.substr(eq + 1));
+    if(name == "keys"sv) options.keys = std::stoull(value);
+    else if(name == "dataset"sv) options.dataset = value;
+    else if(name == "access"sv) options.access = value;
+    else if(name == "zipf_theta"sv) options.zipf_theta = std::stod(value);
+    else if(name == "threads"sv) options.threads = std::max(1u, unsigned(std::stoul(value)));
+    else if(name == "seconds"sv) options.seconds = std::stod(value);
+    else if(name == "mode"sv) options.mode = value;
+    else if(name == "rate"sv) options.rate = std::stod(value);
+    else if(name == "seed"sv) options.seed = std::stoull(value);
+    else if(name == "path"sv) options.path = value;
+    else if(name == "json"sv) options.json = value;
+    else usage(argv[i]);
+  }
+  if(options.dataset != "uniform"sv && options.dataset != "sequential"sv) usage("--dataset");
+  if(options.access != "uniform"sv && options.access != "zipf"sv &&
+      options.access != "sequential"sv)
+    usage("--access");
+  if(options.mode != "closed"sv && options.mode != "open"sv) usage("--mode");
+  return options;
+}
+
+// Write a sorted index of `keys` records
+void generate(const Options& options) {
+  std::vector<uint64_t> keys(options.keys);
+  if(options.dataset == "sequential"sv) {
+    for(uint64_t i = 0; i < options.keys; ++i) keys[i] = i;
+  } else {
+    std::mt19937_64 rng(options.seed);
+    for(auto& key : keys) key = rng();
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  }
+
+  File file;
+  if(file.open(options.path, O_CREAT | O_TRUNC | O_WRONLY) != StatusCode::ok) std::exit(1);
+  Header header{file_magic, keys.size()};
+  file.pwrite(&header, sizeof(header), 0);
+
+  constexpr size_t batch = 1 << 16;
+  std::vector<Record> records;
+  records.reserve(batch);
+  off_t offset = sizeof(header);
+  for(size_t i = 0; i < keys.size(); i += batch) {
+    records.clear();
+    for(size_t j = i; j < std::min(keys.size(), i + batch); ++j)
+      records.push_back({keys[j], value_of(keys[j])});
+    const size_t bytes = records.size() * sizeof(Record);
+    if(file.pwrite(records.data(), bytes, offset).value() != static_cast<ssize_t>(bytes))
+      std::exit(1);
+    offset += static_cast<off_t>(bytes);
+  }
+  file.flush();
+}
+
+// Zipfian ranks in [0, n), from Gray et al. "Quickly generating billion-record synthetic
+// databases", as used by YCSB. Rank 0 is the most popular.
+class Zipfian {
+  uint64_t n;
+  double theta, alpha, zetan, eta;
+
+  static double zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for(uint64_t i = 1; i <= n; ++i) sum += 1.0 / std::pow(static_cast<double>(i), theta);
+    return sum;
+  }
+
+public:
+  Zipfian(uint64_t n, double theta) : n(n), theta(theta) {
+    zetan              = zeta(n, theta);
+    const double zeta2 = zeta(2, theta);
+    alpha              = 1.0 / (1.0 - theta);
+    eta = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta)) / (1.0 - zeta2 / zetan);
+  }
+
+  uint64_t operator()(double u) const noexcept {
+    const double uz = u * zetan;
+    if(uz < 1.0) return 0;
+    if(uz < 1.0 + std::pow(0.5, theta)) return 1;
+    const auto rank =
+        static_cast<uint64_t>(static_cast<double>(n) * std::pow(eta * u - eta + 1.0, alpha));
+    return std::min(rank, n - 1);
+  }
+}; // class Zipfian
+
+struct Index {
+  const Record* records{nullptr};
+  uint64_t count{0};
+
+  bool lookup(uint64_t key, uint64_t& value) const noexcept {
+    const Record* end = records + count;
+    const Record* it  = std::lower_bound(records, end, key,
+         [](const Record& record, uint64_t key) { return record.key < key; });
+    if(it == end || it->key != key) return false;
+    value = it->value;
+    return true;
+  }
+}; // struct Index
+
+struct ThreadResult {
+  IoHistogram latency;
+  uint64_t queries{0};
+  uint64_t misses{0};
+  uint64_t allocations{0};
+}; // struct ThreadResult
+
+void run_thread(const Options& options, const Index& index, const Zipfian* zipf, unsigned id,
+    clock_type::time_point start, clock_type::time_point stop, ThreadResult& result) {
+  std::mt19937_64 rng(options.seed * 7919 + id);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  // Spread popular ranks over the key space so hot keys do not share cache lines
+  const uint64_t scatter = 0x9e3779b97f4a7c15ull | 1;
+  uint64_t next_sequential = index.count / options.threads * id;
+
+  auto next_key = [&]() -> uint64_t {
+    uint64_t position;
+    if(options.access == "zipf"sv) {
+      position = ((*zipf)(uniform(rng)) * scatter) % index.count;
+    } else if(options.access == "sequential"sv) {
+      position = next_sequential++ % index.count;
+    } else {
+      position = rng() % index.count;
+    }
+    return index.records[position].key;
+  };
+
+  const bool open_loop = options.mode == "open"sv;
+  const auto interval  = std::chrono::duration_cast<clock_type::duration>(
+      std::chrono::duration<double>(options.threads / options.rate));
+  auto scheduled = start;
+
+  const uint64_t allocations_before = allocation_count();
+  while(true) {
+    const uint64_t key = next_key();
+
+    clock_type::time_point begin;
+    if(open_loop) {
+      scheduled += interval;
+      if(scheduled >= stop) break;
+      while(clock_type::now() < scheduled) {}
+      begin = scheduled;
+    } else {
+      begin = clock_type::now();
+      if(begin >= stop) break;
+    }
+
+    uint64_t value = 0;
+    if(!index.lookup(key, value) || value != value_of(key)) ++result.misses;
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock_type::now() - begin);
+    ++result.latency.counts[IoHistogram::index(static_cast<uint64_t>(elapsed.count()))];
+    ++result.queries;
+  }
+  // Allocations are counted process wide, so each thread sees the allocations of all threads
+  // during its run. The longest window is used as the total.
+  result.allocations = allocation_count() - allocations_before;
+}
+
+void report(const Options& options, const ThreadResult& total, double seconds) {
+  const double qps              = static_cast<double>(total.queries) / seconds;
+  const double allocs_per_query = total.queries == 0
+                                      ? 0.0
+                                      : static_cast<double>(total.allocations) /
+                                            static_cast<double>(total.queries);
+  const auto& h = total.latency;
+
+  std::printf("dataset=%s keys=%llu access=%s mode=%s threads=%u\n", options.dataset.c_str(),
+      static_cast<unsigned long long>(options.keys), options.access.c_str(), options.mode.c_str(),
+      options.threads);
+  std::printf("queries=%llu misses=%llu seconds=%.2f qps=%.0f allocs/query=%.3f\n",
+      static_cast<unsigned long long>(total.queries),
+      static_cast<unsigned long long>(total.misses), seconds, qps, allocs_per_query);
+  std::printf("latency ns: p50<=%llu p90<=%llu p99<=%llu p999<=%llu max<=%llu\n",
+      static_cast<unsigned long long>(h.percentile(0.5)),
+      static_cast<unsigned long long>(h.percentile(0.9)),
+      static_cast<unsigned long long>(h.percentile(0.99)),
+      static_cast<unsigned long long>(h.percentile(0.999)),
+      static_cast<unsigned long long>(h.percentile(1.0)));
+
+  if(options.json.empty()) return;
+
+  // Percentiles plus the raw non-empty buckets, for merging or plotting runs later
+  std::string json = fmt::format(
+      "{{\"dataset\":\"{}\",\"keys\":{},\"access\":\"{}\",\"mode\":\"{}\",\"threads\":{},"
+      "\"queries\":{},\"misses\":{},\"seconds\":{:.3f},\"qps\":{:.1f},\"allocs_per_query\":{:.4f},"
+      "\"latency_ns\":{{\"p50\":{},\"p90\":{},\"p99\":{},\"p999\":{},\"max\":{}}},"
+      "\"histogram\":["sv,
+      options.dataset, options.keys, options.access, options.mode, options.threads, total.queries,
+      total.misses, seconds, qps, allocs_per_query, h.percentile(0.5), h.percentile(0.9),
+      h.percentile(0.99), h.percentile(0.999), h.percentile(1.0));
+  bool first = true;
+  for(size_t i = 0; i < IoHistogram::bucket_count; ++i) {
+    if(h.counts[i] == 0) continue;
+    json += fmt::format("{}[{},{},{}]"sv, first ? "" : ",", IoHistogram::lower_bound(i),
+        IoHistogram::upper_bound(i), h.counts[i]);
+    first = false;
+  }
+  json += "]}\n";
+
+  File out;
+  if(out.open(options.json, O_CREAT | O_TRUNC | O_WRONLY) != StatusCode::ok ||
+      !out.write(json.data(), json.size()).ok())
+    std::fprintf(stderr, "failed to write %s\n", options.json.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const Options options = parse(argc, argv);
+
+  generate(options);
+
+  File file;
+  MmapFile map;
+  if(file.open(options.path) != StatusCode::ok ||
+      map.map(file, PROT_READ, MAP_SHARED) != StatusCode::ok)
+    return 1;
+  map.advise(MADV_WILLNEED);
+
+  const auto* header = static_cast<const Header*>(map.data());
+  if(header->magic != file_magic) return 1;
+  const Index index{reinterpret_cast<const Record*>(header + 1), header->count};
+
+  std::unique_ptr<Zipfian> zipf;
+  if(options.access == "zipf"sv) zipf = std::make_unique<Zipfian>(index.count, options.zipf_theta);
+
+  std::vector<ThreadResult> results(options.threads);
+  std::vector<std::thread> threads;
+  const auto start = clock_type::now() + std::chrono::milliseconds(10);
+  const auto stop  = start + std::chrono::duration_cast<clock_type::duration>(
+                                std::chrono::duration<double>(options.seconds));
+  for(unsigned id = 0; id < options.threads; ++id) {
+    threads.emplace_back([&, id] {
+      std::this_thread::sleep_until(start);
+      run_thread(options, index, zipf.get(), id, start, stop, results[id]);
+    });
+  }
+  for(auto& thread : threads) thread.join();
+
+  ThreadResult total;
+  uint64_t max_allocations = 0;
+  for(const auto& result : results) {
+    total.latency += result.latency;
+    total.queries += result.queries;
+    total.misses += result.misses;
+    max_allocations = std::max(max_allocations, result.allocations);
+  }
+  total.allocations = max_allocations;
+
+  report(options, total, options.seconds);
+
+  map.unmap();
+  file.close();
+  ::unlink(options.path.c_str());
+  return total.misses == 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <string_view>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class AppendFile
+ * @brief A file written front to back that reserves disk space ahead of the writes.
+ *
+ * Growing a file one write at a time lets the file system allocate blocks piecemeal, which
+ * fragments the file into many extents and updates the block map on every write. `AppendFile`
+ * instead reserves space past the end of the file with `fallocate(FALLOC_FL_KEEP_SIZE)` in chunks
+ * that grow geometrically, from `Options::initial_chunk` up to `Options::max_chunk`. The file
+ * keeps its logical size, so readers never see the reserved tail, and `close()` trims whatever
+ * was reserved but not written.
+ *
+ * If the file system does not support preallocation, appends fall back to plain writes.
+ */
+class AppendFile {
+public:
+  /**
+   * @brief Preallocation options.
+   */
+  struct Options {
+    off_t initial_chunk = off_t{1} << 20; // First reservation
+    off_t max_chunk     = off_t{1} << 30; // Largest single reservation
+    double growth       = 2.0;            // Each reservation is this much larger than the last
+    bool preallocate    = true;           // Reserve space ahead of the writes
+  }; // struct Options
+
+  AppendFile() noexcept = default;
+
+  explicit AppendFile(Options options) noexcept : options(options) {}
+
+  AppendFile(const AppendFile&)            = delete;
+  AppendFile& operator=(const AppendFile&) = delete;
+
+  AppendFile(AppendFile&& other) noexcept;
+  AppendFile& operator=(AppendFile&& other) noexcept;
+
+  /**
+   * @brief Destructor.
+   *
+   * Trims the reserved tail and closes the file, if it is open.
+   */
+  ~AppendFile() { close(); }
+
+  /**
+   * @brief Open a file for appending.
+   *
+   * Writes continue at the current end of the file.
+   *
+   * @param path The path to the file.
+   * @param flags Additional flags, e.g. `O_TRUNC` or `O_EXCL`. `O_WRONLY` and `O_CREAT` are always
+   * set.
+   * @param mode The mode of a newly created file.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode open(std::string_view path, int flags = 0, mode_t mode = File::default_mode);
+
+  /**
+   * @brief Write `count` bytes at the end of the file.
+   *
+   * @return The number of bytes written, or the error status.
+   */
+  Result<ssize_t> append(const void* buf, size_t count) noexcept;
+
+  /**
+   * @brief Reserve space for at least `length` more bytes without changing the file size.
+   *
+   * Useful when the final size is known up front. Reservations never shrink.
+   *
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode reserve(off_t length) noexcept;
+
+  /**
+   * @brief Flush written data to the disk.
+   *
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode flush() const noexcept { return file.flush(); }
+
+  /**
+   * @brief Trim the reserved tail and close the file.
+   *
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode close() noexcept;
+
+  /**
+   * @brief Get the number of bytes in the file.
+   */
+  off_t size() const noexcept { return end; }
+
+  /**
+   * @brief Get the offset up to which disk space is reserved.
+   */
+  off_t reserved() const noexcept { return allocated; }
+
+  /**
+   * @brief Check if the file is open.
+   */
+  bool is_open() const noexcept { return file.is_open(); }
+
+  /**
+   * @brief Get the underlying file, e.g. to read back what was written.
+   */
+  const File& get() const noexcept { return file; }
+
+private:
+  File file;
+  Options options;
+  off_t end{0};       // Logical size of the file
+  off_t allocated{0}; // End of the reserved space
+  off_t chunk{0};     // Size of the next reservation
+
+  StatusCode grow(off_t required) noexcept;
+  StatusCode preallocate(off_t target) noexcept;
+}; // class AppendFile
+
+} // namespace internal
+} // namespace peregrine
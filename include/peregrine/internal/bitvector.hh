@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "simd.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class BitVector
+ * @brief A growable sequence of bits, serialized with a rank/select index for `RankSelect`.
+ */
+class BitVector {
+  std::vector<uint64_t> words;
+  uint64_t bits{0};
+
+public:
+  BitVector() = default;
+
+  /**
+   * @brief Create `size` zero bits.
+   */
+  explicit BitVector(uint64_t size) : words((size + 63) / 64), bits(size) {}
+
+  /**
+   * @brief Append a bit.
+   */
+  void push_back(bool bit) {
+    if(bits % 64 == 0) words.push_back(0);
+    words.back() |= static_cast<uint64_t>(bit) << (bits % 64);
+    ++bits;
+  }
+
+  /**
+   * @brief Set bit `i` to one. `i` must be less than `size()`.
+   */
+  void set(uint64_t i) noexcept { words[i / 64] |= uint64_t{1} << (i % 64); }
+
+  /**
+   * @brief Get bit `i`.
+   */
+  bool get(uint64_t i) const noexcept { return (words[i / 64] >> (i % 64)) & 1; }
+
+  /**
+   * @brief Get the number of bits.
+   */
+  uint64_t size() const noexcept { return bits; }
+
+  /**
+   * @brief Get the bits packed least significant bit first.
+   */
+  const std::vector<uint64_t>& data() const noexcept { return words; }
+
+  /**
+   * @brief Serialize the bits and their rank/select index in the format read by `RankSelect`.
+   */
+  std::string serialize() const;
+}; // class BitVector
+
+/**
+ * @class RankSelect
+ * @brief Constant-time rank and select over a serialized `BitVector`, read in place, e.g. inside
+ * an `MmapFile`.
+ *
+ * The index follows Rank9: every 512-bit block stores its absolute rank and the 9-bit relative
+ * ranks of its words, so `rank1()` is two memory accesses and a popcount. Select samples the block
+ * of every 512th one (and zero), binary searches the blocks between samples, then picks the word
+ * from the relative ranks and the bit with `select64()` (`pdep` when BMI2 is enabled). The index
+ * costs 25% of the bits plus about 0.8% for the samples.
+ *
+ * The format is, in native (little-endian) byte order and 8-byte aligned:
+ *
+ * - A 40-byte header: magic `PRRS`, version, bit count, one count, block count and sample counts.
+ * - The bits as 64-bit words, padded with zeros to whole blocks.
+ * - Two 64-bit counters per block plus a final one holding the total: the rank before the block
+ *   and the packed relative ranks.
+ * - The select samples for ones, then for zeros: 32-bit block numbers, each list ending with the
+ *   block count and padded to 8 bytes.
+ */
+class RankSelect {
+public:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t bits;
+    uint64_t ones;
+    uint64_t blocks;
+    uint32_t samples1; // Including the final sample
+    uint32_t samples0;
+  }; // struct Header
+
+  static constexpr uint32_t magic   = 0x53525250; // "PRRS"
+  static constexpr uint16_t version = 1;
+
+  // Bits per block and ones (or zeros) per select sample
+  static constexpr uint64_t block_bits  = 512;
+  static constexpr uint64_t sample_rate = 512;
+
+  RankSelect() noexcept = default;
+
+  /**
+   * @brief Validate serialized bytes and view them.
+   *
+   * @param data The start of the serialized bitvector. Must be 8-byte aligned.
+   * @param size The number of bytes available.
+   * @return The view, or `StatusCode::invalid_argument` if the bytes are not a valid bitvector.
+   */
+  static Result<RankSelect> open(const void* data, size_t size) noexcept;
+
+  /**
+   * @brief Get the size of the serialized bitvector with `bits` bits and `ones` ones.
+   */
+  static size_t serialized_size(uint64_t bits, uint64_t ones) noexcept;
+
+  /**
+   * @brief Get bit `i`.
+   */
+  bool get(uint64_t i) const noexcept { return (words[i / 64] >> (i % 64)) & 1; }
+
+  /**
+   * @brief Count the ones in `[0, i)`. `i` may be up to `size()`.
+   */
+  uint64_t rank1(uint64_t i) const noexcept {
+    const uint64_t block = i / block_bits;
+    const uint64_t sub   = (i / 64) % 8;
+    uint64_t rank        = counts[2 * block];
+    if(sub != 0) rank += (counts[2 * block + 1] >> (9 * (sub - 1))) & 0x1ff;
+    if(i % 64 != 0) rank += popcount64(words[i / 64] & ((uint64_t{1} << (i % 64)) - 1));
+    return rank;
+  }
+
+  /**
+   * @brief Count the zeros in `[0, i)`.
+   */
+  uint64_t rank0(uint64_t i) const noexcept { return i - rank1(i); }
+
+  /**
+   * @brief Get the position of the one with `k` ones before it. `k` must be less than `ones()`.
+   */
+  uint64_t select1(uint64_t k) const noexcept;
+
+  /**
+   * @brief Get the position of the zero with `k` zeros before it. `k` must be less than `zeros()`.
+   */
+  uint64_t select0(uint64_t k) const noexcept;
+
+  /**
+   * @brief Get the number of bits.
+   */
+  uint64_t size() const noexcept { return header != nullptr ? header->bits : 0; }
+
+  /**
+   * @brief Get the number of ones.
+   */
+  uint64_t ones() const noexcept { return header != nullptr ? header->ones : 0; }
+
+  /**
+   * @brief Get the number of zeros.
+   */
+  uint64_t zeros() const noexcept { return size() - ones(); }
+
+  /**
+   * @brief Get the size of the serialized bitvector in bytes.
+   */
+  size_t bytes() const noexcept { return header != nullptr ? serialized_size(size(), ones()) : 0; }
+
+private:
+  const Header* header{nullptr};
+  const uint64_t* words{nullptr};
+  const uint64_t* counts{nullptr};
+  const uint32_t* samples1{nullptr};
+  const uint32_t* samples0{nullptr};
+}; // class RankSelect
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief The value type of a column.
+ */
+enum class ColumnType : uint8_t {
+  int32   = 0,
+  int64   = 1,
+  float32 = 2,
+  float64 = 3,
+}; // enum class ColumnType
+
+template<typename T>
+struct ColumnTypeOf;
+template<>
+struct ColumnTypeOf<int32_t> : std::integral_constant<ColumnType, ColumnType::int32> {};
+template<>
+struct ColumnTypeOf<int64_t> : std::integral_constant<ColumnType, ColumnType::int64> {};
+template<>
+struct ColumnTypeOf<float> : std::integral_constant<ColumnType, ColumnType::float32> {};
+template<>
+struct ColumnTypeOf<double> : std::integral_constant<ColumnType, ColumnType::float64> {};
+
+/**
+ * @brief The smallest and largest value of a block of a column. NaNs are ignored.
+ */
+template<typename T>
+struct Zone {
+  T min;
+  T max;
+}; // struct Zone
+
+/**
+ * @brief Counters of a predicate scan.
+ */
+struct ScanStats {
+  uint64_t matches{0};        // Rows that satisfy the predicate
+  uint64_t blocks_scanned{0}; // Blocks whose values were compared
+  uint64_t blocks_skipped{0}; // Blocks the zone maps showed have no match
+  uint64_t blocks_matched{0}; // Blocks the zone maps showed match entirely
+
+  void merge(const ScanStats& other) noexcept {
+    matches += other.matches;
+    blocks_scanned += other.blocks_scanned;
+    blocks_skipped += other.blocks_skipped;
+    blocks_matched += other.blocks_matched;
+  }
+}; // struct ScanStats
+
+/**
+ * @brief The count, sum, minimum and maximum of some values of a column.
+ *
+ * Integers sum into 64 bits and wrap on overflow; floats sum into a double. Minimums and maximums
+ * ignore NaNs and are only meaningful if `count != 0`.
+ */
+template<typename T>
+struct Aggregate {
+  using Sum = std::conditional_t<std::is_floating_point_v<T>, double, int64_t>;
+
+  uint64_t count{0};
+  Sum sum{0};
+  T min{std::numeric_limits<T>::max()};
+  T max{std::numeric_limits<T>::lowest()};
+
+  void merge(const Aggregate& other) noexcept {
+    count += other.count;
+    if constexpr(std::is_floating_point_v<T>) {
+      sum += other.sum;
+    } else {
+      sum = static_cast<Sum>(static_cast<uint64_t>(sum) + static_cast<uint64_t>(other.sum));
+    }
+    if(other.min < min) min = other.min;
+    if(other.max > max) max = other.max;
+  }
+}; // struct Aggregate
+
+/**
+ * @class ColumnStoreBuilder
+ * @brief Builds a set of equally long fixed-width columns in the format read by `ColumnStore`.
+ */
+class ColumnStoreBuilder {
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param block_rows The rows per zone map block, rounded up to a multiple of 64. Smaller blocks
+   * let scans skip more precisely and make the zone maps larger.
+   */
+  explicit ColumnStoreBuilder(uint32_t block_rows = 4096) noexcept
+      : block_rows(block_rows == 0 ? 64 : (block_rows + 63) / 64 * 64) {}
+
+  /**
+   * @brief Append a column of `int32_t`, `int64_t`, `float` or `double` values.
+   *
+   * @return `StatusCode::invalid_argument` if `count` differs from the earlier columns.
+   */
+  template<typename T>
+  StatusCode add(const T* values, size_t count);
+
+  /**
+   * @brief Get the number of columns added.
+   */
+  size_t size() const noexcept { return columns.size(); }
+
+  /**
+   * @brief Serialize the columns and reset the builder.
+   */
+  std::string finish();
+
+private:
+  struct Column {
+    ColumnType type;
+    std::string zones;
+    std::string data;
+  }; // struct Column
+
+  std::vector<Column> columns;
+  uint64_t rows{0};
+  uint32_t block_rows;
+}; // class ColumnStoreBuilder
+
+/**
+ * @class ColumnStore
+ * @brief Fixed-width columns with per-block zone maps, scanned in place from serialized bytes
+ * such as an `MmapFile`.
+ *
+ * `select()` evaluates `lo <= value <= hi` into a bitmap of rows, 64 rows per word. Blocks whose
+ * zone map excludes the range are skipped without reading their values, and integer blocks that
+ * lie entirely inside it are filled without comparisons. Other blocks are compared 4 values per
+ * instruction with SSE2 or NEON for 32-bit types. `aggregate()` computes count, sum, minimum and
+ * maximum, optionally of the rows of a bitmap, with SIMD kernels for full 64-row words.
+ *
+ * Both take a block range, and blocks hold a whole number of bitmap words, so threads can scan
+ * disjoint block ranges into one bitmap and merge their `ScanStats` and `Aggregate`s.
+ *
+ * The format is, in native (little-endian) byte order and 8-byte aligned:
+ *
+ * - A 32-byte header: magic `PRCS`, version, column count, rows per block, row count and block
+ *   count.
+ * - A 24-byte entry per column: type, value width, and the offsets of its zone map and values.
+ * - For each column, the zone map as a minimum and maximum per block, then the values, each
+ *   padded to 8 bytes.
+ */
+class ColumnStore {
+public:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t columns;
+    uint32_t block_rows;
+    uint64_t rows;
+    uint64_t blocks;
+  }; // struct Header
+
+  struct Column {
+    uint8_t type;
+    uint8_t width;
+    uint8_t reserved[6];
+    uint64_t zones_offset;
+    uint64_t data_offset;
+  }; // struct Column
+
+  static constexpr uint32_t magic   = 0x53435250; // "PRCS"
+  static constexpr uint16_t version = 1;
+
+  ColumnStore() noexcept = default;
+
+  /**
+   * @brief Validate serialized bytes and view them.
+   *
+   * @param data The start of the serialized columns. Must be 8-byte aligned.
+   * @param size The number of bytes available.
+   * @return The view, or `StatusCode::invalid_argument` if the bytes are not a valid store.
+   */
+  static Result<ColumnStore> open(const void* data, size_t size) noexcept;
+
+  /**
+   * @brief Get the values of a column, or nullptr if it is not of type `T`.
+   */
+  template<typename T>
+  const T* values(size_t column) const noexcept {
+    if(column >= columns() || type(column) != ColumnTypeOf<T>::value) return nullptr;
+    return reinterpret_cast<const T*>(base + entries[column].data_offset);
+  }
+
+  /**
+   * @brief Get the zone map of a column, or nullptr if it is not of type `T`.
+   */
+  template<typename T>
+  const Zone<T>* zones(size_t column) const noexcept {
+    if(column >= columns() || type(column) != ColumnTypeOf<T>::value) return nullptr;
+    return reinterpret_cast<const Zone<T>*>(base + entries[column].zones_offset);
+  }
+
+  /**
+   * @brief Set the bit of each row in `[first_block, last_block)` whose value is in `[lo, hi]`.
+   *
+   * @param bitmap Receives `(rows() + 63) / 64` words; only the words of the block range are
+   * written. NaNs never match.
+   * @return The scan counters, or `StatusCode::invalid_argument` if the column is not of type `T`.
+   */
+  template<typename T>
+  Result<ScanStats> select(size_t column, T lo, T hi, uint64_t* bitmap, uint64_t first_block = 0,
+      uint64_t last_block = UINT64_MAX) const noexcept;
+
+  /**
+   * @brief Aggregate the values of the rows in `[first_block, last_block)`.
+   *
+   * @param filter A bitmap from `select()`, or nullptr for every row.
+   * @return The aggregate, or `StatusCode::invalid_argument` if the column is not of type `T`.
+   */
+  template<typename T>
+  Result<Aggregate<T>> aggregate(size_t column, const uint64_t* filter = nullptr,
+      uint64_t first_block = 0, uint64_t last_block = UINT64_MAX) const noexcept;
+
+  /**
+   * @brief Get the type of a column.
+   */
+  ColumnType type(size_t column) const noexcept {
+    return static_cast<ColumnType>(entries[column].type);
+  }
+
+  /**
+   * @brief Get the number of columns.
+   */
+  uint32_t columns() const noexcept { return header != nullptr ? header->columns : 0; }
+
+  /**
+   * @brief Get the number of rows.
+   */
+  uint64_t rows() const noexcept { return header != nullptr ? header->rows : 0; }
+
+  /**
+   * @brief Get the number of zone map blocks.
+   */
+  uint64_t blocks() const noexcept { return header != nullptr ? header->blocks : 0; }
+
+  /**
+   * @brief Get the number of rows per block.
+   */
+  uint32_t block_rows() const noexcept { return header != nullptr ? header->block_rows : 0; }
+
+  /**
+   * @brief Get the size of the serialized store in bytes.
+   */
+  size_t bytes() const noexcept { return total; }
+
+private:
+  const Header* header{nullptr};
+  const Column* entries{nullptr};
+  const char* base{nullptr};
+  size_t total{0};
+}; // class ColumnStore
+
+} // namespace internal
+} // namespace peregrine
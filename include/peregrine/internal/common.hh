@@ -5,6 +5,11 @@
 
 #define PEREGRINE_FORCE_INLINE __attribute__((always_inline)) inline
 
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <string_view>
 
@@ -13,4 +18,34 @@ namespace peregrine {
 using namespace std::string_view_literals;
 using namespace std::string_literals;
 
+namespace internal {
+
+/**
+ * @brief Round a size up to a multiple of 8 bytes, the alignment of sections in serialized formats.
+ */
+constexpr uint64_t pad8(uint64_t size) noexcept { return (size + 7) & ~uint64_t{7}; }
+
+/**
+ * @brief Get the system page size.
+ */
+inline size_t page_size() noexcept {
+  static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+/**
+ * @brief Get the stripe of `count` striped counters that the calling thread updates.
+ *
+ * Threads keep their stripe for life. The first `count` threads get distinct stripes; beyond that
+ * stripes are shared.
+ */
+template <size_t count>
+size_t thread_stripe() noexcept {
+  static std::atomic<size_t> next{0};
+  thread_local const size_t stripe = next.fetch_add(1, std::memory_order_relaxed) % count;
+  return stripe;
+}
+
+} // namespace internal
+
 } // namespace peregrine
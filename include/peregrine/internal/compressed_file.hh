@@ -0,0 +1,265 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+#include "mmap_file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief How a block of a `CompressedFile` is stored.
+ */
+enum class Codec : uint8_t {
+  none = 0,
+  lz4  = 1, // Available when built with PEREGRINE_HAVE_LZ4
+  zstd = 2, // Available when built with PEREGRINE_HAVE_ZSTD
+}; // enum class Codec
+
+constexpr size_t codec_count = 3;
+
+/**
+ * @brief Get the name of a codec.
+ */
+std::string_view codec_name(Codec codec) noexcept;
+
+/**
+ * @brief Check if a codec was compiled in.
+ */
+bool codec_available(Codec codec) noexcept;
+
+/**
+ * @brief Train a Zstd dictionary from sample blocks.
+ *
+ * @return The dictionary, `StatusCode::enotsup` without Zstd, or `StatusCode::invalid_argument` if
+ * the samples are too few or too small to train on.
+ */
+Result<std::string> train_dictionary(const std::vector<std::string_view>& samples, size_t max_size);
+
+/**
+ * @brief Counters describing the blocks written to or read from compressed files.
+ */
+struct CompressionStats {
+  uint64_t blocks[codec_count]{}; // Blocks written, or decompressed, by codec
+  uint64_t raw_bytes{0};          // Uncompressed bytes of those blocks
+  uint64_t stored_bytes{0};       // Stored bytes of those blocks
+  uint64_t cache_hits{0};         // Reads served from decompressed blocks in the cache
+  uint64_t cache_misses{0};       // Reads that had to decompress a block
+  uint64_t decompress_nanos{0};   // Time spent decompressing
+
+  /**
+   * @brief Get the compression ratio, uncompressed over stored bytes.
+   */
+  double ratio() const noexcept {
+    return stored_bytes != 0 ? static_cast<double>(raw_bytes) / stored_bytes : 1.0;
+  }
+
+  /**
+   * @brief Get the decompression throughput in uncompressed bytes per second.
+   */
+  double throughput() const noexcept {
+    return decompress_nanos != 0 ? 1e9 * static_cast<double>(raw_bytes) / decompress_nanos : 0.0;
+  }
+}; // struct CompressionStats
+
+/**
+ * @class CompressedWriter
+ * @brief Writes a file as independently compressed blocks, readable at random by
+ * `CompressedFile`.
+ *
+ * Each block is compressed with every enabled codec and stored with the one that pays off: Zstd
+ * only if it beats LZ4 by `zstd_gain`, since LZ4 decompresses several times faster, and neither
+ * unless the block shrinks by `min_ratio`. Incompressible blocks are stored as they are, so reads
+ * of them cost nothing extra.
+ */
+class CompressedWriter {
+public:
+  struct Options {
+    uint32_t block_size = 64 * 1024; // Uncompressed bytes per block
+    bool lz4            = true;      // Try LZ4 when available
+    bool zstd           = true;      // Try Zstd when available
+    int zstd_level      = 3;         // Zstd compression level
+    std::string dictionary;          // Zstd dictionary, e.g. from `train_dictionary()`
+    double min_ratio = 1.1;          // Store blocks that shrink less than this uncompressed
+    double zstd_gain = 1.1;          // Prefer Zstd when it is this much smaller than LZ4
+  }; // struct Options
+
+  CompressedWriter() noexcept;
+
+  explicit CompressedWriter(Options options) noexcept;
+
+  CompressedWriter(const CompressedWriter&)            = delete;
+  CompressedWriter& operator=(const CompressedWriter&) = delete;
+
+  /**
+   * @brief Destructor. Closes the file.
+   */
+  ~CompressedWriter();
+
+  /**
+   * @brief Create or truncate a file.
+   */
+  StatusCode open(std::string_view path, int flags = 0, mode_t mode = File::default_mode);
+
+  /**
+   * @brief Append uncompressed bytes.
+   */
+  StatusCode append(const void* buf, size_t count);
+
+  /**
+   * @brief Write the last block, the dictionary and the block index, then close the file.
+   */
+  StatusCode close();
+
+  /**
+   * @brief Get the counters of the blocks written so far.
+   */
+  const CompressionStats& stats() const noexcept { return counters; }
+
+private:
+  struct Codecs;
+
+  StatusCode write_block(const char* data, size_t size);
+  StatusCode write(const void* data, size_t size);
+
+  File file;
+  Options options;
+  std::string pending;
+  std::string scratch[codec_count];
+  std::string index; // Serialized `CompressedFile::IndexEntry`s
+  uint64_t end{0};
+  std::unique_ptr<Codecs> codecs;
+  CompressionStats counters;
+}; // class CompressedWriter
+
+/**
+ * @class CompressedFile
+ * @brief Random access reads of a file written by `CompressedWriter`.
+ *
+ * Reads decompress the blocks they touch into a small LRU cache shared by all threads, so nearby
+ * reads decompress each block once. The stored bytes come from `File::pread()` or, with
+ * `use_mmap`, straight from an `MmapFile` without a copy. Uncompressed blocks bypass the cache.
+ *
+ * The file is the stored blocks, then the dictionary, then a 16-byte index entry per block
+ * (offset, stored size and codec), then a 48-byte footer: magic `PRCF`, version, block size,
+ * dictionary size, block count, uncompressed size and the index and dictionary offsets.
+ */
+class CompressedFile {
+public:
+  struct Options {
+    size_t cache_blocks = 64;    // Decompressed blocks kept in memory
+    bool use_mmap       = false; // Read stored blocks from a mapping instead of `pread()`
+  }; // struct Options
+
+  struct Footer {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t block_size;
+    uint32_t dictionary_size;
+    uint64_t block_count;
+    uint64_t raw_size;
+    uint64_t index_offset;
+    uint64_t dictionary_offset;
+  }; // struct Footer
+
+  struct IndexEntry {
+    uint64_t offset;
+    uint32_t size;
+    uint8_t codec;
+    uint8_t reserved[3];
+  }; // struct IndexEntry
+
+  static constexpr uint32_t magic   = 0x46435250; // "PRCF"
+  static constexpr uint16_t version = 1;
+
+  CompressedFile() noexcept;
+
+  explicit CompressedFile(Options options) noexcept;
+
+  CompressedFile(const CompressedFile&)            = delete;
+  CompressedFile& operator=(const CompressedFile&) = delete;
+
+  ~CompressedFile();
+
+  /**
+   * @brief Open a compressed file and read its index.
+   *
+   * @return `StatusCode::invalid_argument` if the file is not a compressed file, or
+   * `StatusCode::enotsup` if it uses a codec that was not compiled in.
+   */
+  StatusCode open(std::string_view path);
+
+  /**
+   * @brief Read uncompressed bytes. Safe to call from several threads.
+   *
+   * @return The number of bytes read, which is short only at the end of the file, or
+   * `StatusCode::ebadmsg` if a block does not decompress.
+   */
+  Result<size_t> pread(void* buf, size_t count, uint64_t offset) const;
+
+  /**
+   * @brief Get the uncompressed size.
+   */
+  uint64_t size() const noexcept { return footer.raw_size; }
+
+  /**
+   * @brief Get the number of blocks.
+   */
+  size_t block_count() const noexcept { return index.size(); }
+
+  /**
+   * @brief Get the codec of block `i`.
+   */
+  Codec block_codec(size_t i) const noexcept { return static_cast<Codec>(index[i].codec); }
+
+  /**
+   * @brief Get a snapshot of the read counters.
+   */
+  CompressionStats stats() const noexcept;
+
+private:
+  struct Codecs;
+  using Block = std::shared_ptr<const std::string>;
+
+  Result<Block> load(uint64_t block) const;
+  Result<Block> decompress(uint64_t block) const;
+  StatusCode read_stored(uint64_t block, const char*& data, std::string& buffer) const;
+
+  File file;
+  MmapFile map;
+  Options options;
+  Footer footer{};
+  std::vector<IndexEntry> index;
+  std::unique_ptr<Codecs> codecs;
+
+  // LRU cache of decompressed blocks
+  mutable std::mutex mutex;
+  mutable std::list<uint64_t> lru;
+  mutable std::unordered_map<uint64_t, std::pair<Block, std::list<uint64_t>::iterator>> cache;
+
+  struct Counters {
+    std::atomic<uint64_t> blocks[codec_count]{};
+    std::atomic<uint64_t> raw_bytes{0};
+    std::atomic<uint64_t> stored_bytes{0};
+    std::atomic<uint64_t> cache_hits{0};
+    std::atomic<uint64_t> cache_misses{0};
+    std::atomic<uint64_t> decompress_nanos{0};
+  }; // struct Counters
+  mutable Counters counters;
+}; // class CompressedFile
+
+} // namespace internal
+} // namespace peregrine
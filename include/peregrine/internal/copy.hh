@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string_view>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief The ways data can be moved from one file to another, fastest first.
+ */
+enum class CopyMethod {
+  copy_file_range, // In-kernel copy; may share extents (reflink) or offload to the device
+  sendfile,        // In-kernel copy through the page cache
+  splice,          // Moves pages out of a pipe
+  buffered,        // pread() and pwrite() through a user space buffer
+}; // enum class CopyMethod
+
+/**
+ * @brief Get the name of a copy method.
+ */
+std::string_view copy_method_name(CopyMethod method) noexcept;
+
+/**
+ * @brief Counters of a copy or ingestion.
+ */
+struct CopyStats {
+  off_t bytes{0};                          // Bytes moved
+  CopyMethod method{CopyMethod::buffered}; // Method that moved the last byte
+}; // struct CopyStats
+
+/**
+ * @brief Copy a byte range from one file to another without passing it through user space.
+ *
+ * The copy starts with `method` and falls back to the next slower method whenever the kernel or
+ * file system cannot do it, e.g. `copy_file_range()` across file systems on older kernels. The
+ * buffered loop is the last resort and always works. File offsets are not used by
+ * `copy_file_range()` and the buffered loop; the `sendfile()` fallback moves the offset of `out`.
+ * `CopyMethod::splice` only applies to pipes and is treated like `CopyMethod::buffered` here.
+ *
+ * @param in The file to read from.
+ * @param in_offset The offset of the first byte to copy.
+ * @param out The file to write to. It must not be opened with `O_APPEND`.
+ * @param out_offset The offset the first byte is written to.
+ * @param length The number of bytes to copy. The copy stops early at the end of `in`.
+ * @param stats If not null, set to what was copied and how.
+ * @param method The first method to try.
+ * @return The number of bytes copied, or the error status.
+ */
+Result<off_t> copy_range(const File& in, off_t in_offset, const File& out, off_t out_offset,
+    off_t length, CopyStats* stats = nullptr,
+    CopyMethod method = CopyMethod::copy_file_range) noexcept;
+
+/**
+ * @brief Copy a whole file.
+ *
+ * @param in The file to read from.
+ * @param out The file to write to. It is truncated to the size of `in`.
+ * @param stats If not null, set to what was copied and how.
+ * @return The number of bytes copied, or the error status.
+ */
+Result<off_t> copy_file(const File& in, const File& out, CopyStats* stats = nullptr) noexcept;
+
+/**
+ * @brief Write everything read from a pipe, socket or terminal into a file.
+ *
+ * If `in` is a pipe, e.g. standard input of a process fed by a shell pipeline, the data is moved
+ * into the file with `splice()` and never copied into user space. Other inputs are read into a
+ * buffer. Reading continues until the end of the input or until `max_length` bytes were written.
+ *
+ * @param in The input. Its file offset, if any, is advanced.
+ * @param out The file to write to.
+ * @param out_offset The offset the first byte is written to.
+ * @param max_length The maximum number of bytes to ingest, or -1 for no limit.
+ * @param stats If not null, set to what was ingested and how.
+ * @return The number of bytes written, or the error status.
+ */
+Result<off_t> ingest(const File& in, const File& out, off_t out_offset, off_t max_length = -1,
+    CopyStats* stats = nullptr) noexcept;
+
+} // namespace internal
+} // namespace peregrine
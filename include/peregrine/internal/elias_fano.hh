@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "bitvector.hh"
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class EliasFano
+ * @brief A non-decreasing sequence of integers, e.g. an offsets array, read in place from
+ * serialized bytes such as an `MmapFile`.
+ *
+ * Each value is split into `low_bits` low bits, stored packed, and its high part, stored in unary
+ * as a `RankSelect` bitvector of `count + (universe >> low_bits) + 1` bits. With `low_bits` set to
+ * `floor(log2(universe / count))` this takes about `2 + log2(universe / count)` bits per value.
+ * `at()` is one `select1()`; `lower_bound()` is one `select0()` and a short scan of one bucket.
+ *
+ * The format is, in native (little-endian) byte order and 8-byte aligned:
+ *
+ * - A 32-byte header: magic `PREF`, version, low bit count, value count, largest value and the
+ *   number of low words.
+ * - The low bits packed into 64-bit words, plus one zero word.
+ * - The high bits as a serialized `RankSelect`.
+ */
+class EliasFano {
+public:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t low_bits;
+    uint64_t count;
+    uint64_t universe; // The largest value
+    uint64_t low_words;
+  }; // struct Header
+
+  static constexpr uint32_t magic   = 0x46455250; // "PREF"
+  static constexpr uint16_t version = 1;
+
+  EliasFano() noexcept = default;
+
+  /**
+   * @brief Serialize a sequence.
+   *
+   * @param values The values, in non-decreasing order.
+   * @return The serialized sequence, or `StatusCode::invalid_argument` if the values decrease.
+   */
+  static Result<std::string> serialize(const std::vector<uint64_t>& values);
+
+  /**
+   * @brief Validate serialized bytes and view them.
+   *
+   * @param data The start of the serialized sequence. Must be 8-byte aligned.
+   * @param size The number of bytes available.
+   * @return The view, or `StatusCode::invalid_argument` if the bytes are not a valid sequence.
+   */
+  static Result<EliasFano> open(const void* data, size_t size) noexcept;
+
+  /**
+   * @brief Get value `i`. `i` must be less than `size()`.
+   */
+  uint64_t at(uint64_t i) const noexcept { return ((high.select1(i) - i) << low_bits()) | low(i); }
+
+  /**
+   * @brief Get the index of the first value that is at least `value`, or `size()` if there is
+   * none.
+   */
+  uint64_t lower_bound(uint64_t value) const noexcept;
+
+  /**
+   * @brief Get the number of values.
+   */
+  uint64_t size() const noexcept { return header != nullptr ? header->count : 0; }
+
+  /**
+   * @brief Get the largest value.
+   */
+  uint64_t universe() const noexcept { return header != nullptr ? header->universe : 0; }
+
+  /**
+   * @brief Get the size of the serialized sequence in bytes.
+   */
+  size_t bytes() const noexcept;
+
+private:
+  uint32_t low_bits() const noexcept { return header->low_bits; }
+
+  uint64_t low(uint64_t i) const noexcept {
+    const uint32_t width = low_bits();
+    if(width == 0) return 0;
+    const uint64_t bit   = i * width;
+    const uint64_t shift = bit % 64;
+    uint64_t word        = lows[bit / 64] >> shift;
+    if(shift + width > 64) word |= lows[bit / 64 + 1] << (64 - shift);
+    return word & ((uint64_t{1} << width) - 1);
+  }
+
+  const Header* header{nullptr};
+  const uint64_t* lows{nullptr};
+  RankSelect high;
+}; // class EliasFano
+
+} // namespace internal
+} // namespace peregrine
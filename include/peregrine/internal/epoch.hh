@@ -0,0 +1,310 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+class EpochDomain;
+
+namespace detail {
+
+// Cache line size used to keep reader slots from sharing lines.
+constexpr size_t epoch_cache_line = 64;
+
+/**
+ * @brief Per-reader epoch slot.
+ *
+ * Each slot lives on its own cache line and is written only by the reader that owns it. A value
+ * of zero means the reader is quiescent; any other value is the global epoch observed when the
+ * reader entered its critical section.
+ */
+struct alignas(epoch_cache_line) EpochSlot {
+  std::atomic<uint64_t> epoch{0};
+  std::atomic<bool> in_use{false};
+  uint32_t depth{0};
+  EpochSlot* next{nullptr};
+}; // struct EpochSlot
+
+// Base class for objects waiting to be reclaimed.
+struct Retired {
+  uint64_t epoch{0};
+  virtual ~Retired() = default;
+}; // struct Retired
+
+template <typename T>
+struct RetiredObject final : Retired {
+  T object;
+  explicit RetiredObject(T&& object) : object(std::move(object)) {}
+}; // struct RetiredObject
+
+// True when the writer side issues a process-wide barrier (membarrier), which lets readers get
+// away with a compiler-only fence.
+extern bool epoch_asymmetric_fence;
+
+PEREGRINE_FORCE_INLINE void epoch_reader_fence() noexcept {
+  if(PEREGRINE_LIKELY(epoch_asymmetric_fence)) {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+  } else {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+}
+
+} // namespace detail
+
+/**
+ * @class EpochReader
+ * @brief A reader registration with an `EpochDomain`.
+ *
+ * A reader is owned by a single thread. Entering and leaving a critical section only touches the
+ * reader's private slot, so readers never write to a cache line shared with other threads.
+ * Critical sections may be nested.
+ */
+class EpochReader {
+  EpochDomain* domain{nullptr};
+  detail::EpochSlot* slot{nullptr};
+
+  friend class EpochDomain;
+
+  EpochReader(EpochDomain* domain, detail::EpochSlot* slot) noexcept : domain(domain), slot(slot) {}
+
+public:
+  /**
+   * @brief Default constructor.
+   *
+   * Creates a reader that is not registered with any domain.
+   */
+  EpochReader() noexcept = default;
+
+  EpochReader(const EpochReader&) = delete;
+
+  /**
+   * @brief Move constructor.
+   *
+   * @param other The reader to move. `other` is left unregistered.
+   */
+  EpochReader(EpochReader&& other) noexcept : domain(other.domain), slot(other.slot) {
+    other.domain = nullptr;
+    other.slot   = nullptr;
+  }
+
+  /**
+   * @brief Destructor.
+   *
+   * Releases the reader slot back to the domain.
+   */
+  ~EpochReader() { release(); }
+
+  EpochReader& operator=(const EpochReader&) = delete;
+
+  EpochReader& operator=(EpochReader&& other) noexcept {
+    release();
+    domain       = other.domain;
+    slot         = other.slot;
+    other.domain = nullptr;
+    other.slot   = nullptr;
+    return *this;
+  }
+
+  /**
+   * @brief Check if the reader is registered with a domain.
+   */
+  bool is_registered() const noexcept { return slot != nullptr; }
+
+  /**
+   * @brief Enter a read-side critical section.
+   *
+   * Objects retired after this call are not reclaimed until the matching `leave()`.
+   */
+  PEREGRINE_FORCE_INLINE void enter() noexcept;
+
+  /**
+   * @brief Leave a read-side critical section.
+   */
+  PEREGRINE_FORCE_INLINE void leave() noexcept {
+    if(--slot->depth == 0) slot->epoch.store(0, std::memory_order_release);
+  }
+
+  /**
+   * @brief Check if the reader is inside a critical section.
+   */
+  bool is_active() const noexcept { return slot != nullptr && slot->depth != 0; }
+
+private:
+  void release() noexcept;
+}; // class EpochReader
+
+/**
+ * @class EpochGuard
+ * @brief RAII helper that holds a read-side critical section for its lifetime.
+ */
+class EpochGuard {
+  EpochReader& reader;
+
+public:
+  explicit EpochGuard(EpochReader& reader) noexcept : reader(reader) { reader.enter(); }
+  EpochGuard(const EpochGuard&)            = delete;
+  EpochGuard& operator=(const EpochGuard&) = delete;
+  ~EpochGuard() { reader.leave(); }
+}; // class EpochGuard
+
+/**
+ * @class EpochDomain
+ * @brief Epoch-based reclamation for objects shared with lock-free readers.
+ *
+ * Writers hand objects that readers may still be using (e.g. an `MmapFile` or `File` that was
+ * replaced) to `retire()`. A retired object is destroyed, which unmaps or closes it, only after
+ * every reader that could have observed it has left its critical section.
+ *
+ * Readers pay a load of the global epoch, a store to their private slot and a fence. On Linux
+ * the fence is made asymmetric with `membarrier()`, so readers only need a compiler barrier and
+ * writers pay for the full barrier when they reclaim.
+ */
+class EpochDomain {
+  alignas(detail::epoch_cache_line) std::atomic<uint64_t> global_epoch{1};
+
+  alignas(detail::epoch_cache_line) std::atomic<detail::EpochSlot*> slots{nullptr};
+
+  mutable std::mutex retired_mutex;
+  std::vector<std::unique_ptr<detail::Retired>> retired;
+
+  friend class EpochReader;
+
+  detail::EpochSlot* acquire_slot();
+  void retire_impl(std::unique_ptr<detail::Retired> object);
+  uint64_t min_active_epoch() const noexcept;
+
+public:
+  EpochDomain();
+
+  EpochDomain(const EpochDomain&)            = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  /**
+   * @brief Destructor.
+   *
+   * Destroys all retired objects. All readers must be released before the domain is destroyed.
+   */
+  ~EpochDomain();
+
+  /**
+   * @brief Register a new reader.
+   *
+   * Slots of released readers are reused, so registering is cheap once the domain has warmed up.
+   *
+   * @return The reader handle. It should be used only by the calling thread.
+   */
+  EpochReader register_reader() { return EpochReader{this, acquire_slot()}; }
+
+  /**
+   * @brief Retire an object.
+   *
+   * Ownership of `object` moves to the domain. It is destroyed by a later call to `reclaim()` once
+   * no reader can still reference it.
+   *
+   * @param object The object to retire.
+   */
+  template <typename T>
+  void retire(T&& object) {
+    retire_impl(std::make_unique<detail::RetiredObject<std::decay_t<T>>>(std::forward<T>(object)));
+  }
+
+  /**
+   * @brief Destroy retired objects that are no longer reachable by readers.
+   *
+   * This never blocks on readers.
+   *
+   * @return The number of objects destroyed.
+   */
+  size_t reclaim();
+
+  /**
+   * @brief Wait until every object retired so far has been destroyed.
+   *
+   * Must not be called from inside a read-side critical section.
+   */
+  void synchronize();
+
+  /**
+   * @brief Get the number of objects waiting to be reclaimed.
+   */
+  size_t pending() const;
+
+  /**
+   * @brief Get the current global epoch.
+   */
+  uint64_t epoch() const noexcept { return global_epoch.load(std::memory_order_relaxed); }
+
+}; // class EpochDomain
+
+PEREGRINE_FORCE_INLINE void EpochReader::enter() noexcept {
+  if(slot->depth++ != 0) return;
+  // Acquire pairs with the fetch_add in `retire()`: a reader that sees the epoch after a retire
+  // also sees the pointer swap before it. A relaxed load lets weakly ordered CPUs satisfy the
+  // reader's `EpochPointer::load()` first, and the asymmetric fence is only a compiler barrier, so
+  // the reader could hold the retired object while recording an epoch that lets it be reclaimed.
+  const uint64_t epoch = domain->global_epoch.load(std::memory_order_acquire);
+  slot->epoch.store(epoch, std::memory_order_relaxed);
+  detail::epoch_reader_fence();
+}
+
+/**
+ * @class EpochPointer
+ * @brief An atomically swappable owning pointer whose old values are reclaimed by an epoch domain.
+ *
+ * Readers call `load()` inside a critical section of the same domain; the returned pointer stays
+ * valid until they leave it. Writers call `publish()` to install a new object, which retires the
+ * previous one.
+ */
+template <typename T>
+class EpochPointer {
+  EpochDomain& domain;
+  std::atomic<T*> ptr{nullptr};
+
+public:
+  explicit EpochPointer(EpochDomain& domain) noexcept : domain(domain) {}
+
+  EpochPointer(EpochDomain& domain, std::unique_ptr<T> value) noexcept :
+      domain(domain), ptr(value.release()) {}
+
+  EpochPointer(const EpochPointer&)            = delete;
+  EpochPointer& operator=(const EpochPointer&) = delete;
+
+  /**
+   * @brief Destructor.
+   *
+   * Retires the current object; the caller must ensure no reader is still using it when the
+   * domain is destroyed.
+   */
+  ~EpochPointer() {
+    if(T* old = ptr.exchange(nullptr, std::memory_order_acq_rel); old != nullptr)
+      domain.retire(std::unique_ptr<T>(old));
+  }
+
+  /**
+   * @brief Load the current object.
+   *
+   * The caller must be inside a read-side critical section of the owning domain.
+   */
+  T* load() const noexcept { return ptr.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Publish a new object and retire the previous one.
+   *
+   * @param value The new object. May be null.
+   */
+  void publish(std::unique_ptr<T> value) {
+    T* old = ptr.exchange(value.release(), std::memory_order_acq_rel);
+    if(old != nullptr) domain.retire(std::unique_ptr<T>(old));
+  }
+
+}; // class EpochPointer
+
+} // namespace internal
+} // namespace peregrine
@@ -2,14 +2,62 @@
 
 #include <sys/param.h>
 
+#include <memory>
+
+#include "../result.hh"
 #include "../status_code.hh"
 #include "common.hh"
+#include "io_stats.hh"
 #include "log.hh"
 #include "system.hh"
 
 namespace peregrine {
 namespace internal {
 
+/**
+ * @brief Resolve the path of an open file descriptor for diagnostics.
+ *
+ * @param fd The file descriptor.
+ * @return The path, or `fd=<n>` if it cannot be determined.
+ */
+inline std::string path_from_fd(int fd) {
+  char buf[MAXPATHLEN];
+#if defined(F_GETPATH)
+  buf[0]  = '\0';
+  auto rc = ::peregrine::internal::fcntl(fd, F_GETPATH, buf);
+  if(rc != -1) return {buf};
+#elif defined(__linux__)
+  auto link = fmt::format("/proc/self/fd/{}"sv, fd);
+  auto rc   = ::peregrine::internal::readlink(link.c_str(), buf, sizeof(buf) - 1);
+  if(rc != -1) return {buf, static_cast<size_t>(rc)};
+#endif // defined(F_GETPATH)
+  return fmt::format("fd={}"sv, fd);
+}
+
+/**
+ * @brief Formats as the path of a file descriptor.
+ *
+ * The path is only resolved if the message it is part of is actually formatted, so passing it to
+ * a disabled log level costs nothing.
+ */
+struct FdPath {
+  int fd;
+}; // struct FdPath
+
+} // namespace internal
+} // namespace peregrine
+
+template <>
+struct fmt::formatter<::peregrine::internal::FdPath> : fmt::formatter<std::string> {
+  auto format(::peregrine::internal::FdPath path, format_context& ctx) const
+      -> decltype(ctx.out()) {
+    return format_to(ctx.out(), "{}", ::peregrine::internal::path_from_fd(path.fd));
+  }
+}; // struct fmt::formatter<FdPath>
+
+namespace peregrine {
+namespace internal {
+
 class MmapFile;
 
 /**
@@ -22,35 +70,55 @@ class MmapFile;
  */
 class File {
   int fd{-1};
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+  std::unique_ptr<IoStats> stats;
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
 
   friend class MmapFile;
 
-  std::string path_from_fd() const {
-    char buf[MAXPATHLEN];
-    buf[0]  = '\0';
-    auto rc = ::peregrine::internal::fcntl(fd, F_GETPATH, buf);
-    if(rc == -1) { return fmt::format("fd={}"sv, fd); }
-    return {buf};
+  // Run a system call, recording its latency and result when I/O statistics are enabled.
+  template <typename Call>
+  PEREGRINE_FORCE_INLINE auto instrument(IoOp op, Call&& call) const noexcept {
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+    const auto start = IoStats::clock::now();
+    const auto rc    = call();
+    if(PEREGRINE_LIKELY(stats != nullptr)) {
+      // Keep errno intact for the error handler
+      const int saved_errno = errno;
+      stats->record(op, static_cast<int64_t>(rc), start);
+      errno = saved_errno;
+    }
+    return rc;
+#else
+    static_cast<void>(op);
+    return call();
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
+  }
+
+  // Report a failed call. Kept out of line so the success path stays small. Retryable errors are
+  // only traced, so EAGAIN/EINTR loops do not pay for logging.
+  [[gnu::cold, gnu::noinline]] void log_failure(std::string_view fn, StatusCode status) const {
+    if(status == StatusCode::eagain || status == StatusCode::eintr) {
+      PEREGRINE_LOG_TRACE("{} failed for \"{}\" : {}"sv, fn, FdPath{fd}, status);
+    } else {
+      PEREGRINE_LOG_ERROR("{} failed for \"{}\" : {}"sv, fn, FdPath{fd}, status);
+    }
   }
 
   template <typename T>
   StatusCode handler(T rc, std::string_view fn) const noexcept {
-    StatusCode status = StatusCode::ok;
-    if(PEREGRINE_UNLIKELY(rc == T(-1))) {
-      status = errno_to_status();
-      PEREGRINE_LOG_ERROR("{} failed for \"{}\" : {}"sv, fn, path_from_fd(), status);
-    }
+    if(PEREGRINE_LIKELY(rc != T(-1))) return StatusCode::ok;
+    const StatusCode status = errno_to_status();
+    log_failure(fn, status);
     return status;
   }
 
   template <typename T>
-  std::tuple<T, StatusCode> handler2(T rc, std::string_view fn) const noexcept {
-    StatusCode status = StatusCode::ok;
-    if(PEREGRINE_UNLIKELY(rc == T(-1))) {
-      status = errno_to_status();
-      PEREGRINE_LOG_ERROR("{} failed for \"{}\" : {}"sv, fn, path_from_fd(), status);
-    }
-    return {rc, status};
+  Result<T> handler2(T rc, std::string_view fn) const noexcept {
+    if(PEREGRINE_LIKELY(rc != T(-1))) return Result<T>{rc};
+    const StatusCode status = errno_to_status();
+    log_failure(fn, status);
+    return Result<T>{rc, status};
   }
 
 public:
@@ -77,6 +145,15 @@ public:
    */
   static constexpr mode_t default_mode = S_IRWXU | S_IRGRP | S_IROTH;
 
+  /**
+   * @brief True when the library is built with `PEREGRINE_ENABLE_IO_STATS`.
+   */
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+  static constexpr bool io_stats_enabled = true;
+#else
+  static constexpr bool io_stats_enabled = false;
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
+
   /**
    * @brief Default constructor.
    *
@@ -84,6 +161,20 @@ public:
    */
   File() noexcept = default;
 
+  /**
+   * @brief Take ownership of an open file descriptor.
+   *
+   * Used for descriptors that are not created by `open()`, e.g. ones received from another
+   * process. The descriptor is closed by the destructor.
+   *
+   * @param fd The file descriptor to adopt.
+   */
+  explicit File(int fd) noexcept : fd(fd) {
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+    if(fd != -1) stats.reset(new(std::nothrow) IoStats);
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
+  }
+
   // Copy constructor (deleted)
   File(const File&) = delete;
 
@@ -95,7 +186,12 @@ public:
    *
    * @param other The File to move.
    */
-  File(File&& other) noexcept : fd(other.fd) { other.fd = -1; }
+  File(File&& other) noexcept : fd(other.fd) {
+    other.fd = -1;
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+    stats = std::move(other.stats);
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
+  }
 
   /**
    * @brief Destructor.
@@ -120,6 +216,9 @@ public:
     close();
     fd       = other.fd;
     other.fd = -1;
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+    stats = std::move(other.stats);
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
     return *this;
   }
 
@@ -139,7 +238,7 @@ public:
       close();
     } else if(PEREGRINE_UNLIKELY(is_open())) {
       status = StatusCode::already_open;
-      PEREGRINE_LOG_ERROR("File is already open to {} while opening {}"sv, path_from_fd(), path);
+      PEREGRINE_LOG_ERROR("File is already open to {} while opening {}"sv, FdPath{fd}, path);
       return status;
     }
 
@@ -153,6 +252,9 @@ public:
     int new_fd = ::peregrine::internal::open(path_cstr, flags, mode);
     if(PEREGRINE_LIKELY(new_fd != -1)) {
       fd = new_fd;
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+      stats.reset(new(std::nothrow) IoStats);
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
     } else {
       status = errno_to_status();
       PEREGRINE_LOG_ERROR(
@@ -172,7 +274,7 @@ public:
     // Only close the file if it is open
     if(!is_open()) return status;
 
-    PEREGRINE_LOG_TRACE("Closing file : {}"sv, path_from_fd());
+    PEREGRINE_LOG_TRACE("Closing file : {}"sv, FdPath{fd});
 
     // Close the file
     auto rc = ::peregrine::internal::close(fd);
@@ -191,6 +293,13 @@ public:
    */
   bool is_open() const noexcept { return fd != -1; }
 
+  /**
+   * @brief Get the underlying file descriptor, or -1 if the file is not open.
+   *
+   * The descriptor remains owned by this object.
+   */
+  int native_handle() const noexcept { return fd; }
+
   /**
    * @brief Get the status of the file.
    *
@@ -209,10 +318,11 @@ public:
    *
    * @param buf Pointer to the buffer where the data will be stored.
    * @param count Number of bytes to read.
-   * @return A tuple containing the number of bytes read and the status code.
+   * @return The number of bytes read, or the error status.
    */
-  std::tuple<ssize_t, StatusCode> read(void* buf, size_t count) const noexcept {
-    return handler2(::peregrine::internal::read(fd, buf, count), "read"sv);
+  Result<ssize_t> read(void* buf, size_t count) const noexcept {
+    auto call = [&] { return ::peregrine::internal::read(fd, buf, count); };
+    return handler2(instrument(IoOp::read, call), "read"sv);
   }
 
   /**
@@ -224,10 +334,38 @@ public:
    * @param buf Pointer to the buffer where the data will be stored.
    * @param count Number of bytes to read.
    * @param offset The offset in the file to start reading from.
-   * @return A tuple containing the number of bytes read and the status code.
+   * @return The number of bytes read, or the error status.
+   */
+  Result<ssize_t> pread(void* buf, size_t count, off_t offset) const noexcept {
+    auto call = [&] { return ::peregrine::internal::pread(fd, buf, count, offset); };
+    return handler2(instrument(IoOp::pread, call), "pread"sv);
+  }
+
+  /**
+   * @brief Reads exactly `count` bytes from a specific position in the file.
+   *
+   * Repeats `pread()` after short reads and interrupted calls until the whole range is read.
+   *
+   * @param buf Pointer to the buffer where the data will be stored.
+   * @param count Number of bytes to read.
+   * @param offset The offset in the file to start reading from.
+   * @return `StatusCode::ok`, `StatusCode::invalid_argument` if the file ends before the range
+   * does, or the error status.
    */
-  std::tuple<ssize_t, StatusCode> pread(void* buf, size_t count, off_t offset) const noexcept {
-    return handler2(::peregrine::internal::pread(fd, buf, count, offset), "pread"sv);
+  StatusCode pread_exact(void* buf, size_t count, off_t offset) const noexcept {
+    auto* p = static_cast<char*>(buf);
+    while(count != 0) {
+      auto [n, status] = pread(p, count, offset);
+      if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+        if(status == StatusCode::eintr) continue;
+        return status;
+      }
+      if(PEREGRINE_UNLIKELY(n == 0)) return StatusCode::invalid_argument;
+      p += n;
+      count -= static_cast<size_t>(n);
+      offset += static_cast<off_t>(n);
+    }
+    return StatusCode::ok;
   }
 
   /**
@@ -239,10 +377,11 @@ public:
    *
    * @param iov An array of iovec structures specifying the buffers and their sizes.
    * @param iovcnt The number of iovec structures in the array.
-   * @return A tuple containing the number of bytes read and the status code.
+   * @return The number of bytes read, or the error status.
    */
-  std::tuple<ssize_t, StatusCode> readv(const struct iovec* iov, int iovcnt) const noexcept {
-    return handler2(::peregrine::internal::readv(fd, iov, iovcnt), "readv"sv);
+  Result<ssize_t> readv(const struct iovec* iov, int iovcnt) const noexcept {
+    auto call = [&] { return ::peregrine::internal::readv(fd, iov, iovcnt); };
+    return handler2(instrument(IoOp::readv, call), "readv"sv);
   }
 
   /**
@@ -255,11 +394,49 @@ public:
    * @param iov An array of iovec structures specifying the buffers and their sizes.
    * @param iovcnt The number of iovec structures in the array.
    * @param offset The offset in the file to start reading from.
-   * @return A tuple containing the number of bytes read and the status code.
+   * @return The number of bytes read, or the error status.
    */
-  std::tuple<ssize_t, StatusCode> preadv(
+  Result<ssize_t> preadv(
       const struct iovec* iov, int iovcnt, off_t offset) const noexcept {
-    return handler2(::peregrine::internal::preadv(fd, iov, iovcnt, offset), "preadv"sv);
+    auto call = [&] { return ::peregrine::internal::preadv(fd, iov, iovcnt, offset); };
+    return handler2(instrument(IoOp::preadv, call), "preadv"sv);
+  }
+
+  /**
+   * @brief Reads data from a specific position only if it can be served without blocking.
+   *
+   * Uses `preadv2()` with `RWF_NOWAIT`, so the read completes only from the page cache. If the data
+   * is not cached the call fails with `StatusCode::eagain` instead of waiting for the device; the
+   * caller is expected to retry with a blocking read off the latency-critical thread. A short read
+   * may mean either end of file or that only part of the range was cached.
+   *
+   * `StatusCode::eagain` is expected and is not logged. On platforms without `preadv2()`, or when
+   * the file system does not support `RWF_NOWAIT`, the call always fails with
+   * `StatusCode::eagain`.
+   *
+   * @param buf Pointer to the buffer where the data will be stored.
+   * @param count Number of bytes to read.
+   * @param offset The offset in the file to start reading from.
+   * @return The number of bytes read, or the error status.
+   */
+  Result<ssize_t> pread_nowait(
+      void* buf, size_t count, off_t offset) const noexcept {
+#if defined(PEREGRINE_HAVE_PREADV2)
+    struct iovec iov {
+      buf, count
+    };
+    const ssize_t rc = instrument(IoOp::pread_nowait,
+        [&] { return ::peregrine::internal::preadv2(fd, &iov, 1, offset, RWF_NOWAIT); });
+    if(PEREGRINE_LIKELY(rc != -1)) return rc;
+
+    const StatusCode status = errno_to_status();
+    if(status == StatusCode::eagain) return Result<ssize_t>::error(status);
+    if(status == StatusCode::eopnotsupp) return Result<ssize_t>::error(StatusCode::eagain);
+    log_failure("preadv2"sv, status);
+    return Result<ssize_t>::error(status);
+#else
+    return Result<ssize_t>::error(StatusCode::eagain);
+#endif // defined(PEREGRINE_HAVE_PREADV2)
   }
 
   /**
@@ -269,10 +446,11 @@ public:
    *
    * @param buf Pointer to the buffer containing the data to write.
    * @param count Number of bytes to write.
-   * @return A tuple containing the number of bytes written and the status code.
+   * @return The number of bytes written, or the error status.
    */
-  std::tuple<ssize_t, StatusCode> write(const void* buf, size_t count) const noexcept {
-    return handler2(::peregrine::internal::write(fd, buf, count), "write"sv);
+  Result<ssize_t> write(const void* buf, size_t count) const noexcept {
+    auto call = [&] { return ::peregrine::internal::write(fd, buf, count); };
+    return handler2(instrument(IoOp::write, call), "write"sv);
   }
 
   /**
@@ -283,11 +461,39 @@ public:
    * @param buf Pointer to the buffer containing the data to write.
    * @param count Number of bytes to write.
    * @param offset The offset in the file to start writing from.
-   * @return A tuple containing the number of bytes written and the status code.
+   * @return The number of bytes written, or the error status.
    */
-  std::tuple<ssize_t, StatusCode> pwrite(
+  Result<ssize_t> pwrite(
       const void* buf, size_t count, off_t offset) const noexcept {
-    return handler2(::peregrine::internal::pwrite(fd, buf, count, offset), "pwrite"sv);
+    auto call = [&] { return ::peregrine::internal::pwrite(fd, buf, count, offset); };
+    return handler2(instrument(IoOp::pwrite, call), "pwrite"sv);
+  }
+
+  /**
+   * @brief Writes all of the provided buffer to a specific position in the file.
+   *
+   * Repeats `pwrite()` after short writes and interrupted calls until the whole buffer is written.
+   * A write that makes no progress fails with `StatusCode::eio` rather than being retried forever.
+   *
+   * @param buf Pointer to the buffer containing the data to write.
+   * @param count Number of bytes to write.
+   * @param offset The offset in the file to start writing from.
+   * @return `StatusCode::ok`, or the error status.
+   */
+  StatusCode pwrite_all(const void* buf, size_t count, off_t offset) const noexcept {
+    const auto* p = static_cast<const char*>(buf);
+    while(count != 0) {
+      auto [n, status] = pwrite(p, count, offset);
+      if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+        if(status == StatusCode::eintr) continue;
+        return status;
+      }
+      if(PEREGRINE_UNLIKELY(n == 0)) return StatusCode::eio;
+      p += n;
+      count -= static_cast<size_t>(n);
+      offset += static_cast<off_t>(n);
+    }
+    return StatusCode::ok;
   }
 
   /**
@@ -298,10 +504,11 @@ public:
    *
    * @param iov An array of iovec structures specifying the buffers and their sizes.
    * @param iovcnt The number of iovec structures in the array.
-   * @return A tuple containing the number of bytes written and the status code.
+   * @return The number of bytes written, or the error status.
    */
-  std::tuple<ssize_t, StatusCode> writev(const struct iovec* iov, int iovcnt) const noexcept {
-    return handler2(::peregrine::internal::writev(fd, iov, iovcnt), "writev"sv);
+  Result<ssize_t> writev(const struct iovec* iov, int iovcnt) const noexcept {
+    auto call = [&] { return ::peregrine::internal::writev(fd, iov, iovcnt); };
+    return handler2(instrument(IoOp::writev, call), "writev"sv);
   }
 
   /**
@@ -313,11 +520,12 @@ public:
    * @param iov An array of iovec structures specifying the buffers and their sizes.
    * @param iovcnt The number of iovec structures in the array.
    * @param offset The offset in the file to start writing from.
-   * @return A tuple containing the number of bytes written and the status code.
+   * @return The number of bytes written, or the error status.
    */
-  std::tuple<ssize_t, StatusCode> pwritev(
+  Result<ssize_t> pwritev(
       const struct iovec* iov, int iovcnt, off_t offset) const noexcept {
-    return handler2(::peregrine::internal::pwritev(fd, iov, iovcnt, offset), "pwritev"sv);
+    auto call = [&] { return ::peregrine::internal::pwritev(fd, iov, iovcnt, offset); };
+    return handler2(instrument(IoOp::pwritev, call), "pwritev"sv);
   }
 
   /**
@@ -327,9 +535,9 @@ public:
    *
    * @param offset The new file offset.
    * @param whence The starting position for the offset calculation.
-   * @return The new file offset on success, otherwise -1.
+   * @return The new file offset, or the error status.
    */
-  std::tuple<off_t, StatusCode> seek(off_t offset, int whence) noexcept {
+  Result<off_t> seek(off_t offset, int whence) noexcept {
     return handler2(::peregrine::internal::lseek(fd, offset, whence), "lseek"sv);
   }
 
@@ -338,19 +546,21 @@ public:
    * Duplicates the file descriptor. The new file descriptor will refer to the same file as the
    * this file.
    *
-   * @return A tuple containing the new file and a status code. The status code is `StatusCode::ok`
-   * on success, otherwise an error code.
+   * @return The new file, or the error status.
    */
-  std::tuple<File, StatusCode> dup() const noexcept {
+  Result<File> dup() const noexcept {
     File file;
     StatusCode status = StatusCode::ok;
 
-    PEREGRINE_LOG_TRACE("Duplicating file : {}"sv, path_from_fd());
+    PEREGRINE_LOG_TRACE("Duplicating file : {}"sv, FdPath{fd});
     file.fd = ::peregrine::internal::dup(fd);
     if(PEREGRINE_UNLIKELY(file.fd == -1)) {
       status = errno_to_status();
-      PEREGRINE_LOG_ERROR("dup failed for \"{}\" : {}"sv, path_from_fd(), status);
+      log_failure("dup"sv, status);
     }
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+    if(file.fd != -1) file.stats.reset(new(std::nothrow) IoStats);
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
 
     return {std::move(file), status};
   }
@@ -360,7 +570,133 @@ public:
    *
    * @return `StatusCode::ok` on success, otherwise an error code.
    */
-  StatusCode flush() const noexcept { return handler(::peregrine::internal::fsync(fd), "fsync"sv); }
+  StatusCode flush() const noexcept {
+    auto call = [&] { return ::peregrine::internal::fsync(fd); };
+    return handler(instrument(IoOp::fsync, call), "fsync"sv);
+  }
+
+  /**
+   * @brief Start or wait for write-back of a byte range.
+   *
+   * Wraps `sync_file_range()`. It is typically called with `SYNC_FILE_RANGE_WRITE` on many files
+   * before `flush()`, so their write-back overlaps instead of being serialized by each `fsync()`.
+   * It does not flush metadata and gives no durability guarantee on its own. On platforms without
+   * `sync_file_range()` this is a no-op.
+   *
+   * @param offset The start of the range.
+   * @param nbytes The length of the range, or zero for everything up to the end of the file.
+   * @param flags A combination of the `SYNC_FILE_RANGE_*` flags.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode sync_range(off_t offset, off_t nbytes, unsigned int flags) const noexcept {
+#if defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+    auto call = [&] { return ::peregrine::internal::sync_file_range(fd, offset, nbytes, flags); };
+    return handler(instrument(IoOp::sync_file_range, call), "sync_file_range"sv);
+#else
+    return is_open() ? StatusCode::ok : StatusCode::ebadf;
+#endif // defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+  }
+
+  /**
+   * @brief Set the size of the file.
+   *
+   * @param length The new size. The file is extended with zeros or truncated.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode truncate(off_t length) const noexcept {
+    return handler(::peregrine::internal::ftruncate(fd, length), "ftruncate"sv);
+  }
+
+  /**
+   * @brief Allocate disk space for a byte range.
+   *
+   * Wraps `fallocate()`. With `FALLOC_FL_KEEP_SIZE` in `mode` the blocks are reserved past the end
+   * of the file without changing its size, so later appends land in one contiguous extent and do
+   * not update the block map on every write. On platforms without `fallocate()` this returns
+   * `StatusCode::enotsup`.
+   *
+   * @param offset The start of the range.
+   * @param length The length of the range.
+   * @param mode Zero, or a combination of the `FALLOC_FL_*` flags.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode allocate(off_t offset, off_t length, int mode = 0) const noexcept {
+#if defined(PEREGRINE_HAVE_FALLOCATE)
+    return handler(::peregrine::internal::fallocate(fd, mode, offset, length), "fallocate"sv);
+#else
+    static_cast<void>(offset);
+    static_cast<void>(length);
+    static_cast<void>(mode);
+    return is_open() ? StatusCode::enotsup : StatusCode::ebadf;
+#endif // defined(PEREGRINE_HAVE_FALLOCATE)
+  }
+
+  /**
+   * @brief Release the disk space of a byte range, leaving a hole that reads as zeros.
+   *
+   * The size of the file is unchanged. On platforms without `fallocate()` this returns
+   * `StatusCode::enotsup`.
+   *
+   * @param offset The start of the range.
+   * @param length The length of the range.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode punch_hole(off_t offset, off_t length) const noexcept {
+#if defined(PEREGRINE_HAVE_FALLOCATE)
+    return allocate(offset, length, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE);
+#else
+    return allocate(offset, length, 0);
+#endif // defined(PEREGRINE_HAVE_FALLOCATE)
+  }
+
+  /**
+   * @brief Advise the kernel how a byte range will be accessed.
+   *
+   * Wraps `posix_fadvise()`. For example, `POSIX_FADV_DONTNEED` drops the clean cached pages of
+   * the range and `POSIX_FADV_WILLNEED` starts reading it in. On platforms without
+   * `posix_fadvise()` this is a no-op.
+   *
+   * @param offset The start of the range.
+   * @param length The length of the range, or zero for everything up to the end of the file.
+   * @param advice One of the `POSIX_FADV_*` values.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode advise(off_t offset, off_t length, int advice) const noexcept {
+#if defined(PEREGRINE_HAVE_POSIX_FADVISE)
+    const int rc = ::peregrine::internal::posix_fadvise(fd, offset, length, advice);
+    if(PEREGRINE_LIKELY(rc == 0)) return StatusCode::ok;
+    const auto status = static_cast<StatusCode>(rc);
+    log_failure("posix_fadvise"sv, status);
+    return status;
+#else
+    return is_open() ? StatusCode::ok : StatusCode::ebadf;
+#endif // defined(PEREGRINE_HAVE_POSIX_FADVISE)
+  }
+
+  /**
+   * @brief Get the I/O statistics recorded since the file was opened.
+   *
+   * Every read, write and flush is counted per operation with its byte count and latency. A
+   * duplicated file has its own statistics. Statistics are only collected when the library is
+   * built with `PEREGRINE_ENABLE_IO_STATS`; otherwise the snapshot is empty.
+   *
+   * @return A snapshot of the counters.
+   */
+  IoStatsSnapshot io_stats() const noexcept {
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+    if(stats != nullptr) return stats->snapshot();
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
+    return {};
+  }
+
+  /**
+   * @brief Reset the I/O statistics of the file to zero.
+   */
+  void reset_io_stats() noexcept {
+#if defined(PEREGRINE_ENABLE_IO_STATS)
+    if(stats != nullptr) stats->reset();
+#endif // defined(PEREGRINE_ENABLE_IO_STATS)
+  }
 
 }; // class File
 
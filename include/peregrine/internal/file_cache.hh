@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief Counters describing the effectiveness of a `FileCache`.
+ */
+struct FileCacheStats {
+  uint64_t hits{0};          // Lookups served by an already open descriptor
+  uint64_t misses{0};        // Lookups that had to open the file
+  uint64_t evictions{0};     // Idle descriptors closed to stay under the capacity
+  uint64_t open_failures{0}; // Misses where opening the file failed
+  size_t open_files{0};      // Descriptors currently held by the cache
+
+  /**
+   * @brief Get the fraction of lookups served without opening the file.
+   */
+  double hit_rate() const noexcept {
+    const uint64_t lookups = hits + misses;
+    return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+  }
+}; // struct FileCacheStats
+
+/**
+ * @class FileCache
+ * @brief A bounded cache of open file descriptors keyed by path.
+ *
+ * The cache hands out shared, reference-counted `File` handles so many queries can read from the
+ * same descriptor with `pread`-style calls without paying for `open()`/`close()` each time. When
+ * more than `capacity` files are open, the least recently used idle descriptors are closed. A
+ * descriptor is idle when no handle to it is outstanding; files in use are never closed under a
+ * caller, so the cache may briefly exceed its capacity when every entry is busy. Looking up an
+ * evicted path simply reopens it.
+ *
+ * Callers that need an independent descriptor they own outright can use `dup()`.
+ */
+class FileCache {
+  struct Entry {
+    std::string path;
+    std::shared_ptr<File> file;
+  }; // struct Entry
+
+  using lru_list = std::list<Entry>;
+
+  const size_t capacity;
+  const int flags;
+
+  mutable std::mutex mutex;
+  lru_list lru; // Most recently used at the front
+  std::unordered_map<std::string_view, lru_list::iterator> index;
+  FileCacheStats counters;
+
+  void evict_idle();
+
+public:
+  /**
+   * @brief A shared handle to a cached file.
+   */
+  using Handle = std::shared_ptr<const File>;
+
+  /**
+   * @brief Construct a file cache.
+   *
+   * @param capacity The maximum number of idle descriptors to keep open.
+   * @param flags The flags used to open files. `O_CLOEXEC` is always added.
+   */
+  explicit FileCache(size_t capacity, int flags = File::default_flags) noexcept :
+      capacity(capacity), flags(flags | O_CLOEXEC) {}
+
+  FileCache(const FileCache&)            = delete;
+  FileCache& operator=(const FileCache&) = delete;
+
+  /**
+   * @brief Get a shared handle to the file at `path`, opening it if needed.
+   *
+   * @param path The path of the file.
+   * @return The handle, or the error status.
+   */
+  Result<Handle> acquire(std::string_view path);
+
+  /**
+   * @brief Get an independently owned descriptor for the file at `path`.
+   *
+   * The descriptor is duplicated from the cached one with `File::dup()`, so it shares the open
+   * file description but is closed by its own destructor.
+   *
+   * @param path The path of the file.
+   * @return The new file, or the error status.
+   */
+  Result<File> dup(std::string_view path);
+
+  /**
+   * @brief Drop the cached descriptor for `path`, e.g. after the file was replaced.
+   *
+   * Outstanding handles remain valid and keep the old descriptor open until released.
+   *
+   * @return True if an entry was removed.
+   */
+  bool erase(std::string_view path);
+
+  /**
+   * @brief Drop all cached descriptors.
+   */
+  void clear();
+
+  /**
+   * @brief Get a snapshot of the cache counters.
+   */
+  FileCacheStats stats() const;
+}; // class FileCache
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "../status_code.hh"
+#include "common.hh"
+#include "epoch.hh"
+#include "file.hh"
+#include "mmap_file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief A published, validated mapping of an index file.
+ *
+ * Instances are immutable once published. Readers obtain them through `FileReloader::load()`
+ * while inside an epoch critical section.
+ */
+struct MappedIndex {
+  MmapFile map;
+  dev_t device{0};
+  ino_t inode{0};
+  off_t size{0};
+  struct timespec mtime {};
+  uint64_t generation{0};
+}; // struct MappedIndex
+
+/**
+ * @brief The outcome of a reload attempt.
+ */
+struct ReloadResult {
+  StatusCode status{StatusCode::ok};    // Open, map or validation status
+  bool changed{false};                  // True if a new mapping was published
+  uint64_t generation{0};               // Generation of the mapping visible to readers
+  std::chrono::nanoseconds duration{0}; // Wall time spent in the reload
+}; // struct ReloadResult
+
+/**
+ * @class FileReloader
+ * @brief Keeps a mapped index file current while readers keep using it without locks.
+ *
+ * The reloader opens and maps the file at `path`, validates it, and publishes the mapping through
+ * an `EpochPointer`. When the file is replaced (renamed over or rewritten), the new file is opened,
+ * mapped, validated and prefaulted off the query path before being published; the previous mapping
+ * is retired into the `EpochDomain` and unmapped once readers have moved on.
+ *
+ * If the file on disk is unchanged (same device, inode, size and mtime), the current mapping is
+ * kept so its page tables and page cache stay warm. Mappings share the page cache with the file,
+ * so a reload never copies data.
+ *
+ * On Linux, `watch()` and `poll()` use inotify on the parent directory so both in-place rewrites
+ * and rename-into-place deploys are noticed.
+ *
+ * `reload()`, `watch()` and `poll()` must be called from a single writer thread; `load()` may be
+ * called from any registered reader.
+ */
+class FileReloader {
+public:
+  /**
+   * @brief Validates a freshly mapped file before it is published.
+   *
+   * Return `StatusCode::ok` to accept the file; any other status rejects it and keeps the current
+   * mapping.
+   */
+  using Validator = std::function<StatusCode(const File&, const MmapFile&)>;
+
+  /**
+   * @brief Reload options.
+   */
+  struct Options {
+    int prot      = MmapFile::default_prot;
+    int map_flags = MmapFile::default_flags;
+    bool prefault = true; // Issue MADV_WILLNEED on new mappings before publishing
+    Validator validator{};
+  }; // struct Options
+
+  /**
+   * @brief Construct a reloader.
+   *
+   * Nothing is opened until `reload()` is called.
+   *
+   * @param domain The epoch domain used to retire replaced mappings.
+   * @param path The path of the file to keep mapped.
+   * @param options Mapping and validation options.
+   */
+  FileReloader(EpochDomain& domain, std::string path, Options options);
+
+  FileReloader(EpochDomain& domain, std::string path) :
+      FileReloader(domain, std::move(path), Options{}) {}
+
+  FileReloader(const FileReloader&)            = delete;
+  FileReloader& operator=(const FileReloader&) = delete;
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops watching and retires the current mapping.
+   */
+  ~FileReloader();
+
+  /**
+   * @brief Get the current mapping.
+   *
+   * The caller must be inside a critical section of the reloader's epoch domain. The returned
+   * pointer remains valid until the caller leaves the critical section.
+   *
+   * @return The current mapping, or nullptr if no file has been loaded successfully.
+   */
+  const MappedIndex* load() const noexcept { return current.load(); }
+
+  /**
+   * @brief Check the file and publish a new mapping if it changed.
+   *
+   * @return The reload outcome. On failure the previously published mapping stays in place.
+   */
+  ReloadResult reload();
+
+  /**
+   * @brief Start watching the file's directory for changes.
+   *
+   * @return `StatusCode::ok` on success, `StatusCode::enotsup` on platforms without inotify,
+   * otherwise an error code.
+   */
+  StatusCode watch();
+
+  /**
+   * @brief Wait for changes and reload if the watched file was touched.
+   *
+   * @param timeout_ms Maximum time to wait, in milliseconds. Zero returns immediately and a
+   * negative value waits indefinitely.
+   * @return The reload outcome. `changed` is false if no relevant event arrived.
+   */
+  ReloadResult poll(int timeout_ms);
+
+  /**
+   * @brief Get the path being reloaded.
+   */
+  const std::string& path() const noexcept { return file_path; }
+
+private:
+  EpochDomain& domain;
+  std::string file_path;
+  std::string file_name;
+  Options options;
+  EpochPointer<MappedIndex> current;
+  uint64_t generation{0};
+  int notify_fd{-1};
+
+  bool drain_events();
+}; // class FileReloader
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief Scramble a 64-bit value (the SplitMix64 finalizer).
+ */
+PEREGRINE_FORCE_INLINE uint64_t mix64(uint64_t x) noexcept {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+/**
+ * @brief Map a 64-bit hash uniformly onto `[0, n)` without a division.
+ */
+PEREGRINE_FORCE_INLINE uint64_t fastrange64(uint64_t hash, uint64_t n) noexcept {
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * n) >> 64);
+}
+
+/**
+ * @brief Hash bytes to 64 bits (MurmurHash64A).
+ *
+ * The result is the same on every little-endian platform, so it may be stored in files.
+ */
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed) noexcept {
+  constexpr uint64_t m = 0xc6a4a7935bd1e995ull;
+  constexpr int r      = 47;
+  const auto* p        = static_cast<const unsigned char*>(data);
+  uint64_t h           = seed ^ (size * m);
+
+  for(; size >= 8; size -= 8, p += 8) {
+    uint64_t k;
+    std::memcpy(&k, p, 8);
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  if(size != 0) {
+    uint64_t k = 0;
+    std::memcpy(&k, p, size);
+    h ^= k;
+    h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+/**
+ * @brief Hash a string to 64 bits.
+ */
+inline uint64_t hash_bytes(std::string_view key, uint64_t seed) noexcept {
+  return hash_bytes(key.data(), key.size(), seed);
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "epoch.hh"
+#include "file.hh"
+#include "mmap_file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief How an `IndexFile` serves reads.
+ */
+enum class AccessMode {
+  pread, // Copy with pread() from the page cache
+  mmap,  // Copy out of a shared read-only mapping
+}; // enum class AccessMode
+
+/**
+ * @brief The measurements an `IndexFile` bases its choice of access mode on.
+ */
+struct AccessProfile {
+  off_t file_size{0};            // Size of the file in bytes
+  size_t memory_size{0};         // Physical memory of the machine in bytes
+  double resident_fraction{0.0}; // Sampled fraction of the file in the page cache
+  uint64_t reads{0};             // Reads observed since the last decision
+  uint64_t sequential_reads{0};  // Reads that started where the thread's previous read ended
+}; // struct AccessProfile
+
+/**
+ * @class IndexFile
+ * @brief A read-only index file that picks between `mmap()` and `pread()` per file.
+ *
+ * Small files and files that are mostly resident are best served from a mapping: a read is a
+ * `memcpy()` with no system call. Files much larger than memory that are read at random are
+ * better served with `pread()`: every miss in a mapping costs a page fault, readahead around the
+ * fault wastes memory, and the page tables of a huge mapping are themselves costly.
+ *
+ * The file is opened once and always readable with `pread()`. When the mapped mode is chosen, a
+ * mapping is published through an `EpochPointer`, so the mode can change while readers keep
+ * reading without locks; a replaced mapping is unmapped once readers have moved on.
+ *
+ * `open()`, `adapt()` and `set_mode()` must be called from a single maintenance thread. `read()`
+ * may be called from any thread inside a critical section of the file's epoch domain. The file
+ * must not be truncated while it is open.
+ */
+class IndexFile {
+public:
+  /**
+   * @brief Access mode selection options.
+   */
+  struct Options {
+    bool adaptive              = true;             // Let adapt() switch modes
+    off_t small_file_size      = off_t{64} << 20;  // Files up to this size are always mapped
+    double max_memory_fraction = 0.5;              // Larger files are candidates for pread()
+    double resident_fraction   = 0.8;              // Map files at least this resident
+    double random_fraction     = 0.5;              // Non-sequential share that counts as random
+    uint64_t min_reads         = 1024;             // Reads to observe before switching
+    size_t residency_samples   = 64;               // Windows sampled when measuring residency
+  }; // struct Options
+
+  /**
+   * @brief Construct an index file.
+   *
+   * Nothing is opened until `open()` is called.
+   *
+   * @param domain The epoch domain used to retire replaced mappings.
+   * @param options Access mode selection options.
+   */
+  IndexFile(EpochDomain& domain, Options options) noexcept;
+
+  explicit IndexFile(EpochDomain& domain) noexcept : IndexFile(domain, Options{}) {}
+
+  IndexFile(const IndexFile&)            = delete;
+  IndexFile& operator=(const IndexFile&) = delete;
+
+  /**
+   * @brief Open the file and choose the initial access mode from its size and residency.
+   *
+   * @param path The path of the file.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode open(std::string_view path);
+
+  /**
+   * @brief Read up to `count` bytes at `offset`.
+   *
+   * The caller must be inside a critical section of the file's epoch domain.
+   *
+   * @return The number of bytes read, zero at or past the end of the file, or the error status.
+   */
+  Result<ssize_t> read(void* buffer, size_t count, off_t offset) const noexcept;
+
+  /**
+   * @brief Get the current mapping, for callers that can use the data in place.
+   *
+   * The caller must be inside a critical section of the file's epoch domain. The returned pointer
+   * remains valid until the caller leaves the critical section.
+   *
+   * @return The mapping, or nullptr in `AccessMode::pread`.
+   */
+  const MmapFile* mapping() const noexcept { return map.load(); }
+
+  /**
+   * @brief Re-evaluate the access mode from the reads observed since the last decision.
+   *
+   * Does nothing until `Options::min_reads` reads have been observed or if the file is not
+   * adaptive.
+   *
+   * @return The access mode now in use, or the error status if switching failed.
+   */
+  Result<AccessMode> adapt();
+
+  /**
+   * @brief Switch to `mode` regardless of the policy.
+   *
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode set_mode(AccessMode mode);
+
+  /**
+   * @brief Get the access mode in use.
+   */
+  AccessMode mode() const noexcept { return current_mode.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Get the number of times the access mode changed after `open()`.
+   */
+  uint64_t switch_count() const noexcept { return switches; }
+
+  /**
+   * @brief Get the size of the file in bytes.
+   */
+  off_t size() const noexcept { return file_size; }
+
+  /**
+   * @brief Estimate the fraction of the file in the page cache.
+   *
+   * Samples `Options::residency_samples` windows spread evenly over the file with `mincore()`.
+   * Must be called from the maintenance thread.
+   *
+   * @return A fraction between 0 and 1, or the error status.
+   */
+  Result<double> residency() noexcept;
+
+  /**
+   * @brief Get the measurements the next call to `adapt()` would decide on, without residency.
+   */
+  AccessProfile profile() const noexcept;
+
+  /**
+   * @brief The access mode selection policy.
+   *
+   * @param profile The measurements to decide on.
+   * @param options The thresholds to apply.
+   * @return The preferred access mode.
+   */
+  static AccessMode choose(const AccessProfile& profile, const Options& options) noexcept;
+
+private:
+  EpochDomain& domain;
+  Options options;
+  File file;
+  off_t file_size{0};
+  EpochPointer<MmapFile> map;
+  std::atomic<AccessMode> current_mode{AccessMode::pread};
+  uint64_t switches{0};
+
+  // Access pattern counters, reset by every decision. Readers update the stripe of their thread
+  // with relaxed atomics, so threads reading the same file do not share a cache line, and a read
+  // counts as sequential when it continues the previous read of the same stripe.
+  static constexpr size_t stripe_count = 8;
+
+  struct alignas(64) ProfileStripe {
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> sequential_reads{0};
+    std::atomic<off_t> last_end{-1};
+  }; // struct ProfileStripe
+
+  mutable std::array<ProfileStripe, stripe_count> stripes{};
+
+  void record(size_t count, off_t offset) const noexcept;
+  void reset_profile() noexcept;
+}; // class IndexFile
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class IoThreadPool
+ * @brief A small pool of threads that run blocking I/O on behalf of latency-critical threads.
+ */
+class IoThreadPool {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> tasks;
+  std::vector<std::thread> threads;
+  bool stopping{false};
+
+  void run() noexcept;
+
+public:
+  /**
+   * @brief Start the pool.
+   *
+   * @param thread_count The number of I/O threads. At least one thread is started.
+   */
+  explicit IoThreadPool(size_t thread_count);
+
+  IoThreadPool(const IoThreadPool&)            = delete;
+  IoThreadPool& operator=(const IoThreadPool&) = delete;
+
+  /**
+   * @brief Destructor.
+   *
+   * Runs all queued tasks and joins the threads.
+   */
+  ~IoThreadPool();
+
+  /**
+   * @brief Queue a task to run on one of the I/O threads.
+   */
+  void submit(std::function<void()> task);
+
+  /**
+   * @brief Get the number of I/O threads.
+   */
+  size_t size() const noexcept { return threads.size(); }
+}; // class IoThreadPool
+
+/**
+ * @brief Counters describing how reads were served by an `AsyncReader`.
+ */
+struct AsyncReaderStats {
+  uint64_t inline_reads{0};    // Reads fully served from the page cache on the calling thread
+  uint64_t offloaded_reads{0}; // Reads (or their remainders) handed to the I/O pool
+}; // struct AsyncReaderStats
+
+/**
+ * @class AsyncReader
+ * @brief Positional reads that never block the calling thread on the device.
+ *
+ * Each read is first attempted inline with `File::pread_nowait()`. Page cache hits complete on the
+ * calling thread with no context switch. On a miss, or for the uncached tail of a partially cached
+ * range, the blocking `File::pread()` runs on an `IoThreadPool` thread and the result is delivered
+ * through a callback or future.
+ *
+ * The file and the buffer must stay valid until the read completes.
+ */
+class AsyncReader {
+  IoThreadPool& pool;
+  std::atomic<uint64_t> inline_reads{0};
+  std::atomic<uint64_t> offloaded_reads{0};
+
+public:
+  /**
+   * @brief Completion callback.
+   *
+   * Receives the total number of bytes read, or the error status.
+   */
+  using Callback = std::function<void(Result<ssize_t>)>;
+
+  explicit AsyncReader(IoThreadPool& pool) noexcept : pool(pool) {}
+
+  /**
+   * @brief Read up to `count` bytes at `offset` and invoke `callback` when done.
+   *
+   * @param file The file to read from.
+   * @param buf Pointer to the buffer where the data will be stored.
+   * @param count Number of bytes to read.
+   * @param offset The offset in the file to start reading from.
+   * @param callback Invoked exactly once, either on the calling thread or on an I/O thread.
+   * @return True if the read completed inline and `callback` has already run.
+   */
+  bool pread(const File& file, void* buf, size_t count, off_t offset, Callback callback);
+
+  /**
+   * @brief Read up to `count` bytes at `offset`, returning a future for the result.
+   *
+   * The future is ready on return when the data was served from the page cache.
+   */
+  std::future<Result<ssize_t>> pread(
+      const File& file, void* buf, size_t count, off_t offset);
+
+  /**
+   * @brief Get a snapshot of the read counters.
+   */
+  AsyncReaderStats stats() const noexcept {
+    return {inline_reads.load(std::memory_order_relaxed),
+        offloaded_reads.load(std::memory_order_relaxed)};
+  }
+}; // class AsyncReader
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief The file operations tracked by `IoStats`.
+ */
+enum class IoOp : uint8_t {
+  read,
+  pread,
+  readv,
+  preadv,
+  pread_nowait,
+  write,
+  pwrite,
+  writev,
+  pwritev,
+  fsync,
+  sync_file_range,
+  count // Number of operations, not an operation
+}; // enum class IoOp
+
+constexpr size_t io_op_count = static_cast<size_t>(IoOp::count);
+
+/**
+ * @brief Get the name of an operation.
+ */
+std::string_view io_op_name(IoOp op) noexcept;
+
+/**
+ * @class IoHistogram
+ * @brief A log-bucketed latency histogram in nanoseconds.
+ *
+ * Like an HDR histogram, each power of two is split into `sub_bucket_count` linear sub-buckets, so
+ * every recorded value is known to within 25% regardless of its magnitude. Values from zero up to
+ * about 36 minutes are tracked; anything larger is counted in the last bucket.
+ */
+class IoHistogram {
+public:
+  static constexpr unsigned sub_bucket_bits  = 2;
+  static constexpr uint64_t sub_bucket_count = uint64_t{1} << sub_bucket_bits;
+  static constexpr unsigned max_magnitude    = 40;
+  static constexpr size_t bucket_count = (max_magnitude - sub_bucket_bits + 2) << sub_bucket_bits;
+
+  /**
+   * @brief Get the bucket that counts `value`.
+   */
+  static constexpr size_t index(uint64_t value) noexcept {
+    if(value < sub_bucket_count) return static_cast<size_t>(value);
+    const unsigned magnitude = 63u - static_cast<unsigned>(__builtin_clzll(value));
+    const unsigned shift     = magnitude - sub_bucket_bits;
+    const size_t bucket      = ((static_cast<size_t>(shift) + 1) << sub_bucket_bits) +
+                          static_cast<size_t>((value >> shift) & (sub_bucket_count - 1));
+    return bucket < bucket_count ? bucket : bucket_count - 1;
+  }
+
+  /**
+   * @brief Get the smallest value counted by bucket `i`.
+   */
+  static constexpr uint64_t lower_bound(size_t i) noexcept {
+    if(i < sub_bucket_count) return i;
+    const size_t shift = (i >> sub_bucket_bits) - 1;
+    return (sub_bucket_count | (i & (sub_bucket_count - 1))) << shift;
+  }
+
+  /**
+   * @brief Get the largest value counted by bucket `i`.
+   */
+  static constexpr uint64_t upper_bound(size_t i) noexcept {
+    return i + 1 < bucket_count ? lower_bound(i + 1) - 1 : UINT64_MAX;
+  }
+
+  std::array<uint64_t, bucket_count> counts{};
+
+  /**
+   * @brief Get the number of recorded values.
+   */
+  uint64_t count() const noexcept;
+
+  /**
+   * @brief Get an upper bound for the value at quantile `q`, e.g. `0.99` for p99.
+   *
+   * @return The upper bound of the bucket holding the quantile, or zero if the histogram is empty.
+   */
+  uint64_t percentile(double q) const noexcept;
+
+  /**
+   * @brief Add the counts of `other` to this histogram.
+   */
+  IoHistogram& operator+=(const IoHistogram& other) noexcept;
+}; // class IoHistogram
+
+/**
+ * @brief Counters for one operation.
+ */
+struct IoOpStats {
+  uint64_t calls{0};   // Number of calls, including failed ones
+  uint64_t errors{0};  // Number of calls that failed
+  uint64_t bytes{0};   // Bytes transferred by successful calls
+  IoHistogram latency; // Latency of every call in nanoseconds
+}; // struct IoOpStats
+
+/**
+ * @brief A point-in-time copy of the counters of an `IoStats`.
+ */
+struct IoStatsSnapshot {
+  std::array<IoOpStats, io_op_count> ops{};
+
+  IoOpStats& operator[](IoOp op) noexcept { return ops[static_cast<size_t>(op)]; }
+  const IoOpStats& operator[](IoOp op) const noexcept { return ops[static_cast<size_t>(op)]; }
+}; // struct IoStatsSnapshot
+
+/**
+ * @class IoStats
+ * @brief Lock-free I/O counters and latency histograms for one file.
+ *
+ * Recording a call touches only relaxed atomic increments. To keep threads that share a file from
+ * contending on the same cache lines, counters are striped: each thread is assigned one of
+ * `stripe_count` stripes for its lifetime, and a stripe is allocated the first time a thread
+ * using it records a call. `snapshot()` sums the stripes, so it may observe a call that is being
+ * recorded only partially but never blocks writers.
+ */
+class IoStats {
+public:
+  static constexpr size_t stripe_count = 8;
+
+  using clock = std::chrono::steady_clock;
+
+  IoStats() noexcept = default;
+
+  IoStats(const IoStats&)            = delete;
+  IoStats& operator=(const IoStats&) = delete;
+
+  ~IoStats();
+
+  /**
+   * @brief Record a completed call.
+   *
+   * @param op The operation.
+   * @param rc The return value of the call. `-1` counts as an error; otherwise a positive value is
+   * counted as bytes transferred.
+   * @param nanos The latency of the call.
+   */
+  void record(IoOp op, int64_t rc, uint64_t nanos) noexcept {
+    Stripe* stripe = local_stripe();
+    if(PEREGRINE_UNLIKELY(stripe == nullptr)) return;
+    Counters& counters = stripe->ops[static_cast<size_t>(op)];
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    if(PEREGRINE_UNLIKELY(rc == -1)) {
+      counters.errors.fetch_add(1, std::memory_order_relaxed);
+    } else if(rc > 0) {
+      counters.bytes.fetch_add(static_cast<uint64_t>(rc), std::memory_order_relaxed);
+    }
+    counters.latency[IoHistogram::index(nanos)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Record a call that started at `start`.
+   */
+  void record(IoOp op, int64_t rc, clock::time_point start) noexcept {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+    record(op, rc, static_cast<uint64_t>(elapsed.count()));
+  }
+
+  /**
+   * @brief Sum the counters of all threads.
+   */
+  IoStatsSnapshot snapshot() const noexcept;
+
+  /**
+   * @brief Reset all counters to zero.
+   *
+   * Calls recorded concurrently with the reset may be partially kept.
+   */
+  void reset() noexcept;
+
+private:
+  struct Counters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> bytes{0};
+    std::array<std::atomic<uint64_t>, IoHistogram::bucket_count> latency{};
+  }; // struct Counters
+
+  struct alignas(64) Stripe {
+    std::array<Counters, io_op_count> ops{};
+  }; // struct Stripe
+
+  std::array<std::atomic<Stripe*>, stripe_count> stripes{};
+
+  PEREGRINE_FORCE_INLINE Stripe* local_stripe() noexcept {
+    auto& slot     = stripes[thread_stripe<stripe_count>()];
+    Stripe* stripe = slot.load(std::memory_order_acquire);
+    return PEREGRINE_LIKELY(stripe != nullptr) ? stripe : allocate_stripe(slot);
+  }
+
+  [[gnu::cold, gnu::noinline]] Stripe* allocate_stripe(std::atomic<Stripe*>& slot) noexcept;
+}; // class IoStats
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief Get the first 8 bytes of a key, zero padded, as an integer that orders like the bytes.
+ *
+ * If `normalized_prefix(a) < normalized_prefix(b)` then `a < b`; equal prefixes need a full
+ * comparison.
+ */
+inline uint64_t normalized_prefix(std::string_view key) noexcept {
+  uint64_t prefix = 0;
+  std::memcpy(&prefix, key.data(), key.size() < 8 ? key.size() : 8);
+  return __builtin_bswap64(prefix);
+}
+
+/**
+ * @class KeyBlockBuilder
+ * @brief Builds a block of sorted keys and their values in the format read by `KeyBlock`.
+ *
+ * Each key is stored as the length of the prefix it shares with the previous key and the bytes
+ * that follow. Every `restart_interval` keys a restart point stores a key in full, so readers can
+ * binary search the restarts and only decode a few entries.
+ */
+class KeyBlockBuilder {
+  std::string entries;
+  std::vector<uint64_t> prefixes;
+  std::vector<uint32_t> restarts;
+  std::string last;
+  uint32_t restart_interval;
+  uint32_t count{0};
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param restart_interval The number of keys per restart point. Smaller intervals make lookups
+   * faster and blocks larger.
+   */
+  explicit KeyBlockBuilder(uint32_t restart_interval = 16) noexcept
+      : restart_interval(restart_interval == 0 ? 1 : restart_interval) {}
+
+  /**
+   * @brief Append a key and its value.
+   *
+   * @return `StatusCode::invalid_argument` if `key` is not greater than the previous key.
+   */
+  StatusCode add(std::string_view key, std::string_view value);
+
+  /**
+   * @brief Get the number of keys added.
+   */
+  uint32_t size() const noexcept { return count; }
+
+  /**
+   * @brief Get the size `finish()` would return.
+   */
+  size_t serialized_size() const noexcept;
+
+  /**
+   * @brief Serialize the block and reset the builder.
+   */
+  std::string finish();
+}; // class KeyBlockBuilder
+
+/**
+ * @class KeyBlock
+ * @brief A block of prefix-compressed sorted keys read in place, e.g. from an `MmapFile`.
+ *
+ * Lookups binary search the restart points by their normalized 8-byte prefixes, which are stored
+ * beside the restart offsets so most steps are one integer comparison without touching the
+ * entries. Ties, and the linear decode after the last restart not past the key, compare with the
+ * SIMD `compare_bytes()`.
+ *
+ * The format is, in native (little-endian) byte order and 8-byte aligned:
+ *
+ * - A 24-byte header: magic `PRKB`, version, restart interval, key count, restart count and the
+ *   size of the entries.
+ * - The normalized prefix of each restart key as a 64-bit integer.
+ * - The offset of each restart entry as a 32-bit integer, padded to 8 bytes.
+ * - The entries: varint shared length, varint unshared length, varint value length, the unshared
+ *   key bytes and the value.
+ */
+class KeyBlock {
+public:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t restart_interval;
+    uint32_t count;
+    uint32_t restarts;
+    uint64_t entries_bytes;
+  }; // struct Header
+
+  static constexpr uint32_t magic   = 0x424b5250; // "PRKB"
+  static constexpr uint16_t version = 1;
+
+  /**
+   * @class Iterator
+   * @brief Walks the entries of a block in key order.
+   *
+   * The iterator owns the decoded key; values point into the block.
+   */
+  class Iterator {
+    friend class KeyBlock;
+
+    const char* next_entry{nullptr};
+    const char* end{nullptr};
+    std::string current;
+    std::string_view current_value;
+    bool is_valid{false};
+
+    Iterator(const char* p, const char* end) : next_entry(p), end(end) { next(); }
+
+  public:
+    Iterator() = default;
+
+    /**
+     * @brief Check if the iterator is at an entry. Corrupt entries end the iteration.
+     */
+    bool valid() const noexcept { return is_valid; }
+
+    /**
+     * @brief Get the key of the current entry.
+     */
+    std::string_view key() const noexcept { return current; }
+
+    /**
+     * @brief Get the value of the current entry.
+     */
+    std::string_view value() const noexcept { return current_value; }
+
+    /**
+     * @brief Move to the next entry.
+     */
+    void next();
+  }; // class Iterator
+
+  KeyBlock() noexcept = default;
+
+  /**
+   * @brief Validate serialized bytes and view them.
+   *
+   * @param data The start of the serialized block. Must be 8-byte aligned.
+   * @param size The number of bytes available.
+   * @return The view, or `StatusCode::invalid_argument` if the bytes are not a valid block.
+   */
+  static Result<KeyBlock> open(const void* data, size_t size) noexcept;
+
+  /**
+   * @brief Get an iterator at the first entry.
+   */
+  Iterator begin() const { return Iterator(entries, entries + entries_bytes()); }
+
+  /**
+   * @brief Get an iterator at the first entry with a key not less than `key`.
+   */
+  Iterator seek(std::string_view key) const;
+
+  /**
+   * @brief Look up the value of a key.
+   *
+   * @return True if the key was found.
+   */
+  bool get(std::string_view key, std::string_view& value) const;
+
+  /**
+   * @brief Get the number of keys.
+   */
+  uint32_t size() const noexcept { return header != nullptr ? header->count : 0; }
+
+  /**
+   * @brief Get the size of the serialized block in bytes.
+   */
+  size_t bytes() const noexcept;
+
+private:
+  size_t entries_bytes() const noexcept { return header != nullptr ? header->entries_bytes : 0; }
+  std::string_view restart_key(uint32_t i) const noexcept;
+
+  const Header* header{nullptr};
+  const uint64_t* prefixes{nullptr};
+  const uint32_t* restarts{nullptr};
+  const char* entries{nullptr};
+}; // class KeyBlock
+
+} // namespace internal
+} // namespace peregrine
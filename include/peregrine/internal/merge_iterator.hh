@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "sorted_file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief A version of a key in a sorted run.
+ */
+struct MergeEntry {
+  std::string_view key;
+  std::string_view value;
+  uint64_t sequence{0};  // Newer versions have larger sequence numbers
+  bool tombstone{false}; // The key was deleted as of `sequence`
+}; // struct MergeEntry
+
+/**
+ * @class MergeSource
+ * @brief A sorted run read by `MergeIterator` a batch at a time.
+ *
+ * Entries are ordered by key, and versions of the same key by decreasing sequence number.
+ */
+class MergeSource {
+public:
+  virtual ~MergeSource() = default;
+
+  /**
+   * @brief Get the next entries of the run.
+   *
+   * @param out Receives the entries, which must stay valid until the next call.
+   * @param max The maximum number of entries. Never zero.
+   * @return The number of entries, zero at the end of the run, or the error status.
+   */
+  virtual Result<size_t> fill(MergeEntry* out, size_t max) = 0;
+}; // class MergeSource
+
+/**
+ * @class SpanSource
+ * @brief A run of entries in memory, e.g. a snapshot of a write buffer.
+ *
+ * The entries are not copied and must outlive the source.
+ */
+class SpanSource final : public MergeSource {
+  const MergeEntry* entries;
+  size_t count;
+  size_t position{0};
+
+public:
+  SpanSource(const MergeEntry* entries, size_t count) noexcept : entries(entries), count(count) {}
+
+  Result<size_t> fill(MergeEntry* out, size_t max) override;
+}; // class SpanSource
+
+/**
+ * @class SortedFileSource
+ * @brief A run read from a `SortedFile`.
+ *
+ * Every entry gets the run's sequence number; sorted files hold no tombstones. Each batch is
+ * copied out of the file's blocks, since the iterator's keys only live as long as its block.
+ */
+class SortedFileSource final : public MergeSource {
+  SortedFile::Iterator iterator;
+  uint64_t sequence;
+  std::string arena;
+  std::vector<std::pair<uint32_t, uint32_t>> sizes; // Key and value sizes of the batch
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param iterator An iterator at the first entry to merge, e.g. after `seek_to_first()`.
+   * @param sequence The sequence number of the run.
+   */
+  SortedFileSource(SortedFile::Iterator iterator, uint64_t sequence) noexcept :
+      iterator(std::move(iterator)), sequence(sequence) {}
+
+  Result<size_t> fill(MergeEntry* out, size_t max) override;
+}; // class SortedFileSource
+
+/**
+ * @brief Counters of a `MergeIterator`.
+ */
+struct MergeStats {
+  uint64_t entries_read{0};       // Entries taken from the sources
+  uint64_t entries_returned{0};   // Entries returned to the caller
+  uint64_t duplicates_dropped{0}; // Older versions of returned or dropped keys
+  uint64_t tombstones_dropped{0}; // Newest versions that were tombstones
+  uint64_t fills{0};              // Batches fetched from the sources
+}; // struct MergeStats
+
+/**
+ * @class MergeIterator
+ * @brief Merges sorted runs into one sorted stream with a loser tree.
+ *
+ * The tree has a leaf per run and keeps at each inner node the run that lost the match there, so
+ * replacing the winner replays only the matches on its path to the root: `log2(k)` comparisons
+ * per entry for `k` runs, against the `2 log2(k)` of a binary heap. The heads of the runs sit in
+ * one array with the normalized 8-byte prefix of each key, so most matches compare two integers
+ * and touch neither the entries nor the keys.
+ *
+ * Equal keys come out newest first, with ties going to the run added first. With
+ * `Options::resolve_duplicates` only the newest version of each key is returned, and with
+ * `Options::drop_tombstones` keys whose newest version is a tombstone are left out with all their
+ * versions, as a merge that includes the oldest run may.
+ *
+ * Both ends work in batches to keep virtual calls and per-call overhead off the per-entry path:
+ * runs are read `Options::source_batch` entries per `MergeSource::fill()` call and entries are
+ * returned by `next_batch()`.
+ */
+class MergeIterator {
+public:
+  struct Options {
+    bool resolve_duplicates = true;  // Return only the newest version of each key
+    bool drop_tombstones    = false; // Leave out keys whose newest version is a tombstone
+    size_t source_batch     = 256;   // Entries read from a run per fill
+  }; // struct Options
+
+  /**
+   * @brief Constructor.
+   *
+   * @param sources The runs to merge.
+   * @param options Merge options.
+   */
+  MergeIterator(std::vector<std::unique_ptr<MergeSource>> sources, Options options);
+
+  explicit MergeIterator(std::vector<std::unique_ptr<MergeSource>> sources) :
+      MergeIterator(std::move(sources), Options{}) {}
+
+  MergeIterator(const MergeIterator&)            = delete;
+  MergeIterator& operator=(const MergeIterator&) = delete;
+
+  /**
+   * @brief Get the next merged entries.
+   *
+   * A batch may end early when a run needs to be read again, but is only empty at the end. Keys
+   * and values stay valid until the next call.
+   *
+   * @param out Receives the entries.
+   * @param max The maximum number of entries.
+   * @return The number of entries, zero at the end of the merge, or the error status of a run.
+   */
+  Result<size_t> next_batch(MergeEntry* out, size_t max);
+
+  /**
+   * @brief Get the number of runs.
+   */
+  size_t size() const noexcept { return runs.size(); }
+
+  /**
+   * @brief Get the iterator's counters.
+   */
+  const MergeStats& stats() const noexcept { return counters; }
+
+private:
+  struct Run {
+    std::unique_ptr<MergeSource> source;
+    std::vector<MergeEntry> buffer;
+    size_t position{0};
+    size_t count{0};
+  }; // struct Run
+
+  // The current entry of a leaf, or nullptr with the largest prefix once its run is exhausted
+  struct Head {
+    uint64_t prefix;
+    const MergeEntry* entry;
+  }; // struct Head
+
+  static constexpr uint32_t none = UINT32_MAX;
+
+  bool beats(uint32_t a, uint32_t b) const noexcept;
+  StatusCode refill(uint32_t i);
+  void replay(uint32_t leaf) noexcept;
+  void build();
+  void keep_last_key();
+
+  Options options;
+  std::vector<Run> runs;
+  std::vector<Head> heads;    // One per leaf, padded to a power of two
+  std::vector<uint32_t> tree; // The overall winner, then the loser of each inner node
+  uint32_t stale{none};       // The run to read again before the next batch
+  bool started{false};
+  StatusCode error{StatusCode::ok};
+
+  // The last key returned or dropped, to recognize older versions
+  std::string_view last_key;
+  std::string last_key_storage;
+  bool has_last{false};
+  bool last_dropped{false}; // The last key's newest version was a dropped tombstone
+
+  MergeStats counters;
+}; // class MergeIterator
+
+} // namespace internal
+} // namespace peregrine
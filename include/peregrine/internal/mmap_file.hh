@@ -1,13 +1,15 @@
 #pragma once
 
+#include <algorithm>
+
 #include "file.hh"
 
 namespace peregrine {
 namespace internal {
 
 class MmapFile {
-  void* data{nullptr};
-  size_t size{0};
+  void* addr{nullptr};
+  size_t length{0};
 
 public:
   constexpr static int default_prot  = PROT_READ;
@@ -26,9 +28,9 @@ public:
   // constructed state.
   // - Parameters:
   //  - other: The MmapFile to move.
-  MmapFile(MmapFile&& other) noexcept : data(other.data), size(other.size) {
-    other.data = nullptr;
-    other.size = 0;
+  MmapFile(MmapFile&& other) noexcept : addr(other.addr), length(other.length) {
+    other.addr   = nullptr;
+    other.length = 0;
   }
 
   // Destructor
@@ -45,20 +47,24 @@ public:
   // - Returns: A reference to the moved MmapFile.
   MmapFile& operator=(MmapFile&& other) noexcept {
     unmap();
-    data       = other.data;
-    size       = other.size;
-    other.data = nullptr;
-    other.size = 0;
+    addr         = other.addr;
+    length       = other.length;
+    other.addr   = nullptr;
+    other.length = 0;
     return *this;
   }
 
   // Check if the file is open
   // - Returns: True if the file is mapped, otherwise false.
-  bool is_open() const noexcept { return data != nullptr; }
+  bool is_open() const noexcept { return addr != nullptr; }
+
+  // Get the address of the mapped file
+  // - Returns: The start of the mapping, or nullptr if the file is not mapped.
+  void* data() const noexcept { return addr; }
 
   // Get the size of the mapped file
   // - Returns: The size of the mapped file, or zero if the file is not mapped.
-  size_t size() const noexcept { return size; }
+  size_t size() const noexcept { return length; }
 
   // Map a file into memory
   //
@@ -103,11 +109,39 @@ public:
     if(PEREGRINE_UNLIKELY(ptr == MAP_FAILED)) return errno_to_status();
 
     unmap();
-    data = ptr;
-    size = length;
+    addr         = ptr;
+    this->length = length;
     return StatusCode::ok;
   }
 
+  // Advise the kernel about the expected access pattern
+  //
+  // - Parameters:
+  //  - offset: The offset into the mapping where the advice starts. It is rounded down to a page
+  //    boundary.
+  //  - length: The length of the range the advice applies to.
+  //  - advice: One of the MADV_* constants, e.g. MADV_WILLNEED or MADV_RANDOM.
+  // - Returns: An error status if the madvise call fails, otherwise StatusCode::ok.
+  StatusCode advise(size_t offset, size_t length, int advice) const noexcept {
+    if(PEREGRINE_UNLIKELY(!is_open())) return StatusCode::not_open;
+    if(PEREGRINE_UNLIKELY(offset > this->length)) return StatusCode::invalid_argument;
+
+    const size_t begin = offset & ~(page_size() - 1);
+    const size_t end   = offset + std::min(length, this->length - offset);
+    char* const base   = static_cast<char*>(addr);
+    if(auto rc = ::peregrine::internal::madvise(base + begin, end - begin, advice);
+        PEREGRINE_UNLIKELY(rc != 0))
+      return errno_to_status();
+    return StatusCode::ok;
+  }
+
+  // Advise the kernel about the expected access pattern for the whole mapping
+  //
+  // - Parameters:
+  //  - advice: One of the MADV_* constants, e.g. MADV_WILLNEED or MADV_RANDOM.
+  // - Returns: An error status if the madvise call fails, otherwise StatusCode::ok.
+  StatusCode advise(int advice) const noexcept { return advise(0, length, advice); }
+
   // Unmap the file from memory
   //
   // This function removes the mapping for the specified address range from the virtual address
@@ -116,10 +150,10 @@ public:
   // - Returns: An error status if the munmap call fails, otherwise StatusCode::ok.
   StatusCode unmap() noexcept {
     if(!is_open()) return StatusCode::ok;
-    if(auto rc = ::peregrine::internal::munmap(data, size); PEREGRINE_UNLIKELY(rc != 0))
+    if(auto rc = ::peregrine::internal::munmap(addr, length); PEREGRINE_UNLIKELY(rc != 0))
       return errno_to_status();
-    data = nullptr;
-    size = 0;
+    addr   = nullptr;
+    length = 0;
     return StatusCode::ok;
   }
 
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+#include "hash.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class PerfectHash
+ * @brief A minimal perfect hash function for a static key set, evaluated in place from
+ * serialized bytes such as an `MmapFile`.
+ *
+ * The construction follows PTHash. Keys are split into partitions by hash, and each partition is
+ * built independently on its own thread. Within a partition, keys are hashed into skewed buckets
+ * (60% of keys into 30% of buckets). Buckets are then placed largest first: each gets the
+ * smallest "pilot" that sends all its keys to free slots of a table slightly larger than the
+ * partition. Slots past the end of the partition are remapped to the holes left below it. A
+ * lookup is a hash, one read of a packed pilot, and a multiply. For the default options this
+ * stores under 4 bits per key.
+ *
+ * Fingerprints of 8 or 16 bits per key can be stored to reject most non-members in `find()`;
+ * `operator()` returns some slot for any key.
+ *
+ * The format is, in native (little-endian) byte order and 8-byte aligned:
+ *
+ * - A 40-byte header: magic `PRPH`, version, fingerprint and pilot widths, key and partition
+ *   counts, the seed and the pilot word count.
+ * - A 32-byte entry per partition: first slot, key count, table size, bucket count, and the
+ *   offsets of its pilots and remapped slots.
+ * - The pilots packed into 64-bit words, plus one zero word.
+ * - The remapped slots as 32-bit partition-local slots, padded to 8 bytes.
+ * - The fingerprints by slot, padded to 8 bytes.
+ */
+class PerfectHash {
+public:
+  struct Options {
+    double load_factor{0.99};       // Keys per table slot before remapping
+    double bucket_density{5.0};     // Buckets are `bucket_density * keys / log2(keys)`
+    size_t partition_keys{1 << 20}; // Average keys per partition
+    uint32_t fingerprint_bits{0};   // 0, 8 or 16
+    size_t threads{0};              // Builder threads, or 0 for one per core
+    uint64_t seed{0x5045524547524e45ull};
+  }; // struct Options
+
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t fingerprint_bits;
+    uint8_t pilot_bits;
+    uint64_t keys;
+    uint64_t seed;
+    uint32_t partitions;
+    uint32_t reserved;
+    uint64_t pilot_words;
+  }; // struct Header
+
+  struct Partition {
+    uint64_t first;        // Global slot of the partition's first key
+    uint32_t keys;         // Keys in the partition
+    uint32_t table_size;   // Slots before remapping
+    uint32_t buckets;      // Number of pilots
+    uint32_t pilot_offset; // Index of the partition's first pilot
+    uint32_t remap_offset; // Index of the partition's first remapped slot
+    uint32_t reserved;
+  }; // struct Partition
+
+  static constexpr uint32_t magic   = 0x48505250; // "PRPH"
+  static constexpr uint16_t version = 1;
+
+  PerfectHash() noexcept = default;
+
+  /**
+   * @brief Build the function for a set of distinct keys.
+   *
+   * @return The serialized function, or `StatusCode::invalid_argument` if the keys are not
+   * distinct or the options are invalid.
+   */
+  static Result<std::string> build(const std::vector<std::string_view>& keys, Options options);
+
+  /**
+   * @brief Build the function and write it to a file.
+   *
+   * @param file The file to write to.
+   * @param offset Where to write the function. Must be a multiple of 8 to be mapped in place.
+   * @param keys The distinct keys.
+   * @param options The build options.
+   * @return The number of bytes written, or the build or write error.
+   */
+  static Result<size_t> build(
+      File& file, off_t offset, const std::vector<std::string_view>& keys, Options options);
+
+  /**
+   * @brief Validate serialized bytes and view them.
+   *
+   * @param data The start of the serialized function. Must be 8-byte aligned.
+   * @param size The number of bytes available.
+   * @return The view, or `StatusCode::invalid_argument` if the bytes are not a valid function.
+   */
+  static Result<PerfectHash> open(const void* data, size_t size) noexcept;
+
+  /**
+   * @brief Get the slot in `[0, size())` of a key. Each key of the set has its own slot; other
+   * keys get an arbitrary slot.
+   */
+  uint64_t operator()(std::string_view key) const noexcept {
+    return slot(hash_bytes(key, header->seed));
+  }
+
+  /**
+   * @brief Get the slot of a key, or `size()` if its fingerprint shows it is not in the set.
+   *
+   * Without fingerprints this is the same as `operator()`.
+   */
+  uint64_t find(std::string_view key) const noexcept;
+
+  /**
+   * @brief Get the number of keys.
+   */
+  uint64_t size() const noexcept { return header != nullptr ? header->keys : 0; }
+
+  /**
+   * @brief Get the fingerprint width in bits.
+   */
+  uint32_t fingerprint_bits() const noexcept {
+    return header != nullptr ? header->fingerprint_bits : 0;
+  }
+
+  /**
+   * @brief Get the size of the serialized function in bytes.
+   */
+  size_t bytes() const noexcept { return total; }
+
+private:
+  uint64_t slot(uint64_t hash) const noexcept;
+
+  const Header* header{nullptr};
+  const Partition* partitions{nullptr};
+  const uint64_t* pilots{nullptr};
+  const uint32_t* remap{nullptr};
+  const void* fingerprints{nullptr};
+  size_t total{0};
+}; // class PerfectHash
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class PostingIndexBuilder
+ * @brief Builds BM25-scored posting lists in the format read by `PostingIndex`.
+ *
+ * Documents are added in order as streams of term ids and get ids 0, 1, 2, and so on. `finish()`
+ * computes each posting's BM25 score, so queries only add precomputed scores.
+ */
+class PostingIndexBuilder {
+public:
+  struct Options {
+    float k1{1.2f};           // Term frequency saturation
+    float b{0.75f};           // Document length normalization
+    uint32_t block_size{128}; // Postings per block-max entry
+  }; // struct Options
+
+  PostingIndexBuilder() noexcept = default;
+
+  explicit PostingIndexBuilder(Options options) noexcept : options(options) {}
+
+  /**
+   * @brief Add a document.
+   *
+   * @param terms The term ids of the document's tokens, repeated as often as they occur.
+   * @return The document id.
+   */
+  uint32_t add(const std::vector<uint32_t>& terms);
+
+  /**
+   * @brief Get the number of documents added.
+   */
+  uint32_t size() const noexcept { return static_cast<uint32_t>(lengths.size()); }
+
+  /**
+   * @brief Serialize the index and reset the builder.
+   *
+   * @return The serialized index, or `StatusCode::invalid_argument` if the options are invalid.
+   */
+  Result<std::string> finish();
+
+private:
+  struct Posting {
+    uint32_t doc;
+    uint32_t frequency;
+  }; // struct Posting
+
+  Options options;
+  std::vector<std::vector<Posting>> postings; // By term
+  std::vector<uint32_t> lengths;              // By document
+  uint64_t total_length{0};
+}; // class PostingIndexBuilder
+
+/**
+ * @class PostingIndex
+ * @brief Top-k retrieval over BM25-scored posting lists, read in place from serialized bytes
+ * such as an `MmapFile`.
+ *
+ * A query scores each document by the sum of its postings' scores for the query terms and
+ * returns the `k` best. Block-max WAND avoids scoring most postings of common terms: the lists
+ * are kept ordered by their current document, and a document is only scored if the maximum
+ * scores of the lists that can contain it exceed the k-th best score so far. Each list stores
+ * the maximum score of every block of postings, which tightens the bound to the blocks around the
+ * candidate; when even that bound falls short, every list skips past the end of its current
+ * block without decoding it. Results are the same as scoring every posting, down to the bits of
+ * the scores: both sum a document's postings in term order.
+ *
+ * The format is, in native (little-endian) byte order and 8-byte aligned:
+ *
+ * - A 40-byte header: magic `PRPI`, version, term and document counts, block size, average
+ *   document length, and the posting and block counts.
+ * - A 24-byte entry per term: its first posting and block, posting count and maximum score.
+ * - An 8-byte entry per block: its last document and maximum score.
+ * - The document ids of the postings as 32-bit integers, padded to 8 bytes.
+ * - The scores of the postings as floats, padded to 8 bytes.
+ */
+class PostingIndex {
+public:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t terms;
+    uint32_t docs;
+    uint32_t block_size;
+    float average_length;
+    uint64_t postings;
+    uint64_t blocks;
+  }; // struct Header
+
+  struct Term {
+    uint64_t first_posting;
+    uint64_t first_block;
+    uint32_t postings;
+    float max_score;
+  }; // struct Term
+
+  struct Block {
+    uint32_t last_doc;
+    float max_score;
+  }; // struct Block
+
+  struct Hit {
+    uint32_t doc;
+    float score;
+  }; // struct Hit
+
+  /**
+   * @brief Counters of a query.
+   */
+  struct QueryStats {
+    uint64_t postings{0};        // Postings in the query terms' lists
+    uint64_t postings_scored{0}; // Postings whose scores were added
+    uint64_t docs_scored{0};     // Documents fully scored
+  }; // struct QueryStats
+
+  enum class Retrieval {
+    exhaustive,     // Score every posting
+    block_max_wand, // Skip postings that cannot reach the top k
+  }; // enum class Retrieval
+
+  static constexpr uint32_t magic   = 0x49505250; // "PRPI"
+  static constexpr uint16_t version = 1;
+
+  PostingIndex() noexcept = default;
+
+  /**
+   * @brief Validate serialized bytes and view them.
+   *
+   * @param data The start of the serialized index. Must be 8-byte aligned.
+   * @param size The number of bytes available.
+   * @return The view, or `StatusCode::invalid_argument` if the bytes are not a valid index.
+   */
+  static Result<PostingIndex> open(const void* data, size_t size) noexcept;
+
+  /**
+   * @brief Find the `k` documents with the highest scores for some terms.
+   *
+   * @param terms The query's term ids. Unknown and repeated terms are ignored.
+   * @param k The number of results.
+   * @param retrieval The algorithm, which changes only the work done.
+   * @param stats Receives the query's counters, if not nullptr.
+   * @return Up to `k` hits, best first, ties by document id.
+   */
+  std::vector<Hit> top_k(const std::vector<uint32_t>& terms, size_t k,
+      Retrieval retrieval = Retrieval::block_max_wand, QueryStats* stats = nullptr) const;
+
+  /**
+   * @brief Get the number of documents containing a term.
+   */
+  uint32_t document_frequency(uint32_t term) const noexcept {
+    return term < terms() ? term_entries[term].postings : 0;
+  }
+
+  /**
+   * @brief Get the number of term ids.
+   */
+  uint32_t terms() const noexcept { return header != nullptr ? header->terms : 0; }
+
+  /**
+   * @brief Get the number of documents.
+   */
+  uint32_t size() const noexcept { return header != nullptr ? header->docs : 0; }
+
+  /**
+   * @brief Get the size of the serialized index in bytes.
+   */
+  size_t bytes() const noexcept { return total; }
+
+private:
+  const Header* header{nullptr};
+  const Term* term_entries{nullptr};
+  const Block* blocks{nullptr};
+  const uint32_t* docs{nullptr};
+  const float* scores{nullptr};
+  size_t total{0};
+}; // class PostingIndex
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class PublishBatch
+ * @brief Makes a set of new files durable and visible under their final names.
+ *
+ * Each file is created under a temporary name next to its final path and written by the caller.
+ * `commit()` then makes the whole batch durable with as few barriers as possible:
+ *
+ * 1. Write-back of every file is started with `sync_file_range()` so the device sees all of the
+ *    data at once rather than one file per `fsync()`.
+ * 2. Each file is flushed with `fsync()`.
+ * 3. Each file is renamed to its final name. `renameat2(RENAME_NOREPLACE)` is used where
+ *    available so an existing file is never clobbered; otherwise `link()` + `unlink()` gives the
+ *    same guarantee.
+ * 4. Every distinct parent directory is flushed once, making all of the renames durable.
+ *
+ * A batch that is destroyed without being committed removes its temporary files. If `commit()`
+ * fails part way, files already renamed stay published and the remaining temporaries are removed.
+ */
+class PublishBatch {
+public:
+  /**
+   * @brief Publish options.
+   */
+  struct Options {
+    bool sync_ahead = true; // Start write-back of all files before flushing any of them
+    bool no_replace = true; // Fail with `StatusCode::eexist` instead of replacing a final path
+    mode_t mode     = File::default_mode;
+  }; // struct Options
+
+  PublishBatch() noexcept : PublishBatch(Options{}) {}
+
+  explicit PublishBatch(Options options) noexcept : options(options) {}
+
+  PublishBatch(const PublishBatch&)            = delete;
+  PublishBatch& operator=(const PublishBatch&) = delete;
+
+  /**
+   * @brief Destructor.
+   *
+   * Aborts the batch if it has not been committed.
+   */
+  ~PublishBatch() { abort(); }
+
+  /**
+   * @brief Create a new file that will be published as `final_path`.
+   *
+   * The file is opened for writing under a unique temporary name in the same directory. The
+   * returned pointer is owned by the batch and stays valid until `commit()` or `abort()`.
+   *
+   * @param final_path The path the file will have once published.
+   * @return The file, or the error status.
+   */
+  Result<File*> create(std::string_view final_path);
+
+  /**
+   * @brief Make all files durable and rename them to their final paths.
+   *
+   * @return `StatusCode::ok` on success, otherwise the first error encountered.
+   */
+  StatusCode commit();
+
+  /**
+   * @brief Close and remove all files that have not been published.
+   */
+  void abort() noexcept;
+
+  /**
+   * @brief Get the number of files waiting to be published.
+   */
+  size_t size() const noexcept { return pending.size(); }
+
+private:
+  struct Pending {
+    File file;
+    std::string temp_path;
+    std::string final_path;
+  }; // struct Pending
+
+  Options options;
+  std::vector<std::unique_ptr<Pending>> pending;
+  uint64_t sequence{0};
+
+  StatusCode rename_one(const Pending& entry) noexcept;
+}; // class PublishBatch
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief The representation of the values of one 2^16 chunk of a Roaring bitmap.
+ */
+enum class RoaringContainerType : uint8_t {
+  array  = 1, // Sorted 16-bit values, for up to 4096 values
+  bitmap = 2, // 2^16 bits
+  run    = 3, // Sorted (start, length - 1) pairs
+}; // enum class RoaringContainerType
+
+/**
+ * @brief A read-only reference to one container, either owned by a `RoaringBitmap` or in mapped
+ * bytes viewed by a `RoaringView`.
+ */
+struct RoaringContainer {
+  RoaringContainerType type{RoaringContainerType::array};
+  uint32_t cardinality{0};         // Number of values
+  uint32_t size{0};                // Number of array values or runs
+  const uint16_t* values{nullptr}; // Array values or run pairs
+  const uint64_t* words{nullptr};  // Bitmap words
+
+  bool contains(uint16_t value) const noexcept;
+}; // struct RoaringContainer
+
+/**
+ * @brief A container owned by a `RoaringBitmap`.
+ */
+struct RoaringOwnedContainer {
+  RoaringContainerType type{RoaringContainerType::array};
+  uint32_t cardinality{0};
+  std::vector<uint16_t> values; // Array values or run pairs
+  std::vector<uint64_t> words;  // Bitmap words
+
+  RoaringContainer ref() const noexcept {
+    const auto size = static_cast<uint32_t>(
+        type == RoaringContainerType::run ? values.size() / 2 : values.size());
+    return {type, cardinality, size, values.data(), words.data()};
+  }
+}; // struct RoaringOwnedContainer
+
+namespace detail {
+
+// Words in a bitmap container
+constexpr size_t roaring_bitmap_words = 1024;
+
+// Largest cardinality stored as an array
+constexpr uint32_t roaring_max_array = 4096;
+
+// Container kernels. The SIMD versions are selected by the build's instruction set switches.
+void roaring_and(const RoaringContainer& a, const RoaringContainer& b, RoaringOwnedContainer& out);
+void roaring_or(const RoaringContainer& a, const RoaringContainer& b, RoaringOwnedContainer& out);
+void roaring_andnot(
+    const RoaringContainer& a, const RoaringContainer& b, RoaringOwnedContainer& out);
+void roaring_copy(const RoaringContainer& a, RoaringOwnedContainer& out);
+uint32_t roaring_and_cardinality(const RoaringContainer& a, const RoaringContainer& b) noexcept;
+void roaring_append_values(const RoaringContainer& c, uint16_t key, std::vector<uint32_t>& out);
+
+} // namespace detail
+
+/**
+ * @class RoaringBitmap
+ * @brief A compressed set of 32-bit integers that can be serialized for in-place use.
+ *
+ * Values are split by their high 16 bits into containers, each stored as a sorted array, a 2^16
+ * bitmap or a list of runs, whichever is smallest. `serialize()` produces the format read by
+ * `RoaringView`. Results of set operations are returned as `RoaringBitmap`s.
+ */
+class RoaringBitmap {
+  std::vector<uint16_t> keys;
+  std::vector<RoaringOwnedContainer> containers;
+
+public:
+  RoaringBitmap() = default;
+
+  /**
+   * @brief Build a bitmap from values in any order.
+   */
+  static RoaringBitmap from_values(std::vector<uint32_t> values);
+
+  /**
+   * @brief Add a value.
+   *
+   * Adding values in increasing order is fastest.
+   */
+  void add(uint32_t value);
+
+  /**
+   * @brief Add the values in `[first, last)`.
+   */
+  void add_range(uint64_t first, uint64_t last);
+
+  /**
+   * @brief Convert every container to its smallest representation, e.g. runs for ranges.
+   */
+  void optimize();
+
+  /**
+   * @brief Check if `value` is in the set.
+   */
+  bool contains(uint32_t value) const noexcept;
+
+  /**
+   * @brief Get the number of values in the set.
+   */
+  uint64_t cardinality() const noexcept;
+
+  /**
+   * @brief Get the number of containers.
+   */
+  size_t container_count() const noexcept { return containers.size(); }
+
+  /**
+   * @brief Get the high 16 bits shared by the values of container `i`.
+   */
+  uint16_t key(size_t i) const noexcept { return keys[i]; }
+
+  /**
+   * @brief Get container `i`.
+   */
+  RoaringContainer container(size_t i) const noexcept { return containers[i].ref(); }
+
+  /**
+   * @brief Get the values in increasing order.
+   */
+  std::vector<uint32_t> to_vector() const;
+
+  /**
+   * @brief Serialize the bitmap in the format read by `RoaringView`.
+   */
+  std::string serialize() const;
+
+  /**
+   * @brief Get the size of `serialize()`'s result in bytes.
+   */
+  size_t serialized_size() const noexcept;
+
+  /**
+   * @brief Append a container. Keys must be appended in increasing order.
+   */
+  void append(uint16_t key, RoaringOwnedContainer container);
+}; // class RoaringBitmap
+
+/**
+ * @class RoaringView
+ * @brief A Roaring bitmap read in place from serialized bytes, e.g. inside an `MmapFile`.
+ *
+ * `open()` validates the directory once; lookups and set operations then read the containers
+ * straight from the bytes without deserializing them. The bytes must stay valid and unchanged
+ * while the view is used, and must be 8-byte aligned.
+ *
+ * The format is, in native (little-endian) byte order:
+ *
+ * - A 24-byte header: magic `PRRB`, version, container count and total cardinality.
+ * - A directory of 16-byte entries sorted by key: key, type, value or run count, cardinality and
+ *   the payload offset.
+ * - The payloads, each 8-byte aligned: arrays of 16-bit values, 1024 64-bit bitmap words, or
+ *   16-bit (start, length - 1) run pairs.
+ */
+class RoaringView {
+public:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t container_count;
+    uint32_t reserved;
+    uint64_t cardinality;
+  }; // struct Header
+
+  struct Entry {
+    uint16_t key;
+    uint8_t type;
+    uint8_t reserved;
+    uint32_t size;        // Array values or runs
+    uint32_t cardinality; // Values in the container
+    uint32_t offset;      // Payload offset from the start of the header
+  }; // struct Entry
+
+  static constexpr uint32_t magic   = 0x42525250; // "PRRB"
+  static constexpr uint16_t version = 1;
+
+  RoaringView() noexcept = default;
+
+  /**
+   * @brief Validate serialized bytes and view them.
+   *
+   * @param data The start of the serialized bitmap. Must be 8-byte aligned.
+   * @param size The number of bytes available.
+   * @return The view, or `StatusCode::invalid_argument` if the bytes are not a valid bitmap.
+   */
+  static Result<RoaringView> open(const void* data, size_t size) noexcept;
+
+  /**
+   * @brief Check if `value` is in the set.
+   */
+  bool contains(uint32_t value) const noexcept;
+
+  /**
+   * @brief Get the number of values in the set.
+   */
+  uint64_t cardinality() const noexcept { return header != nullptr ? header->cardinality : 0; }
+
+  /**
+   * @brief Get the number of containers.
+   */
+  size_t container_count() const noexcept {
+    return header != nullptr ? header->container_count : 0;
+  }
+
+  /**
+   * @brief Get the high 16 bits shared by the values of container `i`.
+   */
+  uint16_t key(size_t i) const noexcept { return entries[i].key; }
+
+  /**
+   * @brief Get container `i`.
+   */
+  RoaringContainer container(size_t i) const noexcept;
+
+  /**
+   * @brief Get the size of the serialized bitmap in bytes.
+   */
+  size_t size() const noexcept { return bytes; }
+
+  /**
+   * @brief Get the values in increasing order.
+   */
+  std::vector<uint32_t> to_vector() const;
+
+private:
+  const Header* header{nullptr};
+  const Entry* entries{nullptr};
+  size_t bytes{0};
+}; // class RoaringView
+
+// Merge the containers of two bitmaps by key. `keep_left` and `keep_right` say whether a
+// container present on one side only belongs to the result.
+template <typename L, typename R, typename Op>
+RoaringBitmap roaring_merge(const L& a, const R& b, bool keep_left, bool keep_right, Op op) {
+  RoaringBitmap result;
+  size_t i = 0, j = 0;
+  const size_t na = a.container_count(), nb = b.container_count();
+  while(i < na || j < nb) {
+    RoaringOwnedContainer out;
+    uint16_t key;
+    if(j == nb || (i < na && a.key(i) < b.key(j))) {
+      key = a.key(i);
+      if(!keep_left) {
+        ++i;
+        continue;
+      }
+      detail::roaring_copy(a.container(i++), out);
+    } else if(i == na || b.key(j) < a.key(i)) {
+      key = b.key(j);
+      if(!keep_right) {
+        ++j;
+        continue;
+      }
+      detail::roaring_copy(b.container(j++), out);
+    } else {
+      key = a.key(i);
+      op(a.container(i++), b.container(j++), out);
+    }
+    if(out.cardinality != 0) result.append(key, std::move(out));
+  }
+  return result;
+}
+
+/**
+ * @brief Intersect two bitmaps. Either side may be a `RoaringBitmap` or a `RoaringView`.
+ */
+template <typename L, typename R>
+RoaringBitmap roaring_and(const L& a, const R& b) {
+  return roaring_merge(a, b, false, false, detail::roaring_and);
+}
+
+/**
+ * @brief Unite two bitmaps. Either side may be a `RoaringBitmap` or a `RoaringView`.
+ */
+template <typename L, typename R>
+RoaringBitmap roaring_or(const L& a, const R& b) {
+  return roaring_merge(a, b, true, true, detail::roaring_or);
+}
+
+/**
+ * @brief Get the values of `a` that are not in `b`. Either side may be a `RoaringBitmap` or a
+ * `RoaringView`.
+ */
+template <typename L, typename R>
+RoaringBitmap roaring_andnot(const L& a, const R& b) {
+  return roaring_merge(a, b, true, false, detail::roaring_andnot);
+}
+
+/**
+ * @brief Count the values in both bitmaps without materializing the intersection.
+ */
+template <typename L, typename R>
+uint64_t roaring_and_cardinality(const L& a, const R& b) noexcept {
+  uint64_t count = 0;
+  size_t i = 0, j = 0;
+  const size_t na = a.container_count(), nb = b.container_count();
+  while(i < na && j < nb) {
+    if(a.key(i) < b.key(j)) {
+      ++i;
+    } else if(b.key(j) < a.key(i)) {
+      ++j;
+    } else {
+      count += detail::roaring_and_cardinality(a.container(i++), b.container(j++));
+    }
+  }
+  return count;
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+#include "mmap_file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class SharedRegion
+ * @brief An in-memory file that several processes map to share one physical copy of its data.
+ *
+ * A loader process calls `create()`, writes derived structures through `data()`, and calls
+ * `seal()`. Sealing drops the writable mapping, makes the contents immutable where the platform
+ * supports file seals, and maps the region read-only. The loader then hands `file()` to worker
+ * processes, e.g. with `DescriptorChannel`, and each worker calls `attach()` to map the same pages
+ * read-only with `MAP_SHARED`. No data is copied, and a new worker is ready as soon as it has the
+ * descriptor.
+ *
+ * The region is backed by `memfd_create()` on Linux and by an unlinked temporary file elsewhere.
+ * It lives until the last process closes its descriptor and unmaps it.
+ */
+class SharedRegion {
+  File region_file;
+  MmapFile map;
+  bool writable{false};
+
+public:
+  SharedRegion() noexcept = default;
+
+  SharedRegion(SharedRegion&&) noexcept            = default;
+  SharedRegion& operator=(SharedRegion&&) noexcept = default;
+
+  /**
+   * @brief Create a new writable region.
+   *
+   * @param name A name for diagnostics; it appears in `/proc/<pid>/fd` on Linux.
+   * @param size The size of the region in bytes.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode create(std::string_view name, size_t size);
+
+  /**
+   * @brief Make the region read-only in every process.
+   *
+   * Must be called by the creator once the contents are complete and before the region is shared.
+   *
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode seal() noexcept;
+
+  /**
+   * @brief Map a region created by another process.
+   *
+   * @param file The descriptor of the region. Ownership is taken.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode attach(File file) noexcept;
+
+  /**
+   * @brief Get the start of the mapping. Writable only between `create()` and `seal()`.
+   */
+  void* data() const noexcept { return map.data(); }
+
+  /**
+   * @brief Get the size of the region in bytes.
+   */
+  size_t size() const noexcept { return map.size(); }
+
+  /**
+   * @brief Check if the region is mapped.
+   */
+  bool is_open() const noexcept { return map.is_open(); }
+
+  /**
+   * @brief Get the descriptor of the region, e.g. to send it to another process.
+   */
+  const File& file() const noexcept { return region_file; }
+}; // class SharedRegion
+
+/**
+ * @class DescriptorChannel
+ * @brief A Unix domain socket that carries open file descriptors between processes.
+ *
+ * Each message is a descriptor plus a short tag that tells the receiver what it is, e.g. the name
+ * of the index the region holds. Descriptors are sent with `SCM_RIGHTS`, so the receiver gets its
+ * own descriptor for the same open file.
+ */
+class DescriptorChannel {
+  File socket;
+
+  explicit DescriptorChannel(File socket) noexcept : socket(std::move(socket)) {}
+
+public:
+  // The longest tag that can be sent
+  static constexpr size_t max_tag_size = 255;
+
+  DescriptorChannel() noexcept = default;
+
+  /**
+   * @brief Listen for connections on a socket bound to `path`.
+   *
+   * @param path The file system path of the socket. An existing socket file is replaced.
+   * @param backlog The maximum number of pending connections.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode listen(std::string_view path, int backlog = 16);
+
+  /**
+   * @brief Wait for a connection on a listening channel.
+   *
+   * @return The connected channel, or the error status.
+   */
+  Result<DescriptorChannel> accept() const noexcept;
+
+  /**
+   * @brief Connect to a channel listening on `path`.
+   *
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode connect(std::string_view path);
+
+  /**
+   * @brief Create a pair of connected channels, e.g. before `fork()`.
+   *
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  static StatusCode pair(DescriptorChannel& first, DescriptorChannel& second) noexcept;
+
+  /**
+   * @brief Send a duplicate of `file` with a tag.
+   *
+   * @param file The file to send. It stays open in the sender.
+   * @param tag Up to `max_tag_size` bytes describing the file.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  StatusCode send(const File& file, std::string_view tag) const noexcept;
+
+  /**
+   * @brief Receive a file sent with `send()`.
+   *
+   * @param tag Set to the tag sent with the file.
+   * @return The received file, or the error status. `StatusCode::eproto` if the message carried
+   * no descriptor, and `StatusCode::econnreset` if the peer closed the channel.
+   */
+  Result<File> receive(std::string& tag) const;
+
+  /**
+   * @brief Check if the channel is open.
+   */
+  bool is_open() const noexcept { return socket.is_open(); }
+
+  /**
+   * @brief Close the channel.
+   */
+  StatusCode close() noexcept { return socket.close(); }
+}; // class DescriptorChannel
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "common.hh"
+
+// Instruction sets enabled by the build. The top-level CMakeLists.txt adds -msse4.1, -msse2 or
+// -mfpu=neon when the compiler supports them, and defines PEREGRINE_DISABLE_SIMD otherwise or when
+// DISABLE_SIMD is set. Every kernel keeps a scalar version for PEREGRINE_DISABLE_SIMD builds.
+#if !defined(PEREGRINE_DISABLE_SIMD) && defined(__SSE4_1__)
+#define PEREGRINE_SIMD_SSE41 1
+#define PEREGRINE_SIMD_SSE2  1
+#include <smmintrin.h>
+#elif !defined(PEREGRINE_DISABLE_SIMD) && defined(__SSE2__)
+#define PEREGRINE_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif !defined(PEREGRINE_DISABLE_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define PEREGRINE_SIMD_NEON 1
+#include <arm_neon.h>
+#endif // !defined(PEREGRINE_DISABLE_SIMD) && defined(__SSE4_1__)
+
+// BMI2 is enabled separately with ENABLE_BMI2
+#if !defined(PEREGRINE_DISABLE_SIMD) && defined(__BMI2__)
+#define PEREGRINE_SIMD_BMI2 1
+#include <immintrin.h>
+#endif // !defined(PEREGRINE_DISABLE_SIMD) && defined(__BMI2__)
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief Count the set bits of a word.
+ */
+PEREGRINE_FORCE_INLINE uint32_t popcount64(uint64_t word) noexcept {
+  return static_cast<uint32_t>(__builtin_popcountll(word));
+}
+
+/**
+ * @brief Get the position of the set bit of `word` with `rank` set bits below it.
+ *
+ * `rank` must be less than the number of set bits. With BMI2 this is one `pdep`; otherwise whole
+ * bytes are skipped by their popcount before the final byte is scanned.
+ */
+PEREGRINE_FORCE_INLINE uint32_t select64(uint64_t word, uint32_t rank) noexcept {
+#if defined(PEREGRINE_SIMD_BMI2)
+  return static_cast<uint32_t>(__builtin_ctzll(_pdep_u64(uint64_t{1} << rank, word)));
+#else
+  uint32_t shift = 0;
+  for(;; shift += 8) {
+    const uint32_t count = popcount64((word >> shift) & 0xff);
+    if(rank < count) break;
+    rank -= count;
+  }
+  uint64_t byte = (word >> shift) & 0xff;
+  for(; rank != 0; --rank) byte &= byte - 1;
+  return shift + static_cast<uint32_t>(__builtin_ctzll(byte));
+#endif // defined(PEREGRINE_SIMD_BMI2)
+}
+
+/**
+ * @brief Count the set bits of `count` words.
+ *
+ * With SSE4.1 this uses the nibble lookup table popcount on 128-bit lanes, which beats the scalar
+ * fallback when the build does not enable the `popcnt` instruction.
+ */
+inline uint64_t popcount_words(const uint64_t* words, size_t count) noexcept {
+  size_t i       = 0;
+  uint64_t total = 0;
+#if defined(PEREGRINE_SIMD_SSE41)
+  const __m128i lookup = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i low    = _mm_set1_epi8(0x0f);
+  __m128i sums         = _mm_setzero_si128();
+  for(; i + 2 <= count; i += 2) {
+    const __m128i v   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+    const __m128i lo  = _mm_shuffle_epi8(lookup, _mm_and_si128(v, low));
+    const __m128i hi  = _mm_shuffle_epi8(lookup, _mm_and_si128(_mm_srli_epi16(v, 4), low));
+    const __m128i cnt = _mm_add_epi8(lo, hi);
+    sums              = _mm_add_epi64(sums, _mm_sad_epu8(cnt, _mm_setzero_si128()));
+  }
+  total = static_cast<uint64_t>(_mm_cvtsi128_si64(sums)) +
+          static_cast<uint64_t>(_mm_extract_epi64(sums, 1));
+#elif defined(PEREGRINE_SIMD_NEON)
+  uint64x2_t sums = vdupq_n_u64(0);
+  for(; i + 2 <= count; i += 2) {
+    const uint8x16_t cnt = vcntq_u8(vreinterpretq_u8_u64(vld1q_u64(words + i)));
+    sums                 = vaddq_u64(sums, vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(cnt))));
+  }
+  total = vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1);
+#endif // defined(PEREGRINE_SIMD_SSE41)
+  for(; i < count; ++i) total += popcount64(words[i]);
+  return total;
+}
+
+/**
+ * @brief Get the index of the first byte that differs between `a` and `b`, or `size` if the
+ * first `size` bytes are equal.
+ *
+ * Compares 16 bytes per step with SSE2 or NEON, which finds the end of long shared prefixes, such
+ * as those of URL-like keys, several times faster than a byte loop.
+ */
+inline size_t mismatch(const void* a, const void* b, size_t size) noexcept {
+  const auto* x = static_cast<const unsigned char*>(a);
+  const auto* y = static_cast<const unsigned char*>(b);
+  size_t i      = 0;
+#if defined(PEREGRINE_SIMD_SSE2)
+  for(; i + 16 <= size; i += 16) {
+    const __m128i u  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+    const __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+    const auto equal = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(u, v)));
+    if(equal != 0xffff) return i + static_cast<size_t>(__builtin_ctz(~equal));
+  }
+#elif defined(PEREGRINE_SIMD_NEON)
+  for(; i + 16 <= size; i += 16) {
+    const uint8x16_t equal = vceqq_u8(vld1q_u8(x + i), vld1q_u8(y + i));
+    // Narrow each byte's result to 4 bits so the lanes fit in one 64-bit word
+    const uint64_t bits =
+        vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(equal), 4)), 0);
+    if(bits != ~uint64_t{0}) return i + static_cast<size_t>(__builtin_ctzll(~bits)) / 4;
+  }
+#endif // defined(PEREGRINE_SIMD_SSE2)
+  for(; i + 8 <= size; i += 8) {
+    uint64_t u, v;
+    std::memcpy(&u, x + i, 8);
+    std::memcpy(&v, y + i, 8);
+    if(u != v) return i + static_cast<size_t>(__builtin_ctzll(u ^ v)) / 8;
+  }
+  for(; i < size && x[i] == y[i]; ++i) {}
+  return i;
+}
+
+/**
+ * @brief Compare byte strings like `std::string_view::compare()`, using `mismatch()`.
+ */
+inline int compare_bytes(std::string_view a, std::string_view b) noexcept {
+  const size_t size = a.size() < b.size() ? a.size() : b.size();
+  const size_t i    = mismatch(a.data(), b.data(), size);
+  if(i < size) {
+    return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[i]) ? -1 : 1;
+  }
+  return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+/**
+ * @brief Get the squared Euclidean distance between two float vectors.
+ *
+ * Eight lanes per step with SSE2 or NEON, in two independent accumulators.
+ */
+inline float l2_squared(const float* a, const float* b, size_t size) noexcept {
+  size_t i  = 0;
+  float sum = 0.0f;
+#if defined(PEREGRINE_SIMD_SSE2)
+  __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+  for(; i + 8 <= size; i += 8) {
+    const __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    const __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+    s0              = _mm_add_ps(s0, _mm_mul_ps(d0, d0));
+    s1              = _mm_add_ps(s1, _mm_mul_ps(d1, d1));
+  }
+  s0 = _mm_add_ps(s0, s1);
+  s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+  s0 = _mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1));
+  sum = _mm_cvtss_f32(s0);
+#elif defined(PEREGRINE_SIMD_NEON)
+  float32x4_t s0 = vdupq_n_f32(0.0f), s1 = vdupq_n_f32(0.0f);
+  for(; i + 8 <= size; i += 8) {
+    const float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+    const float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    s0                   = vmlaq_f32(s0, d0, d0);
+    s1                   = vmlaq_f32(s1, d1, d1);
+  }
+  s0  = vaddq_f32(s0, s1);
+  sum = vgetq_lane_f32(s0, 0) + vgetq_lane_f32(s0, 1) + vgetq_lane_f32(s0, 2) +
+        vgetq_lane_f32(s0, 3);
+#endif // defined(PEREGRINE_SIMD_SSE2)
+  for(; i < size; ++i) {
+    const float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+/**
+ * @brief Get the inner product of two float vectors.
+ */
+inline float dot_product(const float* a, const float* b, size_t size) noexcept {
+  size_t i  = 0;
+  float sum = 0.0f;
+#if defined(PEREGRINE_SIMD_SSE2)
+  __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+  for(; i + 8 <= size; i += 8) {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+  s0 = _mm_add_ps(s0, s1);
+  s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+  s0 = _mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1));
+  sum = _mm_cvtss_f32(s0);
+#elif defined(PEREGRINE_SIMD_NEON)
+  float32x4_t s0 = vdupq_n_f32(0.0f), s1 = vdupq_n_f32(0.0f);
+  for(; i + 8 <= size; i += 8) {
+    s0 = vmlaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+    s1 = vmlaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  s0  = vaddq_f32(s0, s1);
+  sum = vgetq_lane_f32(s0, 0) + vgetq_lane_f32(s0, 1) + vgetq_lane_f32(s0, 2) +
+        vgetq_lane_f32(s0, 3);
+#endif // defined(PEREGRINE_SIMD_SSE2)
+  for(; i < size; ++i) sum += a[i] * b[i];
+  return sum;
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+#include "io_pool.hh"
+#include "key_block.hh"
+#include "mmap_file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @class SortedWriter
+ * @brief Writes sorted keys and their values as a file of `KeyBlock`s, read by `SortedFile`.
+ */
+class SortedWriter {
+public:
+  struct Options {
+    size_t block_size         = 32 * 1024; // Target serialized bytes per block
+    uint32_t restart_interval = 16;        // Keys per restart point in each block
+  }; // struct Options
+
+  SortedWriter() noexcept = default;
+
+  explicit SortedWriter(Options options) noexcept :
+      options(options), builder(options.restart_interval) {}
+
+  SortedWriter(const SortedWriter&)            = delete;
+  SortedWriter& operator=(const SortedWriter&) = delete;
+
+  /**
+   * @brief Destructor. Closes the file.
+   */
+  ~SortedWriter();
+
+  /**
+   * @brief Create or truncate a file.
+   */
+  StatusCode open(std::string_view path, int flags = 0, mode_t mode = File::default_mode);
+
+  /**
+   * @brief Append a key and its value.
+   *
+   * @return `StatusCode::invalid_argument` if `key` is not greater than the previous key.
+   */
+  StatusCode add(std::string_view key, std::string_view value);
+
+  /**
+   * @brief Write the last block and the block index, then close the file.
+   */
+  StatusCode close();
+
+private:
+  StatusCode flush_block();
+  StatusCode write(const void* data, size_t size);
+
+  File file;
+  Options options;
+  KeyBlockBuilder builder;
+  KeyBlockBuilder index;
+  std::string last;
+  uint64_t end{0};
+  uint64_t blocks{0};
+}; // class SortedWriter
+
+/**
+ * @class SortedFile
+ * @brief Ordered scans and seeks over a file written by `SortedWriter`.
+ *
+ * Iterators walk the keys forward or backward, one block at a time, and read ahead once they see
+ * sequential access: after `ScanOptions::sequential_blocks` steps to adjacent blocks in one
+ * direction they request a window of blocks ahead of the cursor, doubling it with every window up
+ * to `ScanOptions::max_window` like the kernel's own readahead. How a window is requested depends
+ * on how the file is read:
+ *
+ * - Mapped files get `MADV_WILLNEED` on the window, which starts reading it without blocking.
+ * - With an `AsyncReader`, windows are read into a second buffer on the I/O pool while the cursor
+ *   works through the first, so a sequential scan rarely waits on the device.
+ * - Otherwise windows are hinted with `POSIX_FADV_WILLNEED` and read with one `pread()` each.
+ *
+ * A seek elsewhere resets the window. Bulk scans set `ScanOptions::drop_behind` to release the
+ * pages behind the cursor with `MADV_DONTNEED` and `POSIX_FADV_DONTNEED`, so a scan of a large
+ * file does not evict the working set of other readers.
+ *
+ * The file is the data blocks, each 8-byte aligned, then an index block mapping the last key of
+ * every data block to its 16-byte `IndexEntry`, then a 32-byte footer: magic `PRSF`, version,
+ * block count and the index offset and size.
+ */
+class SortedFile {
+public:
+  struct Options {
+    bool use_mmap       = true;    // Read blocks in place from a mapping instead of `pread()`
+    AsyncReader* reader = nullptr; // Reads windows in the background when not mapped
+  }; // struct Options
+
+  struct ScanOptions {
+    size_t sequential_blocks = 2;          // Adjacent block steps before reading ahead
+    size_t initial_window    = 128 * 1024; // Bytes of the first readahead window
+    size_t max_window        = 4 << 20;    // Bytes the window doubles up to
+    bool drop_behind         = false;      // Release the pages of scanned blocks
+  }; // struct ScanOptions
+
+  /**
+   * @brief Counters of an iterator.
+   */
+  struct ScanStats {
+    uint64_t blocks{0};            // Blocks decoded
+    uint64_t reads{0};             // Blocks or windows read on the calling thread
+    uint64_t readahead_windows{0}; // Windows requested ahead of the cursor
+    uint64_t readahead_bytes{0};   // Bytes in those windows
+    uint64_t dropped_bytes{0};     // Bytes released behind the cursor
+  }; // struct ScanStats
+
+  struct Footer {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t block_count;
+    uint64_t index_offset;
+    uint64_t index_size;
+  }; // struct Footer
+
+  struct IndexEntry {
+    uint64_t offset;
+    uint64_t size;
+  }; // struct IndexEntry
+
+  static constexpr uint32_t magic   = 0x46535250; // "PRSF"
+  static constexpr uint16_t version = 1;
+
+  /**
+   * @class Iterator
+   * @brief A cursor over the keys of a `SortedFile`.
+   *
+   * Keys and values stay valid until the cursor moves to another block. An iterator must not
+   * outlive its file and is not safe to share between threads; use one per thread.
+   */
+  class Iterator {
+  public:
+    Iterator(Iterator&&) noexcept            = default;
+    Iterator& operator=(Iterator&&) noexcept = delete;
+
+    /**
+     * @brief Destructor. Waits for a background read into the iterator's buffers.
+     */
+    ~Iterator();
+
+    /**
+     * @brief Check if the iterator is at an entry.
+     */
+    bool valid() const noexcept { return position < entries.size(); }
+
+    /**
+     * @brief Get the error that ended the iteration, or `StatusCode::ok`.
+     */
+    StatusCode status() const noexcept { return error; }
+
+    /**
+     * @brief Get the key of the current entry.
+     */
+    std::string_view key() const noexcept {
+      const Entry& e = entries[position];
+      return std::string_view(keys.data() + e.key_offset, e.key_size);
+    }
+
+    /**
+     * @brief Get the value of the current entry.
+     */
+    std::string_view value() const noexcept { return entries[position].value; }
+
+    /**
+     * @brief Move to the first entry.
+     */
+    void seek_to_first();
+
+    /**
+     * @brief Move to the last entry.
+     */
+    void seek_to_last();
+
+    /**
+     * @brief Move to the first entry with a key not less than `key`.
+     */
+    void seek(std::string_view key);
+
+    /**
+     * @brief Move to the next entry. The iterator must be valid.
+     */
+    void next();
+
+    /**
+     * @brief Move to the previous entry. The iterator must be valid.
+     */
+    void prev();
+
+    /**
+     * @brief Get the iterator's counters.
+     */
+    const ScanStats& stats() const noexcept { return counters; }
+
+  private:
+    friend class SortedFile;
+
+    struct Entry {
+      uint32_t key_offset;
+      uint32_t key_size;
+      std::string_view value;
+    }; // struct Entry
+
+    // A range of blocks read into memory, possibly still in flight
+    struct Window {
+      size_t first{0};
+      size_t last{0};
+      std::vector<uint64_t> buffer;
+      std::future<Result<ssize_t>> pending;
+
+      bool contains(size_t block) const noexcept { return block >= first && block < last; }
+    }; // struct Window
+
+    Iterator(const SortedFile& file, ScanOptions options) noexcept;
+
+    bool load(size_t block);
+    Result<const char*> locate(size_t block);
+    StatusCode finish(Window& window);
+    void track(size_t block) noexcept;
+    void read_ahead(size_t block);
+    void drop_behind(size_t block) noexcept;
+    std::pair<size_t, size_t> window_blocks(size_t block, int step) const noexcept;
+    void fail(StatusCode status) noexcept;
+
+    const SortedFile* file;
+    ScanOptions options;
+    ScanStats counters;
+    StatusCode error{StatusCode::ok};
+
+    // The decoded entries of the current block
+    size_t current_block{0};
+    std::vector<Entry> entries;
+    std::string keys;
+    size_t position{0};
+
+    // Sequential access detection
+    size_t last_block{SIZE_MAX};
+    int direction{0};
+    size_t run{0};
+    size_t window{0};
+    size_t ahead{0};       // Readahead has covered blocks up to (or down from) here
+    uint64_t drop_mark{0}; // Pages behind this offset, in the scan direction, are dropped
+
+    // Windows read with `pread()`
+    Window current;
+    Window next_window;
+  }; // class Iterator
+
+  SortedFile() noexcept = default;
+
+  explicit SortedFile(Options options) noexcept : options(options) {}
+
+  SortedFile(const SortedFile&)            = delete;
+  SortedFile& operator=(const SortedFile&) = delete;
+
+  /**
+   * @brief Open a sorted file and read its index.
+   *
+   * @return `StatusCode::invalid_argument` if the file is not a sorted file.
+   */
+  StatusCode open(std::string_view path);
+
+  /**
+   * @brief Get an iterator, not yet at an entry. Call one of the seek functions first.
+   */
+  Iterator scan(ScanOptions options) const noexcept { return Iterator(*this, options); }
+
+  Iterator scan() const noexcept { return scan(ScanOptions{}); }
+
+  /**
+   * @brief Get the number of data blocks.
+   */
+  size_t block_count() const noexcept { return index.size(); }
+
+  /**
+   * @brief Check if blocks are read from a mapping.
+   */
+  bool mapped() const noexcept { return map.is_open(); }
+
+private:
+  File file;
+  MmapFile map;
+  Options options;
+  std::vector<IndexEntry> index;
+  std::vector<std::string> last_keys; // The last key of each block
+}; // class SortedFile
+
+} // namespace internal
+} // namespace peregrine
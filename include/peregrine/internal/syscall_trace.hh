@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "../status_code.hh"
+#include "common.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief One traced system call.
+ */
+struct SyscallTraceEvent {
+  static constexpr size_t max_args = 4;
+
+  const char* name{nullptr}; // Name of the system call
+  uint64_t start_ns{0};      // Start time on the steady clock
+  uint64_t duration_ns{0};   // Time spent in the call
+  int64_t result{0};         // Return value; pointers are converted to integers
+  uint32_t thread_id{0};     // The thread that made the call
+  uint16_t error{0};         // `errno` if the call returned -1, otherwise zero
+  uint8_t arg_count{0};      // Number of integer arguments captured in `args`
+  int64_t args[max_args]{};  // The leading integer arguments, e.g. descriptor, count and offset
+}; // struct SyscallTraceEvent
+
+namespace detail {
+
+/**
+ * @brief A fixed-size ring of trace events written by a single thread.
+ *
+ * The owning thread overwrites the oldest events when the ring is full. Readers copy the ring
+ * concurrently without blocking the writer, seqlock style: slots are atomics, and any slot the
+ * writer may have touched during the copy is discarded.
+ */
+class SyscallTraceBuffer {
+public:
+  static constexpr size_t capacity = 4096;
+
+  // Words per slot: name, start, duration, result, thread/errno/argc, args
+  static constexpr size_t slot_words = 5 + SyscallTraceEvent::max_args;
+
+  std::atomic<bool> in_use{true};
+  uint32_t thread_id{0};
+
+  void push(const SyscallTraceEvent& event) noexcept;
+
+  // Append a copy of the events recorded at or after `since_ns` to `events`.
+  void copy(std::vector<SyscallTraceEvent>& events, uint64_t since_ns) const;
+
+private:
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> slots[capacity][slot_words]{};
+}; // class SyscallTraceBuffer
+
+} // namespace detail
+
+/**
+ * @class SyscallTracer
+ * @brief Process-wide recorder of system calls for offline profiling.
+ *
+ * When the library is built with `PEREGRINE_TRACE_SYSTEM_CALLS` (`-DENABLE_SYSCALL_TRACE=ON`),
+ * every call made through the `PEREGRINE_MOCK_SYSTEM_CALL` layer is timed and recorded while the
+ * tracer is enabled. Each thread writes into its own lock-free ring buffer, so tracing adds no
+ * contention; a disabled tracer costs one relaxed load per call. The recorded events can be
+ * exported in the Chrome trace event format, which is read by `chrome://tracing` and Perfetto.
+ *
+ * Each thread keeps only its most recent `detail::SyscallTraceBuffer::capacity` events.
+ */
+class SyscallTracer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Check if system calls are being recorded.
+   */
+  static bool is_enabled() noexcept { return enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Start recording system calls.
+   */
+  static void enable() noexcept { enabled.store(true, std::memory_order_relaxed); }
+
+  /**
+   * @brief Stop recording system calls. Events already recorded are kept.
+   */
+  static void disable() noexcept { enabled.store(false, std::memory_order_relaxed); }
+
+  /**
+   * @brief Discard all events recorded so far.
+   */
+  static void clear() noexcept;
+
+  /**
+   * @brief Record an event for the calling thread.
+   */
+  static void record(SyscallTraceEvent event) noexcept;
+
+  /**
+   * @brief Get a copy of the recorded events of all threads, ordered by start time.
+   */
+  static std::vector<SyscallTraceEvent> events();
+
+  /**
+   * @brief Format events in the Chrome trace event JSON format.
+   */
+  static std::string to_chrome_trace(const std::vector<SyscallTraceEvent>& events);
+
+  /**
+   * @brief Write the recorded events to `path` in the Chrome trace event JSON format.
+   *
+   * The system calls made while writing the trace are not recorded.
+   *
+   * @param path The path of the output file. It is created or truncated.
+   * @return `StatusCode::ok` on success, otherwise an error code.
+   */
+  static StatusCode export_chrome_trace(std::string_view path);
+
+  /**
+   * @brief Get the current time on the trace clock in nanoseconds.
+   */
+  static uint64_t now() noexcept {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch())
+            .count());
+  }
+
+private:
+  static std::atomic<bool> enabled;
+}; // class SyscallTracer
+
+/**
+ * @class SyscallTraceScope
+ * @brief Times one system call and records it with `SyscallTracer`.
+ */
+class SyscallTraceScope {
+  SyscallTraceEvent event;
+
+  template <typename T>
+  void capture(const T& arg) noexcept {
+    using type = std::decay_t<T>;
+    if constexpr(std::is_integral_v<type> || std::is_enum_v<type>) {
+      if(event.arg_count < SyscallTraceEvent::max_args)
+        event.args[event.arg_count++] = static_cast<int64_t>(arg);
+    }
+  }
+
+public:
+  template <typename... argTs>
+  SyscallTraceScope(const char* name, const argTs&... args) noexcept {
+    event.name = name;
+    (capture(args), ...);
+    event.start_ns = SyscallTracer::now();
+  }
+
+  /**
+   * @brief Record the call and pass its result through.
+   */
+  template <typename T>
+  T finish(T result) noexcept {
+    event.duration_ns = SyscallTracer::now() - event.start_ns;
+    if constexpr(std::is_pointer_v<T>) {
+      event.result = static_cast<int64_t>(reinterpret_cast<intptr_t>(result));
+    } else {
+      event.result = static_cast<int64_t>(result);
+    }
+    const int saved_errno = errno;
+    if(event.result == -1) event.error = static_cast<uint16_t>(saved_errno);
+    SyscallTracer::record(event);
+    errno = saved_errno;
+    return result;
+  }
+}; // class SyscallTraceScope
+
+} // namespace internal
+} // namespace peregrine
@@ -1,88 +1,272 @@
 #pragma once
 
 #include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <sys/sendfile.h>
+#endif // defined(__linux__)
+
+#if defined(__linux__) && defined(RWF_NOWAIT)
+#define PEREGRINE_HAVE_PREADV2 1
+#endif // defined(__linux__) && defined(RWF_NOWAIT)
+
+#if defined(__linux__) && defined(RENAME_NOREPLACE)
+#define PEREGRINE_HAVE_RENAMEAT2 1
+#endif // defined(__linux__) && defined(RENAME_NOREPLACE)
+
+#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+#define PEREGRINE_HAVE_SYNC_FILE_RANGE 1
+#endif // defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+#define PEREGRINE_HAVE_MEMFD 1
+#endif // defined(__linux__) && defined(MFD_CLOEXEC)
+
+#if defined(__linux__) && defined(POSIX_FADV_DONTNEED)
+#define PEREGRINE_HAVE_POSIX_FADVISE 1
+#endif // defined(__linux__) && defined(POSIX_FADV_DONTNEED)
+
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE) && defined(FALLOC_FL_PUNCH_HOLE)
+#define PEREGRINE_HAVE_FALLOCATE 1
+#endif // defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE) && defined(FALLOC_FL_PUNCH_HOLE)
+
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+#define PEREGRINE_HAVE_SPLICE 1
+#endif // defined(__linux__) && defined(SPLICE_F_MOVE)
+
+// copy_file_range() was added in glibc 2.27
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 27)
+#define PEREGRINE_HAVE_COPY_FILE_RANGE 1
+#endif // defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 27)
+
 #if defined(PEREGRINE_MOCK_SYSTEM_CALLS)
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 #endif // defined(PEREGRINE_MOCK_SYSTEM_CALLS)
 
 #include "../status_code.hh"
 #include "common.hh"
+#include "log.hh"
 #include "type_traits.hh"
 
+#if !defined(PEREGRINE_MOCK_SYSTEM_CALLS) && defined(PEREGRINE_TRACE_SYSTEM_CALLS)
+#include "syscall_trace.hh"
+#endif // !defined(PEREGRINE_MOCK_SYSTEM_CALLS) && defined(PEREGRINE_TRACE_SYSTEM_CALLS)
+
 namespace peregrine {
 namespace internal {
 
 #if defined(PEREGRINE_MOCK_SYSTEM_CALLS)
 
+/**
+ * @brief Faults and delays injected into a mocked system call.
+ *
+ * Used to reproduce slow or flaky devices on an ordinary machine. Each call first sleeps for a
+ * latency drawn from the configured distribution, then may fail with `EAGAIN` or `EINTR` without
+ * reaching the system, and otherwise a positional call may report a short transfer.
+ */
+struct FaultInjection {
+  enum class Latency : uint8_t {
+    none,        // No added latency
+    fixed,       // Always `latency`
+    exponential, // Exponentially distributed with mean `latency`
+    pareto,      // Heavy-tailed Pareto with mean `latency` and shape `pareto_shape`
+  }; // enum class Latency
+
+  Latency distribution{Latency::none};
+  std::chrono::nanoseconds latency{0};
+  std::chrono::nanoseconds max_latency{std::chrono::seconds(1)}; // Cap on any single delay
+  double pareto_shape{1.5}; // Smaller values give a heavier tail; must be greater than one
+
+  double eagain_probability{0.0}; // Fail with EAGAIN
+  double eintr_probability{0.0};  // Fail with EINTR
+
+  // Report fewer bytes than were transferred. Only applies to positional calls (`pread`, `pwrite`,
+  // `preadv`, `pwritev` and `preadv2`), which leave the file offset alone; other calls ignore it.
+  double short_probability{0.0};
+
+  uint64_t seed{0}; // Seed for the per-thread random generators; zero picks one per thread
+}; // struct FaultInjection
+
+namespace detail {
+
+// Uniform random double in [0, 1) from a per-thread generator seeded from `seed`.
+double fault_random(uint64_t seed) noexcept;
+
+// Sleep or spin for a latency drawn from the distribution in `faults`.
+void fault_delay(const FaultInjection& faults) noexcept;
+
+// Whether the system call `name` takes an explicit offset, so a short transfer is safe to report.
+bool positional_call(std::string_view name) noexcept;
+
+} // namespace detail
+
+/**
+ * @class MockSystemCall
+ * @brief Wraps a system call so tests can override its results.
+ *
+ * The next `count` calls can be made to return a canned result with `mock_return_value()`, and
+ * random latency and faults can be injected with `inject()`. All of the call-path state is atomic,
+ * so a mocked call never serializes the threads that use it.
+ */
 template <typename funcT>
 class MockSystemCall {
   using result_t = typename function_traits<funcT>::return_type;
 
   funcT func;
   std::string name;
-  result_t result;
+  bool positional;
+  std::atomic<result_t> result;
   result_t def_result;
-  int return_count{};
-  size_t call_count{};
-  mutable std::mutex mutex{};
+  std::atomic<int> return_count{};
+  std::atomic<size_t> call_count{};
+  std::atomic<size_t> fault_count{};
+
+  // Injection configurations are immutable once published. They are kept until `reset()` so a
+  // concurrent call never sees one freed.
+  std::atomic<const FaultInjection*> faults{nullptr};
+  std::vector<std::unique_ptr<FaultInjection>> fault_configs;
+  std::mutex config_mutex;
+
+  // Take one canned result if any are left
+  bool take_canned() noexcept {
+    int count = return_count.load(std::memory_order_acquire);
+    while(count > 0) {
+      if(return_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+        return true;
+    }
+    return false;
+  }
+
+  template <typename... argTs>
+  result_t call_with_faults(const FaultInjection& config, argTs&&... args) noexcept {
+    detail::fault_delay(config);
+
+    const double u = detail::fault_random(config.seed);
+    if(u < config.eagain_probability + config.eintr_probability) {
+      fault_count.fetch_add(1, std::memory_order_relaxed);
+      errno = u < config.eagain_probability ? EAGAIN : EINTR;
+      return def_result;
+    }
+
+    result_t rc = func(std::forward<argTs>(args)...);
+    if constexpr(std::is_same_v<result_t, ssize_t>) {
+      if(positional && rc > 1 && config.short_probability > 0.0 &&
+          detail::fault_random(config.seed) < config.short_probability) {
+        fault_count.fetch_add(1, std::memory_order_relaxed);
+        const double fraction = detail::fault_random(config.seed);
+        rc = 1 + static_cast<ssize_t>(fraction * static_cast<double>(rc - 1));
+      }
+    }
+    return rc;
+  }
 
 public:
   MockSystemCall(funcT func, result_t result, std::string name) :
-      func{func}, name{std::move(name)}, result{result}, def_result{result} {}
+      func{func}, name{std::move(name)}, positional{detail::positional_call(this->name)},
+      result{result}, def_result{result} {}
 
   template <typename... argTs>
   result_t operator()(argTs&&... args) noexcept {
-    std::lock_guard lock(mutex);
-    ++call_count;
-    if(return_count > 0) {
-      PEREGRINE_LOG_TRACE(
-          "Mock system call name={}, result={}, count={}", name, result, return_count);
-      --return_count;
-      return result;
+    call_count.fetch_add(1, std::memory_order_relaxed);
+    if(PEREGRINE_UNLIKELY(return_count.load(std::memory_order_relaxed) > 0) && take_canned()) {
+      const result_t canned = result.load(std::memory_order_acquire);
+      PEREGRINE_LOG_TRACE("Mock system call name={}, result={}", name, canned);
+      return canned;
+    }
+
+    if(const FaultInjection* config = faults.load(std::memory_order_acquire);
+        PEREGRINE_UNLIKELY(config != nullptr)) {
+      return call_with_faults(*config, std::forward<argTs>(args)...);
     }
 
     return func(std::forward<argTs>(args)...);
   }
 
   void mock_return_value(result_t result, int count) noexcept {
-    std::lock_guard lock(mutex);
-    this->result = result;
-    return_count = count;
+    this->result.store(result, std::memory_order_relaxed);
+    return_count.store(count, std::memory_order_release);
   }
 
   void mock_return_value() noexcept { mock_return_value(def_result, 1); }
 
-  size_t get_call_count() const noexcept {
-    std::lock_guard lock(mutex);
-    return call_count;
+  /**
+   * @brief Inject latency and faults into every following call.
+   */
+  void inject(const FaultInjection& config) {
+    auto copy = std::make_unique<FaultInjection>(config);
+    std::lock_guard lock(config_mutex);
+    faults.store(copy.get(), std::memory_order_release);
+    fault_configs.push_back(std::move(copy));
   }
 
+  /**
+   * @brief Stop injecting latency and faults.
+   */
+  void clear_injection() noexcept { faults.store(nullptr, std::memory_order_release); }
+
+  size_t get_call_count() const noexcept { return call_count.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Get the number of calls that were failed or shortened by fault injection.
+   */
+  size_t get_fault_count() const noexcept { return fault_count.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Restore the default behavior. Must not race with calls.
+   */
   void reset() noexcept {
-    std::lock_guard lock(mutex);
-    result       = def_result;
-    return_count = 0;
-    call_count   = 0;
+    std::lock_guard lock(config_mutex);
+    faults.store(nullptr, std::memory_order_relaxed);
+    fault_configs.clear();
+    result.store(def_result, std::memory_order_relaxed);
+    return_count.store(0, std::memory_order_relaxed);
+    call_count.store(0, std::memory_order_relaxed);
+    fault_count.store(0, std::memory_order_relaxed);
   }
 }; // class MockSystemCall
 
 #define PEREGRINE_MOCK_SYSTEM_CALL(func) extern MockSystemCall<decltype(&func)> func
 
+#elif defined(PEREGRINE_TRACE_SYSTEM_CALLS)
+
+// Record each call with `SyscallTracer` while tracing is enabled.
+#define PEREGRINE_MOCK_SYSTEM_CALL(func)                                                           \
+  template <typename... argTs>                                                                     \
+  PEREGRINE_FORCE_INLINE auto func(argTs&&... args) noexcept                                       \
+      -> decltype(::func(std::forward<argTs>(args)...)) {                                          \
+    if(PEREGRINE_LIKELY(!SyscallTracer::is_enabled())) {                                           \
+      return ::func(std::forward<argTs>(args)...);                                                 \
+    }                                                                                              \
+    SyscallTraceScope scope(#func, args...);                                                       \
+    return scope.finish(::func(std::forward<argTs>(args)...));                                     \
+  }
+
 #else
 
 #define PEREGRINE_MOCK_SYSTEM_CALL(func)                                                           \
   template <typename... argTs>                                                                     \
   PEREGRINE_FORCE_INLINE auto func(argTs&&... args) noexcept                                       \
-      -> decltype(func(std::forward<argTs>(args)...)) {                                            \
-    return func(std::forward<argTs>(args)...);                                                     \
+      -> decltype(::func(std::forward<argTs>(args)...)) {                                          \
+    return ::func(std::forward<argTs>(args)...);                                                   \
   }
 
-#endif // !defined(PEREGRINE_MOCK_SYSTEM_CALLS)
+#endif // defined(PEREGRINE_MOCK_SYSTEM_CALLS)
 
 PEREGRINE_MOCK_SYSTEM_CALL(open);
 PEREGRINE_MOCK_SYSTEM_CALL(close);
@@ -100,7 +284,81 @@ PEREGRINE_MOCK_SYSTEM_CALL(dup);
 PEREGRINE_MOCK_SYSTEM_CALL(fsync);
 PEREGRINE_MOCK_SYSTEM_CALL(mmap);
 PEREGRINE_MOCK_SYSTEM_CALL(munmap);
+PEREGRINE_MOCK_SYSTEM_CALL(madvise);
+PEREGRINE_MOCK_SYSTEM_CALL(mincore);
 PEREGRINE_MOCK_SYSTEM_CALL(fcntl);
+PEREGRINE_MOCK_SYSTEM_CALL(poll);
+PEREGRINE_MOCK_SYSTEM_CALL(rename);
+PEREGRINE_MOCK_SYSTEM_CALL(link);
+PEREGRINE_MOCK_SYSTEM_CALL(unlink);
+PEREGRINE_MOCK_SYSTEM_CALL(readlink);
+PEREGRINE_MOCK_SYSTEM_CALL(ftruncate);
+PEREGRINE_MOCK_SYSTEM_CALL(socket);
+PEREGRINE_MOCK_SYSTEM_CALL(socketpair);
+PEREGRINE_MOCK_SYSTEM_CALL(bind);
+PEREGRINE_MOCK_SYSTEM_CALL(listen);
+PEREGRINE_MOCK_SYSTEM_CALL(accept);
+PEREGRINE_MOCK_SYSTEM_CALL(connect);
+PEREGRINE_MOCK_SYSTEM_CALL(sendmsg);
+PEREGRINE_MOCK_SYSTEM_CALL(recvmsg);
+
+#if defined(__linux__)
+
+PEREGRINE_MOCK_SYSTEM_CALL(inotify_init1);
+PEREGRINE_MOCK_SYSTEM_CALL(inotify_add_watch);
+PEREGRINE_MOCK_SYSTEM_CALL(inotify_rm_watch);
+PEREGRINE_MOCK_SYSTEM_CALL(sendfile);
+PEREGRINE_MOCK_SYSTEM_CALL(accept4);
+
+#endif // defined(__linux__)
+
+#if defined(PEREGRINE_HAVE_PREADV2)
+
+PEREGRINE_MOCK_SYSTEM_CALL(preadv2);
+
+#endif // defined(PEREGRINE_HAVE_PREADV2)
+
+#if defined(PEREGRINE_HAVE_RENAMEAT2)
+
+PEREGRINE_MOCK_SYSTEM_CALL(renameat2);
+
+#endif // defined(PEREGRINE_HAVE_RENAMEAT2)
+
+#if defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+
+PEREGRINE_MOCK_SYSTEM_CALL(sync_file_range);
+
+#endif // defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+
+#if defined(PEREGRINE_HAVE_MEMFD)
+
+PEREGRINE_MOCK_SYSTEM_CALL(memfd_create);
+
+#endif // defined(PEREGRINE_HAVE_MEMFD)
+
+#if defined(PEREGRINE_HAVE_POSIX_FADVISE)
+
+PEREGRINE_MOCK_SYSTEM_CALL(posix_fadvise);
+
+#endif // defined(PEREGRINE_HAVE_POSIX_FADVISE)
+
+#if defined(PEREGRINE_HAVE_FALLOCATE)
+
+PEREGRINE_MOCK_SYSTEM_CALL(fallocate);
+
+#endif // defined(PEREGRINE_HAVE_FALLOCATE)
+
+#if defined(PEREGRINE_HAVE_SPLICE)
+
+PEREGRINE_MOCK_SYSTEM_CALL(splice);
+
+#endif // defined(PEREGRINE_HAVE_SPLICE)
+
+#if defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
+
+PEREGRINE_MOCK_SYSTEM_CALL(copy_file_range);
+
+#endif // defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
 
 #if defined(PEREGRINE_MOCK_SYSTEM_CALLS)
 
@@ -121,9 +379,57 @@ inline void reset_mocks() {
   ::peregrine::internal::pwritev.reset();
   ::peregrine::internal::lseek.reset();
   ::peregrine::internal::dup.reset();
+  ::peregrine::internal::fsync.reset();
   ::peregrine::internal::mmap.reset();
   ::peregrine::internal::munmap.reset();
+  ::peregrine::internal::madvise.reset();
+  ::peregrine::internal::mincore.reset();
   ::peregrine::internal::fcntl.reset();
+  ::peregrine::internal::poll.reset();
+  ::peregrine::internal::rename.reset();
+  ::peregrine::internal::link.reset();
+  ::peregrine::internal::unlink.reset();
+  ::peregrine::internal::readlink.reset();
+  ::peregrine::internal::ftruncate.reset();
+  ::peregrine::internal::socket.reset();
+  ::peregrine::internal::socketpair.reset();
+  ::peregrine::internal::bind.reset();
+  ::peregrine::internal::listen.reset();
+  ::peregrine::internal::accept.reset();
+  ::peregrine::internal::connect.reset();
+  ::peregrine::internal::sendmsg.reset();
+  ::peregrine::internal::recvmsg.reset();
+#if defined(__linux__)
+  ::peregrine::internal::inotify_init1.reset();
+  ::peregrine::internal::inotify_add_watch.reset();
+  ::peregrine::internal::inotify_rm_watch.reset();
+  ::peregrine::internal::sendfile.reset();
+  ::peregrine::internal::accept4.reset();
+#endif // defined(__linux__)
+#if defined(PEREGRINE_HAVE_PREADV2)
+  ::peregrine::internal::preadv2.reset();
+#endif // defined(PEREGRINE_HAVE_PREADV2)
+#if defined(PEREGRINE_HAVE_RENAMEAT2)
+  ::peregrine::internal::renameat2.reset();
+#endif // defined(PEREGRINE_HAVE_RENAMEAT2)
+#if defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+  ::peregrine::internal::sync_file_range.reset();
+#endif // defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+#if defined(PEREGRINE_HAVE_MEMFD)
+  ::peregrine::internal::memfd_create.reset();
+#endif // defined(PEREGRINE_HAVE_MEMFD)
+#if defined(PEREGRINE_HAVE_POSIX_FADVISE)
+  ::peregrine::internal::posix_fadvise.reset();
+#endif // defined(PEREGRINE_HAVE_POSIX_FADVISE)
+#if defined(PEREGRINE_HAVE_FALLOCATE)
+  ::peregrine::internal::fallocate.reset();
+#endif // defined(PEREGRINE_HAVE_FALLOCATE)
+#if defined(PEREGRINE_HAVE_SPLICE)
+  ::peregrine::internal::splice.reset();
+#endif // defined(PEREGRINE_HAVE_SPLICE)
+#if defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
+  ::peregrine::internal::copy_file_range.reset();
+#endif // defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
   ::peregrine::internal::errno_to_status.reset();
 }
 
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../result.hh"
+#include "../status_code.hh"
+#include "common.hh"
+#include "file.hh"
+
+namespace peregrine {
+namespace internal {
+
+/**
+ * @brief How `VectorIndex` compares vectors. Smaller distances are closer.
+ */
+enum class Metric : uint8_t {
+  l2            = 0, // Squared Euclidean distance
+  inner_product = 1, // Negated inner product, e.g. cosine similarity of normalized vectors
+}; // enum class Metric
+
+/**
+ * @class VectorIndex
+ * @brief An approximate nearest neighbour index of float vectors, searched in place from
+ * serialized bytes such as an `MmapFile`.
+ *
+ * The index is an HNSW graph. Every vector is a node with up to `2 * m` links to near neighbours,
+ * and a random, geometrically rarer subset of nodes also appears in upper levels with up to `m`
+ * links each. A search descends greedily from the top level's entry point, then runs a best-first
+ * search of the bottom level that keeps the `ef` closest nodes seen. Larger `ef` finds more of
+ * the true neighbours and visits more nodes, so recall and latency are traded per query. Links
+ * are chosen with the HNSW heuristic, which skips candidates closer to an already chosen link
+ * than to the node, so the graph stays navigable on clustered data.
+ *
+ * Nodes are inserted on several threads, each locking the nodes it links. Distances use the SIMD
+ * `l2_squared()` and `dot_product()` kernels.
+ *
+ * The format is, in native (little-endian) byte order and 8-byte aligned:
+ *
+ * - A 32-byte header: magic `PRVI`, version, metric, top level, dimension, `m`, vector count,
+ *   entry point and the number of upper-level link lists.
+ * - The vectors as floats, padded to 8 bytes.
+ * - A bottom-level link list per node: a 32-bit count and `2 * m` 32-bit node ids.
+ * - For each node, and one past the last, the 32-bit index of its first upper-level link list,
+ *   padded to 8 bytes. A node's level is the number of lists it has.
+ * - The upper-level link lists: a 32-bit count and `m` 32-bit node ids each, padded to 8 bytes.
+ */
+class VectorIndex {
+public:
+  struct Options {
+    Metric metric{Metric::l2};
+    uint32_t m{16};                 // Links per node in upper levels, twice this at the bottom
+    uint32_t ef_construction{200};  // Candidates kept while linking a new node
+    size_t threads{0};              // Builder threads, or 0 for one per core
+    uint64_t seed{0x5045524547524e45ull};
+  }; // struct Options
+
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t metric;
+    uint8_t top_level;
+    uint32_t dim;
+    uint32_t m;
+    uint64_t count;
+    uint32_t entry_point;
+    uint32_t upper_lists;
+  }; // struct Header
+
+  struct Neighbor {
+    uint32_t id;
+    float distance;
+  }; // struct Neighbor
+
+  static constexpr uint32_t magic     = 0x49565250; // "PRVI"
+  static constexpr uint16_t version   = 1;
+  static constexpr uint32_t max_level = 31;
+
+  VectorIndex() noexcept = default;
+
+  /**
+   * @brief Build an index.
+   *
+   * @param vectors `count * dim` floats, one vector after another. Vector `i` gets id `i`.
+   * @param count The number of vectors.
+   * @param dim The number of floats per vector.
+   * @param options The build options.
+   * @return The serialized index, or `StatusCode::invalid_argument` if the options are invalid.
+   */
+  static Result<std::string> build(
+      const float* vectors, size_t count, uint32_t dim, const Options& options);
+
+  /**
+   * @brief Build an index and write it to a file.
+   *
+   * @param offset Where to write the index. Must be a multiple of 8 to be mapped in place.
+   * @return The number of bytes written, or the build or write error.
+   */
+  static Result<size_t> build(File& file, off_t offset, const float* vectors, size_t count,
+      uint32_t dim, const Options& options);
+
+  /**
+   * @brief Validate serialized bytes and view them.
+   *
+   * @param data The start of the serialized index. Must be 8-byte aligned.
+   * @param size The number of bytes available.
+   * @return The view, or `StatusCode::invalid_argument` if the bytes are not a valid index.
+   */
+  static Result<VectorIndex> open(const void* data, size_t size) noexcept;
+
+  /**
+   * @brief Find approximate nearest neighbours of a vector.
+   *
+   * @param query `dim()` floats.
+   * @param k The number of neighbours to return.
+   * @param ef The number of candidates to keep, at least `k`. Larger values raise recall and
+   * latency.
+   * @return Up to `k` neighbours, closest first.
+   */
+  std::vector<Neighbor> search(const float* query, size_t k, size_t ef = 64) const;
+
+  /**
+   * @brief Get the distance between a vector and a query under the index's metric.
+   */
+  float distance(uint32_t id, const float* query) const noexcept;
+
+  /**
+   * @brief Get vector `id`.
+   */
+  const float* vector(uint32_t id) const noexcept { return vectors + size_t{id} * dim(); }
+
+  /**
+   * @brief Get the number of vectors.
+   */
+  uint64_t size() const noexcept { return header != nullptr ? header->count : 0; }
+
+  /**
+   * @brief Get the number of floats per vector.
+   */
+  uint32_t dim() const noexcept { return header != nullptr ? header->dim : 0; }
+
+  /**
+   * @brief Get the metric.
+   */
+  Metric metric() const noexcept {
+    return header != nullptr ? static_cast<Metric>(header->metric) : Metric::l2;
+  }
+
+  /**
+   * @brief Get the size of the serialized index in bytes.
+   */
+  size_t bytes() const noexcept { return total; }
+
+private:
+  const Header* header{nullptr};
+  const float* vectors{nullptr};
+  const uint32_t* bottom{nullptr};
+  const uint32_t* upper_offsets{nullptr};
+  const uint32_t* upper{nullptr};
+  size_t total{0};
+}; // class VectorIndex
+
+} // namespace internal
+} // namespace peregrine
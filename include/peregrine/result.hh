@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "status_code.hh"
+
+namespace peregrine {
+
+namespace detail {
+
+// Signed 64-bit results (byte counts, offsets) are never negative on success, so the negative
+// range is free to hold a status code and the whole result fits in a single register.
+template <typename T>
+constexpr bool packed_result_v =
+    std::is_integral_v<T> && std::is_signed_v<T> && sizeof(T) == sizeof(int64_t);
+
+} // namespace detail
+
+/**
+ * @class Result
+ * @brief A value or a `StatusCode`.
+ *
+ * `Result` replaces `std::tuple<T, StatusCode>` returns. It is cheap to return and to test:
+ * `Result<ssize_t>` and `Result<off_t>` are a single 64-bit word, other small trivially copyable
+ * results come back in a register pair.
+ *
+ * For compatibility with code written against the tuple returns, `Result` supports structured
+ * bindings: `auto [bytes, status] = file.read(buf, count);`. On failure the bound value is the
+ * raw value returned by the failed call, e.g. `-1` for byte counts.
+ */
+template <typename T, typename Enable = void>
+class Result {
+  T val{};
+  StatusCode code{StatusCode::ok};
+
+public:
+  using value_type = T;
+
+  /**
+   * @brief Construct a successful result.
+   */
+  Result(T value) noexcept(std::is_nothrow_move_constructible_v<T>) : val(std::move(value)) {}
+
+  /**
+   * @brief Construct a result with an explicit status.
+   *
+   * @param value The value to carry, even on failure.
+   * @param status The status of the operation.
+   */
+  Result(T value, StatusCode status) noexcept(std::is_nothrow_move_constructible_v<T>) :
+      val(std::move(value)), code(status) {}
+
+  /**
+   * @brief Construct a failed result holding a default constructed value.
+   */
+  static Result error(StatusCode status) noexcept(std::is_nothrow_default_constructible_v<T>) {
+    return Result{T{}, status};
+  }
+
+  /**
+   * @brief Check if the result holds a value.
+   */
+  bool ok() const noexcept { return code == StatusCode::ok; }
+  explicit operator bool() const noexcept { return ok(); }
+
+  /**
+   * @brief Get the status code. `StatusCode::ok` if the result holds a value.
+   */
+  StatusCode status() const noexcept { return code; }
+
+  /**
+   * @brief Get the value.
+   */
+  T& value() & noexcept { return val; }
+  const T& value() const& noexcept { return val; }
+  T&& value() && noexcept { return std::move(val); }
+
+  T* operator->() noexcept { return &val; }
+  const T* operator->() const noexcept { return &val; }
+
+  // Tuple-like access for structured bindings
+  template <size_t I>
+  decltype(auto) get() & noexcept {
+    static_assert(I < 2);
+    if constexpr(I == 0) return (val);
+    else return code;
+  }
+
+  template <size_t I>
+  decltype(auto) get() const& noexcept {
+    static_assert(I < 2);
+    if constexpr(I == 0) return (val);
+    else return code;
+  }
+
+  template <size_t I>
+  decltype(auto) get() && noexcept {
+    static_assert(I < 2);
+    if constexpr(I == 0) return std::move(val);
+    else return code;
+  }
+}; // class Result
+
+/**
+ * @brief `Result` specialization for signed 64-bit values.
+ *
+ * Success values must be non-negative. A failure is stored in the negative range, offset so that
+ * every 32-bit status code is representable.
+ */
+template <typename T>
+class Result<T, std::enable_if_t<detail::packed_result_v<T>>> {
+  int64_t raw{0};
+
+  static constexpr int64_t encode(StatusCode status) noexcept {
+    return std::numeric_limits<int64_t>::min() +
+           (static_cast<int64_t>(status) - std::numeric_limits<int32_t>::min());
+  }
+
+  static constexpr StatusCode decode(int64_t raw) noexcept {
+    return static_cast<StatusCode>(static_cast<int32_t>(
+        raw - std::numeric_limits<int64_t>::min() + std::numeric_limits<int32_t>::min()));
+  }
+
+public:
+  using value_type = T;
+
+  constexpr Result(T value) noexcept : raw(value) {}
+
+  constexpr Result(T value, StatusCode status) noexcept :
+      raw(status == StatusCode::ok ? static_cast<int64_t>(value) : encode(status)) {}
+
+  static constexpr Result error(StatusCode status) noexcept { return Result{T(-1), status}; }
+
+  constexpr bool ok() const noexcept { return raw >= 0; }
+  constexpr explicit operator bool() const noexcept { return ok(); }
+
+  constexpr StatusCode status() const noexcept { return ok() ? StatusCode::ok : decode(raw); }
+
+  // Failed results report a value of -1, like the system calls they wrap.
+  constexpr T value() const noexcept { return ok() ? static_cast<T>(raw) : T(-1); }
+
+  template <size_t I>
+  constexpr auto get() const noexcept {
+    static_assert(I < 2);
+    if constexpr(I == 0) return value();
+    else return status();
+  }
+}; // class Result
+
+} // namespace peregrine
+
+namespace std {
+
+template <typename T>
+struct tuple_size<::peregrine::Result<T>> : integral_constant<size_t, 2> {};
+
+template <typename T>
+struct tuple_element<0, ::peregrine::Result<T>> {
+  using type = T;
+};
+
+template <typename T>
+struct tuple_element<1, ::peregrine::Result<T>> {
+  using type = ::peregrine::StatusCode;
+};
+
+} // namespace std
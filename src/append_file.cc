@@ -0,0 +1,120 @@
+#include "peregrine/internal/append_file.hh"
+
+#include <algorithm>
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+#if defined(PEREGRINE_HAVE_FALLOCATE)
+constexpr int keep_size = FALLOC_FL_KEEP_SIZE;
+#else
+constexpr int keep_size = 0;
+#endif // defined(PEREGRINE_HAVE_FALLOCATE)
+
+} // namespace
+
+AppendFile::AppendFile(AppendFile&& other) noexcept :
+    file(std::move(other.file)),
+    options(other.options),
+    end(other.end),
+    allocated(other.allocated),
+    chunk(other.chunk) {
+  other.end       = 0;
+  other.allocated = 0;
+  other.chunk     = 0;
+}
+
+AppendFile& AppendFile::operator=(AppendFile&& other) noexcept {
+  close();
+  file            = std::move(other.file);
+  options         = other.options;
+  end             = other.end;
+  allocated       = other.allocated;
+  chunk           = other.chunk;
+  other.end       = 0;
+  other.allocated = 0;
+  other.chunk     = 0;
+  return *this;
+}
+
+StatusCode AppendFile::open(std::string_view path, int flags, mode_t mode) {
+  if(PEREGRINE_UNLIKELY(file.is_open())) return StatusCode::already_open;
+  if(auto status = file.open(path, flags | O_WRONLY | O_CREAT | O_CLOEXEC, mode);
+      PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return status;
+
+  struct stat st;
+  if(auto status = file.stat(&st); PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+    file.close();
+    return status;
+  }
+  end       = st.st_size;
+  allocated = st.st_size;
+  chunk     = std::max<off_t>(options.initial_chunk, 1);
+  return StatusCode::ok;
+}
+
+Result<ssize_t> AppendFile::append(const void* buf, size_t count) noexcept {
+  const off_t required = end + static_cast<off_t>(count);
+  if(options.preallocate && required > allocated) {
+    if(auto status = grow(required); PEREGRINE_UNLIKELY(status != StatusCode::ok))
+      return Result<ssize_t>::error(status);
+  }
+
+  auto result = file.pwrite(buf, count, end);
+  if(PEREGRINE_LIKELY(result.ok())) end += result.value();
+  return result;
+}
+
+StatusCode AppendFile::reserve(off_t length) noexcept {
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return StatusCode::not_open;
+  if(!options.preallocate || end + length <= allocated) return StatusCode::ok;
+  return preallocate(end + length);
+}
+
+StatusCode AppendFile::grow(off_t required) noexcept {
+  // Reserve at least what this write needs, and at least the next chunk
+  if(auto status = preallocate(std::max(required, allocated + chunk));
+      PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return status;
+  // Chunks never shrink, even when the options are zero or smaller than the first chunk
+  const auto next  = static_cast<off_t>(static_cast<double>(chunk) * options.growth);
+  const auto limit = std::max({options.max_chunk, options.initial_chunk, chunk});
+  chunk            = std::clamp(next, chunk, limit);
+  return StatusCode::ok;
+}
+
+StatusCode AppendFile::preallocate(off_t target) noexcept {
+  const auto status = file.allocate(allocated, target - allocated, keep_size);
+  if(PEREGRINE_LIKELY(status == StatusCode::ok)) {
+    allocated = target;
+  } else if(status == StatusCode::enotsup || status == StatusCode::eopnotsupp) {
+    // Plain writes still work, so stop trying
+    PEREGRINE_LOG_DEBUG(
+        "Preallocation is not supported for \"{}\""sv, FdPath{file.native_handle()});
+    options.preallocate = false;
+    return StatusCode::ok;
+  }
+  return status;
+}
+
+StatusCode AppendFile::close() noexcept {
+  if(!file.is_open()) return StatusCode::ok;
+
+  // Give back the reserved space that was never written
+  StatusCode status = StatusCode::ok;
+  if(allocated > end) status = file.truncate(end);
+  if(auto close_status = file.close(); status == StatusCode::ok) status = close_status;
+
+  end       = 0;
+  allocated = 0;
+  chunk     = 0;
+  return status;
+}
+
+} // namespace internal
+} // namespace peregrine
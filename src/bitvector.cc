@@ -0,0 +1,168 @@
+#include "peregrine/internal/bitvector.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+constexpr size_t header_bytes = sizeof(RankSelect::Header);
+
+uint64_t block_count(uint64_t bits) noexcept {
+  return (bits + RankSelect::block_bits - 1) / RankSelect::block_bits;
+}
+
+uint64_t sample_count(uint64_t n) noexcept {
+  return (n + RankSelect::sample_rate - 1) / RankSelect::sample_rate + 1;
+}
+
+size_t samples_bytes(uint64_t samples) noexcept { return (samples * sizeof(uint32_t) + 7) / 8 * 8; }
+
+// Find the block holding the value with `k` values before it. `before(b)` counts the values in
+// the blocks before `b` and is non-decreasing; the answer lies in `[lo, hi]`.
+template <typename Before>
+uint64_t find_block(uint64_t lo, uint64_t hi, uint64_t k, Before before) noexcept {
+  while(lo < hi) {
+    const uint64_t mid = lo + (hi - lo + 1) / 2;
+    if(before(mid) <= k) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+} // namespace
+
+size_t RankSelect::serialized_size(uint64_t bits, uint64_t ones) noexcept {
+  const uint64_t blocks = block_count(bits);
+  return header_bytes + blocks * (block_bits / 8) + (blocks + 1) * 2 * sizeof(uint64_t) +
+         samples_bytes(sample_count(ones)) + samples_bytes(sample_count(bits - ones));
+}
+
+std::string BitVector::serialize() const {
+  const uint64_t blocks = block_count(bits);
+  std::vector<uint64_t> padded(blocks * 8, 0);
+  std::copy(words.begin(), words.end(), padded.begin());
+
+  std::vector<uint64_t> counts(2 * (blocks + 1), 0);
+  std::vector<uint32_t> samples1, samples0;
+  uint64_t ones = 0;
+  for(uint64_t b = 0; b < blocks; ++b) {
+    counts[2 * b]     = ones;
+    uint64_t relative = 0, packed = 0;
+    for(uint64_t w = 0; w < 8; ++w) {
+      if(w != 0) packed |= relative << (9 * (w - 1));
+      relative += popcount64(padded[b * 8 + w]);
+    }
+    counts[2 * b + 1] = packed;
+
+    // Sample the block of every 512th one and zero
+    const uint64_t end1 = ones + relative;
+    const uint64_t end0 = std::min((b + 1) * RankSelect::block_bits, bits) - end1;
+    const auto block    = static_cast<uint32_t>(b);
+    while(samples1.size() * RankSelect::sample_rate < end1) samples1.push_back(block);
+    while(samples0.size() * RankSelect::sample_rate < end0) samples0.push_back(block);
+    ones = end1;
+  }
+  counts[2 * blocks] = ones;
+  samples1.push_back(static_cast<uint32_t>(blocks));
+  samples0.push_back(static_cast<uint32_t>(blocks));
+
+  RankSelect::Header header{};
+  header.magic    = RankSelect::magic;
+  header.version  = RankSelect::version;
+  header.bits     = bits;
+  header.ones     = ones;
+  header.blocks   = blocks;
+  header.samples1 = static_cast<uint32_t>(samples1.size());
+  header.samples0 = static_cast<uint32_t>(samples0.size());
+
+  std::string out(RankSelect::serialized_size(bits, ones), '\0');
+  char* p = out.data();
+  std::memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  std::memcpy(p, padded.data(), padded.size() * sizeof(uint64_t));
+  p += padded.size() * sizeof(uint64_t);
+  std::memcpy(p, counts.data(), counts.size() * sizeof(uint64_t));
+  p += counts.size() * sizeof(uint64_t);
+  std::memcpy(p, samples1.data(), samples1.size() * sizeof(uint32_t));
+  p += samples_bytes(samples1.size());
+  std::memcpy(p, samples0.data(), samples0.size() * sizeof(uint32_t));
+  return out;
+}
+
+Result<RankSelect> RankSelect::open(const void* data, size_t size) noexcept {
+  const auto invalid = [] { return Result<RankSelect>::error(StatusCode::invalid_argument); };
+  if(data == nullptr || reinterpret_cast<uintptr_t>(data) % 8 != 0) return invalid();
+  if(size < header_bytes) return invalid();
+
+  RankSelect view;
+  view.header     = static_cast<const Header*>(data);
+  const Header& h = *view.header;
+  if(h.magic != magic || h.version != version) return invalid();
+  if(h.bits / 8 > size || h.ones > h.bits || h.blocks != block_count(h.bits)) return invalid();
+  if(h.samples1 != sample_count(h.ones) || h.samples0 != sample_count(h.bits - h.ones))
+    return invalid();
+  if(serialized_size(h.bits, h.ones) > size) return invalid();
+
+  const char* p = static_cast<const char*>(data) + header_bytes;
+  view.words    = reinterpret_cast<const uint64_t*>(p);
+  p += h.blocks * (block_bits / 8);
+  view.counts = reinterpret_cast<const uint64_t*>(p);
+  p += (h.blocks + 1) * 2 * sizeof(uint64_t);
+  view.samples1 = reinterpret_cast<const uint32_t*>(p);
+  p += samples_bytes(h.samples1);
+  view.samples0 = reinterpret_cast<const uint32_t*>(p);
+
+  // Check what select relies on to stay in bounds
+  if(view.counts[2 * h.blocks] != h.ones) return invalid();
+  for(uint32_t i = 0; i < h.samples1; ++i) {
+    if(view.samples1[i] > h.blocks || (i > 0 && view.samples1[i] < view.samples1[i - 1]))
+      return invalid();
+  }
+  for(uint32_t i = 0; i < h.samples0; ++i) {
+    if(view.samples0[i] > h.blocks || (i > 0 && view.samples0[i] < view.samples0[i - 1]))
+      return invalid();
+  }
+  return view;
+}
+
+uint64_t RankSelect::select1(uint64_t k) const noexcept {
+  const uint64_t s     = k / sample_rate;
+  const uint64_t block = find_block(
+      samples1[s], samples1[s + 1], k, [this](uint64_t b) { return counts[2 * b]; });
+
+  // Pick the word from the relative ranks, then the bit within it
+  uint64_t rank         = k - counts[2 * block];
+  const uint64_t packed = counts[2 * block + 1];
+  uint64_t sub          = 0;
+  while(sub < 7 && ((packed >> (9 * sub)) & 0x1ff) <= rank) ++sub;
+  if(sub != 0) rank -= (packed >> (9 * (sub - 1))) & 0x1ff;
+  const uint64_t word = block * 8 + sub;
+  return word * 64 + select64(words[word], static_cast<uint32_t>(rank));
+}
+
+uint64_t RankSelect::select0(uint64_t k) const noexcept {
+  const uint64_t s     = k / sample_rate;
+  const uint64_t block = find_block(samples0[s], samples0[s + 1], k, [this](uint64_t b) {
+    return b * block_bits - counts[2 * b];
+  });
+
+  uint64_t rank         = k - (block * block_bits - counts[2 * block]);
+  const uint64_t packed = counts[2 * block + 1];
+  const auto zeros      = [packed](uint64_t w) {
+    return 64 * w - ((packed >> (9 * (w - 1))) & 0x1ff);
+  };
+  uint64_t sub = 0;
+  while(sub < 7 && zeros(sub + 1) <= rank) ++sub;
+  if(sub != 0) rank -= zeros(sub);
+  const uint64_t word = block * 8 + sub;
+  return word * 64 + select64(~words[word], static_cast<uint32_t>(rank));
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,360 @@
+#include "peregrine/internal/column_store.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#include "peregrine/internal/simd.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+
+size_t type_width(uint8_t type) noexcept {
+  switch(static_cast<ColumnType>(type)) {
+  case ColumnType::int32:
+  case ColumnType::float32: return 4;
+  case ColumnType::int64:
+  case ColumnType::float64: return 8;
+  }
+  return 0;
+}
+
+uint64_t low_bits(size_t n) noexcept { return n >= 64 ? ~uint64_t{0} : (uint64_t{1} << n) - 1; }
+
+// The bits of the `n <= 64` values in `[lo, hi]`
+template<typename T>
+uint64_t between_word(const T* values, size_t n, T lo, T hi) noexcept {
+  uint64_t word = 0;
+  for(size_t i = 0; i < n; ++i) word |= uint64_t{values[i] >= lo && values[i] <= hi} << i;
+  return word;
+}
+
+#if defined(PEREGRINE_SIMD_NEON)
+// Gather the lanes of a comparison mask into 4 bits
+inline uint64_t mask_bits(uint32x4_t mask) noexcept {
+  static const uint32_t weights[4] = {1, 2, 4, 8};
+  const uint32x4_t bits = vandq_u32(mask, vld1q_u32(weights));
+  const uint32x2_t sums = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+  return vget_lane_u32(vpadd_u32(sums, sums), 0);
+}
+#endif // defined(PEREGRINE_SIMD_NEON)
+
+uint64_t between_word(const int32_t* values, size_t n, int32_t lo, int32_t hi) noexcept {
+#if defined(PEREGRINE_SIMD_SSE2)
+  if(n == 64) {
+    const __m128i l = _mm_set1_epi32(lo), h = _mm_set1_epi32(hi);
+    uint64_t word   = 0;
+    for(size_t i = 0; i < 64; i += 4) {
+      const __m128i x   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+      const __m128i out = _mm_or_si128(_mm_cmplt_epi32(x, l), _mm_cmpgt_epi32(x, h));
+      word |= uint64_t(~_mm_movemask_ps(_mm_castsi128_ps(out)) & 0xf) << i;
+    }
+    return word;
+  }
+#elif defined(PEREGRINE_SIMD_NEON)
+  if(n == 64) {
+    const int32x4_t l = vdupq_n_s32(lo), h = vdupq_n_s32(hi);
+    uint64_t word     = 0;
+    for(size_t i = 0; i < 64; i += 4) {
+      const int32x4_t x = vld1q_s32(values + i);
+      word |= mask_bits(vandq_u32(vcgeq_s32(x, l), vcleq_s32(x, h))) << i;
+    }
+    return word;
+  }
+#endif // defined(PEREGRINE_SIMD_SSE2)
+  return between_word<int32_t>(values, n, lo, hi);
+}
+
+uint64_t between_word(const float* values, size_t n, float lo, float hi) noexcept {
+#if defined(PEREGRINE_SIMD_SSE2)
+  if(n == 64) {
+    const __m128 l = _mm_set1_ps(lo), h = _mm_set1_ps(hi);
+    uint64_t word  = 0;
+    for(size_t i = 0; i < 64; i += 4) {
+      const __m128 x = _mm_loadu_ps(values + i);
+      word |= uint64_t(_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(x, l), _mm_cmple_ps(x, h)))) << i;
+    }
+    return word;
+  }
+#elif defined(PEREGRINE_SIMD_NEON)
+  if(n == 64) {
+    const float32x4_t l = vdupq_n_f32(lo), h = vdupq_n_f32(hi);
+    uint64_t word       = 0;
+    for(size_t i = 0; i < 64; i += 4) {
+      const float32x4_t x = vld1q_f32(values + i);
+      word |= mask_bits(vandq_u32(vcgeq_f32(x, l), vcleq_f32(x, h))) << i;
+    }
+    return word;
+  }
+#endif // defined(PEREGRINE_SIMD_SSE2)
+  return between_word<float>(values, n, lo, hi);
+}
+
+template<typename T>
+void add_value(Aggregate<T>& out, T value) noexcept {
+  if constexpr(std::is_floating_point_v<T>) {
+    out.sum += value;
+  } else {
+    out.sum = static_cast<int64_t>(static_cast<uint64_t>(out.sum) + static_cast<uint64_t>(value));
+  }
+  if(value < out.min) out.min = value;
+  if(value > out.max) out.max = value;
+}
+
+// Aggregate `n` consecutive values
+template<typename T>
+void accumulate(const T* values, size_t n, Aggregate<T>& out) noexcept {
+  for(size_t i = 0; i < n; ++i) add_value(out, values[i]);
+  out.count += n;
+}
+
+void accumulate(const int32_t* values, size_t n, Aggregate<int32_t>& out) noexcept {
+  size_t i = 0;
+#if defined(PEREGRINE_SIMD_SSE41)
+  if(n >= 4) {
+    __m128i sum = _mm_setzero_si128();
+    __m128i min = _mm_set1_epi32(out.min), max = _mm_set1_epi32(out.max);
+    for(; i + 4 <= n; i += 4) {
+      const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+      sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(x));
+      sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(_mm_srli_si128(x, 8)));
+      min = _mm_min_epi32(min, x);
+      max = _mm_max_epi32(max, x);
+    }
+    int64_t sums[2];
+    int32_t mins[4], maxs[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums), sum);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(mins), min);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), max);
+    out.sum = static_cast<int64_t>(static_cast<uint64_t>(out.sum) + static_cast<uint64_t>(sums[0]) +
+                                   static_cast<uint64_t>(sums[1]));
+    out.min = std::min({out.min, mins[0], mins[1], mins[2], mins[3]});
+    out.max = std::max({out.max, maxs[0], maxs[1], maxs[2], maxs[3]});
+  }
+#elif defined(PEREGRINE_SIMD_NEON)
+  if(n >= 4) {
+    int64x2_t sum = vdupq_n_s64(0);
+    int32x4_t min = vdupq_n_s32(out.min), max = vdupq_n_s32(out.max);
+    for(; i + 4 <= n; i += 4) {
+      const int32x4_t x = vld1q_s32(values + i);
+      sum               = vpadalq_s32(sum, x);
+      min               = vminq_s32(min, x);
+      max               = vmaxq_s32(max, x);
+    }
+    out.sum = static_cast<int64_t>(static_cast<uint64_t>(out.sum) +
+                                   static_cast<uint64_t>(vgetq_lane_s64(sum, 0)) +
+                                   static_cast<uint64_t>(vgetq_lane_s64(sum, 1)));
+    int32_t mins[4], maxs[4];
+    vst1q_s32(mins, min);
+    vst1q_s32(maxs, max);
+    out.min = std::min({out.min, mins[0], mins[1], mins[2], mins[3]});
+    out.max = std::max({out.max, maxs[0], maxs[1], maxs[2], maxs[3]});
+  }
+#endif // defined(PEREGRINE_SIMD_SSE41)
+  for(; i < n; ++i) add_value(out, values[i]);
+  out.count += n;
+}
+
+void accumulate(const float* values, size_t n, Aggregate<float>& out) noexcept {
+  size_t i = 0;
+#if defined(PEREGRINE_SIMD_SSE2)
+  if(n >= 4) {
+    // Sum in doubles like the scalar path; min and max take their second operand on NaN
+    __m128d sum = _mm_setzero_pd();
+    __m128 min = _mm_set1_ps(out.min), max = _mm_set1_ps(out.max);
+    for(; i + 4 <= n; i += 4) {
+      const __m128 x = _mm_loadu_ps(values + i);
+      sum            = _mm_add_pd(sum, _mm_cvtps_pd(x));
+      sum            = _mm_add_pd(sum, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+      min            = _mm_min_ps(x, min);
+      max            = _mm_max_ps(x, max);
+    }
+    double sums[2];
+    float mins[4], maxs[4];
+    _mm_storeu_pd(sums, sum);
+    _mm_storeu_ps(mins, min);
+    _mm_storeu_ps(maxs, max);
+    out.sum += sums[0] + sums[1];
+    out.min = std::min({out.min, mins[0], mins[1], mins[2], mins[3]});
+    out.max = std::max({out.max, maxs[0], maxs[1], maxs[2], maxs[3]});
+  }
+#endif // defined(PEREGRINE_SIMD_SSE2)
+  for(; i < n; ++i) add_value(out, values[i]);
+  out.count += n;
+}
+
+} // namespace
+
+template<typename T>
+StatusCode ColumnStoreBuilder::add(const T* values, size_t count) {
+  if(!columns.empty() && count != rows) return StatusCode::invalid_argument;
+  if(count != 0 && values == nullptr) return StatusCode::invalid_argument;
+  rows = count;
+
+  Column column;
+  column.type = ColumnTypeOf<T>::value;
+  column.data.assign(reinterpret_cast<const char*>(values), count * sizeof(T));
+  for(size_t begin = 0; begin < count; begin += block_rows) {
+    Zone<T> zone{std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest()};
+    for(size_t i = begin; i < std::min<size_t>(begin + block_rows, count); ++i) {
+      if(values[i] < zone.min) zone.min = values[i];
+      if(values[i] > zone.max) zone.max = values[i];
+    }
+    column.zones.append(reinterpret_cast<const char*>(&zone), sizeof(zone));
+  }
+  columns.push_back(std::move(column));
+  return StatusCode::ok;
+}
+
+std::string ColumnStoreBuilder::finish() {
+  ColumnStore::Header header{};
+  header.magic      = ColumnStore::magic;
+  header.version    = ColumnStore::version;
+  header.columns    = static_cast<uint32_t>(columns.size());
+  header.block_rows = block_rows;
+  header.rows       = rows;
+  header.blocks     = (rows + block_rows - 1) / block_rows;
+
+  size_t size = sizeof(header) + columns.size() * sizeof(ColumnStore::Column);
+  std::vector<ColumnStore::Column> entries(columns.size());
+  for(size_t i = 0; i < columns.size(); ++i) {
+    entries[i].type         = static_cast<uint8_t>(columns[i].type);
+    entries[i].width        = static_cast<uint8_t>(type_width(entries[i].type));
+    entries[i].zones_offset = size;
+    size += pad8(columns[i].zones.size());
+    entries[i].data_offset = size;
+    size += pad8(columns[i].data.size());
+  }
+
+  std::string out(size, '\0');
+  std::memcpy(out.data(), &header, sizeof(header));
+  std::memcpy(out.data() + sizeof(header), entries.data(), entries.size() * sizeof(entries[0]));
+  for(size_t i = 0; i < columns.size(); ++i) {
+    std::memcpy(out.data() + entries[i].zones_offset, columns[i].zones.data(),
+        columns[i].zones.size());
+    std::memcpy(
+        out.data() + entries[i].data_offset, columns[i].data.data(), columns[i].data.size());
+  }
+
+  columns.clear();
+  rows = 0;
+  return out;
+}
+
+Result<ColumnStore> ColumnStore::open(const void* data, size_t size) noexcept {
+  const auto invalid = [] { return Result<ColumnStore>::error(StatusCode::invalid_argument); };
+  if(data == nullptr || reinterpret_cast<uintptr_t>(data) % 8 != 0) return invalid();
+  if(size < sizeof(Header)) return invalid();
+
+  ColumnStore view;
+  view.header     = static_cast<const Header*>(data);
+  view.base       = static_cast<const char*>(data);
+  const Header& h = *view.header;
+  if(h.magic != magic || h.version != version) return invalid();
+  if(h.block_rows == 0 || h.block_rows % 64 != 0 || h.rows > size) return invalid();
+  if(h.blocks != (h.rows + h.block_rows - 1) / h.block_rows) return invalid();
+  if(h.columns > (size - sizeof(Header)) / sizeof(Column)) return invalid();
+
+  view.entries = reinterpret_cast<const Column*>(view.base + sizeof(Header));
+  view.total   = sizeof(Header) + size_t{h.columns} * sizeof(Column);
+  for(uint32_t i = 0; i < h.columns; ++i) {
+    const Column& c    = view.entries[i];
+    const size_t width = type_width(c.type);
+    if(width == 0 || c.width != width) return invalid();
+    // Each zone map and value array must be aligned and lie inside the bytes
+    const size_t zones_bytes = pad8(h.blocks * 2 * width);
+    const size_t data_bytes  = pad8(h.rows * width);
+    if(c.zones_offset % 8 != 0 || c.zones_offset > size || zones_bytes > size - c.zones_offset)
+      return invalid();
+    if(c.data_offset % 8 != 0 || c.data_offset > size || data_bytes > size - c.data_offset)
+      return invalid();
+    view.total = std::max<size_t>(
+        view.total, std::max(c.zones_offset + zones_bytes, c.data_offset + data_bytes));
+  }
+  return view;
+}
+
+template<typename T>
+Result<ScanStats> ColumnStore::select(size_t column, T lo, T hi, uint64_t* bitmap,
+    uint64_t first_block, uint64_t last_block) const noexcept {
+  const T* data       = values<T>(column);
+  const Zone<T>* zone  = zones<T>(column);
+  if(data == nullptr) return Result<ScanStats>::error(StatusCode::invalid_argument);
+
+  ScanStats stats;
+  last_block = std::min(last_block, blocks());
+  for(uint64_t block = first_block; block < last_block; ++block) {
+    const uint64_t begin = block * block_rows();
+    const uint64_t end   = std::min<uint64_t>(begin + block_rows(), rows());
+    const uint64_t first = begin / 64, last = (end + 63) / 64;
+
+    if(!(lo <= hi) || zone[block].max < lo || zone[block].min > hi) {
+      std::fill(bitmap + first, bitmap + last, 0);
+      ++stats.blocks_skipped;
+      continue;
+    }
+    // Floats may hide NaNs inside a matching zone, so only integers take the shortcut
+    if constexpr(!std::is_floating_point_v<T>) {
+      if(lo <= zone[block].min && zone[block].max <= hi) {
+        std::fill(bitmap + first, bitmap + last, ~uint64_t{0});
+        bitmap[last - 1] = low_bits(end - (last - 1) * 64);
+        stats.matches += end - begin;
+        ++stats.blocks_matched;
+        continue;
+      }
+    }
+    for(uint64_t word = first; word < last; ++word) {
+      const size_t n = static_cast<size_t>(std::min<uint64_t>(64, end - word * 64));
+      bitmap[word]   = between_word(data + word * 64, n, lo, hi);
+      stats.matches += popcount64(bitmap[word]);
+    }
+    ++stats.blocks_scanned;
+  }
+  return stats;
+}
+
+template<typename T>
+Result<Aggregate<T>> ColumnStore::aggregate(size_t column, const uint64_t* filter,
+    uint64_t first_block, uint64_t last_block) const noexcept {
+  const T* data = values<T>(column);
+  if(data == nullptr) return Result<Aggregate<T>>::error(StatusCode::invalid_argument);
+
+  Aggregate<T> out;
+  last_block           = std::min(last_block, blocks());
+  const uint64_t begin = std::min(first_block, last_block) * block_rows();
+  const uint64_t end   = std::min<uint64_t>(last_block * block_rows(), rows());
+  if(filter == nullptr) {
+    if(begin < end) accumulate(data + begin, static_cast<size_t>(end - begin), out);
+    return out;
+  }
+
+  // Whole words use the SIMD kernels; sparse words visit their set bits
+  for(uint64_t word = begin / 64; word * 64 < end; ++word) {
+    const size_t n = static_cast<size_t>(std::min<uint64_t>(64, end - word * 64));
+    uint64_t bits  = filter[word] & low_bits(n);
+    if(bits == ~uint64_t{0}) {
+      accumulate(data + word * 64, 64, out);
+      continue;
+    }
+    out.count += popcount64(bits);
+    for(; bits != 0; bits &= bits - 1) add_value(out, data[word * 64 + __builtin_ctzll(bits)]);
+  }
+  return out;
+}
+
+#define PEREGRINE_COLUMN_TYPE(T)                                                                  \
+  template StatusCode ColumnStoreBuilder::add<T>(const T*, size_t);                               \
+  template Result<ScanStats> ColumnStore::select<T>(                                              \
+      size_t, T, T, uint64_t*, uint64_t, uint64_t) const noexcept;                                \
+  template Result<Aggregate<T>> ColumnStore::aggregate<T>(                                        \
+      size_t, const uint64_t*, uint64_t, uint64_t) const noexcept;
+PEREGRINE_COLUMN_TYPE(int32_t)
+PEREGRINE_COLUMN_TYPE(int64_t)
+PEREGRINE_COLUMN_TYPE(float)
+PEREGRINE_COLUMN_TYPE(double)
+#undef PEREGRINE_COLUMN_TYPE
+
+} // namespace internal
+} // namespace peregrine
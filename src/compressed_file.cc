@@ -0,0 +1,443 @@
+#include "peregrine/internal/compressed_file.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(PEREGRINE_HAVE_LZ4)
+#include <lz4.h>
+#endif // defined(PEREGRINE_HAVE_LZ4)
+
+#if defined(PEREGRINE_HAVE_ZSTD)
+#include <zdict.h>
+#include <zstd.h>
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+#if defined(PEREGRINE_HAVE_ZSTD)
+namespace {
+
+// Decompression contexts are not thread-safe, so each thread keeps its own
+ZSTD_DCtx* thread_dctx() noexcept {
+  thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> dctx(
+      ZSTD_createDCtx(), ZSTD_freeDCtx);
+  return dctx.get();
+}
+
+} // namespace
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+
+std::string_view codec_name(Codec codec) noexcept {
+  switch(codec) {
+  case Codec::none: return "none"sv;
+  case Codec::lz4: return "lz4"sv;
+  case Codec::zstd: return "zstd"sv;
+  }
+  return "unknown"sv;
+}
+
+bool codec_available(Codec codec) noexcept {
+  switch(codec) {
+  case Codec::none: return true;
+#if defined(PEREGRINE_HAVE_LZ4)
+  case Codec::lz4: return true;
+#endif // defined(PEREGRINE_HAVE_LZ4)
+#if defined(PEREGRINE_HAVE_ZSTD)
+  case Codec::zstd: return true;
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+  default: return false;
+  }
+}
+
+Result<std::string> train_dictionary(
+    const std::vector<std::string_view>& samples, size_t max_size) {
+#if defined(PEREGRINE_HAVE_ZSTD)
+  std::string joined;
+  std::vector<size_t> sizes;
+  for(auto sample : samples) {
+    joined.append(sample);
+    sizes.push_back(sample.size());
+  }
+  std::string dictionary(max_size, '\0');
+  const size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), joined.data(),
+      sizes.data(), static_cast<unsigned>(sizes.size()));
+  if(ZDICT_isError(size)) {
+    PEREGRINE_LOG_DEBUG("Dictionary training failed: {}"sv, ZDICT_getErrorName(size));
+    return Result<std::string>::error(StatusCode::invalid_argument);
+  }
+  dictionary.resize(size);
+  return dictionary;
+#else
+  (void)samples;
+  (void)max_size;
+  return Result<std::string>::error(StatusCode::enotsup);
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+}
+
+struct CompressedWriter::Codecs {
+#if defined(PEREGRINE_HAVE_ZSTD)
+  ZSTD_CCtx* cctx{nullptr};
+  ZSTD_CDict* cdict{nullptr};
+
+  ~Codecs() {
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeCCtx(cctx);
+  }
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+}; // struct CompressedWriter::Codecs
+
+CompressedWriter::CompressedWriter() noexcept = default;
+
+CompressedWriter::CompressedWriter(Options options) noexcept : options(std::move(options)) {}
+
+CompressedWriter::~CompressedWriter() {
+  if(file.is_open()) close();
+}
+
+StatusCode CompressedWriter::open(std::string_view path, int flags, mode_t mode) {
+  if(PEREGRINE_UNLIKELY(file.is_open())) return StatusCode::already_open;
+  if(options.block_size == 0) return StatusCode::invalid_argument;
+  if(auto status = file.open(path, flags | O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+      PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return status;
+
+  codecs = std::make_unique<Codecs>();
+#if defined(PEREGRINE_HAVE_ZSTD)
+  codecs->cctx = ZSTD_createCCtx();
+  if(!options.dictionary.empty()) {
+    codecs->cdict = ZSTD_createCDict(
+        options.dictionary.data(), options.dictionary.size(), options.zstd_level);
+  }
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+  pending.clear();
+  index.clear();
+  end      = 0;
+  counters = {};
+  return StatusCode::ok;
+}
+
+StatusCode CompressedWriter::append(const void* buf, size_t count) {
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return StatusCode::not_open;
+  const auto* p = static_cast<const char*>(buf);
+  while(count != 0) {
+    // Whole blocks are compressed straight from the caller's buffer
+    if(pending.empty() && count >= options.block_size) {
+      if(auto status = write_block(p, options.block_size); status != StatusCode::ok)
+        return status;
+      p += options.block_size;
+      count -= options.block_size;
+      continue;
+    }
+    const size_t n = std::min<size_t>(count, options.block_size - pending.size());
+    pending.append(p, n);
+    p += n;
+    count -= n;
+    if(pending.size() == options.block_size) {
+      if(auto status = write_block(pending.data(), pending.size()); status != StatusCode::ok)
+        return status;
+      pending.clear();
+    }
+  }
+  return StatusCode::ok;
+}
+
+StatusCode CompressedWriter::write_block(const char* data, size_t size) {
+  // Keep the smallest result that clears `min_ratio`, preferring LZ4 unless Zstd wins clearly
+  Codec best       = Codec::none;
+  size_t best_size = size;
+  [[maybe_unused]] const auto limit =
+      static_cast<size_t>(static_cast<double>(size) / options.min_ratio);
+#if defined(PEREGRINE_HAVE_LZ4)
+  if(options.lz4) {
+    auto& out = scratch[static_cast<size_t>(Codec::lz4)];
+    out.resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(size))));
+    const int n = LZ4_compress_default(
+        data, out.data(), static_cast<int>(size), static_cast<int>(out.size()));
+    if(n > 0 && static_cast<size_t>(n) <= limit) {
+      best      = Codec::lz4;
+      best_size = static_cast<size_t>(n);
+    }
+  }
+#endif // defined(PEREGRINE_HAVE_LZ4)
+#if defined(PEREGRINE_HAVE_ZSTD)
+  if(options.zstd) {
+    auto& out      = scratch[static_cast<size_t>(Codec::zstd)];
+    out.resize(ZSTD_compressBound(size));
+    const size_t n =
+        codecs->cdict != nullptr
+            ? ZSTD_compress_usingCDict(
+                  codecs->cctx, out.data(), out.size(), data, size, codecs->cdict)
+            : ZSTD_compressCCtx(
+                  codecs->cctx, out.data(), out.size(), data, size, options.zstd_level);
+    const bool wins =
+        best == Codec::none || static_cast<double>(n) * options.zstd_gain <= best_size;
+    if(!ZSTD_isError(n) && n <= limit && wins) {
+      best      = Codec::zstd;
+      best_size = n;
+    }
+  }
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+
+  const char* stored = best == Codec::none ? data : scratch[static_cast<size_t>(best)].data();
+  CompressedFile::IndexEntry entry{};
+  entry.offset = end;
+  entry.size   = static_cast<uint32_t>(best_size);
+  entry.codec  = static_cast<uint8_t>(best);
+  if(auto status = write(stored, best_size); status != StatusCode::ok) return status;
+  index.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+
+  ++counters.blocks[static_cast<size_t>(best)];
+  counters.raw_bytes += size;
+  counters.stored_bytes += best_size;
+  return StatusCode::ok;
+}
+
+StatusCode CompressedWriter::write(const void* data, size_t size) {
+  if(auto status = file.pwrite_all(data, size, static_cast<off_t>(end)); status != StatusCode::ok)
+    return status;
+  end += size;
+  return StatusCode::ok;
+}
+
+StatusCode CompressedWriter::close() {
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return StatusCode::not_open;
+  StatusCode status = StatusCode::ok;
+  if(!pending.empty()) status = write_block(pending.data(), pending.size());
+  pending.clear();
+
+  CompressedFile::Footer footer{};
+  footer.magic             = CompressedFile::magic;
+  footer.version           = CompressedFile::version;
+  footer.block_size        = options.block_size;
+  footer.dictionary_size   = static_cast<uint32_t>(options.dictionary.size());
+  footer.block_count       = index.size() / sizeof(CompressedFile::IndexEntry);
+  footer.raw_size          = counters.raw_bytes;
+  footer.dictionary_offset = end;
+  footer.index_offset      = end + options.dictionary.size();
+  if(status == StatusCode::ok) status = write(options.dictionary.data(), options.dictionary.size());
+  if(status == StatusCode::ok) status = write(index.data(), index.size());
+  if(status == StatusCode::ok) status = write(&footer, sizeof(footer));
+
+  codecs.reset();
+  const auto closed = file.close();
+  return status != StatusCode::ok ? status : closed;
+}
+
+struct CompressedFile::Codecs {
+#if defined(PEREGRINE_HAVE_ZSTD)
+  ZSTD_DDict* ddict{nullptr};
+
+  ~Codecs() { ZSTD_freeDDict(ddict); }
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+}; // struct CompressedFile::Codecs
+
+CompressedFile::CompressedFile() noexcept = default;
+
+CompressedFile::CompressedFile(Options options) noexcept : options(options) {}
+
+CompressedFile::~CompressedFile() = default;
+
+StatusCode CompressedFile::open(std::string_view path) {
+  if(PEREGRINE_UNLIKELY(file.is_open())) return StatusCode::already_open;
+  if(auto status = file.open(path, O_RDONLY | O_CLOEXEC); status != StatusCode::ok) return status;
+
+  const auto fail = [this](StatusCode status) {
+    map.unmap();
+    file.close();
+    index.clear();
+    footer = {};
+    return status;
+  };
+  struct stat st;
+  if(auto status = file.stat(&st); status != StatusCode::ok) return fail(status);
+  const auto file_size = static_cast<uint64_t>(st.st_size);
+  if(file_size < sizeof(Footer)) return fail(StatusCode::invalid_argument);
+  if(auto status = file.pread_exact(&footer, sizeof(footer), file_size - sizeof(Footer));
+      status != StatusCode::ok)
+    return fail(status);
+
+  // Check that the index, dictionary and blocks fit together
+  const Footer& f = footer;
+  if(f.magic != magic || f.version != version || f.block_size == 0) {
+    return fail(StatusCode::invalid_argument);
+  }
+  if(f.block_count != f.raw_size / f.block_size + (f.raw_size % f.block_size != 0) ||
+      f.block_count > file_size / sizeof(IndexEntry) || f.index_offset > file_size ||
+      f.index_offset + f.block_count * sizeof(IndexEntry) + sizeof(Footer) != file_size ||
+      f.dictionary_offset > f.index_offset ||
+      f.dictionary_size != f.index_offset - f.dictionary_offset) {
+    return fail(StatusCode::invalid_argument);
+  }
+  index.resize(f.block_count);
+  const size_t index_bytes = index.size() * sizeof(IndexEntry);
+  if(auto status = file.pread_exact(index.data(), index_bytes, f.index_offset);
+      status != StatusCode::ok)
+    return fail(status);
+  for(size_t i = 0; i < index.size(); ++i) {
+    const IndexEntry& e = index[i];
+    const uint64_t raw  = std::min<uint64_t>(f.block_size, f.raw_size - i * f.block_size);
+    if(e.offset > f.dictionary_offset || e.size > f.dictionary_offset - e.offset ||
+        e.codec >= codec_count)
+      return fail(StatusCode::invalid_argument);
+    if(e.codec == static_cast<uint8_t>(Codec::none) && e.size != raw)
+      return fail(StatusCode::invalid_argument);
+    if(!codec_available(static_cast<Codec>(e.codec))) {
+      PEREGRINE_LOG_ERROR("{} needs the {} codec, which was not compiled in"sv, path,
+          codec_name(static_cast<Codec>(e.codec)));
+      return fail(StatusCode::enotsup);
+    }
+  }
+
+  codecs = std::make_unique<Codecs>();
+  if(f.dictionary_size != 0) {
+    std::string dictionary(f.dictionary_size, '\0');
+    if(auto status = file.pread_exact(dictionary.data(), dictionary.size(), f.dictionary_offset);
+        status != StatusCode::ok)
+      return fail(status);
+#if defined(PEREGRINE_HAVE_ZSTD)
+    codecs->ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+  }
+
+  if(options.use_mmap && f.dictionary_offset != 0) {
+    if(auto status = map.map(file); status != StatusCode::ok) return fail(status);
+  }
+  return StatusCode::ok;
+}
+
+Result<size_t> CompressedFile::pread(void* buf, size_t count, uint64_t offset) const {
+  if(offset >= size()) return size_t{0};
+  count = static_cast<size_t>(std::min<uint64_t>(count, size() - offset));
+
+  auto* out = static_cast<char*>(buf);
+  for(size_t copied = 0; copied < count;) {
+    const uint64_t position = offset + copied;
+    const uint64_t block    = position / footer.block_size;
+    const uint64_t start    = position % footer.block_size;
+    const uint64_t raw = std::min<uint64_t>(footer.block_size, size() - block * footer.block_size);
+    const size_t n     = static_cast<size_t>(std::min<uint64_t>(count - copied, raw - start));
+    const IndexEntry& entry = index[block];
+
+    if(entry.codec == static_cast<uint8_t>(Codec::none)) {
+      // Stored blocks need no cache
+      if(map.data() != nullptr) {
+        std::memcpy(out + copied, static_cast<const char*>(map.data()) + entry.offset + start, n);
+      } else if(auto status = file.pread_exact(out + copied, n, entry.offset + start);
+                status != StatusCode::ok) {
+        return Result<size_t>::error(status);
+      }
+    } else {
+      auto data = load(block);
+      if(!data.ok()) return Result<size_t>::error(data.status());
+      std::memcpy(out + copied, data.value()->data() + start, n);
+    }
+    copied += n;
+  }
+  return count;
+}
+
+Result<CompressedFile::Block> CompressedFile::load(uint64_t block) const {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(auto it = cache.find(block); it != cache.end()) {
+      lru.splice(lru.begin(), lru, it->second.second);
+      counters.cache_hits.fetch_add(1, std::memory_order_relaxed);
+      return it->second.first;
+    }
+  }
+
+  // Decompress outside the lock so misses on different blocks run in parallel
+  counters.cache_misses.fetch_add(1, std::memory_order_relaxed);
+  auto data = decompress(block);
+  if(!data.ok() || options.cache_blocks == 0) return data;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if(auto it = cache.find(block); it != cache.end()) return it->second.first;
+  lru.push_front(block);
+  cache.emplace(block, std::make_pair(data.value(), lru.begin()));
+  while(cache.size() > options.cache_blocks) {
+    cache.erase(lru.back());
+    lru.pop_back();
+  }
+  return data;
+}
+
+StatusCode CompressedFile::read_stored(
+    uint64_t block, const char*& data, std::string& buffer) const {
+  const IndexEntry& entry = index[block];
+  if(map.data() != nullptr) {
+    data = static_cast<const char*>(map.data()) + entry.offset;
+    return StatusCode::ok;
+  }
+  buffer.resize(entry.size);
+  data = buffer.data();
+  return file.pread_exact(buffer.data(), entry.size, entry.offset);
+}
+
+Result<CompressedFile::Block> CompressedFile::decompress(uint64_t block) const {
+  const IndexEntry& entry = index[block];
+  const auto codec        = static_cast<Codec>(entry.codec);
+  const uint64_t raw = std::min<uint64_t>(footer.block_size, size() - block * footer.block_size);
+
+  const char* stored = nullptr;
+  std::string buffer;
+  if(auto status = read_stored(block, stored, buffer); status != StatusCode::ok)
+    return Result<Block>::error(status);
+
+  auto out         = std::make_shared<std::string>(raw, '\0');
+  const auto start = std::chrono::steady_clock::now();
+  bool ok          = false;
+  switch(codec) {
+#if defined(PEREGRINE_HAVE_LZ4)
+  case Codec::lz4: {
+    const int n = LZ4_decompress_safe(
+        stored, out->data(), static_cast<int>(entry.size), static_cast<int>(raw));
+    ok = n >= 0 && static_cast<uint64_t>(n) == raw;
+    break;
+  }
+#endif // defined(PEREGRINE_HAVE_LZ4)
+#if defined(PEREGRINE_HAVE_ZSTD)
+  case Codec::zstd: {
+    const size_t n =
+        codecs->ddict != nullptr
+            ? ZSTD_decompress_usingDDict(
+                  thread_dctx(), out->data(), raw, stored, entry.size, codecs->ddict)
+            : ZSTD_decompressDCtx(thread_dctx(), out->data(), raw, stored, entry.size);
+    ok = !ZSTD_isError(n) && n == raw;
+    break;
+  }
+#endif // defined(PEREGRINE_HAVE_ZSTD)
+  default: break;
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  if(!ok) {
+    PEREGRINE_LOG_ERROR("Block {} does not decompress with {}"sv, block, codec_name(codec));
+    return Result<Block>::error(StatusCode::ebadmsg);
+  }
+
+  counters.blocks[entry.codec].fetch_add(1, std::memory_order_relaxed);
+  counters.raw_bytes.fetch_add(raw, std::memory_order_relaxed);
+  counters.stored_bytes.fetch_add(entry.size, std::memory_order_relaxed);
+  counters.decompress_nanos.fetch_add(
+      static_cast<uint64_t>(std::chrono::nanoseconds(elapsed).count()), std::memory_order_relaxed);
+  return Block(std::move(out));
+}
+
+CompressionStats CompressedFile::stats() const noexcept {
+  CompressionStats stats;
+  for(size_t i = 0; i < codec_count; ++i)
+    stats.blocks[i] = counters.blocks[i].load(std::memory_order_relaxed);
+  stats.raw_bytes        = counters.raw_bytes.load(std::memory_order_relaxed);
+  stats.stored_bytes     = counters.stored_bytes.load(std::memory_order_relaxed);
+  stats.cache_hits       = counters.cache_hits.load(std::memory_order_relaxed);
+  stats.cache_misses     = counters.cache_misses.load(std::memory_order_relaxed);
+  stats.decompress_nanos = counters.decompress_nanos.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,237 @@
+#include "peregrine/internal/copy.hh"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+// Largest request handed to the kernel at once. Both copy_file_range() and sendfile() transfer at
+// most about 2 GiB per call anyway.
+constexpr size_t max_chunk = size_t{1} << 30;
+
+// Size of the buffer for the buffered fallbacks
+constexpr size_t buffer_size = size_t{1} << 20;
+
+size_t chunk_size(off_t remaining) noexcept {
+  return remaining < 0 ? max_chunk : std::min(static_cast<size_t>(remaining), max_chunk);
+}
+
+// True if the error means the method is not available for these files, not that the copy failed
+bool unsupported(StatusCode status) noexcept {
+  return status == StatusCode::enosys || status == StatusCode::exdev ||
+         status == StatusCode::einval || status == StatusCode::enotsup ||
+         status == StatusCode::eopnotsupp;
+}
+
+std::unique_ptr<char[]> make_buffer() noexcept {
+  return std::unique_ptr<char[]>(new(std::nothrow) char[buffer_size]);
+}
+
+// Each step moves up to `length` bytes with one method and returns the number of bytes moved
+// (zero at the end of the input), or the error status.
+
+Result<ssize_t> copy_file_range_step(const File& in, off_t& in_offset, const File& out,
+    off_t& out_offset, off_t length) noexcept {
+#if defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
+  loff_t in_off  = in_offset;
+  loff_t out_off = out_offset;
+  const ssize_t rc = ::peregrine::internal::copy_file_range(
+      in.native_handle(), &in_off, out.native_handle(), &out_off, chunk_size(length), 0);
+  if(PEREGRINE_UNLIKELY(rc == -1)) return Result<ssize_t>::error(errno_to_status());
+  in_offset  = in_off;
+  out_offset = out_off;
+  return rc;
+#else
+  static_cast<void>(in);
+  static_cast<void>(in_offset);
+  static_cast<void>(out);
+  static_cast<void>(out_offset);
+  static_cast<void>(length);
+  return Result<ssize_t>::error(StatusCode::enosys);
+#endif // defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
+}
+
+Result<ssize_t> sendfile_step(const File& in, off_t& in_offset, const File& out,
+    off_t& out_offset, off_t length) noexcept {
+#if defined(__linux__)
+  // sendfile() writes at the file offset of `out`
+  if(::peregrine::internal::lseek(out.native_handle(), out_offset, SEEK_SET) == -1)
+    return Result<ssize_t>::error(errno_to_status());
+  const ssize_t rc = ::peregrine::internal::sendfile(
+      out.native_handle(), in.native_handle(), &in_offset, chunk_size(length));
+  if(PEREGRINE_UNLIKELY(rc == -1)) return Result<ssize_t>::error(errno_to_status());
+  out_offset += rc;
+  return rc;
+#else
+  static_cast<void>(in);
+  static_cast<void>(in_offset);
+  static_cast<void>(out);
+  static_cast<void>(out_offset);
+  static_cast<void>(length);
+  return Result<ssize_t>::error(StatusCode::enosys);
+#endif // defined(__linux__)
+}
+
+Result<ssize_t> buffered_step(const File& in, off_t& in_offset, const File& out,
+    off_t& out_offset, off_t length, char* buffer) noexcept {
+  const size_t count = std::min(chunk_size(length), buffer_size);
+  auto [bytes, status] = in.pread(buffer, count, in_offset);
+  if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) return Result<ssize_t>::error(status);
+  if(auto write_status = out.pwrite_all(buffer, static_cast<size_t>(bytes), out_offset);
+      PEREGRINE_UNLIKELY(write_status != StatusCode::ok))
+    return Result<ssize_t>::error(write_status);
+  in_offset += bytes;
+  out_offset += bytes;
+  return bytes;
+}
+
+CopyMethod next_method(CopyMethod method) noexcept {
+  return method == CopyMethod::copy_file_range ? CopyMethod::sendfile : CopyMethod::buffered;
+}
+
+} // namespace
+
+std::string_view copy_method_name(CopyMethod method) noexcept {
+  switch(method) {
+  case CopyMethod::copy_file_range: return "copy_file_range"sv;
+  case CopyMethod::sendfile: return "sendfile"sv;
+  case CopyMethod::splice: return "splice"sv;
+  case CopyMethod::buffered: return "buffered"sv;
+  }
+  return "unknown"sv;
+}
+
+Result<off_t> copy_range(const File& in, off_t in_offset, const File& out, off_t out_offset,
+    off_t length, CopyStats* stats, CopyMethod method) noexcept {
+  if(PEREGRINE_UNLIKELY(in_offset < 0 || out_offset < 0 || length < 0))
+    return Result<off_t>::error(StatusCode::invalid_argument);
+  if(method == CopyMethod::splice) method = CopyMethod::buffered;
+
+  std::unique_ptr<char[]> buffer;
+  off_t copied = 0;
+  while(copied < length) {
+    const off_t remaining = length - copied;
+    Result<ssize_t> result{0};
+    switch(method) {
+    case CopyMethod::copy_file_range:
+      result = copy_file_range_step(in, in_offset, out, out_offset, remaining);
+      break;
+    case CopyMethod::sendfile:
+      result = sendfile_step(in, in_offset, out, out_offset, remaining);
+      break;
+    default:
+      if(buffer == nullptr && (buffer = make_buffer()) == nullptr)
+        return Result<off_t>::error(StatusCode::enomem);
+      result = buffered_step(in, in_offset, out, out_offset, remaining, buffer.get());
+      break;
+    }
+
+    if(PEREGRINE_UNLIKELY(!result.ok())) {
+      if(result.status() == StatusCode::eintr) continue;
+      // A failed step moved nothing, so the next method resumes where this one stopped
+      if(method != CopyMethod::buffered && unsupported(result.status())) {
+        PEREGRINE_LOG_DEBUG("{} is not supported for \"{}\" : {}, falling back"sv,
+            copy_method_name(method), FdPath{out.native_handle()}, result.status());
+        method = next_method(method);
+        continue;
+      }
+      return Result<off_t>::error(result.status());
+    }
+    if(result.value() == 0) break; // End of the input
+    copied += result.value();
+  }
+
+  if(stats != nullptr) {
+    stats->bytes  = copied;
+    stats->method = method;
+  }
+  return copied;
+}
+
+Result<off_t> copy_file(const File& in, const File& out, CopyStats* stats) noexcept {
+  struct stat st;
+  if(auto status = in.stat(&st); PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return Result<off_t>::error(status);
+  if(auto status = out.truncate(0); PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return Result<off_t>::error(status);
+
+  auto copied = copy_range(in, 0, out, 0, st.st_size, stats);
+  if(copied.ok() && copied.value() != st.st_size) {
+    // The input shrank during the copy
+    if(auto status = out.truncate(copied.value()); PEREGRINE_UNLIKELY(status != StatusCode::ok))
+      return Result<off_t>::error(status);
+  }
+  return copied;
+}
+
+Result<off_t> ingest(const File& in, const File& out, off_t out_offset, off_t max_length,
+    CopyStats* stats) noexcept {
+  if(PEREGRINE_UNLIKELY(out_offset < 0)) return Result<off_t>::error(StatusCode::invalid_argument);
+  const off_t limit = max_length < 0 ? std::numeric_limits<off_t>::max() : max_length;
+  CopyMethod method = CopyMethod::buffered;
+  off_t ingested    = 0;
+
+#if defined(PEREGRINE_HAVE_SPLICE)
+  struct stat st;
+  if(auto status = in.stat(&st); PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return Result<off_t>::error(status);
+
+  if(S_ISFIFO(st.st_mode)) {
+    method          = CopyMethod::splice;
+    const int flags = SPLICE_F_MOVE | SPLICE_F_MORE;
+    while(ingested < limit) {
+      loff_t offset    = out_offset + ingested;
+      const ssize_t rc = ::peregrine::internal::splice(in.native_handle(), nullptr,
+          out.native_handle(), &offset, chunk_size(limit - ingested), flags);
+      if(rc == 0) break;
+      if(PEREGRINE_UNLIKELY(rc == -1)) {
+        const StatusCode status = errno_to_status();
+        if(status == StatusCode::eintr) continue;
+        // Some file systems cannot be spliced into; nothing was consumed from the pipe
+        if(unsupported(status)) {
+          PEREGRINE_LOG_DEBUG("splice is not supported for \"{}\" : {}, falling back"sv,
+              FdPath{out.native_handle()}, status);
+          method = CopyMethod::buffered;
+          break;
+        }
+        return Result<off_t>::error(status);
+      }
+      ingested += rc;
+    }
+  }
+#endif // defined(PEREGRINE_HAVE_SPLICE)
+
+  if(method == CopyMethod::buffered) {
+    auto buffer = make_buffer();
+    if(PEREGRINE_UNLIKELY(buffer == nullptr)) return Result<off_t>::error(StatusCode::enomem);
+    while(ingested < limit) {
+      const size_t count   = std::min(chunk_size(limit - ingested), buffer_size);
+      auto [bytes, status] = in.read(buffer.get(), count);
+      if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+        if(status == StatusCode::eintr) continue;
+        return Result<off_t>::error(status);
+      }
+      if(bytes == 0) break;
+      if(auto write_status =
+              out.pwrite_all(buffer.get(), static_cast<size_t>(bytes), out_offset + ingested);
+          PEREGRINE_UNLIKELY(write_status != StatusCode::ok))
+        return Result<off_t>::error(write_status);
+      ingested += bytes;
+    }
+  }
+
+  if(stats != nullptr) {
+    stats->bytes  = ingested;
+    stats->method = method;
+  }
+  return ingested;
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,90 @@
+#include "peregrine/internal/elias_fano.hh"
+
+#include <cstring>
+
+namespace peregrine {
+namespace internal {
+
+Result<std::string> EliasFano::serialize(const std::vector<uint64_t>& values) {
+  for(size_t i = 1; i < values.size(); ++i) {
+    if(values[i] < values[i - 1]) return Result<std::string>::error(StatusCode::invalid_argument);
+  }
+
+  const uint64_t count    = values.size();
+  const uint64_t universe = values.empty() ? 0 : values.back();
+  uint32_t low_bits       = 0;
+  if(count != 0 && universe / count > 1) low_bits = 63 - __builtin_clzll(universe / count);
+
+  // Low bits packed, plus a zero word so reads of two words never run off the end
+  const uint64_t low_words = (count * low_bits + 63) / 64 + 1;
+  std::vector<uint64_t> lows(low_words, 0);
+  BitVector high(count + (universe >> low_bits) + 1);
+  for(uint64_t i = 0; i < count; ++i) {
+    const uint64_t v = values[i];
+    high.set((v >> low_bits) + i);
+    if(low_bits == 0) continue;
+    const uint64_t low   = v & ((uint64_t{1} << low_bits) - 1);
+    const uint64_t bit   = i * low_bits;
+    const uint64_t shift = bit % 64;
+    lows[bit / 64] |= low << shift;
+    if(shift + low_bits > 64) lows[bit / 64 + 1] |= low >> (64 - shift);
+  }
+
+  Header header{};
+  header.magic     = magic;
+  header.version   = version;
+  header.low_bits  = static_cast<uint16_t>(low_bits);
+  header.count     = count;
+  header.universe  = universe;
+  header.low_words = low_words;
+
+  std::string out(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.append(reinterpret_cast<const char*>(lows.data()), lows.size() * sizeof(uint64_t));
+  out += high.serialize();
+  return out;
+}
+
+Result<EliasFano> EliasFano::open(const void* data, size_t size) noexcept {
+  const auto invalid = [] { return Result<EliasFano>::error(StatusCode::invalid_argument); };
+  if(data == nullptr || reinterpret_cast<uintptr_t>(data) % 8 != 0) return invalid();
+  if(size < sizeof(Header)) return invalid();
+
+  EliasFano view;
+  view.header     = static_cast<const Header*>(data);
+  const Header& h = *view.header;
+  if(h.magic != magic || h.version != version || h.low_bits > 63) return invalid();
+  if(h.count > size * 8 || h.low_words != (h.count * h.low_bits + 63) / 64 + 1) return invalid();
+  if(h.low_words > (size - sizeof(Header)) / sizeof(uint64_t)) return invalid();
+  view.lows = reinterpret_cast<const uint64_t*>(view.header + 1);
+
+  const size_t offset = sizeof(Header) + h.low_words * sizeof(uint64_t);
+  auto high           = RankSelect::open(static_cast<const char*>(data) + offset, size - offset);
+  if(!high.ok()) return invalid();
+  view.high = high.value();
+
+  // The high bits must hold one one per value and one zero per bucket
+  if(view.high.ones() != h.count || view.high.zeros() != (h.universe >> h.low_bits) + 1)
+    return invalid();
+  return view;
+}
+
+uint64_t EliasFano::lower_bound(uint64_t value) const noexcept {
+  if(size() == 0 || value > universe()) return size();
+
+  // Jump to the bucket of `value`, then scan the values in it
+  const uint64_t bucket = value >> low_bits();
+  uint64_t pos          = bucket == 0 ? 0 : high.select0(bucket - 1) + 1;
+  uint64_t i            = pos - bucket;
+  for(; pos < high.size() && high.get(pos); ++pos, ++i) {
+    if(((bucket << low_bits()) | low(i)) >= value) return i;
+  }
+  return i;
+}
+
+size_t EliasFano::bytes() const noexcept {
+  if(header == nullptr) return 0;
+  return sizeof(Header) + header->low_words * sizeof(uint64_t) + high.bytes();
+}
+
+} // namespace internal
+} // namespace peregrine
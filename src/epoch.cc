@@ -0,0 +1,153 @@
+#include "peregrine/internal/epoch.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // defined(__linux__)
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace detail {
+bool epoch_asymmetric_fence = false;
+} // namespace detail
+
+namespace {
+
+#if defined(__linux__)
+
+int membarrier(int cmd, unsigned int flags) noexcept {
+  return static_cast<int>(::syscall(__NR_membarrier, cmd, flags, 0));
+}
+
+#endif // defined(__linux__)
+
+// Try to enable the asymmetric fence once per process.
+void init_asymmetric_fence() noexcept {
+  static std::once_flag once;
+  std::call_once(once, [] {
+#if defined(__linux__)
+    const int supported = membarrier(MEMBARRIER_CMD_QUERY, 0);
+    if(supported != -1 && (supported & MEMBARRIER_CMD_PRIVATE_EXPEDITED) &&
+        membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0) {
+      detail::epoch_asymmetric_fence = true;
+    }
+#endif // defined(__linux__)
+    PEREGRINE_LOG_DEBUG("Epoch reclamation asymmetric fence: {}"sv, detail::epoch_asymmetric_fence);
+  });
+}
+
+// The writer half of the reader fence. Orders every reader's slot store before our slot scan.
+void heavy_fence() noexcept {
+#if defined(__linux__)
+  if(detail::epoch_asymmetric_fence) {
+    if(PEREGRINE_LIKELY(membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0) == 0)) return;
+    // A failing membarrier would leave readers unordered; there is no safe fallback.
+    PEREGRINE_LOG_FAULT("membarrier failed with errno={}"sv, errno);
+    std::abort();
+  }
+#endif // defined(__linux__)
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+} // namespace
+
+void EpochReader::release() noexcept {
+  if(slot == nullptr) return;
+  slot->depth = 0;
+  slot->epoch.store(0, std::memory_order_release);
+  slot->in_use.store(false, std::memory_order_release);
+  slot   = nullptr;
+  domain = nullptr;
+}
+
+EpochDomain::EpochDomain() { init_asymmetric_fence(); }
+
+EpochDomain::~EpochDomain() {
+  retired.clear();
+  for(auto* slot = slots.load(std::memory_order_acquire); slot != nullptr;) {
+    auto* next = slot->next;
+    delete slot;
+    slot = next;
+  }
+}
+
+detail::EpochSlot* EpochDomain::acquire_slot() {
+  // Reuse a released slot if one is available
+  for(auto* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+    bool expected = false;
+    if(!slot->in_use.load(std::memory_order_relaxed) &&
+        slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+      return slot;
+  }
+
+  auto* slot = new detail::EpochSlot;
+  slot->in_use.store(true, std::memory_order_relaxed);
+  slot->next = slots.load(std::memory_order_relaxed);
+  while(!slots.compare_exchange_weak(
+      slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {}
+  return slot;
+}
+
+void EpochDomain::retire_impl(std::unique_ptr<detail::Retired> object) {
+  // Readers that entered at or before this epoch may still see the object. Advancing the epoch
+  // lets new readers be distinguished from them.
+  object->epoch = global_epoch.fetch_add(1, std::memory_order_seq_cst);
+  std::lock_guard lock(retired_mutex);
+  retired.push_back(std::move(object));
+}
+
+uint64_t EpochDomain::min_active_epoch() const noexcept {
+  uint64_t min_epoch = std::numeric_limits<uint64_t>::max();
+  for(auto* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+    const uint64_t epoch = slot->epoch.load(std::memory_order_acquire);
+    if(epoch != 0) min_epoch = std::min(min_epoch, epoch);
+  }
+  return min_epoch;
+}
+
+size_t EpochDomain::reclaim() {
+  std::vector<std::unique_ptr<detail::Retired>> expired;
+  {
+    std::lock_guard lock(retired_mutex);
+    if(retired.empty()) return 0;
+
+    heavy_fence();
+    const uint64_t min_epoch = min_active_epoch();
+
+    auto it = std::stable_partition(retired.begin(), retired.end(),
+        [min_epoch](const auto& object) { return object->epoch >= min_epoch; });
+    expired.assign(std::make_move_iterator(it), std::make_move_iterator(retired.end()));
+    retired.erase(it, retired.end());
+  }
+
+  // Destroy outside the lock; unmapping and closing may be slow.
+  const size_t count = expired.size();
+  expired.clear();
+  if(count) PEREGRINE_LOG_TRACE("Reclaimed {} retired objects"sv, count);
+  return count;
+}
+
+void EpochDomain::synchronize() {
+  while(true) {
+    reclaim();
+    if(pending() == 0) return;
+    std::this_thread::yield();
+  }
+}
+
+size_t EpochDomain::pending() const {
+  std::lock_guard lock(retired_mutex);
+  return retired.size();
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,85 @@
+#include "peregrine/internal/file_cache.hh"
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+Result<FileCache::Handle> FileCache::acquire(std::string_view path) {
+  {
+    std::lock_guard lock(mutex);
+    if(auto it = index.find(path); PEREGRINE_LIKELY(it != index.end())) {
+      lru.splice(lru.begin(), lru, it->second);
+      ++counters.hits;
+      return Handle{it->second->file};
+    }
+    ++counters.misses;
+  }
+
+  // Open outside the lock so a slow open does not stall hits on other files
+  File file;
+  if(auto status = file.open(path, flags); PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+    std::lock_guard lock(mutex);
+    ++counters.open_failures;
+    return Result<Handle>::error(status);
+  }
+
+  std::lock_guard lock(mutex);
+
+  // Another thread may have opened the same file in the meantime; prefer its descriptor.
+  if(auto it = index.find(path); it != index.end()) {
+    lru.splice(lru.begin(), lru, it->second);
+    return Handle{it->second->file};
+  }
+
+  lru.push_front(Entry{std::string(path), std::make_shared<File>(std::move(file))});
+  index.emplace(lru.front().path, lru.begin());
+  Handle handle = lru.front().file;
+  evict_idle();
+  return handle;
+}
+
+Result<File> FileCache::dup(std::string_view path) {
+  auto handle = acquire(path);
+  if(PEREGRINE_UNLIKELY(!handle.ok())) return Result<File>::error(handle.status());
+  return handle.value()->dup();
+}
+
+void FileCache::evict_idle() {
+  for(auto it = lru.end(); lru.size() > capacity && it != lru.begin();) {
+    --it;
+    // Only the cache holds an idle descriptor
+    if(it->file.use_count() != 1) continue;
+
+    PEREGRINE_LOG_TRACE("Evicting cached descriptor for \"{}\""sv, it->path);
+    index.erase(it->path);
+    it = lru.erase(it);
+    ++counters.evictions;
+  }
+}
+
+bool FileCache::erase(std::string_view path) {
+  std::lock_guard lock(mutex);
+  auto it = index.find(path);
+  if(it == index.end()) return false;
+  auto entry = it->second;
+  index.erase(it);
+  lru.erase(entry);
+  return true;
+}
+
+void FileCache::clear() {
+  std::lock_guard lock(mutex);
+  index.clear();
+  lru.clear();
+}
+
+FileCacheStats FileCache::stats() const {
+  std::lock_guard lock(mutex);
+  FileCacheStats stats = counters;
+  stats.open_files     = lru.size();
+  return stats;
+}
+
+} // namespace internal
+} // namespace peregrine
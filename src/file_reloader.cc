@@ -0,0 +1,181 @@
+#include "peregrine/internal/file_reloader.hh"
+
+#include <cstring>
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+const struct timespec& mtime_of(const struct stat& st) noexcept {
+#if defined(__APPLE__)
+  return st.st_mtimespec;
+#else
+  return st.st_mtim;
+#endif // defined(__APPLE__)
+}
+
+bool same_file(const MappedIndex& index, const struct stat& st) noexcept {
+  const auto& mtime = mtime_of(st);
+  return index.device == st.st_dev && index.inode == st.st_ino && index.size == st.st_size &&
+         index.mtime.tv_sec == mtime.tv_sec && index.mtime.tv_nsec == mtime.tv_nsec;
+}
+
+} // namespace
+
+FileReloader::FileReloader(EpochDomain& domain, std::string path, Options options) :
+    domain(domain), file_path(std::move(path)), options(std::move(options)), current(domain) {
+  const auto slash = file_path.rfind('/');
+  file_name        = slash == std::string::npos ? file_path : file_path.substr(slash + 1);
+}
+
+FileReloader::~FileReloader() {
+  if(notify_fd != -1) ::peregrine::internal::close(notify_fd);
+}
+
+ReloadResult FileReloader::reload() {
+  const auto start = std::chrono::steady_clock::now();
+  ReloadResult result;
+  auto finish = [&](StatusCode status, bool changed) {
+    result.status     = status;
+    result.changed    = changed;
+    result.generation = generation;
+    result.duration   = std::chrono::steady_clock::now() - start;
+    return result;
+  };
+
+  File file;
+  if(auto status = file.open(file_path, O_RDONLY | O_CLOEXEC); status != StatusCode::ok)
+    return finish(status, false);
+
+  struct stat st;
+  if(auto status = file.stat(&st); status != StatusCode::ok) return finish(status, false);
+
+  // Only this thread publishes, so the current mapping cannot be retired underneath us.
+  if(const auto* old = current.load(); old != nullptr && same_file(*old, st))
+    return finish(StatusCode::ok, false);
+
+  if(PEREGRINE_UNLIKELY(st.st_size <= 0)) {
+    PEREGRINE_LOG_ERROR("Refusing to map empty file \"{}\""sv, file_path);
+    return finish(StatusCode::invalid_argument, false);
+  }
+
+  auto index = std::make_unique<MappedIndex>();
+  auto status = index->map.map(file, options.prot, options.map_flags);
+  if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+    PEREGRINE_LOG_ERROR("Failed to map \"{}\" : {}"sv, file_path, status);
+    return finish(status, false);
+  }
+
+  if(options.validator) {
+    if(status = options.validator(file, index->map); status != StatusCode::ok) {
+      PEREGRINE_LOG_ERROR("Validation failed for \"{}\" : {}"sv, file_path, status);
+      return finish(status, false);
+    }
+  }
+
+  // Fault the new mapping in before readers can see it
+  if(options.prefault) {
+    if(status = index->map.advise(MADV_WILLNEED); status != StatusCode::ok)
+      PEREGRINE_LOG_WARN("MADV_WILLNEED failed for \"{}\" : {}"sv, file_path, status);
+  }
+
+  index->device     = st.st_dev;
+  index->inode      = st.st_ino;
+  index->size       = st.st_size;
+  index->mtime      = mtime_of(st);
+  index->generation = ++generation;
+  current.publish(std::move(index));
+  domain.reclaim();
+
+  finish(StatusCode::ok, true);
+  PEREGRINE_LOG_INFO("Reloaded \"{}\" generation={} size={} in {}us"sv, file_path, generation,
+      st.st_size, std::chrono::duration_cast<std::chrono::microseconds>(result.duration).count());
+  return result;
+}
+
+#if defined(__linux__)
+
+StatusCode FileReloader::watch() {
+  if(notify_fd != -1) return StatusCode::already_open;
+
+  const auto slash      = file_path.rfind('/');
+  const std::string dir = slash == std::string::npos ? "."s
+                          : slash == 0               ? "/"s
+                                                     : file_path.substr(0, slash);
+
+  notify_fd = ::peregrine::internal::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(PEREGRINE_UNLIKELY(notify_fd == -1)) {
+    auto status = errno_to_status();
+    PEREGRINE_LOG_ERROR("inotify_init1 failed : {}"sv, status);
+    return status;
+  }
+
+  // Renames cover atomic deploys, close-after-write covers in-place rewrites.
+  const auto rc = ::peregrine::internal::inotify_add_watch(
+      notify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if(PEREGRINE_UNLIKELY(rc == -1)) {
+    auto status = errno_to_status();
+    PEREGRINE_LOG_ERROR("inotify_add_watch failed for \"{}\" : {}"sv, dir, status);
+    ::peregrine::internal::close(notify_fd);
+    notify_fd = -1;
+    return status;
+  }
+
+  PEREGRINE_LOG_DEBUG("Watching \"{}\" for changes to \"{}\""sv, dir, file_name);
+  return StatusCode::ok;
+}
+
+bool FileReloader::drain_events() {
+  alignas(struct inotify_event) char buf[4096];
+  bool relevant = false;
+
+  while(true) {
+    const ssize_t n = ::peregrine::internal::read(notify_fd, buf, sizeof(buf));
+    if(n <= 0) break;
+
+    for(ssize_t pos = 0; pos < n;) {
+      const auto* event = reinterpret_cast<const struct inotify_event*>(buf + pos);
+      if(event->mask & IN_Q_OVERFLOW) relevant = true;
+      if(event->len != 0 && file_name == event->name) relevant = true;
+      pos += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  return relevant;
+}
+
+#else
+
+StatusCode FileReloader::watch() { return StatusCode::enotsup; }
+
+bool FileReloader::drain_events() { return false; }
+
+#endif // defined(__linux__)
+
+ReloadResult FileReloader::poll(int timeout_ms) {
+  ReloadResult result;
+  result.generation = generation;
+  if(PEREGRINE_UNLIKELY(notify_fd == -1)) {
+    result.status = StatusCode::not_open;
+    return result;
+  }
+
+  struct pollfd pfd {
+    notify_fd, POLLIN, 0
+  };
+  const int rc = ::peregrine::internal::poll(&pfd, 1, timeout_ms);
+  if(rc == -1) {
+    result.status = errno_to_status();
+    if(result.status != StatusCode::eintr)
+      PEREGRINE_LOG_ERROR("poll failed for inotify watch : {}"sv, result.status);
+    return result;
+  }
+  if(rc == 0 || !drain_events()) return result;
+
+  return reload();
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,215 @@
+#include "peregrine/internal/index_file.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+// Pages checked per residency sample
+constexpr size_t residency_window = 64;
+
+size_t physical_memory() noexcept {
+  const long pages = ::sysconf(_SC_PHYS_PAGES);
+  return pages > 0 ? static_cast<size_t>(pages) * page_size() : 0;
+}
+
+// Count the resident pages in `pages` pages starting at `addr`
+Result<size_t> resident_pages(char* addr, size_t pages, std::vector<unsigned char>& vec) noexcept {
+  vec.resize(pages);
+#if defined(__APPLE__)
+  auto* out = reinterpret_cast<char*>(vec.data());
+#else
+  auto* out = vec.data();
+#endif // defined(__APPLE__)
+  if(PEREGRINE_UNLIKELY(::peregrine::internal::mincore(addr, pages * page_size(), out) != 0))
+    return Result<size_t>::error(errno_to_status());
+  return static_cast<size_t>(
+      std::count_if(vec.begin(), vec.end(), [](unsigned char page) { return (page & 1) != 0; }));
+}
+
+std::string_view mode_name(AccessMode mode) noexcept {
+  return mode == AccessMode::mmap ? "mmap"sv : "pread"sv;
+}
+
+} // namespace
+
+IndexFile::IndexFile(EpochDomain& domain, Options options) noexcept :
+    domain(domain), options(options), map(domain) {}
+
+StatusCode IndexFile::open(std::string_view path) {
+  if(PEREGRINE_UNLIKELY(file.is_open())) return StatusCode::already_open;
+  if(auto status = file.open(path, O_RDONLY | O_CLOEXEC); status != StatusCode::ok) return status;
+
+  struct stat st;
+  if(auto status = file.stat(&st); PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+    file.close();
+    return status;
+  }
+  file_size = st.st_size;
+
+  // Only size and residency are known before the first read
+  AccessProfile initial = profile();
+  if(auto resident = residency(); resident.ok()) initial.resident_fraction = resident.value();
+  const AccessMode mode = options.adaptive ? choose(initial, options) : AccessMode::mmap;
+  if(auto status = set_mode(mode); PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+    file.close();
+    return status;
+  }
+  switches = 0;
+
+  PEREGRINE_LOG_DEBUG("Opened index file \"{}\" of {} bytes using {}"sv, path, file_size,
+      mode_name(mode));
+  return StatusCode::ok;
+}
+
+Result<ssize_t> IndexFile::read(void* buffer, size_t count, off_t offset) const noexcept {
+  record(count, offset);
+
+  const MmapFile* mapped = map.load();
+  if(mapped == nullptr) return file.pread(buffer, count, offset);
+
+  if(PEREGRINE_UNLIKELY(offset < 0)) return Result<ssize_t>::error(StatusCode::invalid_argument);
+  const auto begin = static_cast<size_t>(offset);
+  if(begin >= mapped->size()) return 0;
+  const size_t length = std::min(count, mapped->size() - begin);
+  std::memcpy(buffer, static_cast<const char*>(mapped->data()) + begin, length);
+  return static_cast<ssize_t>(length);
+}
+
+Result<AccessMode> IndexFile::adapt() {
+  const AccessMode current = mode();
+  if(!options.adaptive || !file.is_open()) return current;
+
+  AccessProfile observed = profile();
+  if(observed.reads < options.min_reads) return current;
+  if(auto resident = residency(); resident.ok()) observed.resident_fraction = resident.value();
+  reset_profile();
+
+  const AccessMode preferred = choose(observed, options);
+  if(preferred == current) return current;
+
+  PEREGRINE_LOG_INFO("Switching index file from {} to {} ({} of {} reads sequential, {:.2f} "
+                     "resident)"sv,
+      mode_name(current), mode_name(preferred), observed.sequential_reads, observed.reads,
+      observed.resident_fraction);
+  if(auto status = set_mode(preferred); PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return Result<AccessMode>::error(status);
+  return preferred;
+}
+
+StatusCode IndexFile::set_mode(AccessMode mode) {
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return StatusCode::not_open;
+  if(mode == this->mode() && (mode == AccessMode::pread || map.load() != nullptr))
+    return StatusCode::ok;
+
+  if(mode == AccessMode::pread) {
+    // Readers still copying from the mapping keep it alive until they leave
+    map.publish(nullptr);
+  } else {
+    // An empty file cannot be mapped; reads of it return end of file either way
+    if(file_size > 0) {
+      auto mapped = std::make_unique<MmapFile>();
+      if(auto status = mapped->map(file, PROT_READ, MAP_SHARED);
+          PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+        PEREGRINE_LOG_ERROR("Failed to map index file : {}"sv, status);
+        return status;
+      }
+      map.publish(std::move(mapped));
+    }
+  }
+
+  current_mode.store(mode, std::memory_order_relaxed);
+  ++switches;
+  domain.reclaim();
+  return StatusCode::ok;
+}
+
+Result<double> IndexFile::residency() noexcept {
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return Result<double>::error(StatusCode::not_open);
+  if(file_size == 0) return 1.0;
+
+  // Mapping without touching the pages populates no page tables, so this is cheap for any size
+  MmapFile probe;
+  if(auto status = probe.map(file, 0, static_cast<size_t>(file_size), PROT_READ, MAP_SHARED);
+      PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return Result<double>::error(status);
+
+  const size_t total_pages = (static_cast<size_t>(file_size) + page_size() - 1) / page_size();
+  const size_t samples     = std::max<size_t>(options.residency_samples, 1);
+  const size_t window      = std::min(total_pages, residency_window);
+  auto* const base         = static_cast<char*>(probe.data());
+
+  std::vector<unsigned char> vec;
+  size_t checked = 0, resident = 0;
+  if(total_pages <= samples * window) {
+    auto count = resident_pages(base, total_pages, vec);
+    if(PEREGRINE_UNLIKELY(!count.ok())) return Result<double>::error(count.status());
+    checked  = total_pages;
+    resident = count.value();
+  } else {
+    const size_t stride = (total_pages - window) / (samples - (samples > 1 ? 1 : 0));
+    for(size_t i = 0; i < samples; ++i) {
+      const size_t first = std::min(i * stride, total_pages - window);
+      auto count         = resident_pages(base + first * page_size(), window, vec);
+      if(PEREGRINE_UNLIKELY(!count.ok())) return Result<double>::error(count.status());
+      checked += window;
+      resident += count.value();
+    }
+  }
+  return static_cast<double>(resident) / static_cast<double>(checked);
+}
+
+AccessProfile IndexFile::profile() const noexcept {
+  AccessProfile result;
+  result.file_size        = file_size;
+  result.memory_size      = physical_memory();
+  for(const auto& stripe : stripes) {
+    result.reads += stripe.reads.load(std::memory_order_relaxed);
+    result.sequential_reads += stripe.sequential_reads.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+AccessMode IndexFile::choose(const AccessProfile& profile, const Options& options) noexcept {
+  if(profile.file_size <= options.small_file_size) return AccessMode::mmap;
+
+  // A file that fits comfortably in memory ends up resident, where a mapping is cheapest
+  const double memory_limit =
+      static_cast<double>(profile.memory_size) * options.max_memory_fraction;
+  if(profile.memory_size == 0 || static_cast<double>(profile.file_size) <= memory_limit)
+    return AccessMode::mmap;
+  if(profile.resident_fraction >= options.resident_fraction) return AccessMode::mmap;
+
+  // Large and mostly cold: a mapping only pays off when readahead is put to use. Without
+  // observations assume the random access typical of index lookups.
+  const double random =
+      profile.reads == 0 ? 1.0
+                         : 1.0 - static_cast<double>(profile.sequential_reads) /
+                                     static_cast<double>(profile.reads);
+  return random >= options.random_fraction ? AccessMode::pread : AccessMode::mmap;
+}
+
+void IndexFile::record(size_t count, off_t offset) const noexcept {
+  ProfileStripe& stripe = stripes[thread_stripe<stripe_count>()];
+  stripe.reads.fetch_add(1, std::memory_order_relaxed);
+  if(stripe.last_end.load(std::memory_order_relaxed) == offset)
+    stripe.sequential_reads.fetch_add(1, std::memory_order_relaxed);
+  stripe.last_end.store(offset + static_cast<off_t>(count), std::memory_order_relaxed);
+}
+
+void IndexFile::reset_profile() noexcept {
+  for(auto& stripe : stripes) {
+    stripe.reads.store(0, std::memory_order_relaxed);
+    stripe.sequential_reads.store(0, std::memory_order_relaxed);
+  }
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,92 @@
+#include "peregrine/internal/io_pool.hh"
+
+#include <algorithm>
+#include <memory>
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+IoThreadPool::IoThreadPool(size_t thread_count) {
+  thread_count = std::max<size_t>(thread_count, 1);
+  threads.reserve(thread_count);
+  for(size_t i = 0; i < thread_count; ++i) threads.emplace_back([this] { run(); });
+  PEREGRINE_LOG_DEBUG("Started I/O thread pool with {} threads"sv, thread_count);
+}
+
+IoThreadPool::~IoThreadPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  for(auto& thread : threads) thread.join();
+}
+
+void IoThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  cv.notify_one();
+}
+
+void IoThreadPool::run() noexcept {
+  while(true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(mutex);
+      cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if(tasks.empty()) return;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+bool AsyncReader::pread(
+    const File& file, void* buf, size_t count, off_t offset, Callback callback) {
+  const auto result = file.pread_nowait(buf, count, offset);
+
+  // Fully cached, or a definite end of file
+  if(PEREGRINE_LIKELY(result.ok()) &&
+      (static_cast<size_t>(result.value()) == count || result.value() == 0)) {
+    inline_reads.fetch_add(1, std::memory_order_relaxed);
+    callback(result);
+    return true;
+  }
+
+  // A hard error will not go away by blocking
+  if(PEREGRINE_UNLIKELY(!result.ok() && result.status() != StatusCode::eagain)) {
+    callback(result);
+    return true;
+  }
+
+  // Only part of the range, or none of it, was cached. Block for the rest on an I/O thread.
+  const size_t done = result.ok() ? static_cast<size_t>(result.value()) : 0;
+  offloaded_reads.fetch_add(1, std::memory_order_relaxed);
+  pool.submit([&file, buf, count, offset, done, callback = std::move(callback)] {
+    const auto rest =
+        file.pread(static_cast<char*>(buf) + done, count - done, offset + static_cast<off_t>(done));
+    if(PEREGRINE_UNLIKELY(!rest.ok())) {
+      callback(rest);
+    } else {
+      callback(static_cast<ssize_t>(done) + rest.value());
+    }
+  });
+  return false;
+}
+
+std::future<Result<ssize_t>> AsyncReader::pread(
+    const File& file, void* buf, size_t count, off_t offset) {
+  auto promise = std::make_shared<std::promise<Result<ssize_t>>>();
+  auto future  = promise->get_future();
+  pread(file, buf, count, offset,
+      [promise](Result<ssize_t> bytes_read) { promise->set_value(bytes_read); });
+  return future;
+}
+
+} // namespace internal
+} // namespace peregrine
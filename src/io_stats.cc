@@ -0,0 +1,108 @@
+#include "peregrine/internal/io_stats.hh"
+
+#include <cmath>
+#include <new>
+
+namespace peregrine {
+namespace internal {
+
+std::string_view io_op_name(IoOp op) noexcept {
+  switch(op) {
+  case IoOp::read: return "read"sv;
+  case IoOp::pread: return "pread"sv;
+  case IoOp::readv: return "readv"sv;
+  case IoOp::preadv: return "preadv"sv;
+  case IoOp::pread_nowait: return "pread_nowait"sv;
+  case IoOp::write: return "write"sv;
+  case IoOp::pwrite: return "pwrite"sv;
+  case IoOp::writev: return "writev"sv;
+  case IoOp::pwritev: return "pwritev"sv;
+  case IoOp::fsync: return "fsync"sv;
+  case IoOp::sync_file_range: return "sync_file_range"sv;
+  case IoOp::count: break;
+  }
+  return "unknown"sv;
+}
+
+uint64_t IoHistogram::count() const noexcept {
+  uint64_t total = 0;
+  for(auto n : counts) total += n;
+  return total;
+}
+
+uint64_t IoHistogram::percentile(double q) const noexcept {
+  const uint64_t total = count();
+  if(total == 0) return 0;
+
+  // Rank of the requested value, 1-based
+  const double clamped = q < 0.0 ? 0.0 : (q > 1.0 ? 1.0 : q);
+  uint64_t rank        = static_cast<uint64_t>(std::ceil(clamped * static_cast<double>(total)));
+  if(rank == 0) rank = 1;
+
+  uint64_t seen = 0;
+  for(size_t i = 0; i < bucket_count; ++i) {
+    seen += counts[i];
+    if(seen >= rank) return upper_bound(i);
+  }
+  return upper_bound(bucket_count - 1);
+}
+
+IoHistogram& IoHistogram::operator+=(const IoHistogram& other) noexcept {
+  for(size_t i = 0; i < bucket_count; ++i) counts[i] += other.counts[i];
+  return *this;
+}
+
+IoStats::~IoStats() {
+  for(auto& slot : stripes) delete slot.load(std::memory_order_relaxed);
+}
+
+IoStats::Stripe* IoStats::allocate_stripe(std::atomic<Stripe*>& slot) noexcept {
+  // Statistics are best effort; if memory is short the call is simply not recorded.
+  Stripe* stripe = new(std::nothrow) Stripe;
+  if(stripe == nullptr) return nullptr;
+
+  Stripe* expected = nullptr;
+  if(!slot.compare_exchange_strong(
+         expected, stripe, std::memory_order_acq_rel, std::memory_order_acquire)) {
+    // Another thread sharing the stripe won the race
+    delete stripe;
+    return expected;
+  }
+  return stripe;
+}
+
+IoStatsSnapshot IoStats::snapshot() const noexcept {
+  IoStatsSnapshot result;
+  for(const auto& slot : stripes) {
+    const Stripe* stripe = slot.load(std::memory_order_acquire);
+    if(stripe == nullptr) continue;
+
+    for(size_t op = 0; op < io_op_count; ++op) {
+      const Counters& counters = stripe->ops[op];
+      IoOpStats& stats         = result.ops[op];
+      stats.calls += counters.calls.load(std::memory_order_relaxed);
+      stats.errors += counters.errors.load(std::memory_order_relaxed);
+      stats.bytes += counters.bytes.load(std::memory_order_relaxed);
+      for(size_t i = 0; i < IoHistogram::bucket_count; ++i)
+        stats.latency.counts[i] += counters.latency[i].load(std::memory_order_relaxed);
+    }
+  }
+  return result;
+}
+
+void IoStats::reset() noexcept {
+  for(auto& slot : stripes) {
+    Stripe* stripe = slot.load(std::memory_order_acquire);
+    if(stripe == nullptr) continue;
+
+    for(auto& counters : stripe->ops) {
+      counters.calls.store(0, std::memory_order_relaxed);
+      counters.errors.store(0, std::memory_order_relaxed);
+      counters.bytes.store(0, std::memory_order_relaxed);
+      for(auto& bucket : counters.latency) bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,179 @@
+#include "peregrine/internal/key_block.hh"
+
+#include <algorithm>
+
+#include "peregrine/internal/simd.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+void put_varint(std::string& out, uint64_t value) {
+  for(; value >= 0x80; value >>= 7) out.push_back(static_cast<char>(value | 0x80));
+  out.push_back(static_cast<char>(value));
+}
+
+// Decode a varint, or return nullptr if it runs past `end`
+const char* get_varint(const char* p, const char* end, uint64_t& value) noexcept {
+  value = 0;
+  for(uint32_t shift = 0; p < end && shift < 64; shift += 7) {
+    const auto byte = static_cast<unsigned char>(*p++);
+    value |= uint64_t{byte & 0x7fu} << shift;
+    if(byte < 0x80) return p;
+  }
+  return nullptr;
+}
+
+size_t restarts_bytes(size_t restarts) noexcept {
+  return restarts * sizeof(uint64_t) + (restarts * sizeof(uint32_t) + 7) / 8 * 8;
+}
+
+} // namespace
+
+StatusCode KeyBlockBuilder::add(std::string_view key, std::string_view value) {
+  if(count != 0 && compare_bytes(key, last) <= 0) return StatusCode::invalid_argument;
+
+  size_t shared = 0;
+  if(count % restart_interval == 0) {
+    prefixes.push_back(normalized_prefix(key));
+    restarts.push_back(static_cast<uint32_t>(entries.size()));
+  } else {
+    shared = mismatch(key.data(), last.data(), std::min(key.size(), last.size()));
+  }
+
+  put_varint(entries, shared);
+  put_varint(entries, key.size() - shared);
+  put_varint(entries, value.size());
+  entries.append(key.substr(shared));
+  entries.append(value);
+  last.assign(key);
+  ++count;
+  return StatusCode::ok;
+}
+
+size_t KeyBlockBuilder::serialized_size() const noexcept {
+  return sizeof(KeyBlock::Header) + restarts_bytes(restarts.size()) + entries.size();
+}
+
+std::string KeyBlockBuilder::finish() {
+  KeyBlock::Header header{};
+  header.magic            = KeyBlock::magic;
+  header.version          = KeyBlock::version;
+  header.restart_interval = static_cast<uint16_t>(std::min<uint32_t>(restart_interval, 65535));
+  header.count            = count;
+  header.restarts         = static_cast<uint32_t>(restarts.size());
+  header.entries_bytes    = entries.size();
+
+  std::string out(serialized_size(), '\0');
+  char* p = out.data();
+  std::memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  std::memcpy(p, prefixes.data(), prefixes.size() * sizeof(uint64_t));
+  p += prefixes.size() * sizeof(uint64_t);
+  std::memcpy(p, restarts.data(), restarts.size() * sizeof(uint32_t));
+  p = out.data() + sizeof(header) + restarts_bytes(restarts.size());
+  std::memcpy(p, entries.data(), entries.size());
+
+  entries.clear();
+  prefixes.clear();
+  restarts.clear();
+  last.clear();
+  count = 0;
+  return out;
+}
+
+void KeyBlock::Iterator::next() {
+  is_valid = false;
+  if(next_entry == nullptr || next_entry >= end) return;
+
+  uint64_t shared, unshared, value_size;
+  const char* p = get_varint(next_entry, end, shared);
+  if(p != nullptr) p = get_varint(p, end, unshared);
+  if(p != nullptr) p = get_varint(p, end, value_size);
+  if(p == nullptr || shared > current.size() || unshared > static_cast<size_t>(end - p) ||
+      value_size > static_cast<size_t>(end - p) - unshared) {
+    next_entry = nullptr;
+    return;
+  }
+
+  current.resize(shared);
+  current.append(p, unshared);
+  current_value = std::string_view(p + unshared, value_size);
+  next_entry    = p + unshared + value_size;
+  is_valid      = true;
+}
+
+Result<KeyBlock> KeyBlock::open(const void* data, size_t size) noexcept {
+  const auto invalid = [] { return Result<KeyBlock>::error(StatusCode::invalid_argument); };
+  if(data == nullptr || reinterpret_cast<uintptr_t>(data) % 8 != 0) return invalid();
+  if(size < sizeof(Header)) return invalid();
+
+  KeyBlock view;
+  view.header     = static_cast<const Header*>(data);
+  const Header& h = *view.header;
+  if(h.magic != magic || h.version != version) return invalid();
+  if(h.restarts > h.count || (h.count != 0 && h.restarts == 0)) return invalid();
+  if(h.restarts > size / sizeof(uint64_t) || h.entries_bytes > size) return invalid();
+  if(sizeof(Header) + restarts_bytes(h.restarts) + h.entries_bytes > size) return invalid();
+
+  const auto* base = static_cast<const char*>(data);
+  view.prefixes    = reinterpret_cast<const uint64_t*>(base + sizeof(Header));
+  view.restarts    = reinterpret_cast<const uint32_t*>(view.prefixes + h.restarts);
+  view.entries     = base + sizeof(Header) + restarts_bytes(h.restarts);
+
+  // Restarts must be increasing and start entries, which store their keys in full
+  for(uint32_t i = 0; i < h.restarts; ++i) {
+    if(view.restarts[i] >= h.entries_bytes) return invalid();
+    if(i == 0 ? view.restarts[i] != 0 : view.restarts[i] <= view.restarts[i - 1]) return invalid();
+    if(view.entries[view.restarts[i]] != 0) return invalid();
+  }
+  return view;
+}
+
+size_t KeyBlock::bytes() const noexcept {
+  if(header == nullptr) return 0;
+  return sizeof(Header) + restarts_bytes(header->restarts) + header->entries_bytes;
+}
+
+std::string_view KeyBlock::restart_key(uint32_t i) const noexcept {
+  const char* end = entries + entries_bytes();
+  uint64_t shared, unshared, value_size;
+  const char* p = get_varint(entries + restarts[i], end, shared);
+  if(p != nullptr) p = get_varint(p, end, unshared);
+  if(p != nullptr) p = get_varint(p, end, value_size);
+  if(p == nullptr || unshared > static_cast<size_t>(end - p)) return {};
+  return {p, unshared};
+}
+
+KeyBlock::Iterator KeyBlock::seek(std::string_view key) const {
+  if(size() == 0) return {};
+
+  // Find the last restart whose key is not greater than `key`
+  const uint64_t prefix = normalized_prefix(key);
+  uint32_t lo = 0, hi = header->restarts - 1;
+  while(lo < hi) {
+    const uint32_t mid = lo + (hi - lo + 1) / 2;
+    const bool before  = prefixes[mid] != prefix ? prefixes[mid] < prefix
+                                                 : compare_bytes(restart_key(mid), key) <= 0;
+    if(before) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  Iterator it(entries + restarts[lo], entries + entries_bytes());
+  while(it.valid() && compare_bytes(it.key(), key) < 0) it.next();
+  return it;
+}
+
+bool KeyBlock::get(std::string_view key, std::string_view& value) const {
+  const Iterator it = seek(key);
+  if(!it.valid() || compare_bytes(it.key(), key) != 0) return false;
+  value = it.value();
+  return true;
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,176 @@
+#include "peregrine/internal/merge_iterator.hh"
+
+#include <algorithm>
+
+#include "peregrine/internal/key_block.hh"
+#include "peregrine/internal/simd.hh"
+
+namespace peregrine {
+namespace internal {
+
+Result<size_t> SpanSource::fill(MergeEntry* out, size_t max) {
+  const size_t n = std::min(max, count - position);
+  std::copy(entries + position, entries + position + n, out);
+  position += n;
+  return n;
+}
+
+Result<size_t> SortedFileSource::fill(MergeEntry* out, size_t max) {
+  // Copy first and point into the arena after, since appending may move it
+  arena.clear();
+  sizes.clear();
+  for(; sizes.size() < max && iterator.valid(); iterator.next()) {
+    arena.append(iterator.key());
+    arena.append(iterator.value());
+    sizes.emplace_back(iterator.key().size(), iterator.value().size());
+  }
+  if(PEREGRINE_UNLIKELY(iterator.status() != StatusCode::ok))
+    return Result<size_t>::error(iterator.status());
+
+  const char* p = arena.data();
+  for(size_t i = 0; i < sizes.size(); ++i) {
+    const auto [key_size, value_size] = sizes[i];
+    out[i].key                        = std::string_view(p, key_size);
+    out[i].value                      = std::string_view(p + key_size, value_size);
+    out[i].sequence                   = sequence;
+    out[i].tombstone                  = false;
+    p += key_size + value_size;
+  }
+  return sizes.size();
+}
+
+MergeIterator::MergeIterator(std::vector<std::unique_ptr<MergeSource>> sources, Options options) :
+    options(options) {
+  this->options.source_batch = std::max<size_t>(options.source_batch, 1);
+  runs.resize(sources.size());
+  for(size_t i = 0; i < sources.size(); ++i) runs[i].source = std::move(sources[i]);
+
+  size_t leaves = 1;
+  while(leaves < runs.size()) leaves *= 2;
+  heads.assign(leaves, Head{UINT64_MAX, nullptr});
+  tree.assign(leaves, 0);
+}
+
+Result<size_t> MergeIterator::next_batch(MergeEntry* out, size_t max) {
+  if(PEREGRINE_UNLIKELY(error != StatusCode::ok)) return Result<size_t>::error(error);
+  if(!started) {
+    for(uint32_t i = 0; i < runs.size(); ++i) {
+      if(auto status = refill(i); status != StatusCode::ok) return Result<size_t>::error(status);
+    }
+    build();
+    started = true;
+  }
+
+  size_t n = 0;
+  while(n < max) {
+    if(stale != none) {
+      // Entries returned in this batch may point into the run's buffer
+      if(n != 0) break;
+      keep_last_key();
+      if(auto status = refill(stale); status != StatusCode::ok)
+        return Result<size_t>::error(status);
+      replay(stale);
+      stale = none;
+    }
+
+    const uint32_t winner = tree[0];
+    const MergeEntry* e   = heads[winner].entry;
+    if(e == nullptr) break;
+
+    // Only the newest version of a key decides whether it was deleted. Older versions of a
+    // dropped tombstone go too, or they would bring the key back.
+    ++counters.entries_read;
+    if(!has_last || e->key != last_key) {
+      last_key     = e->key;
+      has_last     = true;
+      last_dropped = e->tombstone && options.drop_tombstones;
+      if(last_dropped) {
+        ++counters.tombstones_dropped;
+      } else {
+        out[n++] = *e;
+      }
+    } else if(options.resolve_duplicates || last_dropped) {
+      ++counters.duplicates_dropped;
+    } else {
+      out[n++] = *e;
+    }
+
+    Run& run = runs[winner];
+    if(++run.position == run.count) {
+      stale = winner;
+      continue;
+    }
+    // With many runs the next keys of a run are rarely cached by the time it wins again
+    if(run.position + 8 < run.count) __builtin_prefetch(run.buffer[run.position + 8].key.data());
+    const MergeEntry& next = run.buffer[run.position];
+    heads[winner]          = Head{normalized_prefix(next.key), &next};
+    replay(winner);
+  }
+
+  keep_last_key();
+  counters.entries_returned += n;
+  return n;
+}
+
+void MergeIterator::keep_last_key() {
+  if(has_last && last_key.data() != last_key_storage.data()) {
+    last_key_storage.assign(last_key);
+    last_key = last_key_storage;
+  }
+}
+
+bool MergeIterator::beats(uint32_t a, uint32_t b) const noexcept {
+  const Head& x = heads[a];
+  const Head& y = heads[b];
+  if(PEREGRINE_LIKELY(x.prefix != y.prefix)) return x.prefix < y.prefix;
+  // Exhausted runs have the largest prefix, so they only get here on ties
+  if(x.entry == nullptr || y.entry == nullptr) {
+    return y.entry == nullptr && (x.entry != nullptr || a < b);
+  }
+  if(const int c = compare_bytes(x.entry->key, y.entry->key); c != 0) return c < 0;
+  if(x.entry->sequence != y.entry->sequence) return x.entry->sequence > y.entry->sequence;
+  return a < b;
+}
+
+StatusCode MergeIterator::refill(uint32_t i) {
+  Run& run = runs[i];
+  run.buffer.resize(options.source_batch);
+  auto filled = run.source->fill(run.buffer.data(), run.buffer.size());
+  if(PEREGRINE_UNLIKELY(!filled.ok())) {
+    error = filled.status();
+    return error;
+  }
+  ++counters.fills;
+  run.position = 0;
+  run.count    = std::min(filled.value(), run.buffer.size());
+  heads[i]     = run.count != 0 ? Head{normalized_prefix(run.buffer[0].key), &run.buffer[0]}
+                                : Head{UINT64_MAX, nullptr};
+  return StatusCode::ok;
+}
+
+void MergeIterator::replay(uint32_t leaf) noexcept {
+  // Only the matches on the path from the last winner's leaf to the root can change
+  uint32_t winner = leaf;
+  for(size_t node = (leaf + heads.size()) / 2; node > 0; node /= 2) {
+    if(beats(tree[node], winner)) std::swap(tree[node], winner);
+  }
+  tree[0] = winner;
+}
+
+void MergeIterator::build() {
+  // Play the matches bottom up; inner node `i` has children `2i` and `2i + 1`, leaves follow
+  const size_t leaves = heads.size();
+  std::vector<uint32_t> winners(2 * leaves);
+  for(size_t i = 0; i < leaves; ++i) winners[leaves + i] = static_cast<uint32_t>(i);
+  for(size_t node = leaves - 1; node > 0; --node) {
+    const uint32_t a = winners[2 * node];
+    const uint32_t b = winners[2 * node + 1];
+    const bool left  = beats(a, b);
+    winners[node]    = left ? a : b;
+    tree[node]       = left ? b : a;
+  }
+  tree[0] = leaves > 1 ? winners[1] : 0;
+}
+
+} // namespace internal
+} // namespace peregrine
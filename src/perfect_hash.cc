@@ -0,0 +1,378 @@
+#include "peregrine/internal/perfect_hash.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+// Constants that derive independent hashes from a key's hash
+constexpr uint64_t bucket_salt      = 0x9e3779b97f4a7c15ull;
+constexpr uint64_t position_salt    = 0xc2b2ae3d27d4eb4full;
+constexpr uint64_t pilot_salt       = 0x165667b19e3779f9ull;
+constexpr uint64_t fingerprint_salt = 0x27d4eb2f165667c5ull;
+
+// Pilots tried per bucket before giving up on a seed, so pilots fit in `max_pilot_bits`
+constexpr uint32_t max_pilot_bits = 24;
+constexpr uint64_t max_pilot      = uint64_t{1} << max_pilot_bits;
+
+// Seeds tried before the keys are assumed not to be distinct
+constexpr int max_attempts = 3;
+
+struct Layout {
+  const PerfectHash::Partition* partitions;
+  uint32_t partition_count;
+  const uint64_t* pilots;
+  uint32_t pilot_bits;
+  const uint32_t* remap;
+}; // struct Layout
+
+uint64_t read_packed(const uint64_t* words, uint32_t width, uint64_t i) noexcept {
+  if(width == 0) return 0;
+  const uint64_t bit   = i * width;
+  const uint64_t shift = bit % 64;
+  uint64_t value       = words[bit / 64] >> shift;
+  if(shift + width > 64) value |= words[bit / 64 + 1] << (64 - shift);
+  return width == 64 ? value : value & ((uint64_t{1} << width) - 1);
+}
+
+// Skewed bucket assignment: 60% of keys go to the first 30% of buckets
+uint32_t bucket_of(uint64_t hash, uint32_t buckets) noexcept {
+  const uint64_t h      = mix64(hash + bucket_salt);
+  const uint32_t dense  = (buckets * 3 + 9) / 10;
+  const uint32_t sparse = buckets - dense;
+  const uint64_t high   = h >> 32;
+  if(sparse == 0 || (h & 0xffffffff) < 0x99999999ull)
+    return static_cast<uint32_t>((high * dense) >> 32);
+  return dense + static_cast<uint32_t>((high * sparse) >> 32);
+}
+
+PEREGRINE_FORCE_INLINE uint64_t position_of(uint64_t hash, uint64_t pilot, uint32_t table) {
+  return fastrange64(mix64(hash + position_salt) ^ mix64(pilot + pilot_salt), table);
+}
+
+uint64_t evaluate(const Layout& layout, uint64_t hash) noexcept {
+  const auto& part    = layout.partitions[fastrange64(hash, layout.partition_count)];
+  const uint32_t b    = bucket_of(hash, part.buckets);
+  const uint64_t p    = read_packed(layout.pilots, layout.pilot_bits, part.pilot_offset + b);
+  const uint64_t slot = position_of(hash, p, part.table_size);
+  if(slot < part.keys) return part.first + slot;
+  return part.first + layout.remap[part.remap_offset + slot - part.keys];
+}
+
+uint64_t fingerprint_of(uint64_t hash) noexcept { return mix64(hash + fingerprint_salt); }
+
+// Run `fn(begin, end)` over `[0, count)` split across threads
+template <typename Fn>
+void parallel_for(size_t count, size_t threads, Fn fn) {
+  threads = std::max<size_t>(1, std::min(threads, count / 4096));
+  std::vector<std::thread> workers;
+  const size_t step = (count + threads - 1) / threads;
+  for(size_t t = 1; t < threads; ++t) {
+    const size_t begin = std::min(count, t * step);
+    workers.emplace_back([=] { fn(begin, std::min(count, begin + step)); });
+  }
+  fn(0, std::min(count, step));
+  for(auto& worker : workers) worker.join();
+}
+
+struct BuiltPartition {
+  uint32_t keys{0};
+  uint32_t table_size{1};
+  uint32_t buckets{1};
+  std::vector<uint64_t> pilots;
+  std::vector<uint32_t> remap;
+}; // struct BuiltPartition
+
+// Find pilots for the keys of one partition. Fails on duplicate hashes or if a bucket finds no
+// pilot, either of which a new seed fixes unless keys repeat.
+bool build_partition(const uint64_t* hashes, size_t n, const PerfectHash::Options& options,
+    BuiltPartition& out) {
+  out.keys       = static_cast<uint32_t>(n);
+  out.table_size = static_cast<uint32_t>(
+      std::max<double>(1, std::max<double>(n, std::ceil(n / options.load_factor))));
+  const double log_n   = std::log2(std::max<double>(n, 2));
+  const double buckets = std::ceil(options.bucket_density * static_cast<double>(n) / log_n);
+  out.buckets          = static_cast<uint32_t>(std::max(1.0, buckets));
+  out.pilots.assign(out.buckets, 0);
+
+  // Group the keys by bucket
+  std::vector<std::pair<uint32_t, uint64_t>> keys(n);
+  for(size_t i = 0; i < n; ++i) keys[i] = {bucket_of(hashes[i], out.buckets), hashes[i]};
+  std::sort(keys.begin(), keys.end());
+  std::vector<uint32_t> starts(out.buckets + 1, 0);
+  for(const auto& key : keys) ++starts[key.first + 1];
+  for(uint32_t b = 0; b < out.buckets; ++b) starts[b + 1] += starts[b];
+
+  // Place the largest buckets first, while the table is emptiest
+  std::vector<uint32_t> order(out.buckets);
+  for(uint32_t b = 0; b < out.buckets; ++b) order[b] = b;
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) {
+    return starts[x + 1] - starts[x] > starts[y + 1] - starts[y];
+  });
+
+  std::vector<uint64_t> taken((out.table_size + 63) / 64, 0);
+  const auto is_taken = [&](uint64_t pos) { return (taken[pos / 64] >> (pos % 64)) & 1; };
+  std::vector<uint64_t> positions;
+  for(uint32_t b : order) {
+    const uint32_t begin = starts[b], end = starts[b + 1];
+    if(begin == end) break;
+    for(uint32_t i = begin + 1; i < end; ++i) {
+      if(keys[i].second == keys[i - 1].second) return false;
+    }
+
+    uint64_t pilot = 0;
+    for(;; ++pilot) {
+      if(pilot == max_pilot) return false;
+      positions.clear();
+      bool free = true;
+      for(uint32_t i = begin; i < end && free; ++i) {
+        const uint64_t pos = position_of(keys[i].second, pilot, out.table_size);
+        free               = !is_taken(pos);
+        positions.push_back(pos);
+      }
+      if(!free) continue;
+      std::sort(positions.begin(), positions.end());
+      if(std::adjacent_find(positions.begin(), positions.end()) == positions.end()) break;
+    }
+    out.pilots[b] = pilot;
+    for(uint64_t pos : positions) taken[pos / 64] |= uint64_t{1} << (pos % 64);
+  }
+
+  // Send the slots past the end of the partition to the holes below it
+  out.remap.assign(out.table_size - n, 0);
+  uint32_t hole = 0;
+  for(uint64_t pos = n; pos < out.table_size; ++pos) {
+    if(!is_taken(pos)) continue;
+    while(is_taken(hole)) ++hole;
+    out.remap[pos - n] = hole++;
+  }
+  return true;
+}
+
+
+} // namespace
+
+Result<std::string> PerfectHash::build(
+    const std::vector<std::string_view>& keys, Options options) {
+  using R = Result<std::string>;
+  if(options.fingerprint_bits != 0 && options.fingerprint_bits != 8 &&
+      options.fingerprint_bits != 16)
+    return R::error(StatusCode::invalid_argument);
+  if(!(options.load_factor > 0 && options.load_factor <= 1) || !(options.bucket_density > 0) ||
+      options.partition_keys == 0 || options.partition_keys > (uint32_t{1} << 30))
+    return R::error(StatusCode::invalid_argument);
+
+  const size_t n       = keys.size();
+  const size_t threads = options.threads != 0 ? options.threads
+                                              : std::max(1u, std::thread::hardware_concurrency());
+  const size_t per_partition = options.partition_keys;
+  const auto partition_count = static_cast<uint32_t>(
+      std::max<size_t>(1, (n + per_partition - 1) / per_partition));
+
+  std::vector<uint64_t> hashes(n), sorted(n);
+  std::vector<size_t> starts(partition_count + 1);
+  std::vector<BuiltPartition> built(partition_count);
+  uint64_t seed = options.seed;
+  for(int attempt = 0;; ++attempt) {
+    if(attempt == max_attempts) {
+      PEREGRINE_LOG_ERROR("Perfect hash build failed for {} keys; are they distinct?"sv, n);
+      return R::error(StatusCode::invalid_argument);
+    }
+    if(attempt != 0) seed = mix64(seed + attempt);
+
+    // Hash the keys and group them by partition
+    parallel_for(n, threads, [&](size_t begin, size_t end) {
+      for(size_t i = begin; i < end; ++i) hashes[i] = hash_bytes(keys[i], seed);
+    });
+    std::fill(starts.begin(), starts.end(), 0);
+    for(uint64_t h : hashes) ++starts[fastrange64(h, partition_count) + 1];
+    for(uint32_t p = 0; p < partition_count; ++p) starts[p + 1] += starts[p];
+    std::vector<size_t> fill(starts.begin(), starts.end() - 1);
+    for(uint64_t h : hashes) sorted[fill[fastrange64(h, partition_count)]++] = h;
+
+    // Build the partitions on worker threads
+    std::atomic<uint32_t> next{0};
+    std::atomic<bool> failed{false};
+    const auto work = [&] {
+      for(uint32_t p; !failed && (p = next++) < partition_count;) {
+        const size_t size = starts[p + 1] - starts[p];
+        if(!build_partition(sorted.data() + starts[p], size, options, built[p])) failed = true;
+      }
+    };
+    std::vector<std::thread> workers;
+    for(size_t t = 1; t < std::min<size_t>(threads, partition_count); ++t)
+      workers.emplace_back(work);
+    work();
+    for(auto& worker : workers) worker.join();
+    if(!failed) break;
+    PEREGRINE_LOG_DEBUG("Perfect hash build retrying with a new seed"sv);
+  }
+
+  // Lay out the partitions. Empty ones send every lookup to slot 0.
+  std::vector<Partition> partitions(partition_count);
+  uint64_t max_pilot_value = 0, pilot_count = 0, remap_count = 0;
+  for(uint32_t p = 0; p < partition_count; ++p) {
+    const auto& part = built[p];
+    partitions[p]    = {part.keys != 0 ? starts[p] : 0, part.keys, part.table_size, part.buckets,
+        static_cast<uint32_t>(pilot_count), static_cast<uint32_t>(remap_count), 0};
+    for(uint64_t pilot : part.pilots) max_pilot_value = std::max(max_pilot_value, pilot);
+    pilot_count += part.pilots.size();
+    remap_count += part.remap.size();
+  }
+  const uint32_t pilot_bits =
+      max_pilot_value == 0 ? 0 : 64 - static_cast<uint32_t>(__builtin_clzll(max_pilot_value));
+
+  Header header{};
+  header.magic            = magic;
+  header.version          = version;
+  header.fingerprint_bits = static_cast<uint8_t>(options.fingerprint_bits);
+  header.pilot_bits       = static_cast<uint8_t>(pilot_bits);
+  header.keys             = n;
+  header.seed             = seed;
+  header.partitions       = partition_count;
+  header.pilot_words      = (pilot_count * pilot_bits + 63) / 64 + 1;
+
+  const size_t partitions_offset   = sizeof(Header);
+  const size_t pilots_offset       = partitions_offset + partition_count * sizeof(Partition);
+  const size_t remap_offset        = pilots_offset + header.pilot_words * sizeof(uint64_t);
+  const size_t fingerprints_offset = remap_offset + pad8(remap_count * sizeof(uint32_t));
+  const size_t total = fingerprints_offset + pad8(n * options.fingerprint_bits / 8);
+
+  std::string out(total, '\0');
+  std::memcpy(out.data(), &header, sizeof(header));
+  std::memcpy(out.data() + partitions_offset, partitions.data(),
+      partitions.size() * sizeof(Partition));
+
+  // Pack the pilots and copy the remapped slots
+  std::vector<uint64_t> pilots(header.pilot_words, 0);
+  auto* remap = reinterpret_cast<uint32_t*>(out.data() + remap_offset);
+  uint64_t index = 0;
+  for(uint32_t p = 0; p < partition_count; ++p) {
+    for(uint64_t pilot : built[p].pilots) {
+      if(pilot_bits != 0) {
+        const uint64_t bit = index * pilot_bits, shift = bit % 64;
+        pilots[bit / 64] |= pilot << shift;
+        if(shift + pilot_bits > 64) pilots[bit / 64 + 1] |= pilot >> (64 - shift);
+      }
+      ++index;
+    }
+    std::memcpy(remap + partitions[p].remap_offset, built[p].remap.data(),
+        built[p].remap.size() * sizeof(uint32_t));
+  }
+  std::memcpy(out.data() + pilots_offset, pilots.data(), pilots.size() * sizeof(uint64_t));
+
+  // Store each key's fingerprint at its slot
+  if(options.fingerprint_bits != 0) {
+    const Layout layout{partitions.data(), partition_count, pilots.data(), pilot_bits, remap};
+    char* fingerprints = out.data() + fingerprints_offset;
+    parallel_for(n, threads, [&](size_t begin, size_t end) {
+      for(size_t i = begin; i < end; ++i) {
+        const uint64_t slot        = evaluate(layout, sorted[i]);
+        const uint64_t fingerprint = fingerprint_of(sorted[i]);
+        if(options.fingerprint_bits == 8) {
+          fingerprints[slot] = static_cast<char>(fingerprint);
+        } else {
+          const auto value = static_cast<uint16_t>(fingerprint);
+          std::memcpy(fingerprints + 2 * slot, &value, sizeof(value));
+        }
+      }
+    });
+  }
+  return out;
+}
+
+Result<size_t> PerfectHash::build(
+    File& file, off_t offset, const std::vector<std::string_view>& keys, Options options) {
+  auto bytes = build(keys, options);
+  if(!bytes.ok()) return Result<size_t>::error(bytes.status());
+  if(auto status = file.pwrite_all(bytes->data(), bytes->size(), offset); status != StatusCode::ok)
+    return Result<size_t>::error(status);
+  return bytes->size();
+}
+
+Result<PerfectHash> PerfectHash::open(const void* data, size_t size) noexcept {
+  const auto invalid = [] { return Result<PerfectHash>::error(StatusCode::invalid_argument); };
+  if(data == nullptr || reinterpret_cast<uintptr_t>(data) % 8 != 0) return invalid();
+  if(size < sizeof(Header)) return invalid();
+
+  PerfectHash view;
+  view.header     = static_cast<const Header*>(data);
+  const Header& h = *view.header;
+  if(h.magic != magic || h.version != version || h.partitions == 0) return invalid();
+  if(h.fingerprint_bits != 0 && h.fingerprint_bits != 8 && h.fingerprint_bits != 16)
+    return invalid();
+  if(h.pilot_bits > max_pilot_bits) return invalid();
+  if(h.keys > size * 8 || h.partitions > size / sizeof(Partition) || h.pilot_words > size / 8)
+    return invalid();
+
+  const auto* base    = static_cast<const char*>(data);
+  size_t offset       = sizeof(Header) + size_t{h.partitions} * sizeof(Partition);
+  const size_t pilots = offset;
+  offset += h.pilot_words * sizeof(uint64_t);
+  if(offset > size) return invalid();
+  view.partitions = reinterpret_cast<const Partition*>(base + sizeof(Header));
+  view.pilots     = reinterpret_cast<const uint64_t*>(base + pilots);
+
+  // Check that every partition's pilots and remapped slots are in bounds
+  uint64_t keys = 0, pilot_count = 0, remap_count = 0;
+  for(uint32_t p = 0; p < h.partitions; ++p) {
+    const Partition& part = view.partitions[p];
+    if(part.first != (part.keys != 0 ? keys : 0)) return invalid();
+    if(part.buckets == 0 || part.table_size < std::max(part.keys, 1u))
+      return invalid();
+    if(part.pilot_offset != pilot_count || part.remap_offset != remap_count) return invalid();
+    keys += part.keys;
+    pilot_count += part.buckets;
+    remap_count += part.table_size - part.keys;
+  }
+  if(keys != h.keys || h.pilot_words != (pilot_count * h.pilot_bits + 63) / 64 + 1)
+    return invalid();
+  view.remap = reinterpret_cast<const uint32_t*>(base + offset);
+  offset += pad8(remap_count * sizeof(uint32_t));
+  view.fingerprints = base + offset;
+  offset += pad8(h.keys * h.fingerprint_bits / 8);
+  if(offset > size) return invalid();
+  for(uint32_t p = 0; p < h.partitions; ++p) {
+    const Partition& part = view.partitions[p];
+    for(uint32_t i = 0; i < part.table_size - part.keys; ++i) {
+      if(view.remap[part.remap_offset + i] >= std::max(part.keys, 1u)) return invalid();
+    }
+  }
+  view.total = offset;
+  return view;
+}
+
+uint64_t PerfectHash::slot(uint64_t hash) const noexcept {
+  const Layout layout{partitions, header->partitions, pilots, header->pilot_bits, remap};
+  return evaluate(layout, hash);
+}
+
+uint64_t PerfectHash::find(std::string_view key) const noexcept {
+  if(PEREGRINE_UNLIKELY(size() == 0)) return 0;
+  const uint64_t hash = hash_bytes(key, header->seed);
+  const uint64_t s    = slot(hash);
+  switch(header->fingerprint_bits) {
+  case 8:
+    if(static_cast<const uint8_t*>(fingerprints)[s] != static_cast<uint8_t>(fingerprint_of(hash)))
+      return size();
+    break;
+  case 16: {
+    uint16_t stored;
+    std::memcpy(&stored, static_cast<const char*>(fingerprints) + 2 * s, sizeof(stored));
+    if(stored != static_cast<uint16_t>(fingerprint_of(hash))) return size();
+    break;
+  }
+  default: break;
+  }
+  return s;
+}
+
+} // namespace internal
+} // namespace peregrine
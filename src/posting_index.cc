@@ -0,0 +1,328 @@
+#include "peregrine/internal/posting_index.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+constexpr uint32_t end_doc = UINT32_MAX;
+
+
+// Higher scores first, then lower document ids
+bool better(const PostingIndex::Hit& a, const PostingIndex::Hit& b) noexcept {
+  return a.score > b.score || (a.score == b.score && a.doc < b.doc);
+}
+
+// The best `k` hits, with the worst of them on top
+class TopK {
+  struct Worse {
+    bool operator()(const PostingIndex::Hit& a, const PostingIndex::Hit& b) const noexcept {
+      return better(a, b);
+    }
+  }; // struct Worse
+
+  std::priority_queue<PostingIndex::Hit, std::vector<PostingIndex::Hit>, Worse> heap;
+  size_t k;
+
+public:
+  explicit TopK(size_t k) : k(k) {}
+
+  // The score a document must beat to enter, since later documents lose ties
+  float threshold() const noexcept {
+    return heap.size() < k ? std::numeric_limits<float>::lowest() : heap.top().score;
+  }
+
+  void push(PostingIndex::Hit hit) {
+    if(heap.size() < k) {
+      heap.push(hit);
+    } else if(better(hit, heap.top())) {
+      heap.pop();
+      heap.push(hit);
+    }
+  }
+
+  std::vector<PostingIndex::Hit> finish() {
+    std::vector<PostingIndex::Hit> hits(heap.size());
+    for(size_t i = hits.size(); i-- > 0; heap.pop()) hits[i] = heap.top();
+    return hits;
+  }
+}; // class TopK
+
+// A position in one term's postings
+class Cursor {
+  const uint32_t* docs;
+  const float* scores;
+  const PostingIndex::Block* blocks;
+  uint32_t size;
+  uint32_t block_size;
+  uint32_t block_count;
+  uint32_t pos{0};
+  uint32_t block{0};
+
+public:
+  float max_score;
+
+  Cursor(const PostingIndex::Term& term, const uint32_t* docs, const float* scores,
+      const PostingIndex::Block* blocks, uint32_t block_size) noexcept
+      : docs(docs + term.first_posting), scores(scores + term.first_posting),
+        blocks(blocks + term.first_block), size(term.postings), block_size(block_size),
+        block_count((term.postings + block_size - 1) / block_size), max_score(term.max_score) {}
+
+  uint32_t doc() const noexcept { return pos < size ? docs[pos] : end_doc; }
+  float score() const noexcept { return scores[pos]; }
+  void next() noexcept { ++pos; }
+
+  // Move to the first posting at or after `target`, skipping whole blocks by their last document
+  void next_geq(uint32_t target) noexcept {
+    if(doc() >= target) return;
+    shallow(target);
+    if(block == block_count) {
+      pos = size;
+      return;
+    }
+    const uint32_t begin = std::max(pos, block * block_size);
+    const uint32_t end   = std::min(size, (block + 1) * block_size);
+    pos = static_cast<uint32_t>(std::lower_bound(docs + begin, docs + end, target) - docs);
+  }
+
+  // Move only the block pointer to the block that would hold `target`
+  void shallow(uint32_t target) noexcept {
+    while(block < block_count && blocks[block].last_doc < target) ++block;
+  }
+
+  float block_max() const noexcept { return block < block_count ? blocks[block].max_score : 0; }
+
+  uint32_t block_last() const noexcept {
+    return block < block_count ? blocks[block].last_doc : end_doc;
+  }
+}; // class Cursor
+
+} // namespace
+
+uint32_t PostingIndexBuilder::add(const std::vector<uint32_t>& terms) {
+  const auto doc = static_cast<uint32_t>(lengths.size());
+  std::vector<uint32_t> sorted(terms);
+  std::sort(sorted.begin(), sorted.end());
+  for(size_t i = 0; i < sorted.size();) {
+    size_t j = i + 1;
+    while(j < sorted.size() && sorted[j] == sorted[i]) ++j;
+    if(sorted[i] >= postings.size()) postings.resize(size_t{sorted[i]} + 1);
+    postings[sorted[i]].push_back({doc, static_cast<uint32_t>(j - i)});
+    i = j;
+  }
+  lengths.push_back(static_cast<uint32_t>(terms.size()));
+  total_length += terms.size();
+  return doc;
+}
+
+Result<std::string> PostingIndexBuilder::finish() {
+  if(options.block_size == 0 || !(options.k1 >= 0) || !(options.b >= 0 && options.b <= 1) ||
+      lengths.size() >= end_doc || postings.size() >= UINT32_MAX) {
+    return Result<std::string>::error(StatusCode::invalid_argument);
+  }
+
+  PostingIndex::Header header{};
+  header.magic          = PostingIndex::magic;
+  header.version        = PostingIndex::version;
+  header.terms          = static_cast<uint32_t>(postings.size());
+  header.docs           = static_cast<uint32_t>(lengths.size());
+  header.block_size     = options.block_size;
+  header.average_length =
+      lengths.empty() ? 1.0f : static_cast<float>(total_length) / lengths.size();
+  for(const auto& list : postings) {
+    header.postings += list.size();
+    header.blocks += (list.size() + options.block_size - 1) / options.block_size;
+  }
+
+  const size_t terms_offset  = sizeof(header);
+  const size_t blocks_offset = terms_offset + postings.size() * sizeof(PostingIndex::Term);
+  const size_t docs_offset   = blocks_offset + header.blocks * sizeof(PostingIndex::Block);
+  const size_t scores_offset = docs_offset + pad8(header.postings * sizeof(uint32_t));
+  std::string out(scores_offset + pad8(header.postings * sizeof(float)), '\0');
+  std::memcpy(out.data(), &header, sizeof(header));
+  auto* terms  = reinterpret_cast<PostingIndex::Term*>(out.data() + terms_offset);
+  auto* blocks = reinterpret_cast<PostingIndex::Block*>(out.data() + blocks_offset);
+  auto* docs   = reinterpret_cast<uint32_t*>(out.data() + docs_offset);
+  auto* scores = reinterpret_cast<float*>(out.data() + scores_offset);
+
+  // BM25 with the non-negative Lucene idf
+  const double n = static_cast<double>(lengths.size());
+  uint64_t posting = 0, block = 0;
+  for(size_t t = 0; t < postings.size(); ++t) {
+    const auto& list = postings[t];
+    const double df  = static_cast<double>(list.size());
+    const double idf = std::log(1.0 + (n - df + 0.5) / (df + 0.5));
+    terms[t]         = {posting, block, static_cast<uint32_t>(list.size()), 0.0f};
+    for(size_t i = 0; i < list.size(); ++i, ++posting) {
+      const double tf     = list[i].frequency;
+      const double length = lengths[list[i].doc] / header.average_length;
+      const double norm   = options.k1 * (1.0 - options.b + options.b * length);
+      docs[posting]       = list[i].doc;
+      scores[posting]     = static_cast<float>(idf * tf * (options.k1 + 1) / (tf + norm));
+      terms[t].max_score  = std::max(terms[t].max_score, scores[posting]);
+      if(i % options.block_size == 0) blocks[block++] = {0, 0.0f};
+      blocks[block - 1].last_doc  = list[i].doc;
+      blocks[block - 1].max_score = std::max(blocks[block - 1].max_score, scores[posting]);
+    }
+  }
+
+  postings.clear();
+  lengths.clear();
+  total_length = 0;
+  return out;
+}
+
+Result<PostingIndex> PostingIndex::open(const void* data, size_t size) noexcept {
+  const auto invalid = [] { return Result<PostingIndex>::error(StatusCode::invalid_argument); };
+  if(data == nullptr || reinterpret_cast<uintptr_t>(data) % 8 != 0) return invalid();
+  if(size < sizeof(Header)) return invalid();
+
+  PostingIndex view;
+  view.header     = static_cast<const Header*>(data);
+  const Header& h = *view.header;
+  if(h.magic != magic || h.version != version || h.block_size == 0 || h.docs == end_doc)
+    return invalid();
+  if(h.terms > size / sizeof(Term) || h.blocks > size / sizeof(Block) ||
+      h.postings > size / sizeof(uint32_t) / 2)
+    return invalid();
+
+  const auto* base           = static_cast<const char*>(data);
+  const size_t blocks_offset = sizeof(Header) + size_t{h.terms} * sizeof(Term);
+  const size_t docs_offset   = blocks_offset + h.blocks * sizeof(Block);
+  const size_t scores_offset = docs_offset + pad8(h.postings * sizeof(uint32_t));
+  view.total                 = scores_offset + pad8(h.postings * sizeof(float));
+  if(view.total > size) return invalid();
+  view.term_entries = reinterpret_cast<const Term*>(base + sizeof(Header));
+  view.blocks       = reinterpret_cast<const Block*>(base + blocks_offset);
+  view.docs         = reinterpret_cast<const uint32_t*>(base + docs_offset);
+  view.scores       = reinterpret_cast<const float*>(base + scores_offset);
+
+  // Each list must be in bounds and increasing, and each block must end where it says
+  for(uint32_t t = 0; t < h.terms; ++t) {
+    const Term& term      = view.term_entries[t];
+    const uint64_t blocks = (uint64_t{term.postings} + h.block_size - 1) / h.block_size;
+    if(term.first_posting > h.postings || term.postings > h.postings - term.first_posting ||
+        term.first_block > h.blocks || blocks > h.blocks - term.first_block)
+      return invalid();
+    const uint32_t* docs = view.docs + term.first_posting;
+    for(uint32_t i = 0; i < term.postings; ++i) {
+      if(docs[i] >= h.docs || (i != 0 && docs[i] <= docs[i - 1])) return invalid();
+      const bool block_end = (i + 1) % h.block_size == 0 || i + 1 == term.postings;
+      if(block_end && view.blocks[term.first_block + i / h.block_size].last_doc != docs[i])
+        return invalid();
+    }
+  }
+  return view;
+}
+
+std::vector<PostingIndex::Hit> PostingIndex::top_k(const std::vector<uint32_t>& terms, size_t k,
+    Retrieval retrieval, QueryStats* stats) const {
+  QueryStats counters;
+  std::vector<uint32_t> unique(terms);
+  std::sort(unique.begin(), unique.end());
+  unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+  std::vector<Cursor> cursors;
+  for(uint32_t term : unique) {
+    if(document_frequency(term) == 0) continue;
+    cursors.emplace_back(term_entries[term], docs, scores, blocks, header->block_size);
+    counters.postings += term_entries[term].postings;
+  }
+
+  TopK top(k);
+  if(k == 0 || cursors.empty()) {
+    // Nothing to rank
+  } else if(retrieval == Retrieval::exhaustive) {
+    // Document at a time, scoring every posting
+    while(true) {
+      uint32_t doc = end_doc;
+      for(const Cursor& c : cursors) doc = std::min(doc, c.doc());
+      if(doc == end_doc) break;
+      float score = 0;
+      for(Cursor& c : cursors) {
+        if(c.doc() != doc) continue;
+        score += c.score();
+        c.next();
+        ++counters.postings_scored;
+      }
+      ++counters.docs_scored;
+      top.push({doc, score});
+    }
+  } else {
+    std::vector<Cursor*> order;
+    for(Cursor& c : cursors) order.push_back(&c);
+    const size_t n = order.size();
+
+    // Bounds are summed in document order and scores in term order, so either may round by up to
+    // `n` ulps. Widening the bounds keeps every document they skip below the threshold.
+    const float slack = 1.0f + 4.0f * static_cast<float>(n) * std::numeric_limits<float>::epsilon();
+    while(true) {
+      // Few lists, mostly in order: insertion sort by current document
+      for(size_t i = 1; i < n; ++i) {
+        for(size_t j = i; j > 0 && order[j]->doc() < order[j - 1]->doc(); --j)
+          std::swap(order[j], order[j - 1]);
+      }
+
+      // The pivot is the first list at which the score bounds can beat the threshold
+      const float threshold = top.threshold();
+      float bound           = 0;
+      size_t pivot          = n;
+      for(size_t i = 0; i < n && order[i]->doc() != end_doc; ++i) {
+        bound += order[i]->max_score;
+        if(bound * slack > threshold) {
+          pivot = i;
+          break;
+        }
+      }
+      if(pivot == n) break;
+      const uint32_t pivot_doc = order[pivot]->doc();
+      while(pivot + 1 < n && order[pivot + 1]->doc() == pivot_doc) ++pivot;
+
+      // Tighten the bound with the maximums of the blocks that would hold the pivot
+      float block_bound = 0;
+      for(size_t i = 0; i <= pivot; ++i) {
+        order[i]->shallow(pivot_doc);
+        block_bound += order[i]->block_max();
+      }
+
+      if(block_bound * slack > threshold) {
+        if(order[0]->doc() == pivot_doc) {
+          // Sum in term order, as the exhaustive path does, for identical scores. The cursors
+          // are stored by term, so that is the order of their addresses.
+          std::sort(order.begin(), order.begin() + static_cast<ptrdiff_t>(pivot) + 1);
+          float score = 0;
+          for(size_t i = 0; i <= pivot; ++i) {
+            score += order[i]->score();
+            order[i]->next();
+          }
+          counters.postings_scored += pivot + 1;
+          ++counters.docs_scored;
+          top.push({pivot_doc, score});
+        } else {
+          for(size_t i = 0; i <= pivot && order[i]->doc() < pivot_doc; ++i)
+            order[i]->next_geq(pivot_doc);
+        }
+        continue;
+      }
+
+      // No document before the end of these blocks, or the next list, can make the top k
+      uint64_t next = order[pivot]->block_last() + uint64_t{1};
+      for(size_t i = 0; i < pivot; ++i) next = std::min(next, order[i]->block_last() + uint64_t{1});
+      if(pivot + 1 < n) next = std::min<uint64_t>(next, order[pivot + 1]->doc());
+      next = std::max<uint64_t>(next, uint64_t{pivot_doc} + 1);
+      const auto target = static_cast<uint32_t>(std::min<uint64_t>(next, end_doc));
+      for(size_t i = 0; i <= pivot; ++i) order[i]->next_geq(target);
+    }
+  }
+
+  if(stats != nullptr) *stats = counters;
+  return top.finish();
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,139 @@
+#include "peregrine/internal/publish.hh"
+
+#include <algorithm>
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+std::string parent_directory(const std::string& path) {
+  const auto slash = path.rfind('/');
+  if(slash == std::string::npos) return "."s;
+  if(slash == 0) return "/"s;
+  return path.substr(0, slash);
+}
+
+} // namespace
+
+Result<File*> PublishBatch::create(std::string_view final_path) {
+  auto entry        = std::make_unique<Pending>();
+  entry->final_path = std::string(final_path);
+  entry->temp_path =
+      fmt::format("{}.tmp.{}.{}"sv, final_path, static_cast<int>(::getpid()), sequence++);
+
+  auto status = entry->file.open(
+      entry->temp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, options.mode);
+  if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) return Result<File*>::error(status);
+
+  File* file = &entry->file;
+  pending.push_back(std::move(entry));
+  return file;
+}
+
+StatusCode PublishBatch::rename_one(const Pending& entry) noexcept {
+  const char* from = entry.temp_path.c_str();
+  const char* to   = entry.final_path.c_str();
+
+  if(!options.no_replace) {
+    if(PEREGRINE_UNLIKELY(::peregrine::internal::rename(from, to) == -1)) {
+      auto status = errno_to_status();
+      PEREGRINE_LOG_ERROR("rename failed from \"{}\" to \"{}\" : {}"sv, from, to, status);
+      return status;
+    }
+    return StatusCode::ok;
+  }
+
+#if defined(PEREGRINE_HAVE_RENAMEAT2)
+  if(PEREGRINE_LIKELY(
+         ::peregrine::internal::renameat2(AT_FDCWD, from, AT_FDCWD, to, RENAME_NOREPLACE) == 0))
+    return StatusCode::ok;
+
+  // Fall back to link/unlink only when the kernel or file system lacks RENAME_NOREPLACE
+  if(auto status = errno_to_status();
+      status != StatusCode::einval && status != StatusCode::enosys) {
+    PEREGRINE_LOG_ERROR("renameat2 failed from \"{}\" to \"{}\" : {}"sv, from, to, status);
+    return status;
+  }
+#endif // defined(PEREGRINE_HAVE_RENAMEAT2)
+
+  // link() fails with EEXIST rather than replacing the target
+  if(PEREGRINE_UNLIKELY(::peregrine::internal::link(from, to) == -1)) {
+    auto status = errno_to_status();
+    PEREGRINE_LOG_ERROR("link failed from \"{}\" to \"{}\" : {}"sv, from, to, status);
+    return status;
+  }
+  if(PEREGRINE_UNLIKELY(::peregrine::internal::unlink(from) == -1)) {
+    // The file is already published; only the temporary name is left behind.
+    PEREGRINE_LOG_WARN("unlink failed for \"{}\" : {}"sv, from, errno_to_status());
+  }
+  return StatusCode::ok;
+}
+
+StatusCode PublishBatch::commit() {
+  StatusCode status = StatusCode::ok;
+
+#if defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+  // Queue write-back for every file before waiting on any of them
+  if(options.sync_ahead) {
+    for(const auto& entry : pending) {
+      status = entry->file.sync_range(0, 0, SYNC_FILE_RANGE_WRITE);
+      if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+        abort();
+        return status;
+      }
+    }
+  }
+#endif // defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+
+  for(auto& entry : pending) {
+    status = entry->file.flush();
+    if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+      abort();
+      return status;
+    }
+    entry->file.close();
+  }
+
+  size_t published = 0;
+  std::vector<std::string> directories;
+  for(const auto& entry : pending) {
+    status = rename_one(*entry);
+    if(PEREGRINE_UNLIKELY(status != StatusCode::ok)) break;
+    ++published;
+
+    auto directory = parent_directory(entry->final_path);
+    if(std::find(directories.begin(), directories.end(), directory) == directories.end())
+      directories.push_back(std::move(directory));
+  }
+
+  // Make the renames durable, including after a partial failure
+  for(const auto& directory : directories) {
+    File dir;
+    auto dir_status = dir.open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(PEREGRINE_LIKELY(dir_status == StatusCode::ok)) dir_status = dir.flush();
+    if(PEREGRINE_UNLIKELY(dir_status != StatusCode::ok) && status == StatusCode::ok)
+      status = dir_status;
+  }
+
+  PEREGRINE_LOG_DEBUG("Published {} of {} files, synced {} directories : {}"sv, published,
+      pending.size(), directories.size(), status);
+
+  pending.erase(pending.begin(), pending.begin() + static_cast<ptrdiff_t>(published));
+  abort();
+  return status;
+}
+
+void PublishBatch::abort() noexcept {
+  for(auto& entry : pending) {
+    entry->file.close();
+    if(::peregrine::internal::unlink(entry->temp_path.c_str()) == -1 && errno != ENOENT)
+      PEREGRINE_LOG_WARN("Failed to remove \"{}\" : {}"sv, entry->temp_path, errno_to_status());
+  }
+  pending.clear();
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,711 @@
+#include "peregrine/internal/roaring.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#include "peregrine/internal/simd.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+using Type = RoaringContainerType;
+using detail::roaring_bitmap_words;
+using detail::roaring_max_array;
+
+// Bitmap payloads and run pairs are stored in 64-bit words and 16-bit halves respectively
+constexpr size_t bitmap_bytes = roaring_bitmap_words * sizeof(uint64_t);
+
+size_t align8(size_t n) noexcept { return (n + 7) & ~size_t{7}; }
+
+size_t payload_bytes(const RoaringContainer& c) noexcept {
+  switch(c.type) {
+  case Type::array: return align8(c.size * sizeof(uint16_t));
+  case Type::bitmap: return bitmap_bytes;
+  case Type::run: return align8(c.size * 2 * sizeof(uint16_t));
+  }
+  return 0;
+}
+
+void set_bit(uint64_t* words, uint16_t value) noexcept {
+  words[value >> 6] |= uint64_t{1} << (value & 63);
+}
+
+void clear_bit(uint64_t* words, uint16_t value) noexcept {
+  words[value >> 6] &= ~(uint64_t{1} << (value & 63));
+}
+
+bool test_bit(const uint64_t* words, uint16_t value) noexcept {
+  return (words[value >> 6] >> (value & 63)) & 1;
+}
+
+// Set or clear the bits [first, last]
+template <bool set>
+void fill_range(uint64_t* words, uint32_t first, uint32_t last) noexcept {
+  const uint32_t first_word = first >> 6, last_word = last >> 6;
+  const uint64_t first_mask = ~uint64_t{0} << (first & 63);
+  const uint64_t last_mask  = ~uint64_t{0} >> (63 - (last & 63));
+  for(uint32_t w = first_word; w <= last_word; ++w) {
+    uint64_t mask = ~uint64_t{0};
+    if(w == first_word) mask &= first_mask;
+    if(w == last_word) mask &= last_mask;
+    if constexpr(set) {
+      words[w] |= mask;
+    } else {
+      words[w] &= ~mask;
+    }
+  }
+}
+
+// Expand any container into bitmap words
+void to_words(const RoaringContainer& c, uint64_t* words) noexcept {
+  if(c.type == Type::bitmap) {
+    std::memcpy(words, c.words, bitmap_bytes);
+    return;
+  }
+  std::memset(words, 0, bitmap_bytes);
+  if(c.type == Type::array) {
+    for(uint32_t i = 0; i < c.size; ++i) set_bit(words, c.values[i]);
+  } else {
+    for(uint32_t i = 0; i < c.size; ++i)
+      fill_range<true>(words, c.values[2 * i], c.values[2 * i] + c.values[2 * i + 1]);
+  }
+}
+
+// Get the words of a container, expanding it into `scratch` unless it is a bitmap
+const uint64_t* words_of(const RoaringContainer& c, uint64_t* scratch) noexcept {
+  if(c.type == Type::bitmap) return c.words;
+  to_words(c, scratch);
+  return scratch;
+}
+
+// Store `out.words` with `cardinality` bits set as an array if that is smaller
+void finish_bitmap(RoaringOwnedContainer& out, uint32_t cardinality) {
+  out.cardinality = cardinality;
+  if(cardinality > roaring_max_array) {
+    out.type = Type::bitmap;
+    out.values.clear();
+    return;
+  }
+  out.type = Type::array;
+  out.values.resize(cardinality);
+  size_t n = 0;
+  for(size_t w = 0; w < roaring_bitmap_words; ++w) {
+    for(uint64_t word = out.words[w]; word != 0; word &= word - 1)
+      out.values[n++] = static_cast<uint16_t>(w * 64 + static_cast<size_t>(__builtin_ctzll(word)));
+  }
+  out.words.clear();
+  out.words.shrink_to_fit();
+}
+
+// Bitmap kernels, vectorized with the build's instruction set
+
+enum class WordOp { and_, or_, andnot };
+
+template <WordOp op>
+uint64_t word_op(uint64_t a, uint64_t b) noexcept {
+  if constexpr(op == WordOp::and_) return a & b;
+  if constexpr(op == WordOp::or_) return a | b;
+  return a & ~b;
+}
+
+template <WordOp op>
+void bitmap_op(const uint64_t* a, const uint64_t* b, uint64_t* out) noexcept {
+  size_t i = 0;
+#if defined(PEREGRINE_SIMD_SSE2)
+  for(; i < roaring_bitmap_words; i += 2) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    __m128i z;
+    if constexpr(op == WordOp::and_) {
+      z = _mm_and_si128(x, y);
+    } else if constexpr(op == WordOp::or_) {
+      z = _mm_or_si128(x, y);
+    } else {
+      z = _mm_andnot_si128(y, x);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), z);
+  }
+#elif defined(PEREGRINE_SIMD_NEON)
+  for(; i < roaring_bitmap_words; i += 2) {
+    const uint64x2_t x = vld1q_u64(a + i);
+    const uint64x2_t y = vld1q_u64(b + i);
+    uint64x2_t z;
+    if constexpr(op == WordOp::and_) {
+      z = vandq_u64(x, y);
+    } else if constexpr(op == WordOp::or_) {
+      z = vorrq_u64(x, y);
+    } else {
+      z = vbicq_u64(x, y);
+    }
+    vst1q_u64(out + i, z);
+  }
+#endif // defined(PEREGRINE_SIMD_SSE2)
+  for(; i < roaring_bitmap_words; ++i) out[i] = word_op<op>(a[i], b[i]);
+}
+
+// Count the bits of `a & b` without storing them, one cache-sized block at a time
+uint32_t bitmap_and_count(const uint64_t* a, const uint64_t* b) noexcept {
+  constexpr size_t block = 64;
+  uint64_t buffer[block];
+  uint64_t count = 0;
+  for(size_t i = 0; i < roaring_bitmap_words; i += block) {
+    size_t j = 0;
+#if defined(PEREGRINE_SIMD_SSE2)
+    for(; j < block; j += 2) {
+      const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + j));
+      const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + j));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer + j), _mm_and_si128(x, y));
+    }
+#elif defined(PEREGRINE_SIMD_NEON)
+    for(; j < block; j += 2)
+      vst1q_u64(buffer + j, vandq_u64(vld1q_u64(a + i + j), vld1q_u64(b + i + j)));
+#endif // defined(PEREGRINE_SIMD_SSE2)
+    for(; j < block; ++j) buffer[j] = a[i + j] & b[i + j];
+    count += popcount_words(buffer, block);
+  }
+  return static_cast<uint32_t>(count);
+}
+
+// Array kernels
+
+// Find the first position in `values[pos, n)` holding a value >= `target`. Skips whole blocks of
+// eight with one comparison each, and compares the final block in one vector instruction.
+size_t seek(const uint16_t* values, size_t pos, size_t n, uint16_t target) noexcept {
+  while(pos + 8 <= n && values[pos + 7] < target) pos += 8;
+#if defined(PEREGRINE_SIMD_SSE2)
+  if(pos + 8 <= n) {
+    // Unsigned 16-bit compare through the signed instruction by flipping the sign bits
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i v =
+        _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + pos)), bias);
+    const __m128i t  = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(target)), bias);
+    const auto below = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmplt_epi16(v, t)));
+    return pos + static_cast<size_t>(__builtin_popcount(below)) / 2;
+  }
+#elif defined(PEREGRINE_SIMD_NEON)
+  if(pos + 8 <= n) {
+    const uint16x8_t below = vcltq_u16(vld1q_u16(values + pos), vdupq_n_u16(target));
+    const uint64x2_t bits  = vreinterpretq_u64_u16(below);
+    const auto count =
+        popcount64(vgetq_lane_u64(bits, 0)) + popcount64(vgetq_lane_u64(bits, 1));
+    return pos + count / 16;
+  }
+#endif // defined(PEREGRINE_SIMD_SSE2)
+  while(pos < n && values[pos] < target) ++pos;
+  return pos;
+}
+
+// Intersect two sorted arrays into `out`, or only count the result if `out` is null
+template <bool store>
+size_t array_and(const uint16_t* a, size_t na, const uint16_t* b, size_t nb, uint16_t* out) {
+  if(na > nb) {
+    std::swap(a, b);
+    std::swap(na, nb);
+  }
+  size_t n = 0;
+  if(na * 16 < nb) {
+    // Skewed sizes: look each value of the small array up in the large one
+    size_t pos = 0;
+    for(size_t i = 0; i < na && pos < nb; ++i) {
+      pos = seek(b, pos, nb, a[i]);
+      if(pos < nb && b[pos] == a[i]) {
+        if constexpr(store) out[n] = a[i];
+        ++n;
+      }
+    }
+    return n;
+  }
+  size_t i = 0, j = 0;
+  while(i < na && j < nb) {
+    if(a[i] < b[j]) {
+      ++i;
+    } else if(b[j] < a[i]) {
+      ++j;
+    } else {
+      if constexpr(store) out[n] = a[i];
+      ++n, ++i, ++j;
+    }
+  }
+  return n;
+}
+
+bool run_contains(const uint16_t* runs, uint32_t count, uint16_t value) noexcept {
+  // Find the last run starting at or before `value`
+  uint32_t lo = 0, hi = count;
+  while(lo < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    if(runs[2 * mid] <= value) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if(lo == 0) return false;
+  const uint32_t start = runs[2 * (lo - 1)];
+  return value - start <= runs[2 * (lo - 1) + 1];
+}
+
+// Count the runs of set bits in bitmap words
+uint32_t count_runs(const uint64_t* words) noexcept {
+  uint32_t runs  = 0;
+  uint64_t carry = 0;
+  for(size_t i = 0; i < roaring_bitmap_words; ++i) {
+    const uint64_t w = words[i];
+    runs += popcount64(w & ~((w << 1) | carry));
+    carry = w >> 63;
+  }
+  return runs;
+}
+
+uint32_t count_runs(const uint16_t* values, uint32_t n) noexcept {
+  uint32_t runs = n == 0 ? 0 : 1;
+  for(uint32_t i = 1; i < n; ++i) runs += values[i] != values[i - 1] + 1;
+  return runs;
+}
+
+// Rewrite `words` as run pairs
+void words_to_runs(const uint64_t* words, std::vector<uint16_t>& runs) {
+  runs.clear();
+  uint32_t pos = 0;
+  while(pos < 65536) {
+    // Find the next set bit
+    uint64_t w = words[pos >> 6] & (~uint64_t{0} << (pos & 63));
+    while(w == 0) {
+      pos = ((pos >> 6) + 1) << 6;
+      if(pos >= 65536) return;
+      w = words[pos >> 6];
+    }
+    const uint32_t start = ((pos >> 6) << 6) + static_cast<uint32_t>(__builtin_ctzll(w));
+    // Find the next clear bit after it
+    pos        = start;
+    uint64_t c = ~words[pos >> 6] & (~uint64_t{0} << (pos & 63));
+    while(c == 0) {
+      pos = ((pos >> 6) + 1) << 6;
+      if(pos >= 65536) break;
+      c = ~words[pos >> 6];
+    }
+    const uint32_t end = pos >= 65536 ? 65536 : ((pos >> 6) << 6) + __builtin_ctzll(c);
+    runs.push_back(static_cast<uint16_t>(start));
+    runs.push_back(static_cast<uint16_t>(end - start - 1));
+    pos = end;
+  }
+}
+
+// Make an owned container mutable as bitmap words
+void make_bitmap(RoaringOwnedContainer& c) {
+  if(c.type == Type::bitmap) return;
+  std::vector<uint64_t> words(roaring_bitmap_words);
+  to_words(c.ref(), words.data());
+  c.words = std::move(words);
+  c.values.clear();
+  c.type = Type::bitmap;
+}
+
+} // namespace
+
+bool RoaringContainer::contains(uint16_t value) const noexcept {
+  switch(type) {
+  case Type::array: return std::binary_search(values, values + size, value);
+  case Type::bitmap: return test_bit(words, value);
+  case Type::run: return run_contains(values, size, value);
+  }
+  return false;
+}
+
+namespace detail {
+
+void roaring_copy(const RoaringContainer& a, RoaringOwnedContainer& out) {
+  out.type        = a.type;
+  out.cardinality = a.cardinality;
+  if(a.type == Type::bitmap) {
+    out.words.assign(a.words, a.words + roaring_bitmap_words);
+  } else {
+    const size_t n = a.type == Type::run ? 2 * size_t{a.size} : a.size;
+    out.values.assign(a.values, a.values + n);
+  }
+}
+
+void roaring_and(const RoaringContainer& a, const RoaringContainer& b, RoaringOwnedContainer& out) {
+  if(a.type == Type::array && b.type == Type::array) {
+    out.type = Type::array;
+    out.values.resize(std::min(a.size, b.size));
+    const size_t count = array_and<true>(a.values, a.size, b.values, b.size, out.values.data());
+    out.cardinality    = static_cast<uint32_t>(count);
+    out.values.resize(out.cardinality);
+    return;
+  }
+  if(a.type == Type::array || b.type == Type::array) {
+    const auto& array = a.type == Type::array ? a : b;
+    const auto& other = a.type == Type::array ? b : a;
+    out.type          = Type::array;
+    out.values.clear();
+    for(uint32_t i = 0; i < array.size; ++i) {
+      if(other.contains(array.values[i])) out.values.push_back(array.values[i]);
+    }
+    out.cardinality = static_cast<uint32_t>(out.values.size());
+    return;
+  }
+
+  uint64_t scratch_a[roaring_bitmap_words], scratch_b[roaring_bitmap_words];
+  out.words.resize(roaring_bitmap_words);
+  bitmap_op<WordOp::and_>(words_of(a, scratch_a), words_of(b, scratch_b), out.words.data());
+  finish_bitmap(out, static_cast<uint32_t>(popcount_words(out.words.data(), roaring_bitmap_words)));
+}
+
+void roaring_or(const RoaringContainer& a, const RoaringContainer& b, RoaringOwnedContainer& out) {
+  if(a.type == Type::array && b.type == Type::array && a.size + b.size <= roaring_max_array) {
+    out.type = Type::array;
+    out.values.resize(a.size + b.size);
+    const auto end  = std::set_union(
+        a.values, a.values + a.size, b.values, b.values + b.size, out.values.begin());
+    out.values.resize(static_cast<size_t>(end - out.values.begin()));
+    out.cardinality = static_cast<uint32_t>(out.values.size());
+    return;
+  }
+
+  out.words.resize(roaring_bitmap_words);
+  to_words(a, out.words.data());
+  if(b.type == Type::bitmap) {
+    bitmap_op<WordOp::or_>(out.words.data(), b.words, out.words.data());
+  } else if(b.type == Type::array) {
+    for(uint32_t i = 0; i < b.size; ++i) set_bit(out.words.data(), b.values[i]);
+  } else {
+    for(uint32_t i = 0; i < b.size; ++i)
+      fill_range<true>(out.words.data(), b.values[2 * i], b.values[2 * i] + b.values[2 * i + 1]);
+  }
+  finish_bitmap(out, static_cast<uint32_t>(popcount_words(out.words.data(), roaring_bitmap_words)));
+}
+
+void roaring_andnot(
+    const RoaringContainer& a, const RoaringContainer& b, RoaringOwnedContainer& out) {
+  if(a.type == Type::array) {
+    out.type = Type::array;
+    out.values.clear();
+    if(b.type == Type::array) {
+      out.values.resize(a.size);
+      const auto end = std::set_difference(
+          a.values, a.values + a.size, b.values, b.values + b.size, out.values.begin());
+      out.values.resize(static_cast<size_t>(end - out.values.begin()));
+    } else {
+      for(uint32_t i = 0; i < a.size; ++i) {
+        if(!b.contains(a.values[i])) out.values.push_back(a.values[i]);
+      }
+    }
+    out.cardinality = static_cast<uint32_t>(out.values.size());
+    return;
+  }
+
+  out.words.resize(roaring_bitmap_words);
+  to_words(a, out.words.data());
+  if(b.type == Type::bitmap) {
+    bitmap_op<WordOp::andnot>(out.words.data(), b.words, out.words.data());
+  } else if(b.type == Type::array) {
+    for(uint32_t i = 0; i < b.size; ++i) clear_bit(out.words.data(), b.values[i]);
+  } else {
+    for(uint32_t i = 0; i < b.size; ++i)
+      fill_range<false>(out.words.data(), b.values[2 * i], b.values[2 * i] + b.values[2 * i + 1]);
+  }
+  finish_bitmap(out, static_cast<uint32_t>(popcount_words(out.words.data(), roaring_bitmap_words)));
+}
+
+uint32_t roaring_and_cardinality(const RoaringContainer& a, const RoaringContainer& b) noexcept {
+  if(a.type == Type::array && b.type == Type::array)
+    return static_cast<uint32_t>(array_and<false>(a.values, a.size, b.values, b.size, nullptr));
+  if(a.type == Type::array || b.type == Type::array) {
+    const auto& array = a.type == Type::array ? a : b;
+    const auto& other = a.type == Type::array ? b : a;
+    uint32_t count    = 0;
+    for(uint32_t i = 0; i < array.size; ++i) count += other.contains(array.values[i]);
+    return count;
+  }
+  uint64_t scratch_a[roaring_bitmap_words], scratch_b[roaring_bitmap_words];
+  return bitmap_and_count(words_of(a, scratch_a), words_of(b, scratch_b));
+}
+
+void roaring_append_values(const RoaringContainer& c, uint16_t key, std::vector<uint32_t>& out) {
+  const uint32_t high = uint32_t{key} << 16;
+  switch(c.type) {
+  case Type::array:
+    for(uint32_t i = 0; i < c.size; ++i) out.push_back(high | c.values[i]);
+    break;
+  case Type::bitmap:
+    for(size_t w = 0; w < roaring_bitmap_words; ++w) {
+      for(uint64_t word = c.words[w]; word != 0; word &= word - 1)
+        out.push_back(high | static_cast<uint32_t>(w * 64 + __builtin_ctzll(word)));
+    }
+    break;
+  case Type::run:
+    for(uint32_t i = 0; i < c.size; ++i) {
+      const uint32_t start = c.values[2 * i];
+      for(uint32_t v = start; v <= start + c.values[2 * i + 1]; ++v) out.push_back(high | v);
+    }
+    break;
+  }
+}
+
+} // namespace detail
+
+RoaringBitmap RoaringBitmap::from_values(std::vector<uint32_t> values) {
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  RoaringBitmap result;
+  for(uint32_t value : values) result.add(value);
+  return result;
+}
+
+void RoaringBitmap::add(uint32_t value) {
+  const auto key = static_cast<uint16_t>(value >> 16);
+  const auto low = static_cast<uint16_t>(value);
+
+  size_t i;
+  if(!keys.empty() && keys.back() == key) {
+    i = keys.size() - 1;
+  } else {
+    i = static_cast<size_t>(std::lower_bound(keys.begin(), keys.end(), key) - keys.begin());
+    if(i == keys.size() || keys[i] != key) {
+      keys.insert(keys.begin() + static_cast<ptrdiff_t>(i), key);
+      containers.insert(containers.begin() + static_cast<ptrdiff_t>(i), RoaringOwnedContainer{});
+    }
+  }
+
+  auto& c = containers[i];
+  if(c.type == Type::run) make_bitmap(c);
+  if(c.type == Type::array) {
+    if(c.values.empty() || c.values.back() < low) {
+      if(c.cardinality < roaring_max_array) {
+        c.values.push_back(low);
+        ++c.cardinality;
+        return;
+      }
+    } else {
+      const auto it = std::lower_bound(c.values.begin(), c.values.end(), low);
+      if(*it == low) return;
+      if(c.cardinality < roaring_max_array) {
+        c.values.insert(it, low);
+        ++c.cardinality;
+        return;
+      }
+    }
+    make_bitmap(c);
+  }
+  if(!test_bit(c.words.data(), low)) {
+    set_bit(c.words.data(), low);
+    ++c.cardinality;
+  }
+}
+
+void RoaringBitmap::add_range(uint64_t first, uint64_t last) {
+  last = std::min<uint64_t>(last, uint64_t{1} << 32);
+  while(first < last) {
+    const auto key       = static_cast<uint16_t>(first >> 16);
+    const uint64_t limit = std::min<uint64_t>(last, (uint64_t{key} + 1) << 16);
+    // Make sure the container exists, then fill it as a bitmap
+    add(static_cast<uint32_t>(first));
+    const size_t i =
+        static_cast<size_t>(std::lower_bound(keys.begin(), keys.end(), key) - keys.begin());
+    auto& c = containers[i];
+    make_bitmap(c);
+    fill_range<true>(c.words.data(), static_cast<uint32_t>(first & 0xffff),
+        static_cast<uint32_t>((limit - 1) & 0xffff));
+    finish_bitmap(c, static_cast<uint32_t>(popcount_words(c.words.data(), roaring_bitmap_words)));
+    first = limit;
+  }
+}
+
+void RoaringBitmap::optimize() {
+  for(auto& c : containers) {
+    const uint32_t runs = c.type == Type::bitmap  ? count_runs(c.words.data())
+                          : c.type == Type::array ? count_runs(c.values.data(), c.cardinality)
+                                                  : static_cast<uint32_t>(c.values.size() / 2);
+    const size_t run_size    = runs * 4;
+    const size_t array_size  = c.cardinality <= roaring_max_array ? c.cardinality * 2 : SIZE_MAX;
+    const size_t bitmap_size = bitmap_bytes;
+
+    if(run_size < std::min(array_size, bitmap_size)) {
+      if(c.type == Type::run) continue;
+      make_bitmap(c);
+      words_to_runs(c.words.data(), c.values);
+      c.words.clear();
+      c.words.shrink_to_fit();
+      c.type = Type::run;
+    } else if(c.type == Type::run) {
+      make_bitmap(c);
+      finish_bitmap(c, c.cardinality);
+    }
+  }
+}
+
+bool RoaringBitmap::contains(uint32_t value) const noexcept {
+  const auto key = static_cast<uint16_t>(value >> 16);
+  const auto it  = std::lower_bound(keys.begin(), keys.end(), key);
+  if(it == keys.end() || *it != key) return false;
+  return containers[static_cast<size_t>(it - keys.begin())].ref().contains(
+      static_cast<uint16_t>(value));
+}
+
+uint64_t RoaringBitmap::cardinality() const noexcept {
+  uint64_t total = 0;
+  for(const auto& c : containers) total += c.cardinality;
+  return total;
+}
+
+std::vector<uint32_t> RoaringBitmap::to_vector() const {
+  std::vector<uint32_t> result;
+  result.reserve(cardinality());
+  for(size_t i = 0; i < containers.size(); ++i)
+    detail::roaring_append_values(containers[i].ref(), keys[i], result);
+  return result;
+}
+
+void RoaringBitmap::append(uint16_t key, RoaringOwnedContainer container) {
+  keys.push_back(key);
+  containers.push_back(std::move(container));
+}
+
+size_t RoaringBitmap::serialized_size() const noexcept {
+  size_t size = sizeof(RoaringView::Header) + containers.size() * sizeof(RoaringView::Entry);
+  for(const auto& c : containers) size += payload_bytes(c.ref());
+  return size;
+}
+
+std::string RoaringBitmap::serialize() const {
+  std::string out(serialized_size(), '\0');
+  char* const base = out.data();
+
+  RoaringView::Header header{};
+  header.magic           = RoaringView::magic;
+  header.version         = RoaringView::version;
+  header.container_count = static_cast<uint32_t>(containers.size());
+  header.cardinality     = cardinality();
+  std::memcpy(base, &header, sizeof(header));
+
+  size_t offset = sizeof(RoaringView::Header) + containers.size() * sizeof(RoaringView::Entry);
+  for(size_t i = 0; i < containers.size(); ++i) {
+    const RoaringContainer c = containers[i].ref();
+    RoaringView::Entry entry{};
+    entry.key         = keys[i];
+    entry.type        = static_cast<uint8_t>(c.type);
+    entry.size        = c.type == Type::bitmap ? 0 : c.size;
+    entry.cardinality = c.cardinality;
+    entry.offset      = static_cast<uint32_t>(offset);
+    std::memcpy(base + sizeof(RoaringView::Header) + i * sizeof(entry), &entry, sizeof(entry));
+
+    if(c.type == Type::bitmap) {
+      std::memcpy(base + offset, c.words, bitmap_bytes);
+    } else {
+      const size_t n = c.type == Type::run ? 2 * size_t{c.size} : c.size;
+      std::memcpy(base + offset, c.values, n * sizeof(uint16_t));
+    }
+    offset += payload_bytes(c);
+  }
+  return out;
+}
+
+Result<RoaringView> RoaringView::open(const void* data, size_t size) noexcept {
+  const auto invalid = [] { return Result<RoaringView>::error(StatusCode::invalid_argument); };
+  if(data == nullptr || reinterpret_cast<uintptr_t>(data) % 8 != 0) return invalid();
+  if(size < sizeof(Header)) return invalid();
+
+  RoaringView view;
+  view.header = static_cast<const Header*>(data);
+  if(view.header->magic != magic || view.header->version != version) return invalid();
+  const size_t count = view.header->container_count;
+  if(count > 65536 || sizeof(Header) + count * sizeof(Entry) > size) return invalid();
+  view.entries = reinterpret_cast<const Entry*>(view.header + 1);
+
+  // Check the directory so lookups never read out of bounds
+  uint64_t total = 0;
+  size_t end     = sizeof(Header) + count * sizeof(Entry);
+  for(size_t i = 0; i < count; ++i) {
+    const Entry& e = view.entries[i];
+    if(i > 0 && e.key <= view.entries[i - 1].key) return invalid();
+    if(e.offset % 8 != 0 || e.offset < sizeof(Header) + count * sizeof(Entry)) return invalid();
+    if(e.cardinality == 0 || e.cardinality > 65536) return invalid();
+
+    RoaringContainer c;
+    c.type = static_cast<Type>(e.type);
+    c.size = e.size;
+    switch(c.type) {
+    case Type::array:
+      if(e.size != e.cardinality || e.size > roaring_max_array) return invalid();
+      break;
+    case Type::bitmap:
+      if(e.size != 0) return invalid();
+      break;
+    case Type::run:
+      if(e.size == 0 || e.size > 32768) return invalid();
+      break;
+    default: return invalid();
+    }
+    const size_t payload_end = size_t{e.offset} + payload_bytes(c);
+    if(payload_end > size) return invalid();
+    end = std::max(end, payload_end);
+
+    // Set operations expand runs into bitmap words without checking them again
+    const auto* values =
+        reinterpret_cast<const uint16_t*>(static_cast<const char*>(data) + e.offset);
+    if(c.type == Type::array) {
+      for(uint32_t j = 1; j < e.size; ++j) {
+        if(values[j] <= values[j - 1]) return invalid();
+      }
+    } else if(c.type == Type::run) {
+      uint32_t run_cardinality = 0;
+      for(uint32_t j = 0; j < e.size; ++j) {
+        const uint32_t start = values[2 * j];
+        const uint32_t last  = start + values[2 * j + 1];
+        if(last > 0xffff) return invalid();
+        if(j > 0 && start <= uint32_t{values[2 * j - 2]} + values[2 * j - 1]) return invalid();
+        run_cardinality += values[2 * j + 1] + 1;
+      }
+      if(run_cardinality != e.cardinality) return invalid();
+    }
+    total += e.cardinality;
+  }
+  if(total != view.header->cardinality) return invalid();
+
+  view.bytes = end;
+  return view;
+}
+
+RoaringContainer RoaringView::container(size_t i) const noexcept {
+  const Entry& e   = entries[i];
+  const char* base = reinterpret_cast<const char*>(header) + e.offset;
+  RoaringContainer c;
+  c.type        = static_cast<RoaringContainerType>(e.type);
+  c.cardinality = e.cardinality;
+  c.size        = e.size;
+  if(c.type == Type::bitmap) {
+    c.words = reinterpret_cast<const uint64_t*>(base);
+  } else {
+    c.values = reinterpret_cast<const uint16_t*>(base);
+  }
+  return c;
+}
+
+bool RoaringView::contains(uint32_t value) const noexcept {
+  const auto key = static_cast<uint16_t>(value >> 16);
+  size_t lo = 0, hi = container_count();
+  while(lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if(entries[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if(lo == container_count() || entries[lo].key != key) return false;
+  return container(lo).contains(static_cast<uint16_t>(value));
+}
+
+std::vector<uint32_t> RoaringView::to_vector() const {
+  std::vector<uint32_t> result;
+  result.reserve(cardinality());
+  for(size_t i = 0; i < container_count(); ++i)
+    detail::roaring_append_values(container(i), key(i), result);
+  return result;
+}
+
+} // namespace internal
+} // namespace peregrine
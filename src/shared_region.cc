@@ -0,0 +1,271 @@
+#include "peregrine/internal/shared_region.hh"
+
+#include <sys/un.h>
+
+#include <atomic>
+#include <cstring>
+
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+// Sockets are created close-on-exec atomically where the platform allows it
+#if defined(SOCK_CLOEXEC)
+constexpr int socket_type = SOCK_STREAM | SOCK_CLOEXEC;
+#else
+constexpr int socket_type = SOCK_STREAM;
+#endif // defined(SOCK_CLOEXEC)
+
+// Create an anonymous file that is not visible in the file system
+Result<File> create_anonymous(std::string_view name) {
+#if defined(PEREGRINE_HAVE_MEMFD)
+  const std::string memfd_name(name);
+  const int fd =
+      ::peregrine::internal::memfd_create(memfd_name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if(PEREGRINE_UNLIKELY(fd == -1)) return Result<File>::error(errno_to_status());
+  return File(fd);
+#else
+  // Fall back to a temporary file that is unlinked as soon as it is open
+  static std::atomic<uint64_t> sequence{0};
+  const char* tmp  = ::getenv("TMPDIR");
+  const auto path  = fmt::format("{}/peregrine-{}.{}.{}"sv, tmp != nullptr ? tmp : "/tmp", name,
+       ::getpid(), sequence.fetch_add(1, std::memory_order_relaxed));
+  File file;
+  if(auto status = file.open(path, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+      PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return Result<File>::error(status);
+  ::peregrine::internal::unlink(path.c_str());
+  return file;
+#endif // defined(PEREGRINE_HAVE_MEMFD)
+}
+
+// Fill in a socket address for `path`
+StatusCode unix_address(std::string_view path, struct sockaddr_un& address) noexcept {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(PEREGRINE_UNLIKELY(path.size() >= sizeof(address.sun_path))) return StatusCode::enametoolong;
+  std::memcpy(address.sun_path, path.data(), path.size());
+  return StatusCode::ok;
+}
+
+Result<File> unix_socket() noexcept {
+  const int fd = ::peregrine::internal::socket(AF_UNIX, socket_type, 0);
+  if(PEREGRINE_UNLIKELY(fd == -1)) return Result<File>::error(errno_to_status());
+#if !defined(SOCK_CLOEXEC)
+  ::peregrine::internal::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif // !defined(SOCK_CLOEXEC)
+  return File(fd);
+}
+
+} // namespace
+
+StatusCode SharedRegion::create(std::string_view name, size_t size) {
+  if(PEREGRINE_UNLIKELY(is_open())) return StatusCode::already_open;
+  if(PEREGRINE_UNLIKELY(size == 0)) return StatusCode::invalid_argument;
+
+  auto file = create_anonymous(name);
+  if(PEREGRINE_UNLIKELY(!file.ok())) {
+    PEREGRINE_LOG_ERROR("Failed to create shared region \"{}\" : {}"sv, name, file.status());
+    return file.status();
+  }
+  if(auto status = file->truncate(static_cast<off_t>(size));
+      PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return status;
+  if(auto status = map.map(file.value(), 0, size, PROT_READ | PROT_WRITE, MAP_SHARED);
+      PEREGRINE_UNLIKELY(status != StatusCode::ok)) {
+    PEREGRINE_LOG_ERROR("Failed to map shared region \"{}\" : {}"sv, name, status);
+    return status;
+  }
+
+  region_file = std::move(file).value();
+  writable    = true;
+  PEREGRINE_LOG_DEBUG("Created shared region \"{}\" of {} bytes"sv, name, size);
+  return StatusCode::ok;
+}
+
+StatusCode SharedRegion::seal() noexcept {
+  if(PEREGRINE_UNLIKELY(!is_open())) return StatusCode::not_open;
+  if(!writable) return StatusCode::ok;
+
+  // A write seal is refused while any writable shared mapping exists, so drop ours first
+  const size_t length = map.size();
+  if(auto status = map.unmap(); PEREGRINE_UNLIKELY(status != StatusCode::ok)) return status;
+  writable = false;
+
+#if defined(F_ADD_SEALS)
+  const int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL;
+  if(::peregrine::internal::fcntl(region_file.native_handle(), F_ADD_SEALS, seals) == -1) {
+    const StatusCode status = errno_to_status();
+    // Not every backing file supports seals; the region is still read-only in this process.
+    PEREGRINE_LOG_WARN("Failed to seal shared region : {}"sv, status);
+  }
+#endif // defined(F_ADD_SEALS)
+
+  return map.map(region_file, 0, length, PROT_READ, MAP_SHARED);
+}
+
+StatusCode SharedRegion::attach(File file) noexcept {
+  if(PEREGRINE_UNLIKELY(is_open())) return StatusCode::already_open;
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return StatusCode::not_open;
+
+  if(auto status = map.map(file, PROT_READ, MAP_SHARED);
+      PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return status;
+  region_file = std::move(file);
+  writable    = false;
+  return StatusCode::ok;
+}
+
+StatusCode DescriptorChannel::listen(std::string_view path, int backlog) {
+  struct sockaddr_un address;
+  if(auto status = unix_address(path, address); PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return status;
+
+  auto result = unix_socket();
+  if(PEREGRINE_UNLIKELY(!result.ok())) return result.status();
+  File server = std::move(result).value();
+
+  // Replace a stale socket left by a previous run
+  ::peregrine::internal::unlink(address.sun_path);
+  if(::peregrine::internal::bind(server.native_handle(),
+         reinterpret_cast<const struct sockaddr*>(&address), sizeof(address)) == -1 ||
+      ::peregrine::internal::listen(server.native_handle(), backlog) == -1) {
+    const StatusCode status = errno_to_status();
+    PEREGRINE_LOG_ERROR("Failed to listen on \"{}\" : {}"sv, path, status);
+    return status;
+  }
+
+  socket = std::move(server);
+  return StatusCode::ok;
+}
+
+Result<DescriptorChannel> DescriptorChannel::accept() const noexcept {
+#if defined(__linux__)
+  const int fd =
+      ::peregrine::internal::accept4(socket.native_handle(), nullptr, nullptr, SOCK_CLOEXEC);
+  if(PEREGRINE_UNLIKELY(fd == -1)) return Result<DescriptorChannel>::error(errno_to_status());
+#else
+  const int fd = ::peregrine::internal::accept(socket.native_handle(), nullptr, nullptr);
+  if(PEREGRINE_UNLIKELY(fd == -1)) return Result<DescriptorChannel>::error(errno_to_status());
+  ::peregrine::internal::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif // defined(__linux__)
+  return DescriptorChannel(File(fd));
+}
+
+StatusCode DescriptorChannel::connect(std::string_view path) {
+  struct sockaddr_un address;
+  if(auto status = unix_address(path, address); PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return status;
+
+  auto result = unix_socket();
+  if(PEREGRINE_UNLIKELY(!result.ok())) return result.status();
+  File client = std::move(result).value();
+
+  if(::peregrine::internal::connect(client.native_handle(),
+         reinterpret_cast<const struct sockaddr*>(&address), sizeof(address)) == -1) {
+    const StatusCode status = errno_to_status();
+    PEREGRINE_LOG_ERROR("Failed to connect to \"{}\" : {}"sv, path, status);
+    return status;
+  }
+
+  socket = std::move(client);
+  return StatusCode::ok;
+}
+
+StatusCode DescriptorChannel::pair(DescriptorChannel& first, DescriptorChannel& second) noexcept {
+  int fds[2];
+  if(::peregrine::internal::socketpair(AF_UNIX, socket_type, 0, fds) == -1)
+    return errno_to_status();
+#if !defined(SOCK_CLOEXEC)
+  ::peregrine::internal::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  ::peregrine::internal::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif // !defined(SOCK_CLOEXEC)
+  first.socket  = File(fds[0]);
+  second.socket = File(fds[1]);
+  return StatusCode::ok;
+}
+
+StatusCode DescriptorChannel::send(const File& file, std::string_view tag) const noexcept {
+  if(PEREGRINE_UNLIKELY(tag.size() > max_tag_size)) return StatusCode::invalid_argument;
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return StatusCode::not_open;
+
+  // The payload is the tag prefixed by its length, which also guarantees at least one byte is
+  // sent with the descriptor.
+  unsigned char payload[1 + max_tag_size];
+  payload[0] = static_cast<unsigned char>(tag.size());
+  std::memcpy(payload + 1, tag.data(), tag.size());
+  struct iovec iov {
+    payload, 1 + tag.size()
+  };
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  std::memset(control, 0, sizeof(control));
+  struct msghdr message {};
+  message.msg_iov        = &iov;
+  message.msg_iovlen     = 1;
+  message.msg_control    = control;
+  message.msg_controllen = sizeof(control);
+
+  struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level     = SOL_SOCKET;
+  header->cmsg_type      = SCM_RIGHTS;
+  header->cmsg_len       = CMSG_LEN(sizeof(int));
+  const int fd           = file.native_handle();
+  std::memcpy(CMSG_DATA(header), &fd, sizeof(fd));
+
+  int flags = 0;
+#if defined(MSG_NOSIGNAL)
+  flags |= MSG_NOSIGNAL;
+#endif // defined(MSG_NOSIGNAL)
+  if(PEREGRINE_UNLIKELY(
+         ::peregrine::internal::sendmsg(socket.native_handle(), &message, flags) == -1)) {
+    const StatusCode status = errno_to_status();
+    PEREGRINE_LOG_ERROR("Failed to send descriptor \"{}\" : {}"sv, tag, status);
+    return status;
+  }
+  return StatusCode::ok;
+}
+
+Result<File> DescriptorChannel::receive(std::string& tag) const {
+  unsigned char payload[1 + max_tag_size];
+  struct iovec iov {
+    payload, sizeof(payload)
+  };
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr message {};
+  message.msg_iov        = &iov;
+  message.msg_iovlen     = 1;
+  message.msg_control    = control;
+  message.msg_controllen = sizeof(control);
+
+  int flags = 0;
+#if defined(MSG_CMSG_CLOEXEC)
+  flags |= MSG_CMSG_CLOEXEC;
+#endif // defined(MSG_CMSG_CLOEXEC)
+  const ssize_t rc = ::peregrine::internal::recvmsg(socket.native_handle(), &message, flags);
+  if(PEREGRINE_UNLIKELY(rc == -1)) return Result<File>::error(errno_to_status());
+  if(PEREGRINE_UNLIKELY(rc == 0)) return Result<File>::error(StatusCode::econnreset);
+
+  File file;
+  for(auto* header = CMSG_FIRSTHDR(&message); header != nullptr;
+      header       = CMSG_NXTHDR(&message, header)) {
+    if(header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+      int fd;
+      std::memcpy(&fd, CMSG_DATA(header), sizeof(fd));
+      file = File(fd);
+    }
+  }
+  if(PEREGRINE_UNLIKELY(!file.is_open() || (message.msg_flags & MSG_CTRUNC) != 0))
+    return Result<File>::error(StatusCode::eproto);
+
+  const size_t length = std::min<size_t>(payload[0], static_cast<size_t>(rc) - 1);
+  tag.assign(reinterpret_cast<const char*>(payload + 1), length);
+  return file;
+}
+
+} // namespace internal
+} // namespace peregrine
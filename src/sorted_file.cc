@@ -0,0 +1,403 @@
+#include "peregrine/internal/sorted_file.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include "peregrine/internal/log.hh"
+#include "peregrine/internal/simd.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+uint64_t page_floor(uint64_t offset) noexcept { return offset & ~uint64_t{page_size() - 1}; }
+
+uint64_t page_ceil(uint64_t offset) noexcept { return page_floor(offset + page_size() - 1); }
+
+
+} // namespace
+
+SortedWriter::~SortedWriter() {
+  if(file.is_open()) close();
+}
+
+StatusCode SortedWriter::open(std::string_view path, int flags, mode_t mode) {
+  if(PEREGRINE_UNLIKELY(file.is_open())) return StatusCode::already_open;
+  if(auto status = file.open(path, flags | O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+      PEREGRINE_UNLIKELY(status != StatusCode::ok))
+    return status;
+
+  builder = KeyBlockBuilder(options.restart_interval);
+  index   = KeyBlockBuilder(1);
+  last.clear();
+  end    = 0;
+  blocks = 0;
+  return StatusCode::ok;
+}
+
+StatusCode SortedWriter::add(std::string_view key, std::string_view value) {
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return StatusCode::not_open;
+  const bool first = builder.size() == 0 && blocks == 0;
+  if(!first && compare_bytes(key, last) <= 0) return StatusCode::invalid_argument;
+  if(auto status = builder.add(key, value); status != StatusCode::ok) return status;
+  last.assign(key);
+  return builder.serialized_size() >= options.block_size ? flush_block() : StatusCode::ok;
+}
+
+StatusCode SortedWriter::flush_block() {
+  const std::string block = builder.finish();
+  SortedFile::IndexEntry entry{end, block.size()};
+  if(auto status = write(block.data(), block.size()); status != StatusCode::ok) return status;
+
+  // Blocks start 8-byte aligned so they can be viewed in place
+  static constexpr char zeros[8] = {};
+  if(auto status = write(zeros, pad8(end) - end); status != StatusCode::ok) return status;
+  ++blocks;
+  return index.add(last, std::string_view(reinterpret_cast<const char*>(&entry), sizeof(entry)));
+}
+
+StatusCode SortedWriter::write(const void* data, size_t size) {
+  if(auto status = file.pwrite_all(data, size, static_cast<off_t>(end)); status != StatusCode::ok)
+    return status;
+  end += size;
+  return StatusCode::ok;
+}
+
+StatusCode SortedWriter::close() {
+  if(PEREGRINE_UNLIKELY(!file.is_open())) return StatusCode::not_open;
+  StatusCode status = StatusCode::ok;
+  if(builder.size() != 0) status = flush_block();
+
+  const std::string serialized = index.finish();
+  SortedFile::Footer footer{};
+  footer.magic        = SortedFile::magic;
+  footer.version      = SortedFile::version;
+  footer.block_count  = blocks;
+  footer.index_offset = end;
+  footer.index_size   = serialized.size();
+  if(status == StatusCode::ok) status = write(serialized.data(), serialized.size());
+  if(status == StatusCode::ok) status = write(&footer, sizeof(footer));
+
+  const auto closed = file.close();
+  return status != StatusCode::ok ? status : closed;
+}
+
+StatusCode SortedFile::open(std::string_view path) {
+  if(PEREGRINE_UNLIKELY(file.is_open())) return StatusCode::already_open;
+  if(auto status = file.open(path, O_RDONLY | O_CLOEXEC); status != StatusCode::ok) return status;
+
+  const auto fail = [this](StatusCode status) {
+    map.unmap();
+    file.close();
+    index.clear();
+    last_keys.clear();
+    return status;
+  };
+  struct stat st;
+  if(auto status = file.stat(&st); status != StatusCode::ok) return fail(status);
+  const auto file_size = static_cast<uint64_t>(st.st_size);
+  if(file_size < sizeof(Footer)) return fail(StatusCode::invalid_argument);
+  Footer footer;
+  if(auto status = file.pread_exact(&footer, sizeof(footer), file_size - sizeof(Footer));
+      status != StatusCode::ok)
+    return fail(status);
+  if(footer.magic != magic || footer.version != version || footer.index_offset % 8 != 0 ||
+      footer.index_size > file_size ||
+      footer.index_offset != file_size - sizeof(Footer) - footer.index_size ||
+      footer.block_count > footer.index_offset / sizeof(KeyBlock::Header)) {
+    return fail(StatusCode::invalid_argument);
+  }
+
+  // The index is a key block from each block's last key to its entry
+  std::vector<uint64_t> storage((footer.index_size + 7) / 8);
+  if(auto status = file.pread_exact(storage.data(), footer.index_size, footer.index_offset);
+      status != StatusCode::ok)
+    return fail(status);
+  auto view = KeyBlock::open(storage.data(), footer.index_size);
+  if(!view.ok() || view->size() != footer.block_count) return fail(StatusCode::invalid_argument);
+  index.reserve(footer.block_count);
+  last_keys.reserve(footer.block_count);
+  uint64_t expected = 0;
+  for(auto it = view->begin(); it.valid(); it.next()) {
+    IndexEntry entry;
+    if(it.value().size() != sizeof(entry)) return fail(StatusCode::invalid_argument);
+    std::memcpy(&entry, it.value().data(), sizeof(entry));
+    if(entry.offset != expected || entry.size < sizeof(KeyBlock::Header) ||
+        entry.size > footer.index_offset - entry.offset) {
+      return fail(StatusCode::invalid_argument);
+    }
+    expected = pad8(entry.offset + entry.size);
+    index.push_back(entry);
+    last_keys.emplace_back(it.key());
+  }
+  if(index.size() != footer.block_count || expected != footer.index_offset)
+    return fail(StatusCode::invalid_argument);
+
+  if(options.use_mmap && footer.index_offset != 0) {
+    if(auto status = map.map(file, PROT_READ, MAP_SHARED); status != StatusCode::ok)
+      return fail(status);
+  }
+  PEREGRINE_LOG_DEBUG("Opened sorted file \"{}\" with {} blocks using {}"sv, path, index.size(),
+      map.is_open() ? "mmap"sv : "pread"sv);
+  return StatusCode::ok;
+}
+
+SortedFile::Iterator::Iterator(const SortedFile& file, ScanOptions options) noexcept :
+    file(&file), options(options) {
+  this->options.sequential_blocks = std::max<size_t>(options.sequential_blocks, 1);
+  this->options.max_window        = std::max(options.max_window, options.initial_window);
+  window                          = options.initial_window;
+}
+
+SortedFile::Iterator::~Iterator() {
+  if(next_window.pending.valid()) next_window.pending.wait();
+}
+
+void SortedFile::Iterator::seek_to_first() {
+  error = StatusCode::ok;
+  if(file->index.empty()) return fail(StatusCode::ok);
+  if(load(0)) position = 0;
+}
+
+void SortedFile::Iterator::seek_to_last() {
+  error = StatusCode::ok;
+  if(file->index.empty()) return fail(StatusCode::ok);
+  if(load(file->index.size() - 1)) position = entries.size() - 1;
+}
+
+void SortedFile::Iterator::seek(std::string_view key) {
+  error = StatusCode::ok;
+  const auto& last_keys = file->last_keys;
+  const auto it         = std::lower_bound(last_keys.begin(), last_keys.end(), key);
+  if(it == last_keys.end()) return fail(StatusCode::ok);
+  if(!load(static_cast<size_t>(it - last_keys.begin()))) return;
+
+  // The block's last key is not less than `key`, so an entry is found
+  const auto key_at = [this](size_t i) {
+    return std::string_view(keys.data() + entries[i].key_offset, entries[i].key_size);
+  };
+  size_t lo = 0, hi = entries.size() - 1;
+  while(lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if(key_at(mid) < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  position = lo;
+}
+
+void SortedFile::Iterator::next() {
+  if(++position < entries.size()) return;
+  if(current_block + 1 >= file->index.size()) return fail(StatusCode::ok);
+  if(load(current_block + 1)) position = 0;
+}
+
+void SortedFile::Iterator::prev() {
+  if(position > 0) {
+    --position;
+    return;
+  }
+  if(current_block == 0) return fail(StatusCode::ok);
+  if(load(current_block - 1)) position = entries.size() - 1;
+}
+
+bool SortedFile::Iterator::load(size_t block) {
+  track(block);
+  auto data = locate(block);
+  if(!data.ok()) {
+    fail(data.status());
+    return false;
+  }
+  read_ahead(block);
+  drop_behind(block);
+
+  auto view = KeyBlock::open(data.value(), file->index[block].size);
+  if(!view.ok() || view->size() == 0) {
+    fail(StatusCode::invalid_argument);
+    return false;
+  }
+  entries.clear();
+  keys.clear();
+  for(auto it = view->begin(); it.valid(); it.next()) {
+    entries.push_back({static_cast<uint32_t>(keys.size()), static_cast<uint32_t>(it.key().size()),
+        it.value()});
+    keys.append(it.key());
+  }
+  if(entries.size() != view->size()) {
+    fail(StatusCode::invalid_argument);
+    return false;
+  }
+  current_block = block;
+  ++counters.blocks;
+  return true;
+}
+
+Result<const char*> SortedFile::Iterator::locate(size_t block) {
+  const auto& index = file->index;
+  if(file->map.is_open())
+    return static_cast<const char*>(file->map.data()) + index[block].offset;
+
+  if(!current.contains(block)) {
+    if(next_window.contains(block)) {
+      // The cursor reached the window read ahead of it
+      const auto status = finish(next_window);
+      std::swap(current, next_window);
+      next_window.first = next_window.last = 0;
+      if(status != StatusCode::ok) {
+        current.first = current.last = 0;
+        return Result<const char*>::error(status);
+      }
+    } else {
+      // A read in flight must land before its buffer is reused
+      if(next_window.pending.valid()) next_window.pending.wait();
+      next_window.pending   = {};
+      next_window.first     = next_window.last = 0;
+      const bool sequential = run >= options.sequential_blocks;
+      std::tie(current.first, current.last) =
+          sequential ? window_blocks(block, direction) : std::make_pair(block, block + 1);
+      const uint64_t begin = index[current.first].offset;
+      const uint64_t bytes = index[current.last - 1].offset + index[current.last - 1].size - begin;
+      current.buffer.resize((bytes + 7) / 8);
+      ++counters.reads;
+      if(auto status = file->file.pread_exact(current.buffer.data(), bytes, begin);
+          status != StatusCode::ok) {
+        current.first = current.last = 0;
+        return Result<const char*>::error(status);
+      }
+    }
+  }
+  const uint64_t offset = index[block].offset - index[current.first].offset;
+  return reinterpret_cast<const char*>(current.buffer.data()) + offset;
+}
+
+StatusCode SortedFile::Iterator::finish(Window& window) {
+  const auto result = window.pending.get();
+  if(!result.ok()) return result.status();
+  const auto& index    = file->index;
+  const uint64_t bytes = index[window.last - 1].offset + index[window.last - 1].size -
+                         index[window.first].offset;
+  return static_cast<uint64_t>(result.value()) == bytes ? StatusCode::ok
+                                                        : StatusCode::invalid_argument;
+}
+
+void SortedFile::Iterator::track(size_t block) noexcept {
+  int step = 0;
+  if(last_block != SIZE_MAX && block == last_block + 1) step = 1;
+  if(last_block != SIZE_MAX && block + 1 == last_block) step = -1;
+
+  if(step != 0 && step == direction) {
+    ++run;
+  } else {
+    // A jump or a turn starts over with a small window from the block the run started at
+    const size_t start = step != 0 ? last_block : block;
+    const auto& entry  = file->index[start];
+    direction          = step;
+    run                = step != 0 ? 1 : 0;
+    window             = options.initial_window;
+    ahead              = block;
+    drop_mark = step >= 0 ? page_floor(entry.offset) : page_ceil(entry.offset + entry.size);
+  }
+  last_block = block;
+}
+
+void SortedFile::Iterator::read_ahead(size_t block) {
+  if(run < options.sequential_blocks) return;
+  const auto& index = file->index;
+  const auto span   = [&](size_t first, size_t last) -> uint64_t {
+    return first < last ? index[last - 1].offset + index[last - 1].size - index[first].offset : 0;
+  };
+
+  size_t first, last;
+  if(!file->map.is_open() && file->options.reader != nullptr) {
+    // Keep one window in flight beyond the one being read
+    if(next_window.last != 0) return;
+    if(direction > 0 ? current.last >= index.size() : current.first == 0) return;
+    std::tie(first, last) = window_blocks(
+        direction > 0 ? current.last : current.first - 1, direction);
+    const uint64_t bytes = span(first, last);
+    next_window.buffer.resize((bytes + 7) / 8);
+    next_window.first   = first;
+    next_window.last    = last;
+    next_window.pending = file->options.reader->pread(file->file, next_window.buffer.data(),
+        bytes, static_cast<off_t>(index[first].offset));
+  } else {
+    // Hint the next window once less than half a window is left ahead of the cursor
+    if(direction > 0) {
+      ahead = std::max(ahead, block + 1);
+      if(ahead >= index.size() || span(block + 1, ahead) >= window / 2) return;
+      std::tie(first, last) = window_blocks(ahead, direction);
+      ahead                 = last;
+    } else {
+      ahead = std::min(ahead, block);
+      if(ahead == 0 || span(ahead, block) >= window / 2) return;
+      std::tie(first, last) = window_blocks(ahead - 1, direction);
+      ahead                 = first;
+    }
+    const uint64_t offset = index[first].offset;
+    if(file->map.is_open()) {
+      file->map.advise(offset, span(first, last), MADV_WILLNEED);
+    } else {
+#if defined(PEREGRINE_HAVE_POSIX_FADVISE)
+      file->file.advise(static_cast<off_t>(offset), static_cast<off_t>(span(first, last)),
+          POSIX_FADV_WILLNEED);
+#endif // defined(PEREGRINE_HAVE_POSIX_FADVISE)
+    }
+  }
+  ++counters.readahead_windows;
+  counters.readahead_bytes += span(first, last);
+  window = std::min(window * 2, options.max_window);
+}
+
+void SortedFile::Iterator::drop_behind(size_t block) noexcept {
+  if(!options.drop_behind || direction == 0) return;
+
+  // Release whole pages behind the current block, a window's worth at a time
+  const auto& entry = file->index[block];
+  uint64_t begin, end;
+  if(direction > 0) {
+    begin = drop_mark;
+    end   = page_floor(entry.offset);
+    if(end <= begin || end - begin < options.initial_window) return;
+    drop_mark = end;
+  } else {
+    begin = page_ceil(entry.offset + entry.size);
+    end   = drop_mark;
+    if(end <= begin || end - begin < options.initial_window) return;
+    drop_mark = begin;
+  }
+  if(file->map.is_open()) file->map.advise(begin, end - begin, MADV_DONTNEED);
+#if defined(PEREGRINE_HAVE_POSIX_FADVISE)
+  file->file.advise(static_cast<off_t>(begin), static_cast<off_t>(end - begin),
+      POSIX_FADV_DONTNEED);
+#endif // defined(PEREGRINE_HAVE_POSIX_FADVISE)
+  counters.dropped_bytes += end - begin;
+}
+
+std::pair<size_t, size_t> SortedFile::Iterator::window_blocks(
+    size_t block, int step) const noexcept {
+  // Whole blocks from `block` in the scan direction, at least one, up to the window size
+  const auto& index = file->index;
+  size_t first = block, last = block + 1;
+  uint64_t bytes = index[block].size;
+  if(step >= 0) {
+    while(last < index.size() && bytes + index[last].size <= window) bytes += index[last++].size;
+  } else {
+    while(first > 0 && bytes + index[first - 1].size <= window) bytes += index[--first].size;
+  }
+  return {first, last};
+}
+
+void SortedFile::Iterator::fail(StatusCode status) noexcept {
+  error = status;
+  entries.clear();
+  keys.clear();
+  position = 0;
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -0,0 +1,215 @@
+#include "peregrine/internal/syscall_trace.hh"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif // defined(__linux__)
+
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/log.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace detail {
+
+void SyscallTraceBuffer::push(const SyscallTraceEvent& event) noexcept {
+  const uint64_t seq = head.load(std::memory_order_relaxed);
+
+  // Order the previous head update before the slot is overwritten, so a reader that sees the new
+  // contents also sees a head that marks the old event as gone.
+  std::atomic_thread_fence(std::memory_order_release);
+
+  auto& slot = slots[seq % capacity];
+  slot[0].store(reinterpret_cast<uintptr_t>(event.name), std::memory_order_relaxed);
+  slot[1].store(event.start_ns, std::memory_order_relaxed);
+  slot[2].store(event.duration_ns, std::memory_order_relaxed);
+  slot[3].store(static_cast<uint64_t>(event.result), std::memory_order_relaxed);
+  slot[4].store((uint64_t{event.thread_id} << 32) | (uint64_t{event.error} << 8) | event.arg_count,
+      std::memory_order_relaxed);
+  for(size_t i = 0; i < SyscallTraceEvent::max_args; ++i)
+    slot[5 + i].store(static_cast<uint64_t>(event.args[i]), std::memory_order_relaxed);
+
+  head.store(seq + 1, std::memory_order_release);
+}
+
+void SyscallTraceBuffer::copy(std::vector<SyscallTraceEvent>& events, uint64_t since_ns) const {
+  const uint64_t end   = head.load(std::memory_order_acquire);
+  const uint64_t begin = end > capacity ? end - capacity : 0;
+
+  std::vector<SyscallTraceEvent> copied;
+  copied.reserve(end - begin);
+  for(uint64_t seq = begin; seq < end; ++seq) {
+    const auto& slot = slots[seq % capacity];
+    SyscallTraceEvent event;
+    event.name        = reinterpret_cast<const char*>(slot[0].load(std::memory_order_relaxed));
+    event.start_ns    = slot[1].load(std::memory_order_relaxed);
+    event.duration_ns = slot[2].load(std::memory_order_relaxed);
+    event.result      = static_cast<int64_t>(slot[3].load(std::memory_order_relaxed));
+    const uint64_t packed = slot[4].load(std::memory_order_relaxed);
+    event.thread_id       = static_cast<uint32_t>(packed >> 32);
+    event.error           = static_cast<uint16_t>(packed >> 8);
+    event.arg_count       = static_cast<uint8_t>(packed);
+    for(size_t i = 0; i < SyscallTraceEvent::max_args; ++i)
+      event.args[i] = static_cast<int64_t>(slot[5 + i].load(std::memory_order_relaxed));
+    copied.push_back(event);
+  }
+
+  // Drop the slots the writer may have overwritten while they were copied, including one write
+  // that may be in flight.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t last  = head.load(std::memory_order_relaxed);
+  const uint64_t valid = last + 1 > capacity ? last + 1 - capacity : 0;
+  const size_t skip    = valid > begin ? static_cast<size_t>(std::min(valid - begin, end - begin))
+                                       : 0;
+
+  for(size_t i = skip; i < copied.size(); ++i) {
+    if(copied[i].start_ns >= since_ns) events.push_back(copied[i]);
+  }
+}
+
+} // namespace detail
+
+std::atomic<bool> SyscallTracer::enabled{false};
+
+namespace {
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<detail::SyscallTraceBuffer>> buffers;
+  std::atomic<uint64_t> cleared_at{0};
+}; // struct Registry
+
+Registry& registry() {
+  // Never destroyed, so threads that exit during static destruction can still release buffers
+  static auto* instance = new Registry;
+  return *instance;
+}
+
+uint32_t current_thread_id() noexcept {
+#if defined(__linux__)
+  return static_cast<uint32_t>(::syscall(SYS_gettid));
+#else
+  static std::atomic<uint32_t> next{1};
+  return next.fetch_add(1, std::memory_order_relaxed);
+#endif // defined(__linux__)
+}
+
+// Owns the calling thread's claim on a buffer and releases it for reuse when the thread exits.
+struct ThreadBuffer {
+  detail::SyscallTraceBuffer* buffer{nullptr};
+  bool exporting{false};
+
+  ~ThreadBuffer() {
+    if(buffer != nullptr) buffer->in_use.store(false, std::memory_order_release);
+  }
+
+  detail::SyscallTraceBuffer* get() {
+    if(PEREGRINE_LIKELY(buffer != nullptr)) return buffer;
+
+    auto& reg = registry();
+    std::lock_guard lock(reg.mutex);
+    // Reuse the buffer of an exited thread before growing
+    for(auto& candidate : reg.buffers) {
+      bool expected = false;
+      if(candidate->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+        buffer = candidate.get();
+        break;
+      }
+    }
+    if(buffer == nullptr) {
+      reg.buffers.push_back(std::make_unique<detail::SyscallTraceBuffer>());
+      buffer = reg.buffers.back().get();
+    }
+    buffer->thread_id = current_thread_id();
+    return buffer;
+  }
+}; // struct ThreadBuffer
+
+thread_local ThreadBuffer thread_buffer;
+
+} // namespace
+
+void SyscallTracer::clear() noexcept {
+  registry().cleared_at.store(now(), std::memory_order_relaxed);
+}
+
+void SyscallTracer::record(SyscallTraceEvent event) noexcept {
+  if(PEREGRINE_UNLIKELY(thread_buffer.exporting)) return;
+  try {
+    auto* buffer    = thread_buffer.get();
+    event.thread_id = buffer->thread_id;
+    buffer->push(event);
+  } catch(...) {
+    // Tracing is best effort; a buffer that cannot be allocated drops the event.
+  }
+}
+
+std::vector<SyscallTraceEvent> SyscallTracer::events() {
+  auto& reg            = registry();
+  const uint64_t since = reg.cleared_at.load(std::memory_order_relaxed);
+
+  std::vector<SyscallTraceEvent> result;
+  {
+    std::lock_guard lock(reg.mutex);
+    for(const auto& buffer : reg.buffers) buffer->copy(result, since);
+  }
+  std::sort(result.begin(), result.end(),
+      [](const auto& a, const auto& b) { return a.start_ns < b.start_ns; });
+  return result;
+}
+
+std::string SyscallTracer::to_chrome_trace(const std::vector<SyscallTraceEvent>& events) {
+  const uint64_t origin = events.empty() ? 0 : events.front().start_ns;
+  const int pid         = static_cast<int>(::getpid());
+
+  fmt::memory_buffer out;
+  fmt::format_to(std::back_inserter(out), "{{\"displayTimeUnit\":\"ns\",\"traceEvents\":["sv);
+  bool first = true;
+  for(const auto& event : events) {
+    if(!first) out.push_back(',');
+    first = false;
+
+    // Timestamps and durations are in microseconds
+    fmt::format_to(std::back_inserter(out),
+        "\n{{\"name\":\"{}\",\"cat\":\"syscall\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},"
+        "\"pid\":{},\"tid\":{},\"args\":{{\"result\":{},\"errno\":{},\"args\":["sv,
+        event.name != nullptr ? event.name : "unknown",
+        static_cast<double>(event.start_ns - origin) / 1000.0,
+        static_cast<double>(event.duration_ns) / 1000.0, pid, event.thread_id, event.result,
+        event.error);
+    for(uint8_t i = 0; i < event.arg_count; ++i)
+      fmt::format_to(std::back_inserter(out), "{}{}"sv, i == 0 ? "" : ",", event.args[i]);
+    fmt::format_to(std::back_inserter(out), "]}}}}"sv);
+  }
+  fmt::format_to(std::back_inserter(out), "\n]}}\n"sv);
+  return fmt::to_string(out);
+}
+
+StatusCode SyscallTracer::export_chrome_trace(std::string_view path) {
+  const std::string json = to_chrome_trace(events());
+
+  // Keep the calls made by the export out of the trace
+  thread_buffer.exporting = true;
+  File file;
+  StatusCode status = file.open(path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+  for(size_t written = 0; status == StatusCode::ok && written < json.size();) {
+    auto result = file.write(json.data() + written, json.size() - written);
+    if(!result.ok()) {
+      status = result.status();
+    } else {
+      written += static_cast<size_t>(result.value());
+    }
+  }
+  if(status == StatusCode::ok) status = file.close();
+  thread_buffer.exporting = false;
+
+  PEREGRINE_LOG_DEBUG("Exported system call trace to \"{}\" : {}"sv, path, status);
+  return status;
+}
+
+} // namespace internal
+} // namespace peregrine
@@ -1,6 +1,8 @@
 #include "peregrine/internal/system.hh"
 
+#include <cmath>
 #include <mutex>
+#include <thread>
 
 #include "peregrine/internal/log.hh"
 
@@ -9,6 +11,78 @@ namespace internal {
 
 #if defined(PEREGRINE_MOCK_SYSTEM_CALLS)
 
+namespace detail {
+
+namespace {
+
+// splitmix64, good enough for fault injection and cheap to seed per thread
+uint64_t next_random(uint64_t& state) noexcept {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z          = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+} // namespace
+
+double fault_random(uint64_t seed) noexcept {
+  static std::atomic<uint64_t> thread_counter{0};
+  thread_local uint64_t thread_index = thread_counter.fetch_add(1, std::memory_order_relaxed);
+  thread_local uint64_t state_seed   = 0;
+  thread_local uint64_t state        = 0;
+
+  // Reseed whenever the configured seed changes, so a fixed seed gives repeatable runs
+  if(state_seed != seed || state == 0) {
+    const auto now      = std::chrono::steady_clock::now().time_since_epoch().count();
+    const uint64_t base = seed != 0 ? seed : static_cast<uint64_t>(now);
+    state_seed = seed;
+    state      = base ^ (thread_index * 0xd1b54a32d192ed03ull) ^ 1;
+  }
+
+  // 53 random bits
+  return static_cast<double>(next_random(state) >> 11) * 0x1.0p-53;
+}
+
+void fault_delay(const FaultInjection& faults) noexcept {
+  using namespace std::chrono;
+
+  const double mean = static_cast<double>(faults.latency.count());
+  double delay      = 0.0;
+  switch(faults.distribution) {
+  case FaultInjection::Latency::none: return;
+  case FaultInjection::Latency::fixed: delay = mean; break;
+  case FaultInjection::Latency::exponential:
+    delay = -mean * std::log1p(-fault_random(faults.seed));
+    break;
+  case FaultInjection::Latency::pareto: {
+    // Scale chosen so the distribution has the requested mean
+    const double shape = faults.pareto_shape > 1.0 ? faults.pareto_shape : 1.5;
+    const double scale = mean * (shape - 1.0) / shape;
+    delay              = scale / std::pow(1.0 - fault_random(faults.seed), 1.0 / shape);
+    break;
+  }
+  }
+
+  const double cap = static_cast<double>(faults.max_latency.count());
+  const auto wait  = nanoseconds(static_cast<int64_t>(delay < cap ? delay : cap));
+  if(wait <= nanoseconds::zero()) return;
+
+  // Sleeping is too coarse for short delays, so spin for those
+  if(wait < microseconds(50)) {
+    const auto until = steady_clock::now() + wait;
+    while(steady_clock::now() < until) {}
+  } else {
+    std::this_thread::sleep_for(wait);
+  }
+}
+
+bool positional_call(std::string_view name) noexcept {
+  return name == "pread" || name == "pwrite" || name == "preadv" || name == "pwritev" ||
+         name == "preadv2";
+}
+
+} // namespace detail
+
 #define PEREGRINE_MOCK_SYSTEM_CALL_IMPL(func, return_default)                                      \
   MockSystemCall<decltype(&::func)> func { &::func, return_default, #func }
 
@@ -28,7 +102,82 @@ PEREGRINE_MOCK_SYSTEM_CALL_IMPL(dup, -1);
 PEREGRINE_MOCK_SYSTEM_CALL_IMPL(fsync, -1);
 PEREGRINE_MOCK_SYSTEM_CALL_IMPL(mmap, MAP_FAILED);
 PEREGRINE_MOCK_SYSTEM_CALL_IMPL(munmap, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(madvise, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(mincore, -1);
 PEREGRINE_MOCK_SYSTEM_CALL_IMPL(fcntl, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(poll, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(rename, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(link, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(unlink, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(readlink, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(ftruncate, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(socket, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(socketpair, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(bind, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(listen, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(accept, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(connect, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(sendmsg, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(recvmsg, -1);
+
+#if defined(__linux__)
+
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(inotify_init1, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(inotify_add_watch, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(inotify_rm_watch, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(sendfile, -1);
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(accept4, -1);
+
+#endif // defined(__linux__)
+
+#if defined(PEREGRINE_HAVE_PREADV2)
+
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(preadv2, -1);
+
+#endif // defined(PEREGRINE_HAVE_PREADV2)
+
+#if defined(PEREGRINE_HAVE_RENAMEAT2)
+
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(renameat2, -1);
+
+#endif // defined(PEREGRINE_HAVE_RENAMEAT2)
+
+#if defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(sync_file_range, -1);
+
+#endif // defined(PEREGRINE_HAVE_SYNC_FILE_RANGE)
+
+#if defined(PEREGRINE_HAVE_MEMFD)
+
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(memfd_create, -1);
+
+#endif // defined(PEREGRINE_HAVE_MEMFD)
+
+#if defined(PEREGRINE_HAVE_POSIX_FADVISE)
+
+// posix_fadvise returns the error number instead of setting errno
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(posix_fadvise, EINVAL);
+
+#endif // defined(PEREGRINE_HAVE_POSIX_FADVISE)
+
+#if defined(PEREGRINE_HAVE_FALLOCATE)
+
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(fallocate, -1);
+
+#endif // defined(PEREGRINE_HAVE_FALLOCATE)
+
+#if defined(PEREGRINE_HAVE_SPLICE)
+
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(splice, -1);
+
+#endif // defined(PEREGRINE_HAVE_SPLICE)
+
+#if defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
+
+PEREGRINE_MOCK_SYSTEM_CALL_IMPL(copy_file_range, -1);
+
+#endif // defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
 
 // Do some special handling for errno_to_status since it is not a system call.
 namespace {
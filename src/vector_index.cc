@@ -0,0 +1,379 @@
+#include "peregrine/internal/vector_index.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+
+#include "peregrine/internal/log.hh"
+#include "peregrine/internal/simd.hh"
+
+namespace peregrine {
+namespace internal {
+
+namespace {
+
+struct Candidate {
+  float distance;
+  uint32_t id;
+
+  bool operator<(const Candidate& other) const noexcept { return distance < other.distance; }
+  bool operator>(const Candidate& other) const noexcept { return distance > other.distance; }
+}; // struct Candidate
+
+// Marks of the nodes a search has visited, reused across searches on a thread
+class Visited {
+  std::vector<uint32_t> marks;
+  uint32_t epoch{0};
+
+public:
+  void reset(size_t count) {
+    if(marks.size() < count) marks.resize(count, 0);
+    if(++epoch == 0) {
+      std::fill(marks.begin(), marks.end(), 0);
+      epoch = 1;
+    }
+  }
+
+  bool insert(uint32_t id) noexcept {
+    if(marks[id] == epoch) return false;
+    marks[id] = epoch;
+    return true;
+  }
+}; // class Visited
+
+Visited& thread_visited() {
+  thread_local Visited visited;
+  return visited;
+}
+
+float metric_distance(Metric metric, const float* a, const float* b, uint32_t dim) noexcept {
+  return metric == Metric::l2 ? l2_squared(a, b, dim) : -dot_product(a, b, dim);
+}
+
+
+// Best-first search of one level from `entry`, keeping the `ef` closest nodes. `distance(id)`
+// measures a node against the query and `for_links(id, level, fn)` calls `fn` on each link.
+template<typename Distance, typename ForLinks>
+std::vector<Candidate> search_level(Candidate entry, size_t ef, uint32_t level, size_t count,
+    Distance&& distance, ForLinks&& for_links) {
+  Visited& visited = thread_visited();
+  visited.reset(count);
+  visited.insert(entry.id);
+
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> frontier;
+  std::priority_queue<Candidate> results;
+  frontier.push(entry);
+  results.push(entry);
+  while(!frontier.empty()) {
+    const Candidate closest = frontier.top();
+    if(results.size() >= ef && closest.distance > results.top().distance) break;
+    frontier.pop();
+    for_links(closest.id, level, [&](uint32_t id) {
+      if(!visited.insert(id)) return;
+      const float d = distance(id);
+      if(results.size() < ef || d < results.top().distance) {
+        frontier.push({d, id});
+        results.push({d, id});
+        if(results.size() > ef) results.pop();
+      }
+    });
+  }
+
+  std::vector<Candidate> found(results.size());
+  for(size_t i = found.size(); i-- > 0; results.pop()) found[i] = results.top();
+  return found;
+}
+
+class Builder {
+  const float* vectors;
+  uint32_t dim;
+  const VectorIndex::Options& options;
+
+public:
+  std::vector<uint8_t> levels;
+  std::vector<std::vector<std::vector<uint32_t>>> links; // By node, then level
+  std::unique_ptr<std::mutex[]> locks;
+  std::mutex entry_lock;
+  uint32_t entry{0};
+  uint32_t top{0};
+
+  Builder(const float* vectors, size_t count, uint32_t dim, const VectorIndex::Options& options)
+      : vectors(vectors), dim(dim), options(options), levels(count), links(count),
+        locks(new std::mutex[count]) {
+    // Levels are geometric with ratio 1/m, from one seeded generator so builds repeat
+    std::mt19937_64 rng(options.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const double scale = 1.0 / std::log(static_cast<double>(options.m));
+    for(size_t i = 0; i < count; ++i) {
+      const double level = std::floor(-std::log(1.0 - uniform(rng)) * scale);
+      levels[i]          = static_cast<uint8_t>(std::min<double>(level, VectorIndex::max_level));
+      links[i].resize(levels[i] + 1u);
+    }
+    if(count != 0) top = levels[0];
+  }
+
+  const float* vector(uint32_t id) const noexcept { return vectors + size_t{id} * dim; }
+
+  float distance(uint32_t a, const float* b) const noexcept {
+    return metric_distance(options.metric, vector(a), b, dim);
+  }
+
+  // Keep up to `max` of `candidates`, sorted closest first to their base node, skipping any that
+  // is closer to a kept candidate than to the base
+  void select(std::vector<Candidate>& candidates, size_t max) const {
+    if(candidates.size() <= max) return;
+    std::vector<Candidate> kept;
+    for(const Candidate& c : candidates) {
+      if(kept.size() == max) break;
+      const bool diverse = std::none_of(kept.begin(), kept.end(),
+          [&](const Candidate& k) { return distance(k.id, vector(c.id)) < c.distance; });
+      if(diverse) kept.push_back(c);
+    }
+    candidates.swap(kept);
+  }
+
+  void insert(uint32_t id) {
+    const float* query        = vector(id);
+    const uint32_t node_level = levels[id];
+    uint32_t top_level;
+    Candidate current;
+    {
+      std::lock_guard<std::mutex> lock(entry_lock);
+      top_level = top;
+      current   = {distance(entry, query), entry};
+    }
+
+    std::vector<uint32_t> buffer;
+    const auto for_links = [&](uint32_t node, uint32_t level, auto&& fn) {
+      {
+        std::lock_guard<std::mutex> lock(locks[node]);
+        buffer = links[node][level];
+      }
+      for(uint32_t link : buffer) fn(link);
+    };
+    const auto to_query = [&](uint32_t node) { return distance(node, query); };
+
+    for(uint32_t level = top_level; level > node_level; --level)
+      current = search_level(current, 1, level, levels.size(), to_query, for_links).front();
+
+    for(uint32_t level = std::min(node_level, top_level) + 1; level-- > 0;) {
+      auto found = search_level(
+          current, options.ef_construction, level, levels.size(), to_query, for_links);
+      // Other threads may already have linked this node
+      found.erase(std::remove_if(found.begin(), found.end(),
+                      [id](const Candidate& c) { return c.id == id; }),
+          found.end());
+      if(found.empty()) continue;
+      current = found.front();
+      select(found, options.m);
+      {
+        std::lock_guard<std::mutex> lock(locks[id]);
+        for(const Candidate& c : found) links[id][level].push_back(c.id);
+      }
+
+      // Link back, pruning neighbours that are full
+      const size_t capacity = level == 0 ? 2 * options.m : options.m;
+      for(const Candidate& c : found) {
+        std::lock_guard<std::mutex> lock(locks[c.id]);
+        auto& list = links[c.id][level];
+        if(list.size() < capacity) {
+          list.push_back(id);
+          continue;
+        }
+        std::vector<Candidate> candidates{{c.distance, id}};
+        for(uint32_t link : list) candidates.push_back({distance(link, vector(c.id)), link});
+        std::sort(candidates.begin(), candidates.end());
+        select(candidates, capacity);
+        list.clear();
+        for(const Candidate& kept : candidates) list.push_back(kept.id);
+      }
+    }
+
+    if(node_level > top_level) {
+      std::lock_guard<std::mutex> lock(entry_lock);
+      if(node_level > top) {
+        top   = node_level;
+        entry = id;
+      }
+    }
+  }
+}; // class Builder
+
+} // namespace
+
+Result<std::string> VectorIndex::build(
+    const float* vectors, size_t count, uint32_t dim, const Options& options) {
+  if(dim == 0 || options.m < 2 || options.m > 65535 || options.ef_construction == 0 ||
+      count >= UINT32_MAX || (count != 0 && vectors == nullptr) ||
+      (options.metric != Metric::l2 && options.metric != Metric::inner_product)) {
+    return Result<std::string>::error(StatusCode::invalid_argument);
+  }
+
+  // Insert the first node alone as the entry point, then the rest on all threads
+  Builder builder(vectors, count, dim, options);
+  const size_t threads = std::max<size_t>(1,
+      std::min<size_t>(options.threads != 0 ? options.threads : std::thread::hardware_concurrency(),
+          count / 1024));
+  std::atomic<size_t> next{1};
+  const auto work = [&] {
+    for(size_t begin; (begin = next.fetch_add(64)) < count;) {
+      for(size_t i = begin; i < std::min<size_t>(begin + 64, count); ++i)
+        builder.insert(static_cast<uint32_t>(i));
+    }
+  };
+  std::vector<std::thread> workers;
+  for(size_t t = 1; t < threads; ++t) workers.emplace_back(work);
+  work();
+  for(auto& worker : workers) worker.join();
+
+  Header header{};
+  header.magic       = magic;
+  header.version     = version;
+  header.metric      = static_cast<uint8_t>(options.metric);
+  header.top_level   = static_cast<uint8_t>(builder.top);
+  header.dim         = dim;
+  header.m           = options.m;
+  header.count       = count;
+  header.entry_point = builder.entry;
+  for(size_t i = 0; i < count; ++i) header.upper_lists += builder.levels[i];
+
+  const size_t bottom_stride = 1 + 2 * size_t{options.m};
+  const size_t upper_stride  = 1 + size_t{options.m};
+  const size_t vectors_bytes = pad8(count * dim * sizeof(float));
+  const size_t bottom_bytes  = pad8(count * bottom_stride * sizeof(uint32_t));
+  const size_t offsets_bytes = pad8((count + 1) * sizeof(uint32_t));
+  const size_t upper_bytes   = pad8(header.upper_lists * upper_stride * sizeof(uint32_t));
+  std::string out(
+      sizeof(Header) + vectors_bytes + bottom_bytes + offsets_bytes + upper_bytes, '\0');
+  char* p = out.data();
+  std::memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  if(count != 0) std::memcpy(p, vectors, count * dim * sizeof(float));
+  p += vectors_bytes;
+
+  auto* bottom  = reinterpret_cast<uint32_t*>(p);
+  auto* offsets = reinterpret_cast<uint32_t*>(p + bottom_bytes);
+  auto* upper   = reinterpret_cast<uint32_t*>(p + bottom_bytes + offsets_bytes);
+  const auto put_list = [](uint32_t* list, const std::vector<uint32_t>& links) {
+    list[0] = static_cast<uint32_t>(links.size());
+    std::copy(links.begin(), links.end(), list + 1);
+  };
+  uint32_t lists = 0;
+  for(size_t i = 0; i < count; ++i) {
+    put_list(bottom + i * bottom_stride, builder.links[i][0]);
+    offsets[i] = lists;
+    for(uint32_t level = 1; level <= builder.levels[i]; ++level)
+      put_list(upper + size_t{lists++} * upper_stride, builder.links[i][level]);
+  }
+  offsets[count] = lists;
+  PEREGRINE_LOG_DEBUG("Built vector index: vectors={}, dim={}, levels={}, bytes={}"sv, count, dim,
+      builder.top + 1, out.size());
+  return out;
+}
+
+Result<size_t> VectorIndex::build(File& file, off_t offset, const float* vectors, size_t count,
+    uint32_t dim, const Options& options) {
+  auto bytes = build(vectors, count, dim, options);
+  if(!bytes.ok()) return Result<size_t>::error(bytes.status());
+  if(auto status = file.pwrite_all(bytes->data(), bytes->size(), offset); status != StatusCode::ok)
+    return Result<size_t>::error(status);
+  return bytes->size();
+}
+
+Result<VectorIndex> VectorIndex::open(const void* data, size_t size) noexcept {
+  const auto invalid = [] { return Result<VectorIndex>::error(StatusCode::invalid_argument); };
+  if(data == nullptr || reinterpret_cast<uintptr_t>(data) % 8 != 0) return invalid();
+  if(size < sizeof(Header)) return invalid();
+
+  VectorIndex view;
+  view.header     = static_cast<const Header*>(data);
+  const Header& h = *view.header;
+  if(h.magic != magic || h.version != version || h.top_level > max_level) return invalid();
+  if(h.metric > static_cast<uint8_t>(Metric::inner_product) || h.dim == 0 || h.m < 2)
+    return invalid();
+  if(h.count >= UINT32_MAX || h.count > size / sizeof(float) / h.dim || h.m > size ||
+      h.upper_lists > size / sizeof(uint32_t))
+    return invalid();
+
+  const size_t count         = h.count;
+  const size_t bottom_stride = 1 + 2 * size_t{h.m};
+  const size_t upper_stride  = 1 + size_t{h.m};
+  const size_t vectors_bytes = pad8(count * h.dim * sizeof(float));
+  const size_t bottom_bytes  = pad8(count * bottom_stride * sizeof(uint32_t));
+  const size_t offsets_bytes = pad8((count + 1) * sizeof(uint32_t));
+  const size_t upper_bytes   = pad8(size_t{h.upper_lists} * upper_stride * sizeof(uint32_t));
+  view.total = sizeof(Header) + vectors_bytes + bottom_bytes + offsets_bytes + upper_bytes;
+  if(count > size / bottom_stride || h.upper_lists > size / upper_stride || view.total > size)
+    return invalid();
+
+  const auto* base   = static_cast<const char*>(data) + sizeof(Header);
+  view.vectors       = reinterpret_cast<const float*>(base);
+  view.bottom        = reinterpret_cast<const uint32_t*>(base + vectors_bytes);
+  view.upper_offsets = reinterpret_cast<const uint32_t*>(base + vectors_bytes + bottom_bytes);
+  view.upper         = view.upper_offsets + offsets_bytes / sizeof(uint32_t);
+
+  // Levels come from the offsets; the entry point must be on the top level
+  const uint32_t* offsets = view.upper_offsets;
+  if(offsets[0] != 0 || offsets[count] != h.upper_lists) return invalid();
+  for(size_t i = 0; i < count; ++i) {
+    if(offsets[i + 1] < offsets[i] || offsets[i + 1] - offsets[i] > h.top_level) return invalid();
+  }
+  if(count != 0 && (h.entry_point >= count ||
+                       offsets[h.entry_point + 1] - offsets[h.entry_point] != h.top_level))
+    return invalid();
+
+  // Every link must name a node that is on the link's level
+  const auto valid_list = [&](const uint32_t* list, size_t capacity, uint32_t level) {
+    if(list[0] > capacity) return false;
+    return std::all_of(list + 1, list + 1 + list[0], [&](uint32_t id) {
+      return id < count && offsets[id + 1] - offsets[id] >= level;
+    });
+  };
+  for(size_t i = 0; i < count; ++i) {
+    if(!valid_list(view.bottom + i * bottom_stride, 2 * size_t{h.m}, 0)) return invalid();
+    for(uint32_t level = 1; level <= offsets[i + 1] - offsets[i]; ++level) {
+      const uint32_t* list = view.upper + (offsets[i] + level - 1) * upper_stride;
+      if(!valid_list(list, h.m, level)) return invalid();
+    }
+  }
+  return view;
+}
+
+float VectorIndex::distance(uint32_t id, const float* query) const noexcept {
+  return metric_distance(metric(), vector(id), query, dim());
+}
+
+std::vector<VectorIndex::Neighbor> VectorIndex::search(
+    const float* query, size_t k, size_t ef) const {
+  if(size() == 0 || k == 0) return {};
+
+  const size_t bottom_stride = 1 + 2 * size_t{header->m};
+  const size_t upper_stride  = 1 + size_t{header->m};
+  const auto for_links       = [&](uint32_t node, uint32_t level, auto&& fn) {
+    const uint32_t* list =
+        level == 0 ? bottom + node * bottom_stride
+                         : upper + (upper_offsets[node] + level - 1) * upper_stride;
+    for(uint32_t i = 1; i <= list[0]; ++i) __builtin_prefetch(vector(list[i]));
+    for(uint32_t i = 1; i <= list[0]; ++i) fn(list[i]);
+  };
+  const auto to_query = [&](uint32_t node) { return distance(node, query); };
+
+  Candidate current{distance(header->entry_point, query), header->entry_point};
+  for(uint32_t level = header->top_level; level > 0; --level)
+    current = search_level(current, 1, level, size(), to_query, for_links).front();
+  const auto found = search_level(current, std::max(ef, k), 0, size(), to_query, for_links);
+
+  std::vector<Neighbor> neighbors;
+  neighbors.reserve(std::min(k, found.size()));
+  for(size_t i = 0; i < found.size() && i < k; ++i)
+    neighbors.push_back({found[i].id, found[i].distance});
+  return neighbors;
+}
+
+} // namespace internal
+} // namespace peregrine
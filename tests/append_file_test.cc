@@ -0,0 +1,144 @@
+#include "peregrine/internal/append_file.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_append_file.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::AppendFile;
+using peregrine::internal::File;
+
+namespace {
+
+struct stat stat_of(std::string_view path) {
+  struct stat st {};
+  ::stat(path.data(), &st);
+  return st;
+}
+
+} // namespace
+
+class AppendFileTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+  }
+
+  void TearDown() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+  }
+}; // class AppendFileTest
+
+TEST_F(AppendFileTest, PreallocateInGrowingChunks) {
+  AppendFile::Options options;
+  options.initial_chunk = 64 * 1024;
+  options.max_chunk     = 256 * 1024;
+  AppendFile file(options);
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+
+  const std::string block(10000, 'x');
+  ASSERT_EQ(file.append(block.data(), block.size()).value(), 10000);
+  EXPECT_EQ(file.size(), 10000);
+  if(file.reserved() == 10000) GTEST_SKIP() << "Preallocation is not supported here";
+
+  // The reservation covers the first chunk, and the file size is unchanged
+  EXPECT_EQ(file.reserved(), 64 * 1024);
+  EXPECT_EQ(stat_of(file_name).st_size, 10000);
+
+  // Chunks double up to the limit
+  std::vector<off_t> reservations{file.reserved()};
+  for(int i = 0; i < 200; ++i) {
+    ASSERT_EQ(file.append(block.data(), block.size()).value(), 10000);
+    if(file.reserved() != reservations.back()) reservations.push_back(file.reserved());
+  }
+  ASSERT_GE(reservations.size(), 5u);
+  EXPECT_EQ(reservations[1] - reservations[0], 128 * 1024);
+  EXPECT_EQ(reservations[2] - reservations[1], 256 * 1024);
+  EXPECT_EQ(reservations[3] - reservations[2], 256 * 1024);
+  EXPECT_GE(file.reserved(), file.size());
+
+  // Closing trims the unused tail
+  const off_t size = file.size();
+  ASSERT_EQ(file.close(), StatusCode::ok);
+  const auto st = stat_of(file_name);
+  EXPECT_EQ(st.st_size, size);
+  EXPECT_LE(st.st_blocks * 512, size + 64 * 1024);
+}
+
+TEST_F(AppendFileTest, ZeroChunks) {
+  AppendFile::Options options;
+  options.initial_chunk = 0;
+  options.max_chunk     = 0;
+  AppendFile file(options);
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+
+  // Each reservation covers just the write
+  const std::string block(100, 'x');
+  for(int i = 0; i < 3; ++i) ASSERT_EQ(file.append(block.data(), block.size()).value(), 100);
+  EXPECT_EQ(file.size(), 300);
+  EXPECT_LE(file.reserved(), 300);
+  ASSERT_EQ(file.close(), StatusCode::ok);
+  EXPECT_EQ(stat_of(file_name).st_size, 300);
+}
+
+TEST_F(AppendFileTest, ContinueAtEnd) {
+  {
+    AppendFile file;
+    ASSERT_EQ(file.open(file_name), StatusCode::ok);
+    ASSERT_EQ(file.append("hello ", 6).value(), 6);
+  }
+  AppendFile file;
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+  EXPECT_EQ(file.size(), 6);
+  ASSERT_EQ(file.append("world", 5).value(), 5);
+  ASSERT_EQ(file.close(), StatusCode::ok);
+
+  File in;
+  ASSERT_EQ(in.open(file_name), StatusCode::ok);
+  char buffer[16];
+  ASSERT_EQ(in.pread(buffer, sizeof(buffer), 0).value(), 11);
+  EXPECT_EQ(std::string_view(buffer, 11), "hello world");
+}
+
+TEST_F(AppendFileTest, FallBackWithoutPreallocation) {
+#if defined(PEREGRINE_HAVE_FALLOCATE)
+  peregrine::internal::fallocate.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(StatusCode::enotsup, 1);
+#endif // defined(PEREGRINE_HAVE_FALLOCATE)
+
+  AppendFile file;
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+  ASSERT_EQ(file.append("data", 4).value(), 4);
+  EXPECT_EQ(file.reserved(), 0);
+  ASSERT_EQ(file.append("more", 4).value(), 4);
+  EXPECT_EQ(file.size(), 8);
+}
+
+TEST_F(AppendFileTest, PunchHole) {
+  File file;
+  ASSERT_EQ(file.open(file_name, O_CREAT | O_RDWR), StatusCode::ok);
+  const std::string data(1024 * 1024, 'x');
+  ASSERT_EQ(file.pwrite(data.data(), data.size(), 0).value(), 1024 * 1024);
+  ASSERT_EQ(file.flush(), StatusCode::ok);
+
+  const auto status = file.punch_hole(256 * 1024, 512 * 1024);
+  if(status == StatusCode::enotsup) GTEST_SKIP() << "Hole punching is not supported here";
+  ASSERT_EQ(status, StatusCode::ok);
+
+  // The size is unchanged, the hole reads as zeros and its blocks are released
+  struct stat st;
+  ASSERT_EQ(file.stat(&st), StatusCode::ok);
+  EXPECT_EQ(st.st_size, 1024 * 1024);
+  EXPECT_LE(st.st_blocks * 512, 512 * 1024 + 64 * 1024);
+  char buffer[4];
+  ASSERT_EQ(file.pread(buffer, sizeof(buffer), 300 * 1024).value(), 4);
+  EXPECT_EQ(std::string_view(buffer, 4), std::string_view("\0\0\0\0", 4));
+  ASSERT_EQ(file.pread(buffer, sizeof(buffer), 900 * 1024).value(), 4);
+  EXPECT_EQ(std::string_view(buffer, 4), "xxxx");
+}
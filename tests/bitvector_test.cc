@@ -0,0 +1,113 @@
+#include "peregrine/internal/bitvector.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/mmap_file.hh"
+#include "test_util.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_bitvector.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::BitVector;
+using peregrine::internal::RankSelect;
+
+namespace {
+
+BitVector random_bits(uint64_t size, double density, uint32_t seed) {
+  std::mt19937_64 rng(seed);
+  std::bernoulli_distribution bit(density);
+  BitVector bits;
+  for(uint64_t i = 0; i < size; ++i) bits.push_back(bit(rng));
+  return bits;
+}
+
+// Compare every rank and select against a linear scan
+void check(const BitVector& bits) {
+  const auto bytes   = bits.serialize();
+  const auto storage = aligned(bytes);
+  auto view          = RankSelect::open(storage.data(), bytes.size());
+  ASSERT_TRUE(view.ok());
+  ASSERT_EQ(view->size(), bits.size());
+  EXPECT_EQ(view->bytes(), bytes.size());
+
+  uint64_t ones = 0;
+  for(uint64_t i = 0; i < bits.size(); ++i) {
+    ASSERT_EQ(view->rank1(i), ones) << i;
+    ASSERT_EQ(view->get(i), bits.get(i)) << i;
+    if(bits.get(i)) {
+      ASSERT_EQ(view->select1(ones), i) << ones;
+      ++ones;
+    } else {
+      ASSERT_EQ(view->select0(i - ones), i) << i - ones;
+    }
+  }
+  EXPECT_EQ(view->rank1(bits.size()), ones);
+  EXPECT_EQ(view->ones(), ones);
+  EXPECT_EQ(view->rank0(bits.size()), bits.size() - ones);
+}
+
+} // namespace
+
+TEST(BitVectorTest, Select64) {
+  std::mt19937_64 rng(3);
+  for(int n = 0; n < 1000; ++n) {
+    const uint64_t word = rng();
+    uint32_t rank       = 0;
+    for(uint32_t bit = 0; bit < 64; ++bit) {
+      if((word >> bit) & 1) {
+        EXPECT_EQ(peregrine::internal::select64(word, rank++), bit);
+      }
+    }
+  }
+}
+
+TEST(BitVectorTest, RankSelect) {
+  for(uint64_t size : {0, 1, 63, 64, 511, 512, 513, 4096, 100000}) {
+    for(double density : {0.01, 0.5, 0.99}) check(random_bits(size, density, size));
+  }
+  check(BitVector(70000));
+  BitVector full(70000);
+  for(uint64_t i = 0; i < full.size(); ++i) full.set(i);
+  check(full);
+}
+
+TEST(BitVectorTest, ViewFromMmapFile) {
+  const auto bits  = random_bits(200000, 0.3, 9);
+  const auto bytes = bits.serialize();
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    ASSERT_EQ(out.write(bytes.data(), bytes.size()).value(), static_cast<ssize_t>(bytes.size()));
+  }
+
+  peregrine::internal::File in;
+  ASSERT_EQ(in.open(file_name), StatusCode::ok);
+  peregrine::internal::MmapFile map;
+  ASSERT_EQ(map.map(in), StatusCode::ok);
+  auto view = RankSelect::open(map.data(), map.size());
+  ASSERT_TRUE(view.ok());
+  const uint64_t last = view->select1(view->ones() - 1);
+  EXPECT_TRUE(bits.get(last));
+  EXPECT_EQ(view->rank1(last), view->ones() - 1);
+  unlink(file_name.data());
+}
+
+TEST(BitVectorTest, RejectCorruptBytes) {
+  const auto bytes = random_bits(5000, 0.5, 1).serialize();
+  auto storage     = aligned(bytes);
+
+  EXPECT_FALSE(RankSelect::open(storage.data(), bytes.size() - 1).ok());
+  EXPECT_FALSE(RankSelect::open(reinterpret_cast<char*>(storage.data()) + 4, 64).ok());
+
+  auto* header = reinterpret_cast<RankSelect::Header*>(storage.data());
+  header->ones += 1;
+  EXPECT_FALSE(RankSelect::open(storage.data(), bytes.size()).ok());
+  header->ones -= 1;
+  header->bits = 1ull << 40;
+  EXPECT_FALSE(RankSelect::open(storage.data(), bytes.size()).ok());
+}
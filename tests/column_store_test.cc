@@ -0,0 +1,242 @@
+#include "peregrine/internal/column_store.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/mmap_file.hh"
+#include "test_util.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_column_store.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::Aggregate;
+using peregrine::internal::ColumnStore;
+using peregrine::internal::ColumnStoreBuilder;
+using peregrine::internal::ColumnType;
+using peregrine::internal::ScanStats;
+
+namespace {
+
+constexpr size_t rows = 100000 + 17;
+
+struct Table {
+  std::vector<int32_t> ids;     // Sorted, so zone maps prune well
+  std::vector<int64_t> amounts; // Random
+  std::vector<float> scores;    // Random, with some NaNs
+  std::vector<double> prices;   // Random
+
+  Table() {
+    std::mt19937_64 rng(1);
+    for(size_t i = 0; i < rows; ++i) {
+      ids.push_back(static_cast<int32_t>(i * 3) - 1000);
+      amounts.push_back(static_cast<int64_t>(rng() % 2000000) - 1000000);
+      scores.push_back(i % 1000 == 7 ? NAN : static_cast<float>(rng() % 10000) / 100);
+      prices.push_back(static_cast<double>(rng() % 100000) / 7);
+    }
+  }
+
+  std::string build(uint32_t block_rows = 4096) const {
+    ColumnStoreBuilder builder(block_rows);
+    EXPECT_EQ(builder.add(ids.data(), rows), StatusCode::ok);
+    EXPECT_EQ(builder.add(amounts.data(), rows), StatusCode::ok);
+    EXPECT_EQ(builder.add(scores.data(), rows), StatusCode::ok);
+    EXPECT_EQ(builder.add(prices.data(), rows), StatusCode::ok);
+    return builder.finish();
+  }
+}; // struct Table
+
+const Table& table() {
+  static const Table table;
+  return table;
+}
+
+// Check a scan against a scalar evaluation
+template<typename T>
+ScanStats check_select(const ColumnStore& store, size_t column, const std::vector<T>& values,
+    T lo, T hi) {
+  std::vector<uint64_t> bitmap((rows + 63) / 64, 0x5555);
+  auto stats = store.select<T>(column, lo, hi, bitmap.data());
+  EXPECT_TRUE(stats.ok());
+  uint64_t matches = 0;
+  for(size_t i = 0; i < rows; ++i) {
+    const bool expected = values[i] >= lo && values[i] <= hi;
+    matches += expected;
+    EXPECT_EQ((bitmap[i / 64] >> (i % 64)) & 1, expected) << i;
+  }
+  EXPECT_EQ(bitmap.back() >> (rows % 64), 0u);
+  EXPECT_EQ(stats->matches, matches);
+
+  // Aggregate the selected rows
+  auto filtered = store.aggregate<T>(column, bitmap.data());
+  EXPECT_TRUE(filtered.ok());
+  Aggregate<T> expected;
+  for(size_t i = 0; i < rows; ++i) {
+    if(!(values[i] >= lo && values[i] <= hi)) continue;
+    ++expected.count;
+    expected.sum += values[i];
+    expected.min = std::min(expected.min, values[i]);
+    expected.max = std::max(expected.max, values[i]);
+  }
+  EXPECT_EQ(filtered->count, expected.count);
+  if constexpr(std::is_floating_point_v<T>) {
+    EXPECT_NEAR(filtered->sum, expected.sum, std::abs(expected.sum) * 1e-9);
+  } else {
+    EXPECT_EQ(filtered->sum, expected.sum);
+  }
+  if(expected.count != 0) {
+    EXPECT_EQ(filtered->min, expected.min);
+    EXPECT_EQ(filtered->max, expected.max);
+  }
+  return stats.value();
+}
+
+} // namespace
+
+TEST(ColumnStoreTest, SelectAndAggregate) {
+  const auto bytes   = table().build();
+  const auto storage = aligned(bytes);
+  auto store         = ColumnStore::open(storage.data(), bytes.size());
+  ASSERT_TRUE(store.ok());
+  EXPECT_EQ(store->columns(), 4u);
+  EXPECT_EQ(store->rows(), rows);
+  EXPECT_EQ(store->blocks(), (rows + 4095) / 4096);
+  EXPECT_EQ(store->bytes(), bytes.size());
+  EXPECT_EQ(store->type(2), ColumnType::float32);
+
+  const auto& t = table();
+  check_select<int32_t>(store.value(), 0, t.ids, 5000, 5000);
+  check_select<int32_t>(store.value(), 0, t.ids, -5000, 0);
+  check_select<int64_t>(store.value(), 1, t.amounts, -1000, 250000);
+  check_select<float>(store.value(), 2, t.scores, 10.5f, 20.25f);
+  check_select<float>(store.value(), 2, t.scores, -1.0f, 1000.0f);
+  check_select<double>(store.value(), 3, t.prices, 100.0, 200.0);
+  check_select<double>(store.value(), 3, t.prices, 5.0, 1.0);
+
+  // The whole column
+  auto all = store->aggregate<int64_t>(1);
+  ASSERT_TRUE(all.ok());
+  EXPECT_EQ(all->count, rows);
+  EXPECT_EQ(all->sum, std::accumulate(t.amounts.begin(), t.amounts.end(), int64_t{0}));
+  EXPECT_EQ(all->min, *std::min_element(t.amounts.begin(), t.amounts.end()));
+  auto ids = store->aggregate<int32_t>(0);
+  ASSERT_TRUE(ids.ok());
+  EXPECT_EQ(ids->min, -1000);
+  EXPECT_EQ(ids->max, static_cast<int32_t>((rows - 1) * 3) - 1000);
+}
+
+TEST(ColumnStoreTest, ZoneMapsSkipBlocks) {
+  const auto bytes   = table().build(1024);
+  const auto storage = aligned(bytes);
+  auto store         = ColumnStore::open(storage.data(), bytes.size());
+  ASSERT_TRUE(store.ok());
+
+  // Sorted ids match a narrow range in one or two blocks
+  const auto narrow = check_select<int32_t>(store.value(), 0, table().ids, 50000, 50100);
+  EXPECT_LE(narrow.blocks_scanned, 2u);
+  EXPECT_EQ(narrow.blocks_skipped, store->blocks() - narrow.blocks_scanned);
+
+  // Blocks inside a wide range are filled without comparisons
+  const auto wide = check_select<int32_t>(store.value(), 0, table().ids, 10000, 200000);
+  EXPECT_GT(wide.blocks_matched, 50u);
+
+  // Random values span every block, so nothing is skipped
+  const auto random = check_select<int64_t>(store.value(), 1, table().amounts, 0, 1000);
+  EXPECT_EQ(random.blocks_scanned, store->blocks());
+}
+
+TEST(ColumnStoreTest, ParallelScanByBlockRange) {
+  const auto bytes   = table().build(2048);
+  const auto storage = aligned(bytes);
+  auto store         = ColumnStore::open(storage.data(), bytes.size());
+  ASSERT_TRUE(store.ok());
+
+  std::vector<uint64_t> bitmap((rows + 63) / 64);
+  const size_t threads = 4;
+  const uint64_t step  = (store->blocks() + threads - 1) / threads;
+  std::vector<ScanStats> stats(threads);
+  std::vector<Aggregate<double>> sums(threads);
+  std::vector<std::thread> workers;
+  for(size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      stats[t] = store->select<double>(3, 1000.0, 5000.0, bitmap.data(), t * step, (t + 1) * step)
+                     .value();
+      sums[t] = store->aggregate<double>(3, bitmap.data(), t * step, (t + 1) * step).value();
+    });
+  }
+  for(auto& worker : workers) worker.join();
+  for(size_t t = 1; t < threads; ++t) {
+    stats[0].merge(stats[t]);
+    sums[0].merge(sums[t]);
+  }
+
+  uint64_t matches = 0;
+  double sum       = 0;
+  for(double price : table().prices) {
+    if(price >= 1000.0 && price <= 5000.0) {
+      ++matches;
+      sum += price;
+    }
+  }
+  EXPECT_EQ(stats[0].matches, matches);
+  EXPECT_EQ(sums[0].count, matches);
+  EXPECT_NEAR(sums[0].sum, sum, sum * 1e-9);
+}
+
+TEST(ColumnStoreTest, RejectWrongTypes) {
+  const auto bytes   = table().build();
+  const auto storage = aligned(bytes);
+  auto store         = ColumnStore::open(storage.data(), bytes.size());
+  ASSERT_TRUE(store.ok());
+  std::vector<uint64_t> bitmap((rows + 63) / 64);
+  EXPECT_EQ(store->select<int64_t>(0, 0, 1, bitmap.data()).status(), StatusCode::invalid_argument);
+  EXPECT_EQ(store->aggregate<float>(3).status(), StatusCode::invalid_argument);
+  EXPECT_EQ(store->aggregate<double>(4).status(), StatusCode::invalid_argument);
+  EXPECT_EQ(store->values<int32_t>(1), nullptr);
+
+  ColumnStoreBuilder builder;
+  const int32_t values[3] = {1, 2, 3};
+  EXPECT_EQ(builder.add(values, 3), StatusCode::ok);
+  EXPECT_EQ(builder.add(values, 2), StatusCode::invalid_argument);
+}
+
+TEST(ColumnStoreTest, ViewFromMmapFile) {
+  const auto bytes = table().build();
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    ASSERT_EQ(out.write(bytes.data(), bytes.size()).value(), static_cast<ssize_t>(bytes.size()));
+  }
+
+  peregrine::internal::File in;
+  ASSERT_EQ(in.open(file_name), StatusCode::ok);
+  peregrine::internal::MmapFile map;
+  ASSERT_EQ(map.map(in), StatusCode::ok);
+  auto store = ColumnStore::open(map.data(), map.size());
+  ASSERT_TRUE(store.ok());
+  check_select<int32_t>(store.value(), 0, table().ids, 1000, 2000);
+  unlink(file_name.data());
+}
+
+TEST(ColumnStoreTest, RejectCorruptBytes) {
+  const auto bytes = table().build();
+  auto storage     = aligned(bytes);
+  EXPECT_FALSE(ColumnStore::open(storage.data(), bytes.size() - 1).ok());
+
+  auto* header  = reinterpret_cast<ColumnStore::Header*>(storage.data());
+  auto* columns = reinterpret_cast<ColumnStore::Column*>(header + 1);
+  columns[1].data_offset += 4;
+  EXPECT_FALSE(ColumnStore::open(storage.data(), bytes.size()).ok());
+  columns[1].data_offset -= 4;
+  columns[2].width = 8;
+  EXPECT_FALSE(ColumnStore::open(storage.data(), bytes.size()).ok());
+  columns[2].width   = 4;
+  header->block_rows = 1000;
+  EXPECT_FALSE(ColumnStore::open(storage.data(), bytes.size()).ok());
+}
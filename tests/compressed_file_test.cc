@@ -0,0 +1,269 @@
+#include "peregrine/internal/compressed_file.hh"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <thread>
+
+#include "peregrine/internal/file.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_compressed_file.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::Codec;
+using peregrine::internal::codec_available;
+using peregrine::internal::CompressedFile;
+using peregrine::internal::CompressedWriter;
+
+namespace {
+
+// Log-like text, which compresses well
+std::string make_text(size_t size, uint32_t seed = 1) {
+  std::mt19937 rng(seed);
+  std::string text;
+  while(text.size() < size) {
+    text += "2024-05-0" + std::to_string(rng() % 9 + 1) + " INFO request id=" +
+            std::to_string(rng() % 1000) + " path=/api/v1/items status=200\n";
+  }
+  text.resize(size);
+  return text;
+}
+
+std::string make_random(size_t size, uint32_t seed = 2) {
+  std::mt19937 rng(seed);
+  std::string bytes(size, '\0');
+  for(auto& c : bytes) c = static_cast<char>(rng());
+  return bytes;
+}
+
+void write_file(const std::string& data, CompressedWriter::Options options = {}) {
+  CompressedWriter writer(std::move(options));
+  ASSERT_EQ(writer.open(file_name), StatusCode::ok);
+  // Append in uneven pieces to cover partial and whole blocks
+  for(size_t offset = 0, step = 1; offset < data.size(); step = step * 3 + 7) {
+    const size_t n = std::min(step, data.size() - offset);
+    ASSERT_EQ(writer.append(data.data() + offset, n), StatusCode::ok);
+    offset += n;
+  }
+  ASSERT_EQ(writer.close(), StatusCode::ok);
+}
+
+bool any_codec() noexcept { return codec_available(Codec::lz4) || codec_available(Codec::zstd); }
+
+} // namespace
+
+TEST(CompressedFileTest, RoundTrip) {
+  const std::string data = make_text(300000) + make_random(100000) + make_text(50000, 3);
+  CompressedWriter::Options options;
+  options.block_size = 16 * 1024;
+  write_file(data, options);
+
+  for(bool use_mmap : {false, true}) {
+    CompressedFile::Options read_options;
+    read_options.use_mmap     = use_mmap;
+    read_options.cache_blocks = 4;
+    CompressedFile file(read_options);
+    ASSERT_EQ(file.open(file_name), StatusCode::ok);
+    EXPECT_EQ(file.size(), data.size());
+    EXPECT_EQ(file.block_count(), (data.size() + options.block_size - 1) / options.block_size);
+
+    std::string all(data.size(), '\0');
+    auto read = file.pread(all.data(), all.size() + 100, 0);
+    ASSERT_TRUE(read.ok());
+    EXPECT_EQ(read.value(), data.size());
+    EXPECT_TRUE(all == data);
+
+    // Random reads across block boundaries
+    std::mt19937 rng(4);
+    for(int i = 0; i < 500; ++i) {
+      const size_t offset = rng() % data.size();
+      const size_t count  = rng() % 40000;
+      std::string buf(count, '\0');
+      auto n = file.pread(buf.data(), count, offset);
+      ASSERT_TRUE(n.ok());
+      const size_t expected = std::min(count, data.size() - offset);
+      ASSERT_EQ(n.value(), expected);
+      EXPECT_EQ(
+          std::string_view(buf.data(), expected), std::string_view(data).substr(offset, count));
+    }
+    EXPECT_EQ(file.pread(all.data(), 1, data.size()).value(), 0u);
+  }
+  unlink(file_name.data());
+}
+
+TEST(CompressedFileTest, CodecChoicePerBlock) {
+  const uint32_t block_size = 64 * 1024;
+  const std::string data    = make_text(block_size) + make_random(block_size);
+  CompressedWriter writer;
+  ASSERT_EQ(writer.open(file_name), StatusCode::ok);
+  ASSERT_EQ(writer.append(data.data(), data.size()), StatusCode::ok);
+  ASSERT_EQ(writer.close(), StatusCode::ok);
+
+  const auto& written = writer.stats();
+  EXPECT_EQ(written.raw_bytes, data.size());
+  CompressedFile file;
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+  ASSERT_EQ(file.block_count(), 2u);
+  EXPECT_EQ(file.block_codec(1), Codec::none);
+  if(any_codec()) {
+    EXPECT_NE(file.block_codec(0), Codec::none);
+    EXPECT_GT(written.ratio(), 1.5);
+  } else {
+    EXPECT_EQ(file.block_codec(0), Codec::none);
+    EXPECT_EQ(written.blocks[0], 2u);
+  }
+
+  // LZ4 alone, when Zstd is disabled
+  if(codec_available(Codec::lz4)) {
+    CompressedWriter::Options options;
+    options.zstd = false;
+    write_file(data, options);
+    CompressedFile lz4;
+    ASSERT_EQ(lz4.open(file_name), StatusCode::ok);
+    EXPECT_EQ(lz4.block_codec(0), Codec::lz4);
+  }
+  unlink(file_name.data());
+}
+
+TEST(CompressedFileTest, CacheStats) {
+  const std::string data = make_text(8 * 4096);
+  CompressedWriter::Options options;
+  options.block_size = 4096;
+  write_file(data, options);
+
+  CompressedFile file;
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+  char buf[100];
+  for(int i = 0; i < 10; ++i) ASSERT_TRUE(file.pread(buf, sizeof(buf), 10).ok());
+  const auto stats = file.stats();
+  if(any_codec()) {
+    EXPECT_EQ(stats.cache_misses, 1u);
+    EXPECT_EQ(stats.cache_hits, 9u);
+    EXPECT_EQ(stats.raw_bytes, 4096u);
+    EXPECT_GT(stats.ratio(), 1.0);
+  } else {
+    EXPECT_EQ(stats.cache_misses + stats.cache_hits, 0u);
+  }
+  unlink(file_name.data());
+}
+
+TEST(CompressedFileTest, ConcurrentReads) {
+  const std::string data = make_text(1 << 20);
+  CompressedWriter::Options options;
+  options.block_size = 8192;
+  write_file(data, options);
+
+  CompressedFile::Options read_options;
+  read_options.cache_blocks = 8;
+  CompressedFile file(read_options);
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+  std::vector<std::thread> threads;
+  std::atomic<int> errors{0};
+  for(uint32_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      std::string buf(3000, '\0');
+      for(int i = 0; i < 1000; ++i) {
+        const size_t offset = rng() % (data.size() - buf.size());
+        auto n              = file.pread(buf.data(), buf.size(), offset);
+        if(!n.ok() || std::string_view(buf) != std::string_view(data).substr(offset, buf.size()))
+          ++errors;
+      }
+    });
+  }
+  for(auto& thread : threads) thread.join();
+  EXPECT_EQ(errors, 0);
+  unlink(file_name.data());
+}
+
+TEST(CompressedFileTest, Dictionary) {
+  if(!codec_available(Codec::zstd)) {
+    EXPECT_EQ(peregrine::internal::train_dictionary({"abc"sv}, 1024).status(), StatusCode::enotsup);
+    GTEST_SKIP() << "Zstd not available";
+  }
+
+  std::vector<std::string> samples;
+  for(uint32_t i = 0; i < 200; ++i) samples.push_back(make_text(1024, i + 10));
+  auto dictionary = peregrine::internal::train_dictionary(
+      std::vector<std::string_view>(samples.begin(), samples.end()), 4096);
+  ASSERT_TRUE(dictionary.ok());
+
+  // Small blocks compress much better with a dictionary
+  const std::string data = make_text(64 * 1024, 5);
+  CompressedWriter::Options options;
+  options.block_size = 1024;
+  options.lz4        = false;
+  write_file(data, options);
+  CompressedFile plain;
+  ASSERT_EQ(plain.open(file_name), StatusCode::ok);
+  std::string all(data.size(), '\0');
+  ASSERT_EQ(plain.pread(all.data(), all.size(), 0).value(), data.size());
+  const double plain_ratio = plain.stats().ratio();
+
+  options.dictionary = dictionary.value();
+  write_file(data, options);
+  CompressedFile trained;
+  ASSERT_EQ(trained.open(file_name), StatusCode::ok);
+  ASSERT_EQ(trained.pread(all.data(), all.size(), 0).value(), data.size());
+  EXPECT_TRUE(all == data);
+  EXPECT_GT(trained.stats().ratio(), plain_ratio);
+  unlink(file_name.data());
+}
+
+TEST(CompressedFileTest, RejectInvalidFiles) {
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    const std::string junk = make_random(1000);
+    ASSERT_EQ(out.write(junk.data(), junk.size()).value(), 1000);
+  }
+  CompressedFile file;
+  EXPECT_EQ(file.open(file_name), StatusCode::invalid_argument);
+
+  // Corrupt the footer of a valid file
+  write_file(make_text(10000));
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_RDWR), StatusCode::ok);
+    struct stat st;
+    ASSERT_EQ(out.stat(&st), StatusCode::ok);
+    const uint64_t raw_size = 1 << 20;
+    const off_t offset      = st.st_size - sizeof(CompressedFile::Footer) +
+                         offsetof(CompressedFile::Footer, raw_size);
+    ASSERT_EQ(out.pwrite(&raw_size, sizeof(raw_size), offset).value(), 8);
+  }
+  EXPECT_EQ(file.open(file_name), StatusCode::invalid_argument);
+  EXPECT_EQ(file.size(), 0u);
+
+  // A block offset whose end wraps around past the dictionary offset
+  write_file(make_text(10000));
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_RDWR), StatusCode::ok);
+    struct stat st;
+    ASSERT_EQ(out.stat(&st), StatusCode::ok);
+    CompressedFile::Footer footer;
+    ASSERT_EQ(out.pread(&footer, sizeof(footer), st.st_size - sizeof(footer)).value(),
+        static_cast<ssize_t>(sizeof(footer)));
+    const uint64_t block_offset = UINT64_MAX - 10;
+    ASSERT_EQ(out.pwrite(&block_offset, sizeof(block_offset), footer.index_offset).value(), 8);
+  }
+  EXPECT_EQ(file.open(file_name), StatusCode::invalid_argument);
+  EXPECT_EQ(file.size(), 0u);
+
+  // A bare footer whose block count wraps around to zero
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    CompressedFile::Footer footer{};
+    footer.magic      = CompressedFile::magic;
+    footer.version    = CompressedFile::version;
+    footer.block_size = 2;
+    footer.raw_size   = UINT64_MAX;
+    ASSERT_EQ(out.write(&footer, sizeof(footer)).value(), static_cast<ssize_t>(sizeof(footer)));
+  }
+  EXPECT_EQ(file.open(file_name), StatusCode::invalid_argument);
+  EXPECT_EQ(file.size(), 0u);
+  unlink(file_name.data());
+}
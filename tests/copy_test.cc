@@ -0,0 +1,146 @@
+#include "peregrine/internal/copy.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+using namespace std::string_view_literals;
+static constexpr auto in_name  = "./test_copy_in.dat"sv;
+static constexpr auto out_name = "./test_copy_out.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::CopyMethod;
+using peregrine::internal::CopyStats;
+using peregrine::internal::File;
+
+namespace {
+
+std::string read_all(const File& file) {
+  struct stat st;
+  file.stat(&st);
+  std::string data(static_cast<size_t>(st.st_size), '\0');
+  file.pread(data.data(), data.size(), 0);
+  return data;
+}
+
+} // namespace
+
+class CopyTest : public ::testing::Test {
+protected:
+  std::string data;
+  File in;
+  File out;
+
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    unlink(in_name.data());
+    unlink(out_name.data());
+
+    data.resize(3 * 1024 * 1024 + 123);
+    for(size_t i = 0; i < data.size(); ++i) data[i] = static_cast<char>(i * 31 + i / 4096);
+    ASSERT_EQ(in.open(in_name, O_CREAT | O_RDWR), StatusCode::ok);
+    ASSERT_EQ(in.pwrite(data.data(), data.size(), 0).value(), static_cast<ssize_t>(data.size()));
+    ASSERT_EQ(out.open(out_name, O_CREAT | O_RDWR), StatusCode::ok);
+  }
+
+  void TearDown() override {
+    in.close();
+    out.close();
+    peregrine::internal::reset_mocks();
+    unlink(in_name.data());
+    unlink(out_name.data());
+  }
+}; // class CopyTest
+
+TEST_F(CopyTest, CopyFile) {
+  CopyStats stats;
+  auto copied = peregrine::internal::copy_file(in, out, &stats);
+  ASSERT_TRUE(copied.ok());
+  EXPECT_EQ(copied.value(), static_cast<off_t>(data.size()));
+  EXPECT_EQ(stats.bytes, copied.value());
+  EXPECT_EQ(read_all(out), data);
+}
+
+TEST_F(CopyTest, CopyRange) {
+  for(auto method : {CopyMethod::copy_file_range, CopyMethod::sendfile, CopyMethod::buffered}) {
+    ASSERT_EQ(out.truncate(0), StatusCode::ok);
+    auto copied = peregrine::internal::copy_range(in, 1000, out, 10, 2'000'000, nullptr, method);
+    ASSERT_TRUE(copied.ok()) << peregrine::internal::copy_method_name(method);
+    EXPECT_EQ(copied.value(), 2'000'000);
+    const auto result = read_all(out);
+    ASSERT_EQ(result.size(), 2'000'010u);
+    EXPECT_EQ(std::string_view(result).substr(10), std::string_view(data).substr(1000, 2'000'000));
+  }
+
+  // Copies stop at the end of the input
+  auto copied = peregrine::internal::copy_range(in, data.size() - 100, out, 0, 1000);
+  EXPECT_EQ(copied.value(), 100);
+}
+
+TEST_F(CopyTest, FallBack) {
+#if defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
+  // Older kernels refuse to copy across file systems
+  peregrine::internal::copy_file_range.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(StatusCode::exdev, 1);
+  CopyStats stats;
+  auto copied = peregrine::internal::copy_file(in, out, &stats);
+  ASSERT_TRUE(copied.ok());
+  EXPECT_EQ(stats.method, CopyMethod::sendfile);
+  EXPECT_EQ(read_all(out), data);
+#endif // defined(PEREGRINE_HAVE_COPY_FILE_RANGE)
+
+#if defined(__linux__)
+  peregrine::internal::sendfile.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(StatusCode::einval, 1);
+  CopyStats buffered;
+  const auto size = static_cast<off_t>(data.size());
+  ASSERT_EQ(out.truncate(0), StatusCode::ok);
+  ASSERT_TRUE(
+      peregrine::internal::copy_range(in, 0, out, 0, size, &buffered, CopyMethod::sendfile).ok());
+  EXPECT_EQ(buffered.method, CopyMethod::buffered);
+  EXPECT_EQ(read_all(out), data);
+#endif // defined(__linux__)
+
+  // Real errors are reported
+  peregrine::internal::pread.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(StatusCode::eio, 1);
+  auto failed = peregrine::internal::copy_range(in, 0, out, 0, 100, nullptr, CopyMethod::buffered);
+  EXPECT_EQ(failed.status(), StatusCode::eio);
+}
+
+TEST_F(CopyTest, IngestFromPipe) {
+  int fds[2];
+  ASSERT_EQ(::pipe(fds), 0);
+  File pipe_in(fds[0]);
+  std::thread writer([&, fd = fds[1]] {
+    File pipe_out(fd);
+    for(size_t offset = 0; offset < data.size();) {
+      const size_t count = std::min<size_t>(65536, data.size() - offset);
+      auto written       = pipe_out.write(data.data() + offset, count);
+      if(!written.ok()) break;
+      offset += static_cast<size_t>(written.value());
+    }
+  });
+
+  CopyStats stats;
+  auto ingested = peregrine::internal::ingest(pipe_in, out, 0, -1, &stats);
+  writer.join();
+  ASSERT_TRUE(ingested.ok());
+  EXPECT_EQ(ingested.value(), static_cast<off_t>(data.size()));
+#if defined(PEREGRINE_HAVE_SPLICE)
+  EXPECT_EQ(stats.method, CopyMethod::splice);
+#endif // defined(PEREGRINE_HAVE_SPLICE)
+  EXPECT_EQ(read_all(out), data);
+}
+
+TEST_F(CopyTest, IngestFromFile) {
+  File source;
+  ASSERT_EQ(source.open(in_name), StatusCode::ok);
+  CopyStats stats;
+  auto ingested = peregrine::internal::ingest(source, out, 5, 1000, &stats);
+  ASSERT_TRUE(ingested.ok());
+  EXPECT_EQ(ingested.value(), 1000);
+  EXPECT_EQ(stats.method, CopyMethod::buffered);
+  EXPECT_EQ(read_all(out).substr(5), data.substr(0, 1000));
+}
@@ -0,0 +1,84 @@
+#include "peregrine/internal/elias_fano.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+#include "test_util.hh"
+
+using peregrine::StatusCode;
+using peregrine::internal::EliasFano;
+
+namespace {
+
+// Offsets of records with random lengths up to `max_gap`, with some repeats
+std::vector<uint64_t> offsets(size_t count, uint64_t max_gap, uint32_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<uint64_t> values;
+  uint64_t offset = rng() % 1000;
+  for(size_t i = 0; i < count; ++i) {
+    values.push_back(offset);
+    offset += rng() % (max_gap + 1);
+  }
+  return values;
+}
+
+} // namespace
+
+TEST(EliasFanoTest, AccessAndLowerBound) {
+  for(uint64_t max_gap : {0ull, 1ull, 100ull, 1ull << 40}) {
+    const auto values = offsets(20000, max_gap, static_cast<uint32_t>(max_gap));
+    auto bytes        = EliasFano::serialize(values);
+    ASSERT_TRUE(bytes.ok());
+    const auto storage = aligned(bytes.value());
+    auto view          = EliasFano::open(storage.data(), bytes->size());
+    ASSERT_TRUE(view.ok()) << max_gap;
+    ASSERT_EQ(view->size(), values.size());
+    EXPECT_EQ(view->universe(), values.back());
+    EXPECT_EQ(view->bytes(), bytes->size());
+
+    for(size_t i = 0; i < values.size(); ++i) ASSERT_EQ(view->at(i), values[i]) << i;
+
+    std::mt19937_64 rng(7);
+    for(int n = 0; n < 20000; ++n) {
+      const uint64_t target = rng() % (values.back() + 2);
+      const auto expected   = std::lower_bound(values.begin(), values.end(), target);
+      ASSERT_EQ(view->lower_bound(target), static_cast<uint64_t>(expected - values.begin()))
+          << target;
+    }
+    EXPECT_EQ(view->lower_bound(values.front()), 0u);
+  }
+}
+
+TEST(EliasFanoTest, Compact) {
+  // Offsets of ~100 byte records take about 2 + log2(100) bits each instead of 64
+  const auto values = offsets(100000, 200, 1);
+  auto bytes        = EliasFano::serialize(values);
+  ASSERT_TRUE(bytes.ok());
+  const double bits_per_value = 8.0 * static_cast<double>(bytes->size()) / values.size();
+  EXPECT_LT(bits_per_value, 10.5);
+}
+
+TEST(EliasFanoTest, Empty) {
+  auto bytes = EliasFano::serialize({});
+  ASSERT_TRUE(bytes.ok());
+  const auto storage = aligned(bytes.value());
+  auto view          = EliasFano::open(storage.data(), bytes->size());
+  ASSERT_TRUE(view.ok());
+  EXPECT_EQ(view->size(), 0u);
+  EXPECT_EQ(view->lower_bound(5), 0u);
+}
+
+TEST(EliasFanoTest, RejectInvalid) {
+  EXPECT_EQ(EliasFano::serialize({1, 3, 2}).status(), StatusCode::invalid_argument);
+
+  auto bytes = EliasFano::serialize(offsets(1000, 50, 2));
+  ASSERT_TRUE(bytes.ok());
+  auto storage = aligned(bytes.value());
+  EXPECT_FALSE(EliasFano::open(storage.data(), bytes->size() - 8).ok());
+
+  auto* header = reinterpret_cast<EliasFano::Header*>(storage.data());
+  header->universe *= 4;
+  EXPECT_FALSE(EliasFano::open(storage.data(), bytes->size()).ok());
+}
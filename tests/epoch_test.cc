@@ -0,0 +1,153 @@
+#include "peregrine/internal/epoch.hh"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "peregrine/internal/file.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_epoch_file.txt"sv;
+
+namespace {
+
+// Counts live instances so tests can observe when retired objects are destroyed.
+struct Tracked {
+  static inline std::atomic<int> live{0};
+  int value;
+  explicit Tracked(int value) : value(value) { ++live; }
+  Tracked(Tracked&& other) noexcept : value(other.value) { ++live; }
+  ~Tracked() { --live; }
+}; // struct Tracked
+
+} // namespace
+
+class EpochTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+    Tracked::live = 0;
+  }
+
+  void TearDown() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+  }
+}; // class EpochTest
+
+TEST_F(EpochTest, ReclaimWithoutReaders) {
+  peregrine::internal::EpochDomain domain;
+
+  domain.retire(Tracked{1});
+  EXPECT_EQ(Tracked::live, 1);
+  EXPECT_EQ(domain.pending(), 1);
+
+  EXPECT_EQ(domain.reclaim(), 1);
+  EXPECT_EQ(Tracked::live, 0);
+  EXPECT_EQ(domain.pending(), 0);
+}
+
+TEST_F(EpochTest, ReclaimWaitsForActiveReader) {
+  peregrine::internal::EpochDomain domain;
+  auto reader = domain.register_reader();
+  EXPECT_TRUE(reader.is_registered());
+
+  reader.enter();
+  EXPECT_TRUE(reader.is_active());
+  domain.retire(Tracked{1});
+  EXPECT_EQ(domain.reclaim(), 0);
+  EXPECT_EQ(Tracked::live, 1);
+
+  // Nested critical sections do not end the outer one
+  reader.enter();
+  reader.leave();
+  EXPECT_EQ(domain.reclaim(), 0);
+  EXPECT_EQ(Tracked::live, 1);
+
+  reader.leave();
+  EXPECT_FALSE(reader.is_active());
+  EXPECT_EQ(domain.reclaim(), 1);
+  EXPECT_EQ(Tracked::live, 0);
+}
+
+TEST_F(EpochTest, ReaderEnteringAfterRetireDoesNotBlock) {
+  peregrine::internal::EpochDomain domain;
+  auto reader = domain.register_reader();
+
+  domain.retire(Tracked{1});
+  {
+    peregrine::internal::EpochGuard guard(reader);
+    EXPECT_EQ(domain.reclaim(), 1);
+  }
+  EXPECT_EQ(Tracked::live, 0);
+}
+
+TEST_F(EpochTest, ReleasedSlotIsReused) {
+  peregrine::internal::EpochDomain domain;
+  {
+    auto reader = domain.register_reader();
+    reader.enter();
+    domain.retire(Tracked{1});
+    // The reader is released while active; its slot must not pin the epoch.
+  }
+  EXPECT_EQ(domain.reclaim(), 1);
+
+  auto a = domain.register_reader();
+  auto b = domain.register_reader();
+  EXPECT_TRUE(a.is_registered());
+  EXPECT_TRUE(b.is_registered());
+}
+
+TEST_F(EpochTest, RetireClosesFile) {
+  peregrine::internal::EpochDomain domain;
+  auto reader = domain.register_reader();
+
+  peregrine::internal::File file;
+  auto status = file.open(file_name, O_CREAT | O_RDWR);
+  EXPECT_EQ(status, peregrine::StatusCode::ok);
+
+  reader.enter();
+  domain.retire(std::move(file));
+  EXPECT_FALSE(file.is_open());
+  EXPECT_EQ(peregrine::internal::close.get_call_count(), 0);
+
+  reader.leave();
+  domain.synchronize();
+  EXPECT_EQ(peregrine::internal::close.get_call_count(), 1);
+}
+
+TEST_F(EpochTest, EpochPointerConcurrentPublish) {
+  peregrine::internal::EpochDomain domain;
+  peregrine::internal::EpochPointer<Tracked> current(domain, std::make_unique<Tracked>(0));
+
+  constexpr int iterations = 2000;
+  std::atomic<bool> done{false};
+  std::atomic<int> bad_reads{0};
+
+  std::vector<std::thread> readers;
+  for(int i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      auto reader = domain.register_reader();
+      int last    = 0;
+      while(!done.load(std::memory_order_relaxed)) {
+        peregrine::internal::EpochGuard guard(reader);
+        const int value = current.load()->value;
+        // Values are published in increasing order and must never go backwards.
+        if(value < last || value > iterations) ++bad_reads;
+        last = value;
+      }
+    });
+  }
+
+  for(int i = 1; i <= iterations; ++i) {
+    current.publish(std::make_unique<Tracked>(i));
+    if(i % 64 == 0) domain.reclaim();
+  }
+  done = true;
+  for(auto& thread : readers) thread.join();
+
+  domain.synchronize();
+  EXPECT_EQ(bad_reads, 0);
+  EXPECT_EQ(Tracked::live, 1);
+}
@@ -0,0 +1,125 @@
+#include "peregrine/internal/file_cache.hh"
+
+#include <gtest/gtest.h>
+
+using namespace std::string_view_literals;
+static constexpr std::string_view file_names[] = {
+    "./test_cache_file_0.txt"sv, "./test_cache_file_1.txt"sv, "./test_cache_file_2.txt"sv};
+
+class FileCacheTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    for(auto name : file_names) {
+      peregrine::internal::File file;
+      ASSERT_EQ(file.open(name, O_CREAT | O_RDWR), peregrine::StatusCode::ok);
+      auto [bytes_written, status] = file.write(name.data(), name.size());
+      ASSERT_EQ(status, peregrine::StatusCode::ok);
+    }
+    peregrine::internal::reset_mocks();
+  }
+
+  void TearDown() override {
+    peregrine::internal::reset_mocks();
+    for(auto name : file_names) unlink(name.data());
+  }
+}; // class FileCacheTest
+
+TEST_F(FileCacheTest, HitAndMiss) {
+  peregrine::internal::FileCache cache(4);
+
+  auto [first, status] = cache.acquire(file_names[0]);
+  EXPECT_EQ(status, peregrine::StatusCode::ok);
+  ASSERT_NE(first, nullptr);
+  EXPECT_TRUE(first->is_open());
+
+  auto [second, status2] = cache.acquire(file_names[0]);
+  EXPECT_EQ(status2, peregrine::StatusCode::ok);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(peregrine::internal::open.get_call_count(), 1);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.open_files, 1);
+  EXPECT_DOUBLE_EQ(stats.hit_rate(), 0.5);
+
+  // The cached descriptor is usable for positional reads
+  std::string buffer(file_names[0].size(), '\0');
+  auto [bytes_read, read_status] = first->pread(buffer.data(), buffer.size(), 0);
+  EXPECT_EQ(read_status, peregrine::StatusCode::ok);
+  EXPECT_EQ(buffer, file_names[0]);
+}
+
+TEST_F(FileCacheTest, EvictsLeastRecentlyUsedIdleFile) {
+  peregrine::internal::FileCache cache(2);
+
+  cache.acquire(file_names[0]);
+  cache.acquire(file_names[1]);
+  cache.acquire(file_names[0]); // file 1 is now least recently used
+  cache.acquire(file_names[2]);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.evictions, 1);
+  EXPECT_EQ(stats.open_files, 2);
+  EXPECT_EQ(peregrine::internal::close.get_call_count(), 1);
+
+  // File 0 is still cached, file 1 is reopened transparently
+  cache.acquire(file_names[0]);
+  EXPECT_EQ(peregrine::internal::open.get_call_count(), 3);
+  auto [reopened, status] = cache.acquire(file_names[1]);
+  EXPECT_EQ(status, peregrine::StatusCode::ok);
+  EXPECT_TRUE(reopened->is_open());
+  EXPECT_EQ(peregrine::internal::open.get_call_count(), 4);
+}
+
+TEST_F(FileCacheTest, BusyFilesAreNotEvicted) {
+  peregrine::internal::FileCache cache(1);
+
+  auto [first, status]   = cache.acquire(file_names[0]);
+  auto [second, status2] = cache.acquire(file_names[1]);
+  EXPECT_EQ(cache.stats().open_files, 2);
+  EXPECT_EQ(cache.stats().evictions, 0);
+  EXPECT_TRUE(first->is_open());
+
+  // Once released, the idle descriptor is evicted on the next insert
+  first.reset();
+  cache.acquire(file_names[2]);
+  EXPECT_EQ(cache.stats().evictions, 1);
+  EXPECT_TRUE(second->is_open());
+}
+
+TEST_F(FileCacheTest, Dup) {
+  peregrine::internal::FileCache cache(2);
+
+  auto [file, status] = cache.dup(file_names[0]);
+  EXPECT_EQ(status, peregrine::StatusCode::ok);
+  EXPECT_TRUE(file.is_open());
+  EXPECT_EQ(peregrine::internal::dup.get_call_count(), 1);
+
+  cache.clear();
+  EXPECT_EQ(cache.stats().open_files, 0);
+  EXPECT_TRUE(file.is_open());
+}
+
+TEST_F(FileCacheTest, OpenError) {
+  peregrine::internal::FileCache cache(2);
+
+  auto [handle, status] = cache.acquire("/this/file/does/not/exist"sv);
+  EXPECT_EQ(status, peregrine::StatusCode::enoent);
+  EXPECT_EQ(handle, nullptr);
+  EXPECT_EQ(cache.stats().open_failures, 1);
+  EXPECT_EQ(cache.stats().open_files, 0);
+}
+
+TEST_F(FileCacheTest, Erase) {
+  peregrine::internal::FileCache cache(2);
+
+  auto [handle, status] = cache.acquire(file_names[0]);
+  EXPECT_TRUE(cache.erase(file_names[0]));
+  EXPECT_FALSE(cache.erase(file_names[0]));
+  EXPECT_TRUE(handle->is_open());
+
+  cache.acquire(file_names[0]);
+  EXPECT_EQ(peregrine::internal::open.get_call_count(), 2);
+}
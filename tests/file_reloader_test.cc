@@ -0,0 +1,155 @@
+#include "peregrine/internal/file_reloader.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+using namespace std::string_view_literals;
+static constexpr auto file_name     = "./test_reload_file.txt"sv;
+static constexpr auto tmp_file_name = "./test_reload_file.txt.tmp"sv;
+
+namespace {
+
+void write_file(std::string_view path, std::string_view data) {
+  peregrine::internal::File file;
+  ASSERT_EQ(file.open(path, O_CREAT | O_TRUNC | O_WRONLY), peregrine::StatusCode::ok);
+  auto [bytes_written, status] = file.write(data.data(), data.size());
+  ASSERT_EQ(status, peregrine::StatusCode::ok);
+  ASSERT_EQ(bytes_written, data.size());
+}
+
+std::string_view mapped_view(const peregrine::internal::MappedIndex* index) {
+  return {static_cast<const char*>(index->map.data()), index->map.size()};
+}
+
+} // namespace
+
+class FileReloaderTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+    unlink(tmp_file_name.data());
+  }
+
+  void TearDown() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+    unlink(tmp_file_name.data());
+  }
+}; // class FileReloaderTest
+
+TEST_F(FileReloaderTest, ReloadMissingFile) {
+  peregrine::internal::EpochDomain domain;
+  peregrine::internal::FileReloader reloader(domain, std::string(file_name));
+
+  auto result = reloader.reload();
+  EXPECT_EQ(result.status, peregrine::StatusCode::enoent);
+  EXPECT_FALSE(result.changed);
+  EXPECT_EQ(reloader.load(), nullptr);
+}
+
+TEST_F(FileReloaderTest, ReloadKeepsUnchangedMapping) {
+  write_file(file_name, "generation one"sv);
+
+  peregrine::internal::EpochDomain domain;
+  auto reader = domain.register_reader();
+  peregrine::internal::FileReloader reloader(domain, std::string(file_name));
+
+  auto result = reloader.reload();
+  EXPECT_EQ(result.status, peregrine::StatusCode::ok);
+  EXPECT_TRUE(result.changed);
+  EXPECT_EQ(result.generation, 1);
+  EXPECT_EQ(peregrine::internal::mmap.get_call_count(), 1);
+
+  result = reloader.reload();
+  EXPECT_EQ(result.status, peregrine::StatusCode::ok);
+  EXPECT_FALSE(result.changed);
+  EXPECT_EQ(result.generation, 1);
+  EXPECT_EQ(peregrine::internal::mmap.get_call_count(), 1);
+
+  peregrine::internal::EpochGuard guard(reader);
+  EXPECT_EQ(mapped_view(reloader.load()), "generation one"sv);
+}
+
+TEST_F(FileReloaderTest, ValidationFailureKeepsCurrentMapping) {
+  write_file(file_name, "good"sv);
+
+  peregrine::internal::FileReloader::Options options;
+  options.validator = [](const peregrine::internal::File&,
+                          const peregrine::internal::MmapFile& map) {
+    return std::string_view(static_cast<const char*>(map.data()), map.size()) == "bad"sv
+               ? peregrine::StatusCode::invalid_argument
+               : peregrine::StatusCode::ok;
+  };
+
+  peregrine::internal::EpochDomain domain;
+  auto reader = domain.register_reader();
+  peregrine::internal::FileReloader reloader(domain, std::string(file_name), options);
+  EXPECT_EQ(reloader.reload().status, peregrine::StatusCode::ok);
+
+  write_file(tmp_file_name, "bad"sv);
+  ASSERT_EQ(rename(tmp_file_name.data(), file_name.data()), 0);
+
+  auto result = reloader.reload();
+  EXPECT_EQ(result.status, peregrine::StatusCode::invalid_argument);
+  EXPECT_FALSE(result.changed);
+  EXPECT_EQ(result.generation, 1);
+
+  peregrine::internal::EpochGuard guard(reader);
+  EXPECT_EQ(mapped_view(reloader.load()), "good"sv);
+}
+
+TEST_F(FileReloaderTest, MapError) {
+  write_file(file_name, "data"sv);
+
+  peregrine::internal::EpochDomain domain;
+  peregrine::internal::FileReloader reloader(domain, std::string(file_name));
+
+  peregrine::internal::mmap.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(peregrine::StatusCode::enomem, 1);
+
+  auto result = reloader.reload();
+  EXPECT_EQ(result.status, peregrine::StatusCode::enomem);
+  EXPECT_FALSE(result.changed);
+  EXPECT_EQ(reloader.load(), nullptr);
+}
+
+#if defined(__linux__)
+
+TEST_F(FileReloaderTest, WatchPublishesRenamedFile) {
+  write_file(file_name, "old"sv);
+
+  peregrine::internal::EpochDomain domain;
+  auto reader = domain.register_reader();
+  peregrine::internal::FileReloader reloader(domain, std::string(file_name));
+  EXPECT_EQ(reloader.reload().status, peregrine::StatusCode::ok);
+  EXPECT_EQ(reloader.watch(), peregrine::StatusCode::ok);
+
+  // Nothing happened yet
+  auto result = reloader.poll(0);
+  EXPECT_EQ(result.status, peregrine::StatusCode::ok);
+  EXPECT_FALSE(result.changed);
+
+  // A reader keeps using the old mapping across the swap
+  reader.enter();
+  const auto* old_index = reloader.load();
+
+  write_file(tmp_file_name, "new contents"sv);
+  ASSERT_EQ(rename(tmp_file_name.data(), file_name.data()), 0);
+
+  result = reloader.poll(1000);
+  EXPECT_EQ(result.status, peregrine::StatusCode::ok);
+  EXPECT_TRUE(result.changed);
+  EXPECT_EQ(result.generation, 2);
+  EXPECT_EQ(mapped_view(old_index), "old"sv);
+  EXPECT_EQ(domain.pending(), 1);
+
+  reader.leave();
+  domain.synchronize();
+
+  peregrine::internal::EpochGuard guard(reader);
+  EXPECT_EQ(mapped_view(reloader.load()), "new contents"sv);
+}
+
+#endif // defined(__linux__)
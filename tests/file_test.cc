@@ -298,6 +298,48 @@ TEST_F(FileTest, PreadPWrite) {
   EXPECT_FALSE(file.is_open());
 }
 
+TEST_F(FileTest, PreadExactPwriteAll) {
+  peregrine::internal::File file;
+  ASSERT_EQ(file.open(file_name, O_CREAT | O_RDWR), peregrine::StatusCode::ok);
+
+  constexpr auto data = "Hello, World!"sv;
+  EXPECT_EQ(file.pwrite_all(data.data(), data.size(), 0), peregrine::StatusCode::ok);
+  std::string buffer(data.size(), '\0');
+  EXPECT_EQ(file.pread_exact(buffer.data(), buffer.size(), 0), peregrine::StatusCode::ok);
+  EXPECT_EQ(buffer, data);
+
+  // Reading past the end of the file
+  EXPECT_EQ(
+      file.pread_exact(buffer.data(), buffer.size(), 1), peregrine::StatusCode::invalid_argument);
+
+  // Interrupted calls are retried
+  {
+    peregrine::internal::pwrite.mock_return_value();
+    peregrine::internal::errno_to_status.mock_return_value(peregrine::StatusCode::eintr, 1);
+    EXPECT_EQ(file.pwrite_all("J", 1, 0), peregrine::StatusCode::ok);
+
+    peregrine::internal::pread.mock_return_value();
+    peregrine::internal::errno_to_status.mock_return_value(peregrine::StatusCode::eintr, 1);
+    EXPECT_EQ(file.pread_exact(buffer.data(), 5, 0), peregrine::StatusCode::ok);
+    EXPECT_EQ(buffer.substr(0, 5), "Jello"sv);
+  }
+
+  // A write that makes no progress fails instead of spinning
+  {
+    peregrine::internal::pwrite.mock_return_value(0, 1);
+    EXPECT_EQ(file.pwrite_all(data.data(), data.size(), 0), peregrine::StatusCode::eio);
+  }
+
+  // Other errors are returned
+  {
+    peregrine::internal::pread.mock_return_value();
+    peregrine::internal::errno_to_status.mock_return_value(peregrine::StatusCode::eacces, 1);
+    EXPECT_EQ(file.pread_exact(buffer.data(), 2, 0), peregrine::StatusCode::eacces);
+  }
+
+  EXPECT_EQ(file.close(), peregrine::StatusCode::ok);
+}
+
 TEST_F(FileTest, ReadvWritev) {
   peregrine::internal::File file;
   EXPECT_FALSE(file.is_open());
@@ -0,0 +1,180 @@
+#include "peregrine/internal/index_file.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_index_file.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::AccessMode;
+using peregrine::internal::AccessProfile;
+using peregrine::internal::EpochDomain;
+using peregrine::internal::EpochGuard;
+using peregrine::internal::IndexFile;
+
+namespace {
+
+constexpr off_t MiB = off_t{1} << 20;
+
+// Options under which any non-empty file counts as large and cold
+IndexFile::Options large_file_options() {
+  IndexFile::Options options;
+  options.small_file_size     = 0;
+  options.max_memory_fraction = 0.0;
+  options.resident_fraction   = 2.0;
+  options.min_reads           = 64;
+  return options;
+}
+
+} // namespace
+
+class IndexFileTest : public ::testing::Test {
+protected:
+  std::string data;
+
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+    data.resize(256 * 1024);
+    for(size_t i = 0; i < data.size(); ++i) data[i] = static_cast<char>('a' + i % 26);
+    peregrine::internal::File file;
+    ASSERT_EQ(file.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    ASSERT_EQ(file.write(data.data(), data.size()).value(), static_cast<ssize_t>(data.size()));
+  }
+
+  void TearDown() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+  }
+}; // class IndexFileTest
+
+TEST(IndexFilePolicyTest, Choose) {
+  IndexFile::Options options;
+  AccessProfile profile;
+  profile.memory_size = 16 * 1024 * MiB;
+
+  // Small and comfortably fitting files are mapped
+  profile.file_size = MiB;
+  EXPECT_EQ(IndexFile::choose(profile, options), AccessMode::mmap);
+  profile.file_size = 4 * 1024 * MiB;
+  EXPECT_EQ(IndexFile::choose(profile, options), AccessMode::mmap);
+
+  // Large, cold files start out with pread()
+  profile.file_size = 64 * 1024 * MiB;
+  EXPECT_EQ(IndexFile::choose(profile, options), AccessMode::pread);
+
+  // ... unless they are mostly resident or read sequentially
+  profile.resident_fraction = 0.9;
+  EXPECT_EQ(IndexFile::choose(profile, options), AccessMode::mmap);
+  profile.resident_fraction = 0.1;
+  profile.reads             = 1000;
+  profile.sequential_reads  = 900;
+  EXPECT_EQ(IndexFile::choose(profile, options), AccessMode::mmap);
+  profile.sequential_reads = 100;
+  EXPECT_EQ(IndexFile::choose(profile, options), AccessMode::pread);
+}
+
+TEST_F(IndexFileTest, ReadInBothModes) {
+  EpochDomain domain;
+  auto reader = domain.register_reader();
+  IndexFile file(domain);
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+  EXPECT_EQ(file.size(), static_cast<off_t>(data.size()));
+  EXPECT_EQ(file.mode(), AccessMode::mmap);
+
+  for(auto mode : {AccessMode::mmap, AccessMode::pread}) {
+    ASSERT_EQ(file.set_mode(mode), StatusCode::ok);
+    EpochGuard guard(reader);
+    EXPECT_EQ(file.mapping() != nullptr, mode == AccessMode::mmap);
+
+    char buffer[100];
+    ASSERT_EQ(file.read(buffer, sizeof(buffer), 1000).value(), 100);
+    EXPECT_EQ(std::string_view(buffer, 100), std::string_view(data).substr(1000, 100));
+
+    // Reads are clipped at the end of the file
+    const auto tail = static_cast<off_t>(data.size() - 10);
+    EXPECT_EQ(file.read(buffer, sizeof(buffer), tail).value(), 10);
+    EXPECT_EQ(file.read(buffer, sizeof(buffer), file.size()).value(), 0);
+  }
+  EXPECT_EQ(file.switch_count(), 1u);
+}
+
+TEST_F(IndexFileTest, Residency) {
+  EpochDomain domain;
+  IndexFile file(domain);
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+
+  // The file was just written, so it is in the page cache
+  auto resident = file.residency();
+  ASSERT_TRUE(resident.ok());
+  EXPECT_GT(resident.value(), 0.5);
+  EXPECT_LE(resident.value(), 1.0);
+
+  peregrine::internal::mincore.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(StatusCode::enomem, 1);
+  EXPECT_EQ(file.residency().status(), StatusCode::enomem);
+}
+
+TEST_F(IndexFileTest, AdaptToAccessPattern) {
+  EpochDomain domain;
+  auto reader = domain.register_reader();
+  IndexFile file(domain, large_file_options());
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+  EXPECT_EQ(file.mode(), AccessMode::pread);
+
+  char buffer[512];
+  auto read_at = [&](off_t offset) {
+    EpochGuard guard(reader);
+    ASSERT_EQ(file.read(buffer, sizeof(buffer), offset).value(), 512);
+  };
+
+  // Too few reads to decide
+  for(off_t offset = 0; offset < 16 * 512; offset += 512) read_at(offset);
+  EXPECT_EQ(file.adapt().value(), AccessMode::pread);
+
+  // A sequential scan switches to the mapping
+  for(off_t offset = 16 * 512; offset < 256 * 512; offset += 512) read_at(offset);
+  EXPECT_EQ(file.adapt().value(), AccessMode::mmap);
+  EXPECT_EQ(file.switch_count(), 1u);
+
+  // Random lookups switch back
+  for(int i = 0; i < 128; ++i) read_at(static_cast<off_t>((i * 7919) % 400) * 512);
+  EXPECT_EQ(file.adapt().value(), AccessMode::pread);
+  EXPECT_EQ(file.switch_count(), 2u);
+}
+
+TEST_F(IndexFileTest, SwitchWhileReading) {
+  EpochDomain domain;
+  IndexFile file(domain);
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> mismatches{0};
+  std::vector<std::thread> readers;
+  for(int t = 0; t < 4; ++t) {
+    readers.emplace_back([&, t] {
+      auto reader = domain.register_reader();
+      char buffer[64];
+      for(off_t offset = t * 64; !stop.load(); offset = (offset + 4096) % (200 * 1024)) {
+        EpochGuard guard(reader);
+        auto result = file.read(buffer, sizeof(buffer), offset);
+        const auto expected = std::string_view(data).substr(offset, 64);
+        if(!result.ok() || std::string_view(buffer, 64) != expected) ++mismatches;
+      }
+    });
+  }
+
+  for(int i = 0; i < 200; ++i) {
+    EXPECT_EQ(file.set_mode(i % 2 == 0 ? AccessMode::pread : AccessMode::mmap), StatusCode::ok);
+    std::this_thread::yield();
+  }
+  stop = true;
+  for(auto& thread : readers) thread.join();
+  domain.synchronize();
+  EXPECT_EQ(mismatches.load(), 0u);
+}
@@ -0,0 +1,113 @@
+#include "peregrine/internal/io_pool.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_io_pool_file.txt"sv;
+static constexpr auto data      = "Hello, World!"sv;
+
+class AsyncReaderTest : public ::testing::Test {
+protected:
+  peregrine::internal::File file;
+
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+
+    ASSERT_EQ(file.open(file_name, O_CREAT | O_RDWR), peregrine::StatusCode::ok);
+    auto [bytes_written, status] = file.write(data.data(), data.size());
+    ASSERT_EQ(status, peregrine::StatusCode::ok);
+    ASSERT_EQ(bytes_written, data.size());
+  }
+
+  void TearDown() override {
+    file.close();
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+  }
+}; // class AsyncReaderTest
+
+TEST_F(AsyncReaderTest, RunsTasks) {
+  std::atomic<int> count{0};
+  {
+    peregrine::internal::IoThreadPool pool(2);
+    EXPECT_EQ(pool.size(), 2);
+    for(int i = 0; i < 100; ++i) pool.submit([&] { ++count; });
+  }
+  EXPECT_EQ(count, 100);
+}
+
+TEST_F(AsyncReaderTest, CachedReadCompletesInline) {
+  peregrine::internal::IoThreadPool pool(1);
+  peregrine::internal::AsyncReader reader(pool);
+
+  std::string buffer(5, '\0');
+  auto future = reader.pread(file, buffer.data(), buffer.size(), 7);
+
+#if defined(PEREGRINE_HAVE_PREADV2)
+  // The data was just written, so it is in the page cache
+  EXPECT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+  EXPECT_EQ(reader.stats().inline_reads, 1);
+  EXPECT_EQ(peregrine::internal::pread.get_call_count(), 0);
+#endif // defined(PEREGRINE_HAVE_PREADV2)
+
+  auto [bytes_read, status] = future.get();
+  EXPECT_EQ(status, peregrine::StatusCode::ok);
+  EXPECT_EQ(bytes_read, 5);
+  EXPECT_EQ(buffer, "World"sv);
+}
+
+#if defined(PEREGRINE_HAVE_PREADV2)
+
+TEST_F(AsyncReaderTest, CacheMissIsOffloaded) {
+  peregrine::internal::IoThreadPool pool(1);
+  peregrine::internal::AsyncReader reader(pool);
+
+  peregrine::internal::preadv2.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(peregrine::StatusCode::eagain, 1);
+
+  std::string buffer(data.size(), '\0');
+  auto future = reader.pread(file, buffer.data(), buffer.size(), 0);
+  auto [bytes_read, status] = future.get();
+  EXPECT_EQ(status, peregrine::StatusCode::ok);
+  EXPECT_EQ(bytes_read, data.size());
+  EXPECT_EQ(buffer, data);
+
+  EXPECT_EQ(reader.stats().inline_reads, 0);
+  EXPECT_EQ(reader.stats().offloaded_reads, 1);
+  EXPECT_EQ(peregrine::internal::pread.get_call_count(), 1);
+}
+
+TEST_F(AsyncReaderTest, PartialHitReadsRemainder) {
+  peregrine::internal::IoThreadPool pool(1);
+  peregrine::internal::AsyncReader reader(pool);
+
+  // Pretend only the first four bytes were cached
+  peregrine::internal::preadv2.mock_return_value(4, 1);
+
+  std::string buffer(data.size(), '\0');
+  std::memcpy(buffer.data(), data.data(), 4);
+  auto [bytes_read, status] = reader.pread(file, buffer.data(), buffer.size(), 0).get();
+  EXPECT_EQ(status, peregrine::StatusCode::ok);
+  EXPECT_EQ(bytes_read, data.size());
+  EXPECT_EQ(buffer, data);
+  EXPECT_EQ(reader.stats().offloaded_reads, 1);
+}
+
+TEST_F(AsyncReaderTest, HardErrorIsNotOffloaded) {
+  peregrine::internal::IoThreadPool pool(1);
+  peregrine::internal::AsyncReader reader(pool);
+
+  peregrine::internal::preadv2.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(peregrine::StatusCode::eio, 1);
+
+  std::string buffer(data.size(), '\0');
+  auto [bytes_read, status] = reader.pread(file, buffer.data(), buffer.size(), 0).get();
+  EXPECT_EQ(status, peregrine::StatusCode::eio);
+  EXPECT_EQ(bytes_read, -1);
+  EXPECT_EQ(peregrine::internal::pread.get_call_count(), 0);
+}
+
+#endif // defined(PEREGRINE_HAVE_PREADV2)
@@ -0,0 +1,97 @@
+#include "peregrine/internal/io_stats.hh"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "peregrine/internal/file.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_io_stats_file.txt"sv;
+
+using peregrine::internal::IoHistogram;
+using peregrine::internal::IoOp;
+using peregrine::internal::IoStats;
+
+TEST(IoHistogram, Buckets) {
+  // Small values are exact
+  for(uint64_t v = 0; v < IoHistogram::sub_bucket_count; ++v) EXPECT_EQ(IoHistogram::index(v), v);
+
+  // Every value lies within the bounds of its bucket, and buckets are contiguous
+  for(uint64_t v : {4ull, 5ull, 7ull, 8ull, 100ull, 1000ull, 123456ull, 1ull << 39}) {
+    const size_t i = IoHistogram::index(v);
+    EXPECT_LE(IoHistogram::lower_bound(i), v);
+    EXPECT_GE(IoHistogram::upper_bound(i), v);
+    EXPECT_EQ(IoHistogram::upper_bound(i) + 1, IoHistogram::lower_bound(i + 1));
+  }
+
+  // Huge values saturate
+  EXPECT_EQ(IoHistogram::index(UINT64_MAX), IoHistogram::bucket_count - 1);
+}
+
+TEST(IoHistogram, Percentile) {
+  IoHistogram histogram;
+  EXPECT_EQ(histogram.percentile(0.5), 0u);
+
+  for(int i = 0; i < 99; ++i) histogram.counts[IoHistogram::index(1000)]++;
+  histogram.counts[IoHistogram::index(1000000)]++;
+
+  EXPECT_EQ(histogram.count(), 100u);
+  EXPECT_EQ(histogram.percentile(0.5), IoHistogram::upper_bound(IoHistogram::index(1000)));
+  EXPECT_EQ(histogram.percentile(0.99), IoHistogram::upper_bound(IoHistogram::index(1000)));
+  EXPECT_EQ(histogram.percentile(1.0), IoHistogram::upper_bound(IoHistogram::index(1000000)));
+}
+
+TEST(IoStats, RecordFromManyThreads) {
+  IoStats stats;
+  constexpr int thread_count = 16;
+  constexpr int calls        = 1000;
+
+  std::vector<std::thread> threads;
+  for(int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&stats] {
+      for(int i = 0; i < calls; ++i) stats.record(IoOp::pread, 4096, uint64_t{2000});
+      stats.record(IoOp::pread, -1, uint64_t{50});
+    });
+  }
+  for(auto& thread : threads) thread.join();
+
+  auto snapshot = stats.snapshot();
+  const auto& pread = snapshot[IoOp::pread];
+  EXPECT_EQ(pread.calls, uint64_t{thread_count * (calls + 1)});
+  EXPECT_EQ(pread.errors, uint64_t{thread_count});
+  EXPECT_EQ(pread.bytes, uint64_t{thread_count} * calls * 4096);
+  EXPECT_EQ(pread.latency.count(), pread.calls);
+  EXPECT_EQ(snapshot[IoOp::pwrite].calls, 0u);
+
+  stats.reset();
+  EXPECT_EQ(stats.snapshot()[IoOp::pread].calls, 0u);
+}
+
+TEST(IoStats, File) {
+  peregrine::internal::reset_mocks();
+  unlink(file_name.data());
+
+  peregrine::internal::File file;
+  ASSERT_EQ(file.open(file_name, O_CREAT | O_RDWR), peregrine::StatusCode::ok);
+
+  char buffer[16] = "0123456789";
+  file.pwrite(buffer, 10, 0);
+  file.pread(buffer, sizeof(buffer), 0);
+  file.flush();
+
+  auto snapshot = file.io_stats();
+  if constexpr(peregrine::internal::File::io_stats_enabled) {
+    EXPECT_EQ(snapshot[IoOp::pwrite].calls, 1u);
+    EXPECT_EQ(snapshot[IoOp::pwrite].bytes, 10u);
+    EXPECT_EQ(snapshot[IoOp::pread].bytes, 10u);
+    EXPECT_EQ(snapshot[IoOp::fsync].calls, 1u);
+    EXPECT_EQ(snapshot[IoOp::fsync].latency.count(), 1u);
+  } else {
+    EXPECT_EQ(snapshot[IoOp::pwrite].calls, 0u);
+  }
+
+  file.close();
+  unlink(file_name.data());
+}
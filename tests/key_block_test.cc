@@ -0,0 +1,171 @@
+#include "peregrine/internal/key_block.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/mmap_file.hh"
+#include "peregrine/internal/simd.hh"
+#include "test_util.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_key_block.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::KeyBlock;
+using peregrine::internal::KeyBlockBuilder;
+
+namespace {
+
+// Sorted URL-like keys with long shared prefixes
+std::map<std::string, std::string> make_entries(size_t count) {
+  std::mt19937 rng(1);
+  const std::string hosts[] = {"https://example.com/", "https://example.org/docs/"};
+  std::map<std::string, std::string> entries;
+  while(entries.size() < count) {
+    const auto key = hosts[rng() % 2] + "section/" + std::to_string(rng() % 50) + "/item-" +
+                     std::to_string(rng() % 100000);
+    entries[key] = std::to_string(rng());
+  }
+  return entries;
+}
+
+std::string build(const std::map<std::string, std::string>& entries, uint32_t interval = 16) {
+  KeyBlockBuilder builder(interval);
+  for(const auto& [key, value] : entries) EXPECT_EQ(builder.add(key, value), StatusCode::ok);
+  EXPECT_EQ(builder.size(), entries.size());
+  const size_t expected = builder.serialized_size();
+  auto bytes            = builder.finish();
+  EXPECT_EQ(bytes.size(), expected);
+  return bytes;
+}
+
+} // namespace
+
+TEST(KeyBlockTest, Mismatch) {
+  std::string a(100, 'x');
+  for(size_t offset = 0; offset < 4; ++offset) {
+    for(size_t diff = offset; diff < a.size(); ++diff) {
+      std::string b = a;
+      b[diff]       = 'y';
+      EXPECT_EQ(peregrine::internal::mismatch(a.data() + offset, b.data() + offset, 96),
+          std::min<size_t>(diff - offset, 96));
+    }
+  }
+  // Bytes compare unsigned, like memcmp
+  EXPECT_GT(peregrine::internal::compare_bytes("abc\x80", "abc\x7f"), 0);
+  EXPECT_LT(peregrine::internal::compare_bytes("abc", "abcd"), 0);
+  EXPECT_EQ(peregrine::internal::compare_bytes("abcd", "abcd"), 0);
+}
+
+TEST(KeyBlockTest, IterateAndSeek) {
+  const auto entries = make_entries(5000);
+  for(uint32_t interval : {1u, 16u, 64u}) {
+    const auto bytes   = build(entries, interval);
+    const auto storage = aligned(bytes);
+    auto block         = KeyBlock::open(storage.data(), bytes.size());
+    ASSERT_TRUE(block.ok());
+    EXPECT_EQ(block->size(), entries.size());
+    EXPECT_EQ(block->bytes(), bytes.size());
+
+    auto it = block->begin();
+    for(const auto& [key, value] : entries) {
+      ASSERT_TRUE(it.valid());
+      EXPECT_EQ(it.key(), key);
+      EXPECT_EQ(it.value(), value);
+      it.next();
+    }
+    EXPECT_FALSE(it.valid());
+
+    for(const auto& [key, value] : entries) {
+      std::string_view found;
+      ASSERT_TRUE(block->get(key, found)) << key;
+      EXPECT_EQ(found, value);
+
+      // Keys between entries land on the next entry
+      const auto next = entries.upper_bound(key);
+      auto seek       = block->seek(key + "\x01");
+      ASSERT_EQ(seek.valid(), next != entries.end());
+      if(seek.valid()) {
+        EXPECT_EQ(seek.key(), next->first);
+      }
+      EXPECT_FALSE(block->get(key + "\x01", found));
+    }
+
+    EXPECT_EQ(block->seek("").key(), entries.begin()->first);
+    EXPECT_EQ(block->seek("a").key(), entries.begin()->first);
+    EXPECT_FALSE(block->seek("zzz").valid());
+  }
+}
+
+TEST(KeyBlockTest, Compression) {
+  const auto entries = make_entries(5000);
+  size_t raw         = 0;
+  for(const auto& [key, value] : entries) raw += key.size() + value.size();
+  EXPECT_LT(build(entries).size(), raw * 6 / 10);
+}
+
+TEST(KeyBlockTest, RejectUnsortedKeys) {
+  KeyBlockBuilder builder;
+  EXPECT_EQ(builder.add("b", "1"), StatusCode::ok);
+  EXPECT_EQ(builder.add("a", "2"), StatusCode::invalid_argument);
+  EXPECT_EQ(builder.add("b", "2"), StatusCode::invalid_argument);
+  EXPECT_EQ(builder.add("c", "3"), StatusCode::ok);
+  EXPECT_EQ(builder.size(), 2u);
+}
+
+TEST(KeyBlockTest, Empty) {
+  const auto bytes   = KeyBlockBuilder().finish();
+  const auto storage = aligned(bytes);
+  auto block         = KeyBlock::open(storage.data(), bytes.size());
+  ASSERT_TRUE(block.ok());
+  EXPECT_FALSE(block->begin().valid());
+  EXPECT_FALSE(block->seek("a").valid());
+}
+
+TEST(KeyBlockTest, ViewFromMmapFile) {
+  const auto entries = make_entries(2000);
+  const auto bytes   = build(entries);
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    ASSERT_EQ(out.write(bytes.data(), bytes.size()).value(), static_cast<ssize_t>(bytes.size()));
+  }
+
+  peregrine::internal::File in;
+  ASSERT_EQ(in.open(file_name), StatusCode::ok);
+  peregrine::internal::MmapFile map;
+  ASSERT_EQ(map.map(in), StatusCode::ok);
+  auto block = KeyBlock::open(map.data(), map.size());
+  ASSERT_TRUE(block.ok());
+  const auto& [key, value] = *std::next(entries.begin(), 1234);
+  std::string_view found;
+  ASSERT_TRUE(block->get(key, found));
+  EXPECT_EQ(found, value);
+  unlink(file_name.data());
+}
+
+TEST(KeyBlockTest, RejectCorruptBytes) {
+  const auto bytes = build(make_entries(100));
+  auto storage     = aligned(bytes);
+  EXPECT_FALSE(KeyBlock::open(storage.data(), bytes.size() - 1).ok());
+
+  auto* header         = reinterpret_cast<KeyBlock::Header*>(storage.data());
+  auto* prefixes       = reinterpret_cast<uint64_t*>(header + 1);
+  auto* restarts       = reinterpret_cast<uint32_t*>(prefixes + header->restarts);
+  const uint32_t saved = restarts[1];
+  restarts[1]          = saved + 1;
+  EXPECT_FALSE(KeyBlock::open(storage.data(), bytes.size()).ok());
+  restarts[1] = saved;
+
+  // Truncated entries end iteration instead of reading past the block
+  header->entries_bytes -= 3;
+  auto block = KeyBlock::open(storage.data(), bytes.size());
+  ASSERT_TRUE(block.ok());
+  size_t count = 0;
+  for(auto it = block->begin(); it.valid(); it.next()) ++count;
+  EXPECT_EQ(count, 99u);
+}
@@ -0,0 +1,237 @@
+#include "peregrine/internal/merge_iterator.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_merge_iterator.dat"sv;
+
+using peregrine::Result;
+using peregrine::StatusCode;
+using peregrine::internal::MergeEntry;
+using peregrine::internal::MergeIterator;
+using peregrine::internal::MergeSource;
+using peregrine::internal::SortedFile;
+using peregrine::internal::SortedFileSource;
+using peregrine::internal::SortedWriter;
+using peregrine::internal::SpanSource;
+
+namespace {
+
+// Runs of random keys that overlap between and within runs, each version with its own sequence
+struct Runs {
+  std::vector<std::string> keys;
+  std::vector<std::vector<MergeEntry>> runs;
+
+  Runs(size_t count, size_t length, uint32_t seed) {
+    std::mt19937 rng(seed);
+    for(uint32_t i = 0; i < 2000; ++i) {
+      // Shared 8-byte prefixes make the prefix comparisons tie
+      char buf[32];
+      std::snprintf(buf, sizeof(buf), "%s%06u", i % 3 == 0 ? "prefix__" : "", i * 7919 % 100000);
+      keys.emplace_back(buf);
+    }
+    uint64_t sequence = 0;
+    runs.resize(count);
+    for(auto& run : runs) {
+      const size_t n = rng() % (length + 1);
+      for(size_t i = 0; i < n; ++i) {
+        const auto& key = keys[rng() % keys.size()];
+        run.push_back({key, key, ++sequence, rng() % 8 == 0});
+      }
+      std::sort(run.begin(), run.end(), [](const MergeEntry& a, const MergeEntry& b) {
+        return a.key != b.key ? a.key < b.key : a.sequence > b.sequence;
+      });
+    }
+  }
+
+  MergeIterator merge(MergeIterator::Options options) const {
+    std::vector<std::unique_ptr<MergeSource>> sources;
+    for(const auto& run : runs)
+      sources.push_back(std::make_unique<SpanSource>(run.data(), run.size()));
+    return MergeIterator(std::move(sources), options);
+  }
+}; // struct Runs
+
+std::vector<MergeEntry> drain(MergeIterator& merge, size_t batch) {
+  std::vector<MergeEntry> out, buffer(batch);
+  while(true) {
+    auto n = merge.next_batch(buffer.data(), buffer.size());
+    EXPECT_TRUE(n.ok());
+    if(!n.ok() || n.value() == 0) break;
+    out.insert(out.end(), buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(n.value()));
+  }
+  return out;
+}
+
+class FailingSource final : public MergeSource {
+public:
+  Result<size_t> fill(MergeEntry*, size_t) override {
+    return Result<size_t>::error(StatusCode::eio);
+  }
+}; // class FailingSource
+
+} // namespace
+
+TEST(MergeIteratorTest, MatchesSortedConcatenation) {
+  for(size_t count : {0, 1, 2, 3, 7, 16, 33}) {
+    const Runs runs(count, 500, static_cast<uint32_t>(count));
+    std::vector<MergeEntry> all;
+    for(const auto& run : runs.runs) all.insert(all.end(), run.begin(), run.end());
+    std::sort(all.begin(), all.end(), [](const MergeEntry& a, const MergeEntry& b) {
+      return a.key != b.key ? a.key < b.key : a.sequence > b.sequence;
+    });
+
+    // Small batches end often on run boundaries
+    for(size_t batch : {1, 3, 64}) {
+      MergeIterator::Options options;
+      options.resolve_duplicates = false;
+      options.source_batch       = batch;
+      auto merge                 = runs.merge(options);
+      EXPECT_EQ(merge.size(), count);
+      const auto merged = drain(merge, batch + 2);
+      ASSERT_EQ(merged.size(), all.size());
+      for(size_t i = 0; i < all.size(); ++i) {
+        ASSERT_EQ(merged[i].key, all[i].key) << i;
+        ASSERT_EQ(merged[i].sequence, all[i].sequence) << i;
+      }
+      EXPECT_EQ(merge.stats().entries_read, all.size());
+      EXPECT_EQ(merge.stats().entries_returned, all.size());
+    }
+  }
+}
+
+TEST(MergeIteratorTest, ResolvesDuplicatesAndTombstones) {
+  const Runs runs(12, 800, 7);
+  std::map<std::string_view, MergeEntry> newest;
+  size_t total = 0;
+  for(const auto& run : runs.runs) {
+    for(const auto& entry : run) {
+      auto& slot = newest[entry.key];
+      if(slot.key.empty() || entry.sequence > slot.sequence) slot = entry;
+      ++total;
+    }
+  }
+
+  for(bool drop : {false, true}) {
+    for(size_t batch : {1, 5, 256}) {
+      MergeIterator::Options options;
+      options.drop_tombstones = drop;
+      options.source_batch    = batch;
+      auto merge              = runs.merge(options);
+      const auto merged       = drain(merge, 7);
+
+      std::vector<MergeEntry> expected;
+      size_t tombstones = 0;
+      for(const auto& [key, entry] : newest) {
+        if(entry.tombstone && drop) {
+          ++tombstones;
+        } else {
+          expected.push_back(entry);
+        }
+      }
+      ASSERT_EQ(merged.size(), expected.size());
+      for(size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(merged[i].key, expected[i].key) << i;
+        ASSERT_EQ(merged[i].sequence, expected[i].sequence) << i;
+        ASSERT_EQ(merged[i].tombstone, expected[i].tombstone) << i;
+      }
+      const auto& stats = merge.stats();
+      EXPECT_EQ(stats.entries_read, total);
+      EXPECT_EQ(stats.duplicates_dropped, total - newest.size());
+      EXPECT_EQ(stats.tombstones_dropped, tombstones);
+    }
+  }
+}
+
+TEST(MergeIteratorTest, DropsAllVersionsOfDeletedKeys) {
+  const Runs runs(12, 800, 11);
+  std::vector<MergeEntry> all;
+  std::map<std::string_view, MergeEntry> newest;
+  for(const auto& run : runs.runs) {
+    for(const auto& entry : run) {
+      all.push_back(entry);
+      auto& slot = newest[entry.key];
+      if(slot.key.empty() || entry.sequence > slot.sequence) slot = entry;
+    }
+  }
+  std::sort(all.begin(), all.end(), [](const MergeEntry& a, const MergeEntry& b) {
+    return a.key != b.key ? a.key < b.key : a.sequence > b.sequence;
+  });
+
+  // Without resolving duplicates, live keys keep every version and deleted keys keep none
+  std::vector<MergeEntry> expected;
+  for(const auto& entry : all) {
+    if(!newest[entry.key].tombstone) expected.push_back(entry);
+  }
+  for(size_t batch : {1, 5, 256}) {
+    MergeIterator::Options options;
+    options.resolve_duplicates = false;
+    options.drop_tombstones    = true;
+    options.source_batch       = batch;
+    auto merge                 = runs.merge(options);
+    const auto merged          = drain(merge, 7);
+    ASSERT_EQ(merged.size(), expected.size());
+    for(size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_EQ(merged[i].key, expected[i].key) << i;
+      ASSERT_EQ(merged[i].sequence, expected[i].sequence) << i;
+    }
+    EXPECT_EQ(merge.stats().entries_read, all.size());
+  }
+}
+
+TEST(MergeIteratorTest, MergesSortedFiles) {
+  // Three generations of the same keys; generation `g` rewrites every `g + 1`th key
+  std::vector<std::unique_ptr<SortedFile>> files;
+  std::vector<std::unique_ptr<MergeSource>> sources;
+  for(int g = 0; g < 3; ++g) {
+    const std::string path = std::string(file_name) + std::to_string(g);
+    SortedWriter writer;
+    ASSERT_EQ(writer.open(path), StatusCode::ok);
+    for(int i = 0; i < 20000; i += g + 1) {
+      char key[16];
+      std::snprintf(key, sizeof(key), "k%07d", i);
+      ASSERT_EQ(writer.add(key, std::to_string(g)), StatusCode::ok);
+    }
+    ASSERT_EQ(writer.close(), StatusCode::ok);
+
+    files.push_back(std::make_unique<SortedFile>());
+    ASSERT_EQ(files.back()->open(path), StatusCode::ok);
+    auto it = files.back()->scan();
+    it.seek_to_first();
+    sources.push_back(std::make_unique<SortedFileSource>(std::move(it), g));
+    unlink(path.c_str());
+  }
+
+  // Entries of file runs live only until the next batch, so check them as they come
+  MergeIterator merge(std::move(sources));
+  std::vector<MergeEntry> batch(100);
+  int i = 0;
+  for(auto n = merge.next_batch(batch.data(), batch.size()); n.ok() && n.value() != 0;
+      n     = merge.next_batch(batch.data(), batch.size())) {
+    for(size_t j = 0; j < n.value(); ++j, ++i) {
+      const int newest = i % 3 == 0 ? 2 : (i % 2 == 0 ? 1 : 0);
+      char key[16];
+      std::snprintf(key, sizeof(key), "k%07d", i);
+      ASSERT_EQ(batch[j].key, key);
+      ASSERT_EQ(batch[j].value, std::to_string(newest)) << i;
+    }
+  }
+  EXPECT_EQ(i, 20000);
+  EXPECT_EQ(merge.stats().duplicates_dropped, 10000u + 6667u);
+}
+
+TEST(MergeIteratorTest, ReportsSourceErrors) {
+  const Runs runs(1, 10, 1);
+  std::vector<std::unique_ptr<MergeSource>> sources;
+  sources.push_back(std::make_unique<SpanSource>(runs.runs[0].data(), runs.runs[0].size()));
+  sources.push_back(std::make_unique<FailingSource>());
+  MergeIterator merge(std::move(sources));
+  MergeEntry out[4];
+  EXPECT_EQ(merge.next_batch(out, 4).status(), StatusCode::eio);
+  EXPECT_EQ(merge.next_batch(out, 4).status(), StatusCode::eio);
+}
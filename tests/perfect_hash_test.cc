@@ -0,0 +1,151 @@
+#include "peregrine/internal/perfect_hash.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+
+#include "peregrine/internal/mmap_file.hh"
+#include "test_util.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_perfect_hash.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::PerfectHash;
+
+namespace {
+
+// URL-like keys with long shared prefixes
+std::vector<std::string> make_keys(size_t count, const std::string& prefix) {
+  std::mt19937_64 rng(count);
+  std::vector<std::string> keys;
+  for(size_t i = 0; i < count; ++i)
+    keys.push_back(prefix + std::to_string(i) + "/page?id=" + std::to_string(rng() % 1000));
+  return keys;
+}
+
+std::vector<std::string_view> views(const std::vector<std::string>& keys) {
+  return {keys.begin(), keys.end()};
+}
+
+// Check that every key has its own slot
+void expect_minimal_perfect(const PerfectHash& mphf, const std::vector<std::string>& keys) {
+  ASSERT_EQ(mphf.size(), keys.size());
+  std::vector<bool> seen(keys.size(), false);
+  for(const auto& key : keys) {
+    const uint64_t slot = mphf(key);
+    ASSERT_LT(slot, keys.size());
+    ASSERT_FALSE(seen[slot]) << key;
+    seen[slot] = true;
+    EXPECT_EQ(mphf.find(key), slot);
+  }
+}
+
+} // namespace
+
+TEST(PerfectHashTest, Build) {
+  const auto keys = make_keys(200000, "https://example.com/catalog/");
+  PerfectHash::Options options;
+  options.threads = 1;
+  auto bytes      = PerfectHash::build(views(keys), options);
+  ASSERT_TRUE(bytes.ok());
+  const auto storage = aligned(bytes.value());
+  auto mphf          = PerfectHash::open(storage.data(), bytes->size());
+  ASSERT_TRUE(mphf.ok());
+  EXPECT_EQ(mphf->bytes(), bytes->size());
+  expect_minimal_perfect(mphf.value(), keys);
+
+  const double bits_per_key = 8.0 * static_cast<double>(bytes->size()) / keys.size();
+  EXPECT_LT(bits_per_key, 4.0);
+}
+
+TEST(PerfectHashTest, PartitionedParallelBuild) {
+  const auto keys = make_keys(100000, "https://example.org/");
+  PerfectHash::Options options;
+  options.partition_keys = 5000;
+  options.threads        = 4;
+  auto bytes             = PerfectHash::build(views(keys), options);
+  ASSERT_TRUE(bytes.ok());
+  const auto storage = aligned(bytes.value());
+  auto mphf          = PerfectHash::open(storage.data(), bytes->size());
+  ASSERT_TRUE(mphf.ok());
+  expect_minimal_perfect(mphf.value(), keys);
+
+  // The result does not depend on the thread count
+  options.threads = 1;
+  EXPECT_EQ(PerfectHash::build(views(keys), options).value(), bytes.value());
+}
+
+TEST(PerfectHashTest, Fingerprints) {
+  const auto keys   = make_keys(50000, "https://example.net/");
+  const auto others = make_keys(50000, "https://example.invalid/");
+  for(uint32_t bits : {8u, 16u}) {
+    PerfectHash::Options options;
+    options.fingerprint_bits = bits;
+    auto bytes               = PerfectHash::build(views(keys), options);
+    ASSERT_TRUE(bytes.ok());
+    const auto storage = aligned(bytes.value());
+    auto mphf          = PerfectHash::open(storage.data(), bytes->size());
+    ASSERT_TRUE(mphf.ok());
+    EXPECT_EQ(mphf->fingerprint_bits(), bits);
+    expect_minimal_perfect(mphf.value(), keys);
+
+    size_t false_positives = 0;
+    for(const auto& key : others) false_positives += mphf->find(key) != mphf->size();
+    EXPECT_LT(false_positives, others.size() * 2 / (size_t{1} << bits) + 10) << bits;
+  }
+}
+
+TEST(PerfectHashTest, WriteAndMap) {
+  const auto keys = make_keys(30000, "/var/data/");
+  peregrine::internal::File file;
+  ASSERT_EQ(file.open(file_name, O_CREAT | O_TRUNC | O_RDWR), StatusCode::ok);
+  auto written = PerfectHash::build(file, 0, views(keys), {});
+  ASSERT_TRUE(written.ok());
+
+  peregrine::internal::MmapFile map;
+  ASSERT_EQ(map.map(file), StatusCode::ok);
+  ASSERT_EQ(map.size(), written.value());
+  auto mphf = PerfectHash::open(map.data(), map.size());
+  ASSERT_TRUE(mphf.ok());
+  expect_minimal_perfect(mphf.value(), keys);
+  unlink(file_name.data());
+}
+
+TEST(PerfectHashTest, Small) {
+  for(size_t count : {0, 1, 2, 10}) {
+    const auto keys = make_keys(count, "k");
+    auto bytes      = PerfectHash::build(views(keys), {});
+    ASSERT_TRUE(bytes.ok()) << count;
+    const auto storage = aligned(bytes.value());
+    auto mphf          = PerfectHash::open(storage.data(), bytes->size());
+    ASSERT_TRUE(mphf.ok()) << count;
+    expect_minimal_perfect(mphf.value(), keys);
+  }
+}
+
+TEST(PerfectHashTest, RejectInvalid) {
+  auto keys = make_keys(1000, "dup/");
+  keys.push_back(keys[10]);
+  EXPECT_EQ(PerfectHash::build(views(keys), {}).status(), StatusCode::invalid_argument);
+
+  PerfectHash::Options options;
+  options.fingerprint_bits = 12;
+  EXPECT_EQ(PerfectHash::build({}, options).status(), StatusCode::invalid_argument);
+
+  keys.pop_back();
+  auto bytes = PerfectHash::build(views(keys), {});
+  ASSERT_TRUE(bytes.ok());
+  auto storage = aligned(bytes.value());
+  EXPECT_FALSE(PerfectHash::open(storage.data(), bytes->size() - 8).ok());
+  auto* header       = reinterpret_cast<PerfectHash::Header*>(storage.data());
+  header->partitions = 2;
+  EXPECT_FALSE(PerfectHash::open(storage.data(), bytes->size()).ok());
+
+  // Pilots wider than a word would shift out of range in lookups
+  storage            = aligned(bytes.value());
+  header             = reinterpret_cast<PerfectHash::Header*>(storage.data());
+  header->pilot_bits = 200;
+  EXPECT_FALSE(PerfectHash::open(storage.data(), bytes->size()).ok());
+}
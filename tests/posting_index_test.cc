@@ -0,0 +1,161 @@
+#include "peregrine/internal/posting_index.hh"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/mmap_file.hh"
+#include "test_util.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_posting_index.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::PostingIndex;
+using peregrine::internal::PostingIndexBuilder;
+using Retrieval = PostingIndex::Retrieval;
+
+namespace {
+
+constexpr uint32_t vocabulary = 2000;
+
+// Documents of Zipf-distributed terms, so a few terms are very common
+std::string make_index(uint32_t docs, PostingIndexBuilder::Options options = {}) {
+  std::mt19937 rng(1);
+  std::vector<double> weights(vocabulary);
+  for(uint32_t i = 0; i < vocabulary; ++i) weights[i] = 1.0 / (i + 1);
+  std::discrete_distribution<uint32_t> zipf(weights.begin(), weights.end());
+
+  PostingIndexBuilder builder(options);
+  for(uint32_t doc = 0; doc < docs; ++doc) {
+    std::vector<uint32_t> terms(20 + rng() % 200);
+    for(auto& term : terms) term = zipf(rng);
+    EXPECT_EQ(builder.add(terms), doc);
+  }
+  EXPECT_EQ(builder.size(), docs);
+  auto bytes = builder.finish();
+  EXPECT_TRUE(bytes.ok());
+  return bytes.value();
+}
+
+void expect_same(const std::vector<PostingIndex::Hit>& a, const std::vector<PostingIndex::Hit>& b) {
+  ASSERT_EQ(a.size(), b.size());
+  for(size_t i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(a[i].score, b[i].score) << i;
+    EXPECT_EQ(a[i].doc, b[i].doc) << i;
+  }
+}
+
+} // namespace
+
+TEST(PostingIndexTest, BlockMaxWandMatchesExhaustive) {
+  const auto bytes   = make_index(20000);
+  const auto storage = aligned(bytes);
+  auto index         = PostingIndex::open(storage.data(), bytes.size());
+  ASSERT_TRUE(index.ok());
+  EXPECT_EQ(index->size(), 20000u);
+  EXPECT_EQ(index->bytes(), bytes.size());
+
+  std::mt19937 rng(2);
+  const std::vector<std::vector<uint32_t>> queries = {
+      {0}, {0, 1}, {0, 5, 50}, {3, 30, 300, 1999}, {1, 1, 2}, {700, 800}, {5000}};
+  for(size_t k : {1, 10, 100}) {
+    for(const auto& query : queries) {
+      PostingIndex::QueryStats exhaustive_stats, wand_stats;
+      const auto expected = index->top_k(query, k, Retrieval::exhaustive, &exhaustive_stats);
+      const auto found    = index->top_k(query, k, Retrieval::block_max_wand, &wand_stats);
+      expect_same(found, expected);
+      EXPECT_EQ(wand_stats.postings, exhaustive_stats.postings);
+      EXPECT_LE(wand_stats.postings_scored, exhaustive_stats.postings_scored);
+      for(size_t i = 1; i < found.size(); ++i) EXPECT_GE(found[i - 1].score, found[i].score);
+    }
+  }
+}
+
+TEST(PostingIndexTest, SkipsMostPostingsOfCommonTerms) {
+  const auto bytes   = make_index(20000);
+  const auto storage = aligned(bytes);
+  auto index         = PostingIndex::open(storage.data(), bytes.size());
+  ASSERT_TRUE(index.ok());
+
+  // A rare term bounds the scores of documents without it, so common terms are mostly skipped
+  PostingIndex::QueryStats stats;
+  const auto hits = index->top_k({0, 1, 2, 1500}, 10, Retrieval::block_max_wand, &stats);
+  EXPECT_EQ(hits.size(), 10u);
+  EXPECT_GT(stats.postings, 30000u);
+  EXPECT_LT(stats.postings_scored * 4, stats.postings);
+}
+
+TEST(PostingIndexTest, Scores) {
+  // Term 1 appears twice in the short document, which ranks first
+  PostingIndexBuilder builder;
+  builder.add({1, 1, 2});
+  builder.add({1, 2, 3, 4, 5, 6});
+  builder.add({2, 3});
+  auto bytes = builder.finish();
+  ASSERT_TRUE(bytes.ok());
+  const auto storage = aligned(bytes.value());
+  auto index         = PostingIndex::open(storage.data(), bytes->size());
+  ASSERT_TRUE(index.ok());
+  EXPECT_EQ(index->terms(), 7u);
+  EXPECT_EQ(index->document_frequency(1), 2u);
+  EXPECT_EQ(index->document_frequency(0), 0u);
+  EXPECT_EQ(index->document_frequency(99), 0u);
+
+  const auto hits = index->top_k({1}, 5);
+  ASSERT_EQ(hits.size(), 2u);
+  EXPECT_EQ(hits[0].doc, 0u);
+  EXPECT_EQ(hits[1].doc, 1u);
+  EXPECT_GT(hits[0].score, hits[1].score);
+  EXPECT_GT(hits[1].score, 0);
+  EXPECT_TRUE(index->top_k({99}, 5).empty());
+  EXPECT_TRUE(index->top_k({1}, 0).empty());
+
+  PostingIndexBuilder::Options options;
+  options.block_size = 0;
+  EXPECT_EQ(PostingIndexBuilder(options).finish().status(), StatusCode::invalid_argument);
+}
+
+TEST(PostingIndexTest, ViewFromMmapFile) {
+  PostingIndexBuilder::Options options;
+  options.block_size = 64;
+  const auto bytes   = make_index(3000, options);
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    ASSERT_EQ(out.write(bytes.data(), bytes.size()).value(), static_cast<ssize_t>(bytes.size()));
+  }
+
+  peregrine::internal::File in;
+  ASSERT_EQ(in.open(file_name), StatusCode::ok);
+  peregrine::internal::MmapFile map;
+  ASSERT_EQ(map.map(in), StatusCode::ok);
+  auto index = PostingIndex::open(map.data(), map.size());
+  ASSERT_TRUE(index.ok());
+  expect_same(index->top_k({4, 40}, 20), index->top_k({4, 40}, 20, Retrieval::exhaustive));
+  unlink(file_name.data());
+}
+
+TEST(PostingIndexTest, RejectCorruptBytes) {
+  const auto bytes = make_index(500);
+  auto storage     = aligned(bytes);
+  EXPECT_FALSE(PostingIndex::open(storage.data(), bytes.size() - 1).ok());
+
+  auto* header = reinterpret_cast<PostingIndex::Header*>(storage.data());
+  auto* terms  = reinterpret_cast<PostingIndex::Term*>(header + 1);
+  terms[3].postings += 1000000;
+  EXPECT_FALSE(PostingIndex::open(storage.data(), bytes.size()).ok());
+  terms[3].postings -= 1000000;
+
+  // Postings out of order
+  auto* blocks = reinterpret_cast<PostingIndex::Block*>(terms + header->terms);
+  auto* docs   = reinterpret_cast<uint32_t*>(blocks + header->blocks);
+  std::swap(docs[terms[0].first_posting], docs[terms[0].first_posting + 1]);
+  EXPECT_FALSE(PostingIndex::open(storage.data(), bytes.size()).ok());
+  std::swap(docs[terms[0].first_posting], docs[terms[0].first_posting + 1]);
+  EXPECT_TRUE(PostingIndex::open(storage.data(), bytes.size()).ok());
+
+  blocks[0].last_doc += 1;
+  EXPECT_FALSE(PostingIndex::open(storage.data(), bytes.size()).ok());
+}
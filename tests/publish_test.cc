@@ -0,0 +1,136 @@
+#include "peregrine/internal/publish.hh"
+
+#include <gtest/gtest.h>
+
+#include <dirent.h>
+
+using namespace std::string_view_literals;
+static constexpr std::string_view file_names[] = {
+    "./test_publish_file_0.txt"sv, "./test_publish_file_1.txt"sv};
+
+namespace {
+
+std::string read_file(std::string_view path) {
+  peregrine::internal::File file;
+  if(file.open(path) != peregrine::StatusCode::ok) return {};
+  std::string buffer(64, '\0');
+  auto [bytes_read, status] = file.read(buffer.data(), buffer.size());
+  buffer.resize(bytes_read > 0 ? bytes_read : 0);
+  return buffer;
+}
+
+// Count leftover temporary files in the current directory
+int count_temp_files() {
+  int count = 0;
+  DIR* dir  = opendir(".");
+  while(auto* entry = readdir(dir)) {
+    if(std::string_view(entry->d_name).find("test_publish_file_"sv) != std::string_view::npos &&
+        std::string_view(entry->d_name).find(".tmp."sv) != std::string_view::npos)
+      ++count;
+  }
+  closedir(dir);
+  return count;
+}
+
+} // namespace
+
+class PublishTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    for(auto name : file_names) unlink(name.data());
+  }
+
+  void TearDown() override {
+    peregrine::internal::reset_mocks();
+    for(auto name : file_names) unlink(name.data());
+  }
+}; // class PublishTest
+
+TEST_F(PublishTest, Commit) {
+  peregrine::internal::PublishBatch batch;
+
+  for(auto name : file_names) {
+    auto [file, status] = batch.create(name);
+    ASSERT_EQ(status, peregrine::StatusCode::ok);
+    ASSERT_NE(file, nullptr);
+    auto [bytes_written, write_status] = file->write(name.data(), name.size());
+    EXPECT_EQ(write_status, peregrine::StatusCode::ok);
+  }
+  EXPECT_EQ(batch.size(), 2);
+  EXPECT_EQ(count_temp_files(), 2);
+
+  // Nothing is visible before commit
+  struct stat st;
+  EXPECT_EQ(stat(file_names[0].data(), &st), -1);
+
+  EXPECT_EQ(batch.commit(), peregrine::StatusCode::ok);
+  EXPECT_EQ(batch.size(), 0);
+  EXPECT_EQ(count_temp_files(), 0);
+  for(auto name : file_names) EXPECT_EQ(read_file(name), name);
+
+  // Two file syncs and a single directory sync
+  EXPECT_EQ(peregrine::internal::fsync.get_call_count(), 3);
+}
+
+TEST_F(PublishTest, NoReplace) {
+  {
+    peregrine::internal::File existing;
+    ASSERT_EQ(existing.open(file_names[0], O_CREAT | O_WRONLY), peregrine::StatusCode::ok);
+    existing.write("old", 3);
+  }
+
+  peregrine::internal::PublishBatch batch;
+  auto [file, status] = batch.create(file_names[0]);
+  ASSERT_EQ(status, peregrine::StatusCode::ok);
+  file->write("new", 3);
+
+  EXPECT_EQ(batch.commit(), peregrine::StatusCode::eexist);
+  EXPECT_EQ(read_file(file_names[0]), "old"sv);
+  EXPECT_EQ(count_temp_files(), 0);
+}
+
+TEST_F(PublishTest, Replace) {
+  {
+    peregrine::internal::File existing;
+    ASSERT_EQ(existing.open(file_names[0], O_CREAT | O_WRONLY), peregrine::StatusCode::ok);
+    existing.write("old", 3);
+  }
+
+  peregrine::internal::PublishBatch::Options options;
+  options.no_replace = false;
+  peregrine::internal::PublishBatch batch(options);
+  auto [file, status] = batch.create(file_names[0]);
+  ASSERT_EQ(status, peregrine::StatusCode::ok);
+  file->write("new", 3);
+
+  EXPECT_EQ(batch.commit(), peregrine::StatusCode::ok);
+  EXPECT_EQ(read_file(file_names[0]), "new"sv);
+}
+
+TEST_F(PublishTest, AbortRemovesTemporaries) {
+  {
+    peregrine::internal::PublishBatch batch;
+    for(auto name : file_names) batch.create(name);
+    EXPECT_EQ(count_temp_files(), 2);
+  }
+  EXPECT_EQ(count_temp_files(), 0);
+
+  struct stat st;
+  for(auto name : file_names) EXPECT_EQ(stat(name.data(), &st), -1);
+}
+
+TEST_F(PublishTest, FlushError) {
+  peregrine::internal::PublishBatch batch;
+  for(auto name : file_names) batch.create(name);
+
+  peregrine::internal::fsync.mock_return_value();
+  peregrine::internal::errno_to_status.mock_return_value(peregrine::StatusCode::eio, 1);
+
+  EXPECT_EQ(batch.commit(), peregrine::StatusCode::eio);
+  EXPECT_EQ(batch.size(), 0);
+  EXPECT_EQ(count_temp_files(), 0);
+
+  struct stat st;
+  for(auto name : file_names) EXPECT_EQ(stat(name.data(), &st), -1);
+}
@@ -0,0 +1,51 @@
+#include "peregrine/result.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <sys/types.h>
+
+using peregrine::Result;
+using peregrine::StatusCode;
+
+static_assert(sizeof(Result<ssize_t>) == sizeof(int64_t));
+static_assert(sizeof(Result<off_t>) == sizeof(int64_t));
+
+TEST(Result, PackedValue) {
+  Result<ssize_t> result{42};
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(result.value(), 42);
+  EXPECT_EQ(result.status(), StatusCode::ok);
+
+  auto [value, status] = result;
+  EXPECT_EQ(value, 42);
+  EXPECT_EQ(status, StatusCode::ok);
+}
+
+TEST(Result, PackedError) {
+  for(auto code : {StatusCode::eagain, StatusCode::enoent, StatusCode::invalid_argument}) {
+    auto result = Result<ssize_t>::error(code);
+    EXPECT_FALSE(result.ok());
+    EXPECT_EQ(result.status(), code);
+    EXPECT_EQ(result.value(), -1);
+  }
+
+  // A status of ok keeps the value even when it is zero
+  Result<off_t> zero{0, StatusCode::ok};
+  EXPECT_TRUE(zero.ok());
+  EXPECT_EQ(zero.value(), 0);
+}
+
+TEST(Result, GenericValue) {
+  Result<std::string> result{std::string("peregrine")};
+  EXPECT_TRUE(result);
+  EXPECT_EQ(result->size(), 9u);
+
+  auto error = Result<std::string>::error(StatusCode::eacces);
+  EXPECT_FALSE(error);
+  EXPECT_EQ(error.status(), StatusCode::eacces);
+
+  auto [value, status] = std::move(result);
+  EXPECT_EQ(value, "peregrine");
+  EXPECT_EQ(status, StatusCode::ok);
+}
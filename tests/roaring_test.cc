@@ -0,0 +1,211 @@
+#include "peregrine/internal/roaring.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <random>
+
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/mmap_file.hh"
+#include "test_util.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_roaring.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::RoaringBitmap;
+using peregrine::internal::RoaringContainerType;
+using peregrine::internal::RoaringView;
+
+namespace {
+
+// Sorted, unique values mixing sparse, dense and run-heavy chunks
+std::vector<uint32_t> make_values(uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint32_t> values;
+  for(uint32_t i = 0; i < 3000; ++i) values.push_back(rng() % (1u << 20));   // Sparse
+  for(uint32_t i = 0; i < 30000; ++i) values.push_back((5u << 16) | (rng() & 0xffff)); // Dense
+  const uint32_t start = (9u << 16) + rng() % 1000;
+  for(uint32_t v = start; v < start + 20000; ++v) values.push_back(v); // One long run
+  values.push_back(0xffffffffu);
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  return values;
+}
+
+template <typename Op>
+std::vector<uint32_t> expected(
+    const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, Op op) {
+  std::vector<uint32_t> out;
+  op(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+  return out;
+}
+
+} // namespace
+
+TEST(RoaringTest, BuildAndQuery) {
+  const auto values = make_values(1);
+  auto bitmap       = RoaringBitmap::from_values(values);
+  EXPECT_EQ(bitmap.cardinality(), values.size());
+  EXPECT_EQ(bitmap.to_vector(), values);
+  for(uint32_t v : {values.front(), values.back(), values[values.size() / 2]})
+    EXPECT_TRUE(bitmap.contains(v));
+  EXPECT_FALSE(bitmap.contains(0xfffffffeu));
+
+  // Optimizing turns the long run into a run container without changing the set
+  bitmap.optimize();
+  bool has_run = false;
+  for(size_t i = 0; i < bitmap.container_count(); ++i)
+    has_run |= bitmap.container(i).type == RoaringContainerType::run;
+  EXPECT_TRUE(has_run);
+  EXPECT_EQ(bitmap.to_vector(), values);
+}
+
+TEST(RoaringTest, AddRange) {
+  RoaringBitmap bitmap;
+  bitmap.add_range(65530, 200000);
+  bitmap.add(7);
+  EXPECT_EQ(bitmap.cardinality(), 200000u - 65530u + 1);
+  EXPECT_TRUE(bitmap.contains(65530));
+  EXPECT_TRUE(bitmap.contains(199999));
+  EXPECT_FALSE(bitmap.contains(200000));
+  bitmap.optimize();
+  EXPECT_LT(bitmap.serialized_size(), 200u);
+  EXPECT_EQ(bitmap.cardinality(), 200000u - 65530u + 1);
+}
+
+TEST(RoaringTest, SetOperations) {
+  for(uint32_t seed = 0; seed < 4; ++seed) {
+    const auto a = make_values(seed);
+    const auto b = make_values(seed + 100);
+    auto x       = RoaringBitmap::from_values(a);
+    auto y       = RoaringBitmap::from_values(b);
+    if(seed % 2 == 1) {
+      x.optimize();
+      y.optimize();
+    }
+
+    const auto both = expected(a, b, [](auto... args) { return std::set_intersection(args...); });
+    const auto any  = expected(a, b, [](auto... args) { return std::set_union(args...); });
+    const auto only = expected(a, b, [](auto... args) { return std::set_difference(args...); });
+
+    EXPECT_EQ(peregrine::internal::roaring_and(x, y).to_vector(), both);
+    EXPECT_EQ(peregrine::internal::roaring_or(x, y).to_vector(), any);
+    EXPECT_EQ(peregrine::internal::roaring_andnot(x, y).to_vector(), only);
+    EXPECT_EQ(peregrine::internal::roaring_and_cardinality(x, y), both.size());
+  }
+}
+
+TEST(RoaringTest, SkewedArrays) {
+  std::vector<uint32_t> small, large;
+  for(uint32_t v = 0; v < 4000; ++v) large.push_back(v * 16);
+  for(uint32_t v = 0; v < 100; ++v) small.push_back(v * 640 + (v % 2));
+  auto x = RoaringBitmap::from_values(small);
+  auto y = RoaringBitmap::from_values(large);
+  const auto both =
+      expected(small, large, [](auto... args) { return std::set_intersection(args...); });
+  EXPECT_EQ(peregrine::internal::roaring_and(x, y).to_vector(), both);
+  EXPECT_EQ(peregrine::internal::roaring_and_cardinality(y, x), both.size());
+}
+
+TEST(RoaringTest, ViewInPlace) {
+  const auto a = make_values(7);
+  const auto b = make_values(8);
+  auto x       = RoaringBitmap::from_values(a);
+  x.optimize();
+  auto y = RoaringBitmap::from_values(b);
+
+  const auto bytes   = x.serialize();
+  ASSERT_EQ(bytes.size(), x.serialized_size());
+  const auto storage = aligned(bytes);
+  auto view          = RoaringView::open(storage.data(), bytes.size());
+  ASSERT_TRUE(view.ok());
+  EXPECT_EQ(view->cardinality(), a.size());
+  EXPECT_EQ(view->size(), bytes.size());
+  EXPECT_EQ(view->to_vector(), a);
+  EXPECT_TRUE(view->contains(a[123]));
+  EXPECT_FALSE(view->contains(0xfffffffeu));
+
+  // Views and owned bitmaps mix freely
+  const auto both = expected(a, b, [](auto... args) { return std::set_intersection(args...); });
+  EXPECT_EQ(peregrine::internal::roaring_and(view.value(), y).to_vector(), both);
+  EXPECT_EQ(peregrine::internal::roaring_and_cardinality(y, view.value()), both.size());
+}
+
+TEST(RoaringTest, ViewFromMmapFile) {
+  const auto values = make_values(3);
+  const auto bytes  = RoaringBitmap::from_values(values).serialize();
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    ASSERT_EQ(out.write(bytes.data(), bytes.size()).value(), static_cast<ssize_t>(bytes.size()));
+  }
+
+  peregrine::internal::File in;
+  ASSERT_EQ(in.open(file_name), StatusCode::ok);
+  peregrine::internal::MmapFile map;
+  ASSERT_EQ(map.map(in), StatusCode::ok);
+  auto view = RoaringView::open(map.data(), map.size());
+  ASSERT_TRUE(view.ok());
+  EXPECT_EQ(view->to_vector(), values);
+  unlink(file_name.data());
+}
+
+TEST(RoaringTest, RejectCorruptBytes) {
+  const auto bytes = RoaringBitmap::from_values(make_values(5)).serialize();
+  auto storage     = aligned(bytes);
+
+  // Truncated
+  EXPECT_FALSE(RoaringView::open(storage.data(), bytes.size() - 1).ok());
+  // Misaligned
+  EXPECT_FALSE(RoaringView::open(reinterpret_cast<char*>(storage.data()) + 1, 64).ok());
+
+  // Bad magic
+  auto* header  = reinterpret_cast<RoaringView::Header*>(storage.data());
+  header->magic = 0;
+  EXPECT_FALSE(RoaringView::open(storage.data(), bytes.size()).ok());
+  header->magic = RoaringView::magic;
+
+  // Payload out of bounds
+  auto* entry   = reinterpret_cast<RoaringView::Entry*>(header + 1);
+  entry->offset = static_cast<uint32_t>(bytes.size());
+  EXPECT_FALSE(RoaringView::open(storage.data(), bytes.size()).ok());
+}
+
+TEST(RoaringTest, RejectCorruptContainers) {
+  // One array container and one container of two runs
+  std::vector<uint32_t> values = {3, 70, 900};
+  for(uint32_t v = 0x10000 + 100; v < 0x10000 + 5000; ++v) values.push_back(v);
+  for(uint32_t v = 0x10000 + 6000; v < 0x10000 + 9000; ++v) values.push_back(v);
+  auto bitmap = RoaringBitmap::from_values(values);
+  bitmap.optimize();
+  const auto bytes = bitmap.serialize();
+
+  const auto corrupt = [&](auto mutate) {
+    auto storage = aligned(bytes);
+    auto* header = reinterpret_cast<RoaringView::Header*>(storage.data());
+    auto* entry  = reinterpret_cast<RoaringView::Entry*>(header + 1);
+    ASSERT_EQ(entry[0].type, static_cast<uint8_t>(RoaringContainerType::array));
+    ASSERT_EQ(entry[1].type, static_cast<uint8_t>(RoaringContainerType::run));
+    auto* base = reinterpret_cast<char*>(storage.data());
+    mutate(entry, reinterpret_cast<uint16_t*>(base + entry[0].offset),
+        reinterpret_cast<uint16_t*>(base + entry[1].offset));
+    EXPECT_FALSE(RoaringView::open(storage.data(), bytes.size()).ok());
+  };
+  auto storage = aligned(bytes);
+  ASSERT_TRUE(RoaringView::open(storage.data(), bytes.size()).ok());
+
+  // Arrays out of order or with duplicates
+  corrupt([](RoaringView::Entry*, uint16_t* array, uint16_t*) { std::swap(array[0], array[1]); });
+  corrupt([](RoaringView::Entry*, uint16_t* array, uint16_t*) { array[1] = array[0]; });
+  // A run past the end of the chunk, which would write past the bitmap words
+  corrupt([](RoaringView::Entry*, uint16_t*, uint16_t* runs) { runs[0] = 0xff00; });
+  // Overlapping runs
+  corrupt([](RoaringView::Entry*, uint16_t*, uint16_t* runs) {
+    runs[2] = static_cast<uint16_t>(runs[0] + runs[1]);
+  });
+  // Runs that do not add up to the cardinality
+  corrupt([](RoaringView::Entry*, uint16_t*, uint16_t* runs) { --runs[1]; });
+}
@@ -0,0 +1,111 @@
+#include "peregrine/internal/shared_region.hh"
+
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+
+#include <cstring>
+
+using namespace std::string_view_literals;
+static constexpr auto socket_name = "./test_shared_region.sock"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::DescriptorChannel;
+using peregrine::internal::File;
+using peregrine::internal::SharedRegion;
+
+class SharedRegionTest : public ::testing::Test {
+protected:
+  void SetUp() override { peregrine::internal::reset_mocks(); }
+
+  void TearDown() override {
+    peregrine::internal::reset_mocks();
+    unlink(socket_name.data());
+  }
+}; // class SharedRegionTest
+
+TEST_F(SharedRegionTest, CreateAndSeal) {
+  SharedRegion region;
+  ASSERT_EQ(region.create("test"sv, 8192), StatusCode::ok);
+  EXPECT_EQ(region.size(), 8192u);
+  EXPECT_EQ(region.create("test"sv, 8192), StatusCode::already_open);
+  std::memset(region.data(), 'a', region.size());
+
+  ASSERT_EQ(region.seal(), StatusCode::ok);
+  EXPECT_EQ(static_cast<const char*>(region.data())[8191], 'a');
+
+#if defined(PEREGRINE_HAVE_MEMFD)
+  // Sealed regions refuse writable shared mappings and resizing
+  peregrine::internal::MmapFile map;
+  File file = region.file().dup().value();
+  EXPECT_NE(map.map(file, PROT_READ | PROT_WRITE, MAP_SHARED), StatusCode::ok);
+  EXPECT_NE(file.truncate(0), StatusCode::ok);
+#endif // defined(PEREGRINE_HAVE_MEMFD)
+}
+
+TEST_F(SharedRegionTest, SendAndAttach) {
+  DescriptorChannel sender, receiver;
+  ASSERT_EQ(DescriptorChannel::pair(sender, receiver), StatusCode::ok);
+
+  SharedRegion region;
+  ASSERT_EQ(region.create("test"sv, 4096), StatusCode::ok);
+  std::memcpy(region.data(), "shared", 7);
+  ASSERT_EQ(region.seal(), StatusCode::ok);
+  ASSERT_EQ(sender.send(region.file(), "index"sv), StatusCode::ok);
+
+  std::string tag;
+  auto file = receiver.receive(tag);
+  ASSERT_TRUE(file.ok());
+  EXPECT_EQ(tag, "index");
+
+  SharedRegion attached;
+  ASSERT_EQ(attached.attach(std::move(file).value()), StatusCode::ok);
+  EXPECT_EQ(attached.size(), 4096u);
+  EXPECT_STREQ(static_cast<const char*>(attached.data()), "shared");
+
+  // The receiver sees end of stream once the sender is closed
+  sender.close();
+  EXPECT_EQ(receiver.receive(tag).status(), StatusCode::econnreset);
+}
+
+TEST_F(SharedRegionTest, ForkedWorker) {
+  SharedRegion region;
+  ASSERT_EQ(region.create("test"sv, 4096), StatusCode::ok);
+  std::memcpy(region.data(), "loaded", 7);
+  ASSERT_EQ(region.seal(), StatusCode::ok);
+
+  DescriptorChannel server;
+  ASSERT_EQ(server.listen(socket_name), StatusCode::ok);
+
+  const pid_t pid = fork();
+  ASSERT_NE(pid, -1);
+  if(pid == 0) {
+    // Worker: connect, receive the region and check its contents
+    DescriptorChannel client;
+    if(client.connect(socket_name) != StatusCode::ok) _exit(1);
+    std::string tag;
+    auto file = client.receive(tag);
+    if(!file.ok() || tag != "region") _exit(2);
+    SharedRegion attached;
+    if(attached.attach(std::move(file).value()) != StatusCode::ok) _exit(3);
+    _exit(std::strcmp(static_cast<const char*>(attached.data()), "loaded") == 0 ? 0 : 4);
+  }
+
+  auto connection = server.accept();
+  ASSERT_TRUE(connection.ok());
+  ASSERT_EQ(connection->send(region.file(), "region"sv), StatusCode::ok);
+
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST_F(SharedRegionTest, TagTooLong) {
+  DescriptorChannel sender, receiver;
+  ASSERT_EQ(DescriptorChannel::pair(sender, receiver), StatusCode::ok);
+  SharedRegion region;
+  ASSERT_EQ(region.create("test"sv, 4096), StatusCode::ok);
+  const std::string tag(DescriptorChannel::max_tag_size + 1, 't');
+  EXPECT_EQ(sender.send(region.file(), tag), StatusCode::invalid_argument);
+}
@@ -0,0 +1,224 @@
+#include "peregrine/internal/sorted_file.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <random>
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_sorted_file.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::SortedFile;
+using peregrine::internal::SortedWriter;
+
+namespace {
+
+constexpr size_t count = 50000;
+
+std::string key_of(size_t i) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "key%08zu", i * 2);
+  return buf;
+}
+
+std::string value_of(size_t i) { return std::string(i % 37, static_cast<char>('a' + i % 26)); }
+
+void write_file(size_t block_size = 4096) {
+  SortedWriter::Options options;
+  options.block_size = block_size;
+  SortedWriter writer(options);
+  ASSERT_EQ(writer.open(file_name), StatusCode::ok);
+  for(size_t i = 0; i < count; ++i) ASSERT_EQ(writer.add(key_of(i), value_of(i)), StatusCode::ok);
+  ASSERT_EQ(writer.close(), StatusCode::ok);
+}
+
+} // namespace
+
+class SortedFileTest : public ::testing::Test {
+protected:
+  void SetUp() override { unlink(file_name.data()); }
+
+  void TearDown() override { unlink(file_name.data()); }
+}; // class SortedFileTest
+
+TEST_F(SortedFileTest, ScanAndSeek) {
+  write_file();
+  peregrine::internal::IoThreadPool pool(2);
+  peregrine::internal::AsyncReader reader(pool);
+
+  // Mapped, read with pread(), and read ahead on the I/O pool
+  for(int mode = 0; mode < 3; ++mode) {
+    SortedFile::Options options;
+    options.use_mmap = mode == 0;
+    options.reader   = mode == 2 ? &reader : nullptr;
+    SortedFile file(options);
+    ASSERT_EQ(file.open(file_name), StatusCode::ok);
+    EXPECT_EQ(file.mapped(), mode == 0);
+    EXPECT_GT(file.block_count(), 100u);
+
+    auto it  = file.scan();
+    size_t i = 0;
+    for(it.seek_to_first(); it.valid(); it.next(), ++i) {
+      ASSERT_EQ(it.key(), key_of(i));
+      ASSERT_EQ(it.value(), value_of(i));
+    }
+    EXPECT_EQ(i, count);
+    EXPECT_EQ(it.status(), StatusCode::ok);
+
+    for(it.seek_to_last(); it.valid(); it.prev()) {
+      --i;
+      ASSERT_EQ(it.key(), key_of(i));
+      ASSERT_EQ(it.value(), value_of(i));
+    }
+    EXPECT_EQ(i, 0u);
+
+    // Keys between and around the stored ones
+    it.seek(key_of(1234));
+    ASSERT_TRUE(it.valid());
+    EXPECT_EQ(it.key(), key_of(1234));
+    it.seek("key00002469"sv);
+    ASSERT_TRUE(it.valid());
+    EXPECT_EQ(it.key(), key_of(1235));
+    it.prev();
+    it.prev();
+    EXPECT_EQ(it.key(), key_of(1233));
+    it.seek(""sv);
+    EXPECT_EQ(it.key(), key_of(0));
+    it.seek("zzz"sv);
+    EXPECT_FALSE(it.valid());
+    EXPECT_EQ(it.status(), StatusCode::ok);
+  }
+}
+
+TEST_F(SortedFileTest, ReadsAheadOnSequentialScans) {
+  write_file();
+  peregrine::internal::IoThreadPool pool(2);
+  peregrine::internal::AsyncReader reader(pool);
+  SortedFile::Options options;
+  options.use_mmap = false;
+  options.reader   = &reader;
+  SortedFile file(options);
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+
+  // Windows on the I/O pool serve almost every block of a scan in either direction
+  for(bool forward : {true, false}) {
+    auto it = file.scan();
+    for(forward ? it.seek_to_first() : it.seek_to_last(); it.valid();
+        forward ? it.next() : it.prev()) {}
+    const auto& stats = it.stats();
+    EXPECT_EQ(stats.blocks, file.block_count());
+    EXPECT_LE(stats.reads, 3u);
+    EXPECT_GT(stats.readahead_windows, 3u);
+    EXPECT_LT(stats.readahead_windows, stats.blocks / 4);
+  }
+
+  // Random seeks never read ahead
+  auto it = file.scan();
+  std::mt19937 rng(1);
+  for(int i = 0; i < 200; ++i) {
+    it.seek(key_of(rng() % count));
+    ASSERT_TRUE(it.valid());
+  }
+  EXPECT_EQ(it.stats().readahead_windows, 0u);
+  EXPECT_EQ(it.stats().reads, it.stats().blocks);
+
+  // A mapped scan advises windows instead of reading them
+  SortedFile mapped;
+  ASSERT_EQ(mapped.open(file_name), StatusCode::ok);
+  auto scan = mapped.scan();
+  for(scan.seek_to_first(); scan.valid(); scan.next()) {}
+  EXPECT_EQ(scan.stats().reads, 0u);
+  EXPECT_GT(scan.stats().readahead_windows, 3u);
+  EXPECT_GT(scan.stats().readahead_bytes, scan.stats().readahead_windows * 128 * 1024);
+}
+
+TEST_F(SortedFileTest, DropBehindBulkScans) {
+  write_file();
+  for(bool use_mmap : {true, false}) {
+    SortedFile::Options options;
+    options.use_mmap = use_mmap;
+    SortedFile file(options);
+    ASSERT_EQ(file.open(file_name), StatusCode::ok);
+
+    SortedFile::ScanOptions scan_options;
+    scan_options.initial_window = 64 * 1024;
+    scan_options.drop_behind    = true;
+    for(bool forward : {true, false}) {
+      auto it  = file.scan(scan_options);
+      size_t n = 0;
+      for(forward ? it.seek_to_first() : it.seek_to_last(); it.valid();
+          forward ? it.next() : it.prev()) {
+        ++n;
+      }
+      EXPECT_EQ(n, count);
+      EXPECT_GT(it.stats().dropped_bytes, 0u);
+      EXPECT_LE(it.stats().dropped_bytes, file.block_count() * 4096);
+    }
+
+    // Scans that are not bulk keep their pages
+    auto it = file.scan();
+    for(it.seek_to_first(); it.valid(); it.next()) {}
+    EXPECT_EQ(it.stats().dropped_bytes, 0u);
+  }
+}
+
+TEST_F(SortedFileTest, EmptyFile) {
+  SortedWriter writer;
+  ASSERT_EQ(writer.open(file_name), StatusCode::ok);
+  ASSERT_EQ(writer.close(), StatusCode::ok);
+
+  SortedFile file;
+  ASSERT_EQ(file.open(file_name), StatusCode::ok);
+  EXPECT_EQ(file.block_count(), 0u);
+  auto it = file.scan();
+  it.seek_to_first();
+  EXPECT_FALSE(it.valid());
+  it.seek("a"sv);
+  EXPECT_FALSE(it.valid());
+  EXPECT_EQ(it.status(), StatusCode::ok);
+}
+
+TEST_F(SortedFileTest, RejectCorruptFiles) {
+  SortedWriter writer;
+  ASSERT_EQ(writer.open(file_name), StatusCode::ok);
+  EXPECT_EQ(writer.add("b"sv, "1"sv), StatusCode::ok);
+  EXPECT_EQ(writer.add("a"sv, "2"sv), StatusCode::invalid_argument);
+  EXPECT_EQ(writer.add("b"sv, "2"sv), StatusCode::invalid_argument);
+  ASSERT_EQ(writer.close(), StatusCode::ok);
+
+  write_file();
+  peregrine::internal::File f;
+  ASSERT_EQ(f.open(file_name, O_RDWR), StatusCode::ok);
+  struct stat st;
+  ASSERT_EQ(f.stat(&st), StatusCode::ok);
+
+  // A bad footer
+  SortedFile::Footer footer;
+  ASSERT_EQ(f.pread(&footer, sizeof(footer), st.st_size - sizeof(footer)).value(),
+      static_cast<ssize_t>(sizeof(footer)));
+  auto bad = footer;
+  bad.index_offset += 8;
+  ASSERT_TRUE(f.pwrite(&bad, sizeof(bad), st.st_size - sizeof(bad)).ok());
+  EXPECT_EQ(SortedFile().open(file_name), StatusCode::invalid_argument);
+  ASSERT_TRUE(f.pwrite(&footer, sizeof(footer), st.st_size - sizeof(footer)).ok());
+
+  // A bad data block is found when the iterator reaches it
+  const uint32_t garbage = 0;
+  ASSERT_TRUE(f.pwrite(&garbage, sizeof(garbage), 0).ok());
+  for(bool use_mmap : {true, false}) {
+    SortedFile::Options options;
+    options.use_mmap = use_mmap;
+    SortedFile file(options);
+    ASSERT_EQ(file.open(file_name), StatusCode::ok);
+    auto it = file.scan();
+    it.seek(key_of(count - 1));
+    EXPECT_TRUE(it.valid());
+    it.seek_to_first();
+    EXPECT_FALSE(it.valid());
+    EXPECT_EQ(it.status(), StatusCode::invalid_argument);
+  }
+
+  ASSERT_EQ(f.truncate(st.st_size - 1), StatusCode::ok);
+  EXPECT_EQ(SortedFile().open(file_name), StatusCode::invalid_argument);
+}
@@ -0,0 +1,105 @@
+#include "peregrine/internal/syscall_trace.hh"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "peregrine/internal/file.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_syscall_trace.json"sv;
+
+using peregrine::internal::SyscallTracer;
+using peregrine::internal::SyscallTraceScope;
+
+class SyscallTraceTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    SyscallTracer::clear();
+    unlink(file_name.data());
+  }
+
+  void TearDown() override {
+    peregrine::internal::reset_mocks();
+    SyscallTracer::clear();
+    unlink(file_name.data());
+  }
+}; // class SyscallTraceTest
+
+TEST_F(SyscallTraceTest, RecordFromManyThreads) {
+  constexpr int thread_count = 4;
+  constexpr int calls        = 100;
+
+  std::vector<std::thread> threads;
+  for(int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([] {
+      for(int i = 0; i < calls; ++i) {
+        SyscallTraceScope scope("pread", 3, static_cast<void*>(nullptr), size_t{4096}, off_t{i});
+        scope.finish(ssize_t{4096});
+      }
+    });
+  }
+  for(auto& thread : threads) thread.join();
+
+  auto events = SyscallTracer::events();
+  ASSERT_EQ(events.size(), size_t{thread_count * calls});
+  for(size_t i = 1; i < events.size(); ++i) EXPECT_LE(events[i - 1].start_ns, events[i].start_ns);
+
+  // The pointer argument is skipped
+  const auto& event = events.front();
+  EXPECT_STREQ(event.name, "pread");
+  EXPECT_EQ(event.result, 4096);
+  EXPECT_EQ(event.arg_count, 3);
+  EXPECT_EQ(event.args[0], 3);
+  EXPECT_EQ(event.args[1], 4096);
+}
+
+TEST_F(SyscallTraceTest, KeepsMostRecentEvents) {
+  constexpr size_t capacity = peregrine::internal::detail::SyscallTraceBuffer::capacity;
+  std::thread thread([] {
+    for(size_t i = 0; i < capacity + 10; ++i) {
+      SyscallTraceScope scope("read", static_cast<int64_t>(i));
+      scope.finish(0);
+    }
+  });
+  thread.join();
+
+  auto events = SyscallTracer::events();
+  ASSERT_EQ(events.size(), capacity - 1);
+  EXPECT_EQ(events.back().args[0], static_cast<int64_t>(capacity + 9));
+}
+
+TEST_F(SyscallTraceTest, RecordsErrno) {
+  std::thread thread([] {
+    SyscallTraceScope scope("open", 0);
+    errno = ENOENT;
+    EXPECT_EQ(scope.finish(-1), -1);
+    EXPECT_EQ(errno, ENOENT);
+  });
+  thread.join();
+
+  auto events = SyscallTracer::events();
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].error, ENOENT);
+}
+
+TEST_F(SyscallTraceTest, ExportChromeTrace) {
+  std::thread thread([] {
+    SyscallTraceScope scope("fsync", 7);
+    scope.finish(0);
+  });
+  thread.join();
+
+  auto json = SyscallTracer::to_chrome_trace(SyscallTracer::events());
+  EXPECT_NE(json.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"fsync\""), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(json.find("\"args\":[7]"), std::string::npos);
+
+  ASSERT_EQ(SyscallTracer::export_chrome_trace(file_name), peregrine::StatusCode::ok);
+  struct stat st;
+  ASSERT_EQ(stat(file_name.data(), &st), 0);
+  EXPECT_EQ(static_cast<size_t>(st.st_size), json.size());
+}
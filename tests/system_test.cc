@@ -0,0 +1,126 @@
+#include "peregrine/internal/system.hh"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "peregrine/internal/file.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_system_file.txt"sv;
+
+using peregrine::internal::FaultInjection;
+
+class SystemTest : public ::testing::Test {
+protected:
+  peregrine::internal::File file;
+
+  void SetUp() override {
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+    ASSERT_EQ(file.open(file_name, O_CREAT | O_RDWR), peregrine::StatusCode::ok);
+    std::string data(1024, 'x');
+    ASSERT_EQ(file.pwrite(data.data(), data.size(), 0).value(), 1024);
+  }
+
+  void TearDown() override {
+    file.close();
+    peregrine::internal::reset_mocks();
+    unlink(file_name.data());
+  }
+}; // class SystemTest
+
+TEST_F(SystemTest, InjectEagain) {
+  FaultInjection faults;
+  faults.eagain_probability = 1.0;
+  peregrine::internal::pread.inject(faults);
+
+  char buffer[64];
+  auto result = file.pread(buffer, sizeof(buffer), 0);
+  EXPECT_EQ(result.status(), peregrine::StatusCode::eagain);
+  EXPECT_EQ(peregrine::internal::pread.get_fault_count(), 1u);
+
+  peregrine::internal::pread.clear_injection();
+  EXPECT_EQ(file.pread(buffer, sizeof(buffer), 0).value(), 64);
+}
+
+TEST_F(SystemTest, InjectShortReads) {
+  FaultInjection faults;
+  faults.short_probability = 1.0;
+  faults.seed              = 42;
+  peregrine::internal::pread.inject(faults);
+
+  char buffer[512];
+  for(int i = 0; i < 20; ++i) {
+    auto result = file.pread(buffer, sizeof(buffer), 0);
+    ASSERT_TRUE(result.ok());
+    EXPECT_GE(result.value(), 1);
+    EXPECT_LT(result.value(), 512);
+  }
+  EXPECT_EQ(peregrine::internal::pread.get_fault_count(), 20u);
+}
+
+TEST_F(SystemTest, NoShortTransfersWithoutOffset) {
+  // A short read would leave the file offset past the reported bytes
+  FaultInjection faults;
+  faults.short_probability = 1.0;
+  peregrine::internal::read.inject(faults);
+
+  char buffer[256];
+  for(int i = 0; i < 4; ++i) EXPECT_EQ(file.read(buffer, sizeof(buffer)).value(), 256);
+  EXPECT_EQ(peregrine::internal::read.get_fault_count(), 0u);
+}
+
+TEST_F(SystemTest, InjectLatency) {
+  using namespace std::chrono;
+
+  FaultInjection faults;
+  faults.distribution = FaultInjection::Latency::fixed;
+  faults.latency      = milliseconds(2);
+  peregrine::internal::pread.inject(faults);
+
+  char buffer[64];
+  const auto start = steady_clock::now();
+  for(int i = 0; i < 5; ++i) file.pread(buffer, sizeof(buffer), 0);
+  EXPECT_GE(steady_clock::now() - start, milliseconds(10));
+
+  // Heavy-tailed delays are capped
+  faults.distribution = FaultInjection::Latency::pareto;
+  faults.latency      = microseconds(10);
+  faults.max_latency  = microseconds(100);
+  peregrine::internal::pread.inject(faults);
+  for(int i = 0; i < 100; ++i) EXPECT_TRUE(file.pread(buffer, sizeof(buffer), 0).ok());
+}
+
+TEST_F(SystemTest, ConcurrentCalls) {
+  FaultInjection faults;
+  faults.eintr_probability = 0.5;
+  faults.seed              = 7;
+  peregrine::internal::pread.inject(faults);
+
+  constexpr int thread_count = 8;
+  constexpr int calls        = 500;
+  std::atomic<size_t> failures{0};
+
+  std::vector<std::thread> threads;
+  for(int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([this, &failures] {
+      char buffer[16];
+      for(int i = 0; i < calls; ++i) {
+        auto result = file.pread(buffer, sizeof(buffer), 0);
+        if(!result.ok()) {
+          EXPECT_EQ(result.status(), peregrine::StatusCode::eintr);
+          ++failures;
+        }
+      }
+    });
+  }
+  for(auto& thread : threads) thread.join();
+
+  EXPECT_EQ(peregrine::internal::pread.get_call_count(), size_t{thread_count * calls});
+  EXPECT_EQ(peregrine::internal::pread.get_fault_count(), failures.load());
+  EXPECT_GT(failures.load(), size_t{thread_count * calls / 4});
+  EXPECT_LT(failures.load(), size_t{thread_count * calls * 3 / 4});
+}
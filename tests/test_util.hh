@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Copy serialized bytes into 8-byte aligned storage, as formats viewed in place require
+inline std::vector<uint64_t> aligned(const std::string& bytes) {
+  std::vector<uint64_t> storage((bytes.size() + 7) / 8);
+  std::memcpy(storage.data(), bytes.data(), bytes.size());
+  return storage;
+}
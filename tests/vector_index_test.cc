@@ -0,0 +1,219 @@
+#include "peregrine/internal/vector_index.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "peregrine/internal/file.hh"
+#include "peregrine/internal/mmap_file.hh"
+#include "peregrine/internal/simd.hh"
+#include "test_util.hh"
+
+using namespace std::string_view_literals;
+static constexpr auto file_name = "./test_vector_index.dat"sv;
+
+using peregrine::StatusCode;
+using peregrine::internal::Metric;
+using peregrine::internal::VectorIndex;
+
+namespace {
+
+constexpr uint32_t dim = 24;
+
+// Gaussian clusters, which is closer to real embeddings than uniform noise
+std::vector<float> make_vectors(size_t count, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> normal;
+  std::vector<float> centers(32 * dim);
+  for(auto& x : centers) x = 4 * normal(rng);
+  std::vector<float> vectors(count * dim);
+  for(size_t i = 0; i < count; ++i) {
+    const float* center = centers.data() + (rng() % 32) * dim;
+    for(uint32_t j = 0; j < dim; ++j) vectors[i * dim + j] = center[j] + normal(rng);
+  }
+  return vectors;
+}
+
+std::vector<uint32_t> exact(
+    const VectorIndex& index, const std::vector<float>& vectors, const float* query, size_t k) {
+  std::vector<std::pair<float, uint32_t>> all;
+  for(uint32_t i = 0; i < vectors.size() / dim; ++i) all.emplace_back(index.distance(i, query), i);
+  std::partial_sort(all.begin(), all.begin() + k, all.end());
+  std::vector<uint32_t> ids;
+  for(size_t i = 0; i < k; ++i) ids.push_back(all[i].second);
+  return ids;
+}
+
+double recall(const VectorIndex& index, const std::vector<float>& vectors,
+    const std::vector<float>& queries, size_t k, size_t ef) {
+  size_t hits = 0, total = 0;
+  for(size_t q = 0; q < queries.size() / dim; ++q) {
+    const float* query = queries.data() + q * dim;
+    const auto truth   = exact(index, vectors, query, k);
+    const auto found   = index.search(query, k, ef);
+    EXPECT_EQ(found.size(), k);
+    EXPECT_TRUE(std::is_sorted(found.begin(), found.end(),
+        [](const auto& a, const auto& b) { return a.distance < b.distance; }));
+    for(const auto& neighbor : found) {
+      EXPECT_FLOAT_EQ(neighbor.distance, index.distance(neighbor.id, query));
+      hits += std::count(truth.begin(), truth.end(), neighbor.id);
+    }
+    total += k;
+  }
+  return static_cast<double>(hits) / total;
+}
+
+// Scale vectors to unit length, so inner product ranks like cosine similarity
+std::vector<float> normalized(std::vector<float> vectors) {
+  for(size_t i = 0; i < vectors.size(); i += dim) {
+    const float norm = std::sqrt(peregrine::internal::dot_product(&vectors[i], &vectors[i], dim));
+    for(uint32_t j = 0; j < dim; ++j) vectors[i + j] /= norm;
+  }
+  return vectors;
+}
+
+} // namespace
+
+TEST(VectorIndexTest, DistanceKernels) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> uniform(-1, 1);
+  for(size_t size : {0, 1, 7, 8, 9, 31, 100}) {
+    std::vector<float> a(size), b(size);
+    for(auto& x : a) x = uniform(rng);
+    for(auto& x : b) x = uniform(rng);
+    double l2 = 0, dot = 0;
+    for(size_t i = 0; i < size; ++i) {
+      l2 += (a[i] - b[i]) * (a[i] - b[i]);
+      dot += a[i] * b[i];
+    }
+    EXPECT_NEAR(peregrine::internal::l2_squared(a.data(), b.data(), size), l2, 1e-4);
+    EXPECT_NEAR(peregrine::internal::dot_product(a.data(), b.data(), size), dot, 1e-4);
+  }
+}
+
+TEST(VectorIndexTest, Recall) {
+  for(Metric metric : {Metric::l2, Metric::inner_product}) {
+    auto vectors = make_vectors(4000, 1);
+    auto queries = make_vectors(100, 2);
+    if(metric == Metric::inner_product) {
+      vectors = normalized(std::move(vectors));
+      queries = normalized(std::move(queries));
+    }
+    VectorIndex::Options options;
+    options.metric = metric;
+    auto bytes     = VectorIndex::build(vectors.data(), vectors.size() / dim, dim, options);
+    ASSERT_TRUE(bytes.ok());
+    const auto storage = aligned(bytes.value());
+    auto index         = VectorIndex::open(storage.data(), bytes->size());
+    ASSERT_TRUE(index.ok());
+    EXPECT_EQ(index->size(), 4000u);
+    EXPECT_EQ(index->dim(), dim);
+    EXPECT_EQ(index->metric(), metric);
+    EXPECT_EQ(index->bytes(), bytes->size());
+
+    // Recall rises with `ef`
+    const double low  = recall(index.value(), vectors, queries, 10, 10);
+    const double high = recall(index.value(), vectors, queries, 10, 200);
+    EXPECT_GE(high, low);
+    EXPECT_GT(high, 0.95);
+  }
+}
+
+TEST(VectorIndexTest, FindsItself) {
+  const auto vectors = make_vectors(2000, 3);
+  VectorIndex::Options options;
+  options.threads = 1;
+  auto bytes      = VectorIndex::build(vectors.data(), 2000, dim, options);
+  ASSERT_TRUE(bytes.ok());
+  const auto storage = aligned(bytes.value());
+  auto index         = VectorIndex::open(storage.data(), bytes->size());
+  ASSERT_TRUE(index.ok());
+  size_t found = 0;
+  for(uint32_t i = 0; i < 2000; ++i) {
+    const auto result = index->search(vectors.data() + i * dim, 1);
+    found += !result.empty() && result[0].id == i;
+  }
+  EXPECT_GT(found, 1990u);
+
+  // A single-threaded build repeats exactly
+  EXPECT_EQ(VectorIndex::build(vectors.data(), 2000, dim, options).value(), bytes.value());
+}
+
+TEST(VectorIndexTest, SmallAndEmpty) {
+  VectorIndex::Options options;
+  auto empty = VectorIndex::build(nullptr, 0, dim, options);
+  ASSERT_TRUE(empty.ok());
+  auto storage = aligned(empty.value());
+  auto index   = VectorIndex::open(storage.data(), empty->size());
+  ASSERT_TRUE(index.ok());
+  float query[dim] = {};
+  EXPECT_TRUE(index->search(query, 5).empty());
+
+  const auto vectors = make_vectors(3, 4);
+  auto small         = VectorIndex::build(vectors.data(), 3, dim, options);
+  ASSERT_TRUE(small.ok());
+  storage = aligned(small.value());
+  index   = VectorIndex::open(storage.data(), small->size());
+  ASSERT_TRUE(index.ok());
+  EXPECT_EQ(index->search(vectors.data() + dim, 10).size(), 3u);
+  EXPECT_EQ(index->search(vectors.data() + dim, 10)[0].id, 1u);
+
+  options.m = 1;
+  EXPECT_EQ(VectorIndex::build(vectors.data(), 3, dim, options).status(),
+      StatusCode::invalid_argument);
+  EXPECT_EQ(VectorIndex::build(vectors.data(), 3, 0, VectorIndex::Options{}).status(),
+      StatusCode::invalid_argument);
+}
+
+TEST(VectorIndexTest, ViewFromMmapFile) {
+  const auto vectors = make_vectors(3000, 5);
+  size_t written     = 0;
+  {
+    peregrine::internal::File out;
+    ASSERT_EQ(out.open(file_name, O_CREAT | O_TRUNC | O_WRONLY), StatusCode::ok);
+    auto result = VectorIndex::build(out, 0, vectors.data(), 3000, dim, VectorIndex::Options{});
+    ASSERT_TRUE(result.ok());
+    written = result.value();
+  }
+
+  peregrine::internal::File in;
+  ASSERT_EQ(in.open(file_name), StatusCode::ok);
+  peregrine::internal::MmapFile map;
+  ASSERT_EQ(map.map(in), StatusCode::ok);
+  auto index = VectorIndex::open(map.data(), map.size());
+  ASSERT_TRUE(index.ok());
+  EXPECT_EQ(index->bytes(), written);
+  const auto result = index->search(vectors.data() + 1234 * dim, 5);
+  ASSERT_FALSE(result.empty());
+  EXPECT_EQ(result[0].id, 1234u);
+  unlink(file_name.data());
+}
+
+TEST(VectorIndexTest, RejectCorruptBytes) {
+  const auto vectors = make_vectors(500, 6);
+  auto bytes         = VectorIndex::build(vectors.data(), 500, dim, VectorIndex::Options{});
+  ASSERT_TRUE(bytes.ok());
+  auto storage = aligned(bytes.value());
+  EXPECT_FALSE(VectorIndex::open(storage.data(), bytes->size() - 1).ok());
+
+  // A link past the last node
+  auto* header   = reinterpret_cast<VectorIndex::Header*>(storage.data());
+  auto* vectors_ = reinterpret_cast<float*>(header + 1);
+  auto* bottom   = reinterpret_cast<uint32_t*>(vectors_ + 500 * dim);
+  ASSERT_GT(bottom[0], 0u);
+  const uint32_t saved = bottom[1];
+  bottom[1]            = 500;
+  EXPECT_FALSE(VectorIndex::open(storage.data(), bytes->size()).ok());
+  bottom[1] = saved;
+
+  // A link count over the capacity
+  bottom[0] = 2 * header->m + 1;
+  EXPECT_FALSE(VectorIndex::open(storage.data(), bytes->size()).ok());
+  bottom[0] = 0;
+  EXPECT_TRUE(VectorIndex::open(storage.data(), bytes->size()).ok());
+
+  header->top_level += 1;
+  EXPECT_FALSE(VectorIndex::open(storage.data(), bytes->size()).ok());
+}